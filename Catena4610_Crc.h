@@ -0,0 +1,49 @@
+/*
+
+Module: Catena4610_Crc.h
+
+Function:
+        CRC-32 for records kept in flash.
+
+Copyright:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#ifndef _Catena4610_Crc_h_
+# define _Catena4610_Crc_h_
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace McciCatena4610 {
+
+// CRC-32 (IEEE 802.3, reflected, as used by zlib). Computed bitwise: the
+// records are small and rarely checked, so a 1 KiB table isn't worth
+// the flash. Pass the previous result as crc to continue a computation.
+static inline std::uint32_t crc32(
+    const void *pBuffer,
+    std::size_t nBuffer,
+    std::uint32_t crc = 0
+    )
+    {
+    auto p = static_cast<const std::uint8_t *>(pBuffer);
+
+    crc = ~crc;
+    while (nBuffer-- > 0)
+        {
+        crc ^= *p++;
+        for (unsigned i = 0; i < 8; ++i)
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+        }
+    return ~crc;
+    }
+
+} // namespace McciCatena4610
+
+#endif /* _Catena4610_Crc_h_ */
@@ -0,0 +1,54 @@
+/*
+
+Module: Catena4610_FlashMap.h
+
+Function:
+        Layout of the sketch's data in the MX25V8035F SPI flash.
+
+Copyright:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#ifndef _Catena4610_FlashMap_h_
+# define _Catena4610_FlashMap_h_
+
+#pragma once
+
+#include <cstdint>
+
+namespace McciCatena4610 {
+namespace FlashMap {
+
+// erase granularity of the MX25V8035F.
+constexpr std::uint32_t kSectorSize = 4096;
+// programming granularity: a program must not cross a page boundary.
+constexpr std::uint32_t kPageSize = 256;
+
+// the sketch keeps its data in the top 64 KiB of the 1 MiB part; the
+// rest is left to the platform (e.g. firmware download images).
+constexpr std::uint32_t kSketchBase = 0xF0000;
+
+// LoRaWAN session: two sectors used alternately.
+constexpr std::uint32_t kSessionBase = kSketchBase;
+constexpr std::uint32_t kSessionSectors = 2;
+
+// lifetime touch counters: two sectors used alternately.
+constexpr std::uint32_t kCounterBase = kSessionBase + kSessionSectors * kSectorSize;
+constexpr std::uint32_t kCounterSectors = 2;
+
+// configuration: two sectors used alternately.
+constexpr std::uint32_t kConfigBase = kCounterBase + kCounterSectors * kSectorSize;
+constexpr std::uint32_t kConfigSectors = 2;
+
+constexpr std::uint32_t kSketchEnd = kConfigBase + kConfigSectors * kSectorSize;
+
+static_assert(kSketchEnd <= 0x100000, "flash map overflows the MX25V8035F");
+
+} // namespace FlashMap
+} // namespace McciCatena4610
+
+#endif /* _Catena4610_FlashMap_h_ */
@@ -0,0 +1,54 @@
+/*
+
+Module: Catena4610_MeasurementDefaults.h
+
+Function:
+        Defaults and limits of the measurement loop's configuration.
+
+Copyright:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#ifndef _Catena4610_MeasurementDefaults_h_
+# define _Catena4610_MeasurementDefaults_h_
+
+#pragma once
+
+#include <cstdint>
+
+namespace McciCatena4610 {
+namespace MeasurementDefaults {
+
+// These are cMeasurementLoop's; they're kept here, free of the Arduino
+// headers, so the host tools in extra/ use the same values.
+
+// above this bus voltage (mV), we're running from USB.
+constexpr std::uint16_t kVbusPresentMv = 4000;
+
+// time from starting a sensor read to fetching its results; the
+// shortest sampling period, and the default.
+constexpr std::uint32_t kSensorSettleMs = 50;
+
+// configuration defaults.
+constexpr std::uint32_t kTxCycleSec = 6 * 60;
+constexpr std::uint32_t kFastTxCycleSec = 30;
+constexpr std::uint32_t kFastTxCycleCount = 10;
+constexpr std::uint16_t kThresholdRight = 400;
+constexpr std::uint16_t kThresholdLeft = 270;
+constexpr std::uint16_t kTouchHysteresis = 20;
+constexpr std::uint16_t kTouchDebounce = 1;
+constexpr std::uint32_t kSamplePeriodMs = kSensorSettleMs;
+
+// configuration limits.
+constexpr std::uint32_t kMinTxCycleSec = 10;
+constexpr std::uint32_t kMaxSamplePeriodMs = 10000;
+constexpr std::uint16_t kMaxTouchDebounce = 10;
+
+} // namespace MeasurementDefaults
+} // namespace McciCatena4610
+
+#endif /* _Catena4610_MeasurementDefaults_h_ */
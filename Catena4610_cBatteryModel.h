@@ -0,0 +1,307 @@
+/*
+
+Module: Catena4610_cBatteryModel.h
+
+Function:
+        cBatteryModel: battery state estimate, boost control and uplink
+        interval policy.
+
+Copyright:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#ifndef _Catena4610_cBatteryModel_h_
+# define _Catena4610_cBatteryModel_h_
+
+#pragma once
+
+#include <cstdint>
+
+namespace McciCatena4610 {
+
+/****************************************************************************\
+|
+|   The battery model.
+|
+|   Charge drawn is counted by the caller (time awake, time asleep and
+|   transmissions, each times a current) and passed to consume(). Each
+|   time a battery voltage is read, sampleVbat() smooths it and update()
+|   advances the model. Once per window (kWindowSec) the model takes the
+|   average current and the voltage slope over the window, and from them
+|   predicts the remaining service life two ways: charge left at the
+|   current draw, and time until the voltage trend reaches kEmptyMv. The
+|   shorter wins. The voltage trend is only used below kKneeMv: above
+|   it a LiPo cell's curve is so flat that reading noise swamps the
+|   slope.
+|
+|   If the prediction falls short of the target service life, the uplink
+|   interval stretch factor goes up (at most kMaxStretch); if there's
+|   ample margin it comes back down. The factor is adjusted from its
+|   current value, since the measured draw already reflects it; after a
+|   change, the averages restart so the next step sees the new draw.
+|
+|   The boost regulator is switched with hysteresis: on below kBoostOnMv,
+|   off again only above kBoostOffMv, and always off on USB power.
+|
+|   Time is passed in as seconds of service; nothing here touches the
+|   hardware, so the model can be run over months of virtual time on a
+|   host.
+|
+\****************************************************************************/
+
+class cBatteryModel
+    {
+public:
+    // defaults; see setCapacity() and setTargetLife().
+    static constexpr std::uint32_t kCapacityMah = 1000;
+    static constexpr std::uint32_t kTargetLifeDays = 365;
+
+    // boost regulator hysteresis.
+    static constexpr std::uint16_t kBoostOnMv = 3100;
+    static constexpr std::uint16_t kBoostOffMv = 3250;
+
+    // the battery is considered flat at this voltage; the voltage trend
+    // is believed only below the knee of the discharge curve.
+    static constexpr std::uint16_t kEmptyMv = 3000;
+    static constexpr std::uint16_t kKneeMv = 3600;
+
+    // model update window, and limit on the interval stretch.
+    static constexpr std::uint32_t kWindowSec = 6 * 60 * 60;
+    static constexpr std::uint8_t kMaxStretch = 8;
+
+    static constexpr std::uint32_t kSecPerDay = 24 * 60 * 60;
+    static constexpr std::uint32_t kUasPerMah = 3600 * 1000;
+
+    struct Estimate
+        {
+        std::uint32_t   usedMah;            // charge drawn so far
+        std::uint32_t   averageUa;          // average current, last windows
+        std::int32_t    slopeMvPerDay;      // Vbat trend
+        std::uint32_t   remainingDays;      // predicted life left
+        std::uint16_t   vbatMv;             // smoothed Vbat
+        std::uint8_t    percent;            // charge left
+        std::uint8_t    stretch;            // uplink interval multiplier
+        };
+
+    cBatteryModel()
+        : m_usedUas(0)
+        , m_windowUsedUas(0)
+        , m_capacityMah(kCapacityMah)
+        , m_targetLifeDays(kTargetLifeDays)
+        , m_elapsedSec(0)
+        , m_windowStartSec(0)
+        , m_averageUa(0)
+        , m_vbatMvx16(0)
+        , m_windowVbatMvx16(0)
+        , m_slopeMvPerDay(0)
+        , m_stretch(1)
+        , m_fVbatValid(false)
+        , m_fAverageValid(false)
+        , m_fBoostOn(false)
+        {}
+
+    // neither copyable nor movable
+    cBatteryModel(const cBatteryModel&) = delete;
+    cBatteryModel& operator=(const cBatteryModel&) = delete;
+    cBatteryModel(const cBatteryModel&&) = delete;
+    cBatteryModel& operator=(const cBatteryModel&&) = delete;
+
+    void setCapacity(std::uint32_t capacityMah)
+        {
+        this->m_capacityMah = capacityMah;
+        }
+
+    std::uint32_t getCapacity() const
+        {
+        return this->m_capacityMah;
+        }
+
+    void setTargetLife(std::uint32_t days)
+        {
+        this->m_targetLifeDays = days;
+        }
+
+    // record charge drawn, in microamp-seconds.
+    void consume(std::uint64_t uAs)
+        {
+        this->m_usedUas += uAs;
+        }
+
+    // record a battery voltage reading.
+    void sampleVbat(std::uint16_t mV)
+        {
+        std::uint32_t const mVx16 = std::uint32_t(mV) << 4;
+
+        if (! this->m_fVbatValid)
+            {
+            this->m_vbatMvx16 = mVx16;
+            this->m_windowVbatMvx16 = mVx16;
+            this->m_fVbatValid = true;
+            }
+        else
+            this->m_vbatMvx16 = (this->m_vbatMvx16 * 7 + mVx16) / 8;
+        }
+
+    // advance service time to elapsedSec; closes a window if one is due.
+    // Returns true if the stretch factor changed.
+    bool update(std::uint32_t elapsedSec)
+        {
+        this->m_elapsedSec = elapsedSec;
+
+        std::uint32_t const windowSec = elapsedSec - this->m_windowStartSec;
+        if (windowSec < kWindowSec)
+            return false;
+
+        // average current and voltage slope over the window, smoothed
+        // over a few windows.
+        std::uint32_t const windowUa = std::uint32_t(
+            (this->m_usedUas - this->m_windowUsedUas) / windowSec
+            );
+        std::int32_t const windowSlope = std::int32_t(
+            (std::int64_t(this->m_vbatMvx16) - std::int64_t(this->m_windowVbatMvx16)) *
+            kSecPerDay / 16 / std::int64_t(windowSec)
+            );
+
+        if (! this->m_fAverageValid)
+            {
+            this->m_averageUa = windowUa;
+            this->m_slopeMvPerDay = windowSlope;
+            this->m_fAverageValid = true;
+            }
+        else
+            {
+            this->m_averageUa = (this->m_averageUa * 3 + windowUa) / 4;
+            this->m_slopeMvPerDay = (this->m_slopeMvPerDay * 3 + windowSlope) / 4;
+            }
+
+        this->m_windowStartSec = elapsedSec;
+        this->m_windowUsedUas = this->m_usedUas;
+        this->m_windowVbatMvx16 = this->m_vbatMvx16;
+
+        if (! this->updateStretch())
+            return false;
+
+        // the draw will change; start the averages afresh next window
+        // rather than letting the old interval's history drive the
+        // factor further.
+        this->m_fAverageValid = false;
+        return true;
+        }
+
+    // decide whether the boost regulator should be on.
+    bool updateBoost(std::uint16_t vbatMv, bool fUsbPower)
+        {
+        if (fUsbPower)
+            this->m_fBoostOn = false;
+        else if (this->m_fBoostOn)
+            this->m_fBoostOn = vbatMv < kBoostOffMv;
+        else
+            this->m_fBoostOn = vbatMv < kBoostOnMv;
+
+        return this->m_fBoostOn;
+        }
+
+    bool isBoostOn() const
+        {
+        return this->m_fBoostOn;
+        }
+
+    std::uint8_t getStretch() const
+        {
+        return this->m_stretch;
+        }
+
+    // predicted remaining life, in days; ~0 if there is no prediction yet.
+    std::uint32_t getRemainingDays() const
+        {
+        std::uint32_t days = ~std::uint32_t(0);
+
+        if (this->m_averageUa != 0)
+            days = std::uint32_t(
+                this->getRemainingUas() / this->m_averageUa / kSecPerDay
+                );
+
+        if (this->m_fVbatValid && this->m_slopeMvPerDay < 0 &&
+            (this->m_vbatMvx16 >> 4) < kKneeMv)
+            {
+            std::int32_t const headroom = std::int32_t(this->m_vbatMvx16 >> 4) - kEmptyMv;
+            std::uint32_t const vDays = headroom <= 0 ? 0 : std::uint32_t(headroom / -this->m_slopeMvPerDay);
+
+            if (vDays < days)
+                days = vDays;
+            }
+
+        return days;
+        }
+
+    void getEstimate(Estimate &e) const
+        {
+        std::uint64_t const capacityUas = std::uint64_t(this->m_capacityMah) * kUasPerMah;
+
+        e.usedMah = std::uint32_t(this->m_usedUas / kUasPerMah);
+        e.averageUa = this->m_averageUa;
+        e.slopeMvPerDay = this->m_slopeMvPerDay;
+        e.remainingDays = this->getRemainingDays();
+        e.vbatMv = std::uint16_t(this->m_vbatMvx16 >> 4);
+        e.percent = capacityUas == 0 ? 0 : std::uint8_t(this->getRemainingUas() * 100 / capacityUas);
+        e.stretch = this->m_stretch;
+        }
+
+private:
+    std::uint64_t getRemainingUas() const
+        {
+        std::uint64_t const capacityUas = std::uint64_t(this->m_capacityMah) * kUasPerMah;
+
+        return this->m_usedUas < capacityUas ? capacityUas - this->m_usedUas : 0;
+        }
+
+    // scale the stretch by (life needed / life predicted). Round up when
+    // stretching and down when relaxing, which leaves a dead band.
+    bool updateStretch()
+        {
+        std::uint32_t const elapsedDays = this->m_elapsedSec / kSecPerDay;
+        std::uint32_t const predicted = this->getRemainingDays();
+
+        if (elapsedDays >= this->m_targetLifeDays || predicted == ~std::uint32_t(0))
+            return false;
+
+        std::uint64_t const needed = this->m_targetLifeDays - elapsedDays;
+        std::uint64_t const num = needed * this->m_stretch;
+        std::uint64_t const den = predicted == 0 ? 1 : predicted;
+        std::uint64_t stretch = num > den ? (num + den - 1) / den : num / den;
+
+        if (stretch < 1)
+            stretch = 1;
+        else if (stretch > kMaxStretch)
+            stretch = kMaxStretch;
+
+        if (stretch == this->m_stretch)
+            return false;
+
+        this->m_stretch = std::uint8_t(stretch);
+        return true;
+        }
+
+    std::uint64_t   m_usedUas;
+    std::uint64_t   m_windowUsedUas;
+    std::uint32_t   m_capacityMah;
+    std::uint32_t   m_targetLifeDays;
+    std::uint32_t   m_elapsedSec;
+    std::uint32_t   m_windowStartSec;
+    std::uint32_t   m_averageUa;
+    std::uint32_t   m_vbatMvx16;
+    std::uint32_t   m_windowVbatMvx16;
+    std::int32_t    m_slopeMvPerDay;
+    std::uint8_t    m_stretch;
+    bool            m_fVbatValid;
+    bool            m_fAverageValid;
+    bool            m_fBoostOn;
+    };
+
+} // namespace McciCatena4610
+
+#endif /* _Catena4610_cBatteryModel_h_ */
@@ -0,0 +1,138 @@
+/*
+
+Module: Catena4610_cBootProfile.h
+
+Function:
+        cBootProfile: record how long each phase of start-up took.
+
+Copyright:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#ifndef _Catena4610_cBootProfile_h_
+# define _Catena4610_cBootProfile_h_
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace McciCatena4610 {
+
+/****************************************************************************\
+|
+|   The boot profile.
+|
+|   Each phase is stamped once, the first time it completes, with the
+|   millis() value at that point. Phases are kept in the order in which
+|   they completed, since fast boot runs some of them later.
+|
+\****************************************************************************/
+
+class cBootProfile
+    {
+public:
+    enum class Phase : std::uint8_t
+        {
+        kPlatform,      // setup_platform() done
+        kSignOn,        // setup_printSignOn() done
+        kFlash,         // setup_flash() done
+        kMeasurement,   // setup_measurement() done
+        kRadio,         // setup_radio() done
+        kCommands,      // setup_commands() done
+        kStart,         // setup_start() done
+        kWarmup,        // measurement loop left stWarmup
+        kFirstUplink,   // first uplink completed
+        kCount          // number of phases
+        };
+
+    static constexpr const char *getPhaseName(Phase p)
+        {
+        switch (p)
+            {
+            case Phase::kPlatform:      return "platform";
+            case Phase::kSignOn:        return "signon";
+            case Phase::kFlash:         return "flash";
+            case Phase::kMeasurement:   return "measurement";
+            case Phase::kRadio:         return "radio";
+            case Phase::kCommands:      return "commands";
+            case Phase::kStart:         return "start";
+            case Phase::kWarmup:        return "warmup";
+            case Phase::kFirstUplink:   return "first uplink";
+            default:                    return "<<unknown>>";
+            }
+        }
+
+    struct Record
+        {
+        std::uint32_t   ms;
+        Phase           phase;
+        };
+
+    cBootProfile()
+        : m_nRecords(0)
+        , m_fFastBoot(false)
+        {}
+
+    // neither copyable nor movable
+    cBootProfile(const cBootProfile&) = delete;
+    cBootProfile& operator=(const cBootProfile&) = delete;
+    cBootProfile(const cBootProfile&&) = delete;
+    cBootProfile& operator=(const cBootProfile&&) = delete;
+
+    // stamp a phase with the current time; later stamps are ignored.
+    void mark(Phase phase, std::uint32_t ms)
+        {
+        if (this->isMarked(phase) || this->m_nRecords >= kCount)
+            return;
+
+        this->m_records[this->m_nRecords].ms = ms;
+        this->m_records[this->m_nRecords].phase = phase;
+        ++this->m_nRecords;
+        }
+
+    bool isMarked(Phase phase) const
+        {
+        for (std::size_t i = 0; i < this->m_nRecords; ++i)
+            {
+            if (this->m_records[i].phase == phase)
+                return true;
+            }
+        return false;
+        }
+
+    std::size_t getCount() const
+        {
+        return this->m_nRecords;
+        }
+
+    const Record &getRecord(std::size_t i) const
+        {
+        return this->m_records[i];
+        }
+
+    void setFastBoot(bool fFastBoot)
+        {
+        this->m_fFastBoot = fFastBoot;
+        }
+
+    bool isFastBoot() const
+        {
+        return this->m_fFastBoot;
+        }
+
+private:
+    static constexpr std::size_t kCount = std::size_t(Phase::kCount);
+
+    Record          m_records[kCount];
+    std::uint8_t    m_nRecords;
+    bool            m_fFastBoot;
+    };
+
+} // namespace McciCatena4610
+
+#endif /* _Catena4610_cBootProfile_h_ */
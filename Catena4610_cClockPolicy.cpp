@@ -0,0 +1,217 @@
+/*
+
+Module: Catena4610_cClockPolicy.cpp
+
+Function:
+        cClockPolicy: the hardware side of clock scaling.
+
+Copyright:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#include "Catena4610_cClockPolicy.h"
+
+#include <Arduino.h>
+#include <arduino_lmic.h>
+
+using namespace McciCatena4610;
+
+// don't switch if the LMIC has a time-critical job due this soon.
+static constexpr std::uint32_t kLmicGuardMs = 10;
+
+// a UART that's enabled and still sending.
+static bool isUartSending(USART_TypeDef *pUart)
+    {
+    return (pUart->CR1 & USART_CR1_UE) != 0 && (pUart->ISR & USART_ISR_TC) == 0;
+    }
+
+// keep an enabled UART's baud rate, if it runs from the system clock.
+static void rescaleUart(USART_TypeDef *pUart, std::uint32_t selMask, std::uint32_t oldHz, std::uint32_t newHz)
+    {
+    if ((RCC->CCIPR & selMask) != 0 || (pUart->CR1 & USART_CR1_UE) == 0)
+        return;
+
+    // BRR can only be written with the UART disabled.
+    pUart->CR1 &= ~USART_CR1_UE;
+    pUart->BRR = cClockPolicy::scaleBaudDivisor(pUart->BRR, oldHz, newHz);
+    pUart->CR1 |= USART_CR1_UE;
+    }
+
+// likewise the I2C timing, with the I2C disabled.
+static void rescaleI2c(std::uint32_t oldHz, std::uint32_t newHz)
+    {
+    if ((RCC->CCIPR & RCC_CCIPR_I2C1SEL) != 0 || (I2C1->CR1 & I2C_CR1_PE) == 0)
+        return;
+
+    I2C1->CR1 &= ~I2C_CR1_PE;
+    while (I2C1->CR1 & I2C_CR1_PE)
+        /* wait */;
+    I2C1->TIMINGR = cClockPolicy::scaleI2cTiming(I2C1->TIMINGR, oldHz, newHz);
+    I2C1->CR1 |= I2C_CR1_PE;
+    }
+
+/*
+
+Name:   McciCatena4610::cClockPolicy::poll()
+
+Function:
+        Switch the system clock to the target level, if it's safe to.
+
+Definition:
+        bool McciCatena4610::cClockPolicy::poll(
+                std::uint32_t tNow
+                );
+
+Description:
+        If the clock isn't at getTarget(), tries setSystemClock(). If a
+        peripheral is busy the attempt is counted as deferred, and the
+        next call tries again.
+
+Returns:
+        true if the clock is at the target level.
+
+*/
+
+bool cClockPolicy::poll(std::uint32_t tNow)
+    {
+    Level const target = this->getTarget();
+
+    if (target == this->m_level)
+        return true;
+
+    if (! setSystemClock(target))
+        {
+        this->noteDeferred();
+        return false;
+        }
+
+    this->setLevel(tNow, target);
+    return true;
+    }
+
+/*
+
+Name:   McciCatena4610::cClockPolicy::setSystemClock()
+
+Function:
+        Run the system clock from the PLL or from HSI16.
+
+Definition:
+        static bool McciCatena4610::cClockPolicy::setSystemClock(
+                Level l
+                );
+
+Description:
+        kHigh raises the core voltage to range 1, starts the PLL (as the
+        core configured it at boot) and selects it. kLow selects HSI16,
+        stops the PLL and drops to range 2. Both use one flash wait state.
+
+        The PLL is started (and, after a switch to HSI16, stopped) with
+        interrupts on. The switch itself is made just after a SysTick
+        tick, which is waited for with interrupts on; interrupts are off
+        only from there until SysTick has been reloaded for the new clock,
+        so millis() loses no more than the few microseconds the switch
+        takes, and micros() stays right. Enabled UARTs and I2C1, if
+        clocked from PCLK, are rescaled to keep their baud rate and bus
+        timing.
+
+Returns:
+        true if the clock was switched; false if the LMIC is busy or due
+        to be, I2C1 is mid-transfer, or a UART is still sending.
+
+*/
+
+bool cClockPolicy::setSystemClock(Level l)
+    {
+    std::uint32_t const oldHz = SystemCoreClock;
+    std::uint32_t const newHz = getHz(l);
+
+    if (! LMIC_queryTxReady() ||
+        os_queryTimeCriticalJobs(ms2osticks(kLmicGuardMs)))
+        return false;
+
+    if ((I2C1->ISR & I2C_ISR_BUSY) != 0 ||
+        isUartSending(USART1) ||
+        isUartSending(USART2) ||
+        isUartSending(LPUART1))
+        return false;
+
+    __HAL_RCC_PWR_CLK_ENABLE();
+    FLASH->ACR |= FLASH_ACR_LATENCY;
+    if ((RCC->CR & RCC_CR_HSIRDY) == 0)
+        {
+        RCC->CR |= RCC_CR_HSION;
+        while ((RCC->CR & RCC_CR_HSIRDY) == 0)
+            /* wait */;
+        }
+
+    // the PLL needs range 1, and takes a while to lock; neither needs
+    // interrupts off.
+    if (l == Level::kHigh)
+        {
+        PWR->CR = (PWR->CR & ~PWR_CR_VOS) | PWR_CR_VOS_0;
+        while (PWR->CSR & PWR_CSR_VOSF)
+            /* wait */;
+
+        RCC->CR |= RCC_CR_PLLON;
+        while ((RCC->CR & RCC_CR_PLLRDY) == 0)
+            /* wait */;
+        }
+
+    // wait for the next tick: the counter counts down, so it's reloaded
+    // when it goes up. COUNTFLAG isn't used, as the tick handler may
+    // clear it.
+    std::uint32_t last = SysTick->VAL;
+    for (;;)
+        {
+        std::uint32_t const now = SysTick->VAL;
+
+        if (now > last)
+            break;
+        last = now;
+        }
+
+    noInterrupts();
+
+    if (l == Level::kHigh)
+        {
+        RCC->CFGR = (RCC->CFGR & ~RCC_CFGR_SW) | RCC_CFGR_SW_PLL;
+        while ((RCC->CFGR & RCC_CFGR_SWS) != RCC_CFGR_SWS_PLL)
+            /* wait */;
+        }
+    else
+        {
+        RCC->CFGR = (RCC->CFGR & ~RCC_CFGR_SW) | RCC_CFGR_SW_HSI;
+        while ((RCC->CFGR & RCC_CFGR_SWS) != RCC_CFGR_SWS_HSI)
+            /* wait */;
+        }
+
+    SystemCoreClock = newHz;
+    SysTick->LOAD = newHz / 1000 - 1;
+    SysTick->VAL = 0;
+
+    rescaleUart(USART1, RCC_CCIPR_USART1SEL, oldHz, newHz);
+    rescaleUart(USART2, RCC_CCIPR_USART2SEL, oldHz, newHz);
+    rescaleUart(LPUART1, RCC_CCIPR_LPUART1SEL, oldHz, newHz);
+    rescaleI2c(oldHz, newHz);
+
+    interrupts();
+
+    // off the PLL, the core can drop to range 2.
+    if (l == Level::kLow)
+        {
+        RCC->CR &= ~RCC_CR_PLLON;
+        while (RCC->CR & RCC_CR_PLLRDY)
+            /* wait */;
+
+        PWR->CR = (PWR->CR & ~PWR_CR_VOS) | PWR_CR_VOS_1;
+        while (PWR->CSR & PWR_CSR_VOSF)
+            /* wait */;
+        }
+
+    return true;
+    }
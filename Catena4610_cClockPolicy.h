@@ -0,0 +1,266 @@
+/*
+
+Module: Catena4610_cClockPolicy.h
+
+Function:
+        cClockPolicy: run the CPU slowly when there's only sampling to do.
+
+Copyright:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#ifndef _Catena4610_cClockPolicy_h_
+# define _Catena4610_cClockPolicy_h_
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Catena4610_cEnergyMeter.h"
+
+namespace McciCatena4610 {
+
+/****************************************************************************\
+|
+|   The clock policy.
+|
+|   Most of the time the measurement loop only samples the touch sensor,
+|   which is bound by the I2C bus, not the CPU. The policy picks a clock
+|   level for each energy category: kLow (HSI16 directly, 16 MHz, core
+|   voltage range 2) while sleeping between uplinks or idling, and kHigh
+|   (the PLL, 32 MHz, range 1) while measuring, encoding and transmitting.
+|   On USB power, or if disabled, it holds kHigh.
+|
+|   A switch can't always be made at once: not while the LMIC is busy,
+|   an I2C transfer is running or a UART is sending. So setTarget() only
+|   records the level wanted, and poll() tries the switch until it's done.
+|   After a switch, SysTick is reloaded so millis() keeps counting
+|   milliseconds, and the I2C timing and UART baud divisors of enabled
+|   peripherals that run from the system clock are rescaled.
+|
+|   scaleCurrent() models the current at each level, for the energy meter:
+|   the part above kFloorUa (the board, not the MCU) scales with clock
+|   and core voltage. Only poll() touches the hardware; the rest, and the
+|   register arithmetic, run on a host.
+|
+\****************************************************************************/
+
+class cClockPolicy
+    {
+public:
+    enum class Level : std::uint8_t
+        {
+        kLow,
+        kHigh,
+        kCount
+        };
+
+    static constexpr std::size_t kLevels = std::size_t(Level::kCount);
+
+    static constexpr std::uint32_t kLowHz = 16000000;
+    static constexpr std::uint32_t kHighHz = 32000000;
+
+    // current that doesn't depend on the MCU clock, in microamps.
+    static constexpr std::uint32_t kFloorUa = 250;
+    // MCU current at kLow relative to kHigh: half the clock, at 1.5 V
+    // rather than 1.8 V.
+    static constexpr std::uint32_t kLowCurrentPermille = 1000 * 16 * 15 / (32 * 18);
+
+    struct Stats
+        {
+        std::uint64_t   ms[kLevels];    // time at each level
+        std::uint32_t   nSwitches;      // clock switches made
+        std::uint32_t   nDeferred;      // attempts put off by a busy peripheral
+        };
+
+    cClockPolicy()
+        : m_level(Level::kHigh)
+        , m_target(Level::kHigh)
+        , m_fEnabled(true)
+        , m_fHold(false)
+        , m_tLevelMs(0)
+        , m_stats {}
+        {}
+
+    // neither copyable nor movable
+    cClockPolicy(const cClockPolicy&) = delete;
+    cClockPolicy& operator=(const cClockPolicy&) = delete;
+    cClockPolicy(const cClockPolicy&&) = delete;
+    cClockPolicy& operator=(const cClockPolicy&&) = delete;
+
+    static const char *getLevelName(Level l)
+        {
+        switch (l)
+            {
+        case Level::kLow:   return "low";
+        case Level::kHigh:  return "high";
+        default:            return "<<unknown>>";
+            }
+        }
+
+    static std::uint32_t getHz(Level l)
+        {
+        return l == Level::kLow ? kLowHz : kHighHz;
+        }
+
+    // the level for an activity: sampling only, or real work.
+    static Level getLevelFor(cEnergyMeter::Category c)
+        {
+        switch (c)
+            {
+        case cEnergyMeter::Category::kMeasure:
+        case cEnergyMeter::Category::kTransmit:
+            return Level::kHigh;
+        default:
+            return Level::kLow;
+            }
+        }
+
+    // model: the current at level l, given the current at kHigh.
+    static std::uint32_t scaleCurrent(std::uint32_t uaAtHigh, Level l)
+        {
+        if (l == Level::kHigh || uaAtHigh <= kFloorUa)
+            return uaAtHigh;
+
+        return kFloorUa + (uaAtHigh - kFloorUa) * kLowCurrentPermille / 1000;
+        }
+
+    // a UART baud divisor (USART or LPUART BRR) for the same baud rate,
+    // after the kernel clock changes from oldHz to newHz.
+    static std::uint32_t scaleBaudDivisor(std::uint32_t brr, std::uint32_t oldHz, std::uint32_t newHz)
+        {
+        return std::uint32_t((std::uint64_t(brr) * newHz + oldHz / 2) / oldHz);
+        }
+
+    // an I2C TIMINGR for the same bus timing, after the kernel clock
+    // changes from oldHz to newHz. The SCL low and high times and the
+    // setup time are minimums, so they round up; the prescaler is the
+    // smallest that lets every field fit. If none does, the value is
+    // returned unchanged.
+    static std::uint32_t scaleI2cTiming(std::uint32_t timingr, std::uint32_t oldHz, std::uint32_t newHz)
+        {
+        std::uint32_t const presc = (timingr >> 28) + 1;
+        // each period, in kernel clocks at oldHz.
+        std::uint32_t const scll = ((timingr & 0xFF) + 1) * presc;
+        std::uint32_t const sclh = (((timingr >> 8) & 0xFF) + 1) * presc;
+        std::uint32_t const sdadel = ((timingr >> 16) & 0xF) * presc;
+        std::uint32_t const scldel = (((timingr >> 20) & 0xF) + 1) * presc;
+
+        for (std::uint32_t p = 1; p <= 16; ++p)
+            {
+            std::uint64_t const den = std::uint64_t(oldHz) * p;
+            auto const up = [=](std::uint32_t clocks)
+                {
+                std::uint64_t const n = (clocks * std::uint64_t(newHz) + den - 1) / den;
+                return std::uint32_t(n < 1 ? 1 : n);
+                };
+            std::uint32_t const l = up(scll);
+            std::uint32_t const h = up(sclh);
+            std::uint32_t const c = up(scldel);
+            std::uint32_t const d = std::uint32_t((sdadel * std::uint64_t(newHz) + den / 2) / den);
+
+            if (l <= 256 && h <= 256 && c <= 16 && d <= 15)
+                return ((p - 1) << 28) | ((c - 1) << 20) | (d << 16) | ((h - 1) << 8) | (l - 1);
+            }
+        return timingr;
+        }
+
+    void setEnabled(bool fEnabled)
+        {
+        this->m_fEnabled = fEnabled;
+        }
+
+    bool isEnabled() const
+        {
+        return this->m_fEnabled;
+        }
+
+    // hold kHigh regardless of the target, e.g. on USB power.
+    void setHold(bool fHold)
+        {
+        this->m_fHold = fHold;
+        }
+
+    bool isHeld() const
+        {
+        return this->m_fHold;
+        }
+
+    void setTarget(Level l)
+        {
+        this->m_target = l;
+        }
+
+    // the level wanted now.
+    Level getTarget() const
+        {
+        return (this->m_fEnabled && ! this->m_fHold) ? this->m_target : Level::kHigh;
+        }
+
+    Level getLevel() const
+        {
+        return this->m_level;
+        }
+
+    bool isSwitchPending() const
+        {
+        return this->getTarget() != this->m_level;
+        }
+
+    // the clock is now at level l (by a switch, if fSwitch; otherwise,
+    // e.g., restored on wakeup). Charge the time to the old level.
+    void setLevel(std::uint32_t tNow, Level l, bool fSwitch = true)
+        {
+        this->account(tNow);
+        if (fSwitch && l != this->m_level)
+            ++this->m_stats.nSwitches;
+        this->m_level = l;
+        }
+
+    void noteDeferred()
+        {
+        ++this->m_stats.nDeferred;
+        }
+
+    // charge the time since the last call to the current level.
+    void account(std::uint32_t tNow)
+        {
+        this->m_stats.ms[unsigned(this->m_level)] += tNow - this->m_tLevelMs;
+        this->m_tLevelMs = tNow;
+        }
+
+    const Stats &getStats() const
+        {
+        return this->m_stats;
+        }
+
+    void resetStats(std::uint32_t tNow)
+        {
+        this->m_stats = Stats {};
+        this->m_tLevelMs = tNow;
+        }
+
+    // switch to the target level if it's safe; true if the clock is at
+    // the target. Call from loop().
+    bool poll(std::uint32_t tNow);
+
+private:
+    // switch the system clock; false if a peripheral is busy.
+    static bool setSystemClock(Level l);
+
+    Level           m_level;
+    Level           m_target;
+    bool            m_fEnabled;
+    bool            m_fHold;
+    std::uint32_t   m_tLevelMs;
+    Stats           m_stats;
+    };
+
+} // namespace McciCatena4610
+
+#endif /* _Catena4610_cClockPolicy_h_ */
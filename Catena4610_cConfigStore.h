@@ -0,0 +1,139 @@
+/*
+
+Module: Catena4610_cConfigStore.h
+
+Function:
+        cConfigStore: a versioned configuration record in flash.
+
+Copyright:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#ifndef _Catena4610_cConfigStore_h_
+# define _Catena4610_cConfigStore_h_
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "Catena4610_FlashMap.h"
+#include "Catena4610_cTwoSectorStore.h"
+
+namespace McciCatena4610 {
+
+/****************************************************************************\
+|
+|   The configuration store.
+|
+|   The configuration is kept as one fixed-size record in a
+|   cTwoSectorStore: a save writes it to the sector not holding the
+|   current record, so the old record survives until the new one is
+|   complete. At boot, one read per sector fetches each record; the one
+|   with a good CRC and the highest generation wins.
+|
+|   Config is a plain struct with a static kVersion. The record carries
+|   the version and the size of the Config that wrote it. A record of
+|   another version is ignored. Fields may be added at the end of Config
+|   without changing the version: a shorter record loads over the
+|   caller's defaults, so the new fields keep their default values.
+|
+\****************************************************************************/
+
+template <class Flash, class Config>
+class cConfigStore
+    {
+public:
+    // room for the configuration in a record.
+    static constexpr std::size_t kPayloadBytes = 48;
+
+    static_assert(sizeof(Config) <= kPayloadBytes, "Config is too big for a record");
+
+    cConfigStore(Flash &flash, std::uint32_t base = FlashMap::kConfigBase)
+        : m_store(flash, base, kMagic)
+        , m_fValid(false)
+        {}
+
+    // neither copyable nor movable
+    cConfigStore(const cConfigStore&) = delete;
+    cConfigStore& operator=(const cConfigStore&) = delete;
+    cConfigStore(const cConfigStore&&) = delete;
+    cConfigStore& operator=(const cConfigStore&&) = delete;
+
+    // find the newest record and load it over c, which should hold the
+    // defaults. Returns true if a record was found.
+    bool begin(Config &c)
+        {
+        Record r;
+
+        this->m_fValid = this->m_store.begin(r) &&
+                         r.version == Config::kVersion &&
+                         r.size <= kPayloadBytes;
+
+        if (! this->m_fValid)
+            return false;
+
+        std::memcpy(
+            &c, r.payload,
+            r.size < sizeof(Config) ? r.size : sizeof(Config)
+            );
+        return true;
+        }
+
+    bool isValid() const
+        {
+        return this->m_fValid;
+        }
+
+    // write c as the new configuration.
+    void save(const Config &c)
+        {
+        Record r;
+
+        std::memset(&r, 0xFF, sizeof(r));
+        r.version = Config::kVersion;
+        r.size = sizeof(Config);
+        std::memcpy(r.payload, &c, sizeof(Config));
+
+        this->m_store.write(r);
+        this->m_fValid = true;
+        }
+
+    // forget the stored configuration; the next boot uses the defaults.
+    void erase()
+        {
+        this->m_store.erase();
+        this->m_fValid = false;
+        }
+
+    // instrumentation
+    std::uint32_t getGeneration() const { return this->m_store.getGeneration(); }
+    unsigned getSector() const { return this->m_store.getSector(); }
+
+private:
+    static constexpr std::uint32_t kMagic = 0x31474643; // "CFG1"
+
+    struct Record
+        {
+        std::uint16_t   version;
+        std::uint16_t   size;
+        std::uint8_t    payload[kPayloadBytes];
+        };
+
+    using Store = cTwoSectorStore<Flash, Record>;
+
+    static_assert(sizeof(Record) == 52, "Record must not contain padding; it's checked with a CRC");
+    static_assert(FlashMap::kConfigSectors == Store::kSectors, "the flash map must give the store two sectors");
+
+    Store           m_store;
+    bool            m_fValid;
+    };
+
+} // namespace McciCatena4610
+
+#endif /* _Catena4610_cConfigStore_h_ */
@@ -0,0 +1,71 @@
+/*
+
+Module: Catena4610_cConfiguration.cpp
+
+Function:
+        Load, apply and save the measurement loop's tunables.
+
+Copyright:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#include "Catena4610_cConfiguration.h"
+
+#include <TouchSense-Lorawan.h>
+
+using namespace McciCatena4610;
+using namespace McciCatena;
+
+void cConfiguration::begin()
+    {
+    Config c = cMeasurementLoop::getDefaultConfig();
+
+    this->m_fEnabled = true;
+
+    this->m_power.acquire(cPowerManager::Peripheral::kFlash);
+    bool const fFound = this->m_store.begin(c);
+    this->m_power.release(cPowerManager::Peripheral::kFlash);
+
+    if (! fFound)
+        return;
+
+    if (! cMeasurementLoop::isValidConfig(c))
+        {
+        gCatena.SafePrintf("saved configuration is not valid: using defaults\n");
+        return;
+        }
+
+    gMeasurementLoop.applyConfig(c);
+    }
+
+bool cConfiguration::update(const Config &c)
+    {
+    if (! cMeasurementLoop::isValidConfig(c))
+        return false;
+
+    gMeasurementLoop.applyConfig(c);
+
+    if (! this->m_fEnabled)
+        return true;
+
+    this->m_power.acquire(cPowerManager::Peripheral::kFlash);
+    this->m_store.save(c);
+    this->m_power.release(cPowerManager::Peripheral::kFlash);
+    return true;
+    }
+
+void cConfiguration::reset()
+    {
+    gMeasurementLoop.applyConfig(cMeasurementLoop::getDefaultConfig());
+
+    if (! this->m_fEnabled)
+        return;
+
+    this->m_power.acquire(cPowerManager::Peripheral::kFlash);
+    this->m_store.erase();
+    this->m_power.release(cPowerManager::Peripheral::kFlash);
+    }
@@ -0,0 +1,85 @@
+/*
+
+Module: Catena4610_cConfiguration.h
+
+Function:
+        cConfiguration: the measurement loop's tunables, saved in flash.
+
+Copyright:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#ifndef _Catena4610_cConfiguration_h_
+# define _Catena4610_cConfiguration_h_
+
+#pragma once
+
+#include <Catena_Mx25v8035f.h>
+
+#include "Catena4610_cConfigStore.h"
+#include "Catena4610_cMeasurementLoop.h"
+#include "Catena4610_cPowerManager.h"
+
+namespace McciCatena4610 {
+
+/****************************************************************************\
+|
+|   Glue between the measurement loop and the configuration store.
+|
+|   Changes are checked, put into effect at once, and then saved. The
+|   flash is kept powered down except while the store is accessed.
+|
+\****************************************************************************/
+
+class cConfiguration
+    {
+public:
+    using Config = cMeasurementLoop::Config;
+    using Store = cConfigStore<McciCatena::Catena_Mx25v8035f, Config>;
+
+    cConfiguration(McciCatena::Catena_Mx25v8035f &flash, cPowerManager &power)
+        : m_power(power)
+        , m_store(flash)
+        , m_fEnabled(false)
+        {}
+
+    // neither copyable nor movable
+    cConfiguration(const cConfiguration&) = delete;
+    cConfiguration& operator=(const cConfiguration&) = delete;
+    cConfiguration(const cConfiguration&&) = delete;
+    cConfiguration& operator=(const cConfiguration&&) = delete;
+
+    // call once the flash is known to be present; loads the saved
+    // configuration, if any, into the measurement loop.
+    void begin();
+
+    // use c from now on, and save it. Returns false (and changes
+    // nothing) if c isn't valid.
+    bool update(const Config &c);
+
+    // go back to the defaults, and forget the saved configuration.
+    void reset();
+
+    bool isEnabled() const
+        {
+        return this->m_fEnabled;
+        }
+
+    const Store &getStore() const
+        {
+        return this->m_store;
+        }
+
+private:
+    cPowerManager                   &m_power;
+    Store                           m_store;
+    bool                            m_fEnabled;
+    };
+
+} // namespace McciCatena4610
+
+#endif /* _Catena4610_cConfiguration_h_ */
@@ -0,0 +1,148 @@
+/*
+
+Module: Catena4610_cCounterJournal.h
+
+Function:
+        cCounterJournal: append-only journal of touch counters in flash.
+
+Copyright:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#ifndef _Catena4610_cCounterJournal_h_
+# define _Catena4610_cCounterJournal_h_
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Catena4610_Crc.h"
+#include "Catena4610_FlashMap.h"
+#include "Catena4610_cTwoSectorStore.h"
+
+namespace McciCatena4610 {
+
+/****************************************************************************\
+|
+|   The counter journal.
+|
+|   The counters are kept in a cTwoSectorStore: each record is appended
+|   to the journal as a 16-byte entry with its own CRC, and the last
+|   valid entry is current. When the journal fills, the record goes into
+|   a new header in the other sector, starting an empty journal there.
+|   So every write programs one entry or one header, and each sector is
+|   erased once per 2 * 254 records.
+|
+|   At boot the newest header is found, then its journal is scanned with
+|   a binary search for the first erased entry, and backwards over any
+|   entry torn by a reset while programming.
+|
+\****************************************************************************/
+
+template <class Flash>
+class cCounterJournal
+    {
+public:
+    struct Record
+        {
+        std::uint32_t   left;           // lifetime touches, left
+        std::uint32_t   right;          // lifetime touches, right
+        std::uint16_t   unackedLeft;    // not yet in a completed uplink
+        std::uint16_t   unackedRight;
+        };
+
+    static_assert(sizeof(Record) == 12, "Record must not contain padding; it's checked with a CRC");
+
+    using Store = cTwoSectorStore<Flash, Record>;
+    using Stats = typename Store::Stats;
+
+    cCounterJournal(Flash &flash, std::uint32_t base = FlashMap::kCounterBase)
+        : m_store(flash, base, kMagic)
+        , m_record {}
+        , m_fValid(false)
+        {}
+
+    // neither copyable nor movable
+    cCounterJournal(const cCounterJournal&) = delete;
+    cCounterJournal& operator=(const cCounterJournal&) = delete;
+    cCounterJournal(const cCounterJournal&&) = delete;
+    cCounterJournal& operator=(const cCounterJournal&&) = delete;
+
+    // scan flash for the newest record. Returns true if one was found.
+    bool begin()
+        {
+        Entry e;
+
+        this->m_fValid = this->m_store.begin(this->m_record);
+        if (this->m_fValid && this->m_store.scanJournal(e))
+            this->m_record = e.record;
+
+        return this->m_fValid;
+        }
+
+    bool getRecord(Record &r) const
+        {
+        if (! this->m_fValid)
+            return false;
+
+        r = this->m_record;
+        return true;
+        }
+
+    void append(const Record &r)
+        {
+        Entry e;
+
+        e.record = r;
+        e.crc = crc32(&e, offsetof(Entry, crc));
+
+        if (! this->m_store.appendJournal(e))
+            this->m_store.write(r);
+
+        this->m_record = r;
+        this->m_fValid = true;
+        }
+
+    // forget the counters.
+    void erase()
+        {
+        this->m_store.erase();
+        this->m_fValid = false;
+        }
+
+    // instrumentation
+    const Stats &getStats() const { return this->m_store.getStats(); }
+    std::uint32_t getGeneration() const { return this->m_store.getGeneration(); }
+    std::uint32_t getJournalCount() const { return this->m_store.getJournalCount(); }
+    static constexpr std::uint32_t getJournalCapacity() { return Store::template getJournalCapacity<Entry>(); }
+
+private:
+    static constexpr std::uint32_t kMagic = 0x31544E43; // "CNT1"
+
+    struct Entry
+        {
+        Record          record;
+        std::uint32_t   crc;
+
+        bool isValid() const
+            {
+            return crc == crc32(this, offsetof(Entry, crc));
+            }
+        };
+
+    static_assert(sizeof(Entry) == 16, "journal entries must be 16 bytes");
+    static_assert(FlashMap::kCounterSectors == Store::kSectors, "the flash map must give the store two sectors");
+
+    Store           m_store;
+    Record          m_record;
+    bool            m_fValid;
+    };
+
+} // namespace McciCatena4610
+
+#endif /* _Catena4610_cCounterJournal_h_ */
@@ -0,0 +1,188 @@
+/*
+
+Module: Catena4610_cDownlinkParser.h
+
+Function:
+        cDownlinkParser: decode configuration downlinks.
+
+Copyright:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#ifndef _Catena4610_cDownlinkParser_h_
+# define _Catena4610_cDownlinkParser_h_
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace McciCatena4610 {
+
+/****************************************************************************\
+|
+|   The downlink parser.
+|
+|   Downlinks on kPort carry one or more commands, each an opcode byte
+|   followed by fixed-size big-endian arguments (see
+|   extra/catena-downlink-port-2-format.md). The whole message is decoded
+|   into a copy of the configuration before anything is changed: if any
+|   command is unknown or truncated, the message is rejected as a whole,
+|   so a configuration is never half-applied. Later commands override
+|   earlier ones.
+|
+|   Config is any struct with the fields of cMeasurementLoop::Config;
+|   nothing here touches the hardware or allocates, so the host test
+|   tool uses the same code.
+|
+\****************************************************************************/
+
+class cDownlinkParser
+    {
+public:
+    static constexpr std::uint8_t kPort = 2;
+
+    enum class Command : std::uint8_t
+        {
+        kSetTxCycle = 0x01,         // u16 seconds
+        kSetFastCycle = 0x02,       // u16 seconds, u8 count
+        kSetThresholds = 0x03,      // u16 right (Ch1), u16 left (Ch2)
+        kSetSamplePeriod = 0x04,    // u16 milliseconds
+        kRequestDiagnostics = 0x05, // no arguments
+        kSetTouchDetection = 0x06,  // u16 hysteresis, u8 debounce
+        };
+
+    enum class Status : std::uint8_t
+        {
+        kSuccess,
+        kEmpty,                     // no commands
+        kUnknownCommand,            // opcode not recognized
+        kTruncated,                 // arguments missing
+        };
+
+    struct Result
+        {
+        Status          status;
+        std::uint8_t    iError;         // offset of the failing command
+        std::uint8_t    nCommands;      // commands decoded
+        bool            fConfig;        // the configuration was changed
+        bool            fDiagnostics;   // a diagnostics frame was asked for
+        };
+
+    static const char *getStatusName(Status s)
+        {
+        switch (s)
+            {
+        case Status::kSuccess:          return "success";
+        case Status::kEmpty:            return "empty";
+        case Status::kUnknownCommand:   return "unknown command";
+        case Status::kTruncated:        return "truncated";
+        default:                        return "<<unknown>>";
+            }
+        }
+
+    // number of argument bytes for a command; -1 if unknown.
+    static int getArgumentBytes(std::uint8_t opcode)
+        {
+        switch (Command(opcode))
+            {
+        case Command::kSetTxCycle:          return 2;
+        case Command::kSetFastCycle:        return 3;
+        case Command::kSetThresholds:       return 4;
+        case Command::kSetSamplePeriod:     return 2;
+        case Command::kRequestDiagnostics:  return 0;
+        case Command::kSetTouchDetection:   return 3;
+        default:                            return -1;
+            }
+        }
+
+    // decode pMessage into c. c is only meaningful if the result is
+    // kSuccess; it should start as a copy of the configuration in use.
+    template <class Config>
+    static Result parse(const std::uint8_t *pMessage, std::size_t nMessage, Config &c)
+        {
+        Result r {};
+
+        r.status = Status::kSuccess;
+        if (nMessage == 0)
+            {
+            r.status = Status::kEmpty;
+            return r;
+            }
+
+        std::size_t i = 0;
+        while (i < nMessage)
+            {
+            std::uint8_t const opcode = pMessage[i];
+            int const nArgs = getArgumentBytes(opcode);
+
+            r.iError = std::uint8_t(i);
+            if (nArgs < 0)
+                {
+                r.status = Status::kUnknownCommand;
+                return r;
+                }
+            if (nMessage - i - 1 < std::size_t(nArgs))
+                {
+                r.status = Status::kTruncated;
+                return r;
+                }
+
+            const std::uint8_t * const p = pMessage + i + 1;
+            switch (Command(opcode))
+                {
+            case Command::kSetTxCycle:
+                c.txCycleSec = get16(p);
+                r.fConfig = true;
+                break;
+
+            case Command::kSetFastCycle:
+                c.fastTxCycleSec = get16(p);
+                c.fastTxCycleCount = p[2];
+                r.fConfig = true;
+                break;
+
+            case Command::kSetThresholds:
+                c.thresholdRight = get16(p);
+                c.thresholdLeft = get16(p + 2);
+                r.fConfig = true;
+                break;
+
+            case Command::kSetSamplePeriod:
+                c.samplePeriodMs = get16(p);
+                r.fConfig = true;
+                break;
+
+            case Command::kRequestDiagnostics:
+                r.fDiagnostics = true;
+                break;
+
+            case Command::kSetTouchDetection:
+                c.touchHysteresis = get16(p);
+                c.touchDebounce = p[2];
+                r.fConfig = true;
+                break;
+                }
+
+            ++r.nCommands;
+            i += 1 + nArgs;
+            }
+
+        r.iError = 0;
+        return r;
+        }
+
+private:
+    static std::uint16_t get16(const std::uint8_t *p)
+        {
+        return std::uint16_t((p[0] << 8) | p[1]);
+        }
+    };
+
+} // namespace McciCatena4610
+
+#endif /* _Catena4610_cDownlinkParser_h_ */
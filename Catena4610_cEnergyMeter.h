@@ -0,0 +1,241 @@
+/*
+
+Module: Catena4610_cEnergyMeter.h
+
+Function:
+        cEnergyMeter: charge used, by activity.
+
+Copyright:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#ifndef _Catena4610_cEnergyMeter_h_
+# define _Catena4610_cEnergyMeter_h_
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace McciCatena4610 {
+
+/****************************************************************************\
+|
+|   The energy meter.
+|
+|   Time spent in each activity is multiplied by a configurable current
+|   for that activity and accumulated as charge (microamp-seconds). The
+|   radio is accounted separately: each uplink adds its time on air,
+|   computed from spreading factor, bandwidth and payload length with the
+|   LoRa modem formula, at the transmit current, plus two receive windows
+|   at the receive current. Totals are cumulative from boot.
+|
+|   The figures are models, not measurements: they're as good as the
+|   currents configured. Time is passed in by the caller; nothing here
+|   touches the hardware, so a host simulation can use the same code to
+|   project battery life for a given configuration.
+|
+\****************************************************************************/
+
+class cEnergyMeter
+    {
+public:
+    enum class Category : std::uint8_t
+        {
+        kIdle,          // inactive or warming up
+        kSleeping,      // light sleep between uplinks
+        kMeasure,       // taking a measurement
+        kTransmit,      // CPU while sending
+        kDeepSleep,     // deep sleep
+        kRadioTx,       // radio transmitting
+        kRadioRx,       // radio receive windows
+        kCount
+        };
+
+    static constexpr std::size_t kCategories = std::size_t(Category::kCount);
+
+    // LoRaWAN framing around the application payload: MHDR, FHDR
+    // (without options), FPort and MIC.
+    static constexpr std::uint8_t kLoRaWANOverhead = 1 + 7 + 1 + 4;
+    // symbols each receive window stays open when nothing arrives.
+    static constexpr std::uint32_t kRxWindowSymbols = 8;
+
+    struct Stats
+        {
+        std::uint64_t   uAs[kCategories];   // charge, by category
+        std::uint64_t   ms[kCategories];    // time, by category
+        std::uint32_t   nUplinks;           // uplinks accounted
+        };
+
+    cEnergyMeter()
+        : m_stats {}
+        {
+        for (std::size_t i = 0; i < kCategories; ++i)
+            this->m_currentUa[i] = getDefaultCurrent(Category(i));
+        }
+
+    // neither copyable nor movable
+    cEnergyMeter(const cEnergyMeter&) = delete;
+    cEnergyMeter& operator=(const cEnergyMeter&) = delete;
+    cEnergyMeter(const cEnergyMeter&&) = delete;
+    cEnergyMeter& operator=(const cEnergyMeter&&) = delete;
+
+    static const char *getCategoryName(Category c)
+        {
+        switch (c)
+            {
+        case Category::kIdle:       return "idle";
+        case Category::kSleeping:   return "sleeping";
+        case Category::kMeasure:    return "measure";
+        case Category::kTransmit:   return "transmit";
+        case Category::kDeepSleep:  return "deepsleep";
+        case Category::kRadioTx:    return "radiotx";
+        case Category::kRadioRx:    return "radiorx";
+        default:                    return "<<unknown>>";
+            }
+        }
+
+    // defaults, in microamps, for a Catena 4610 at +14 dBm.
+    static std::uint32_t getDefaultCurrent(Category c)
+        {
+        switch (c)
+            {
+        case Category::kIdle:       return 3500;
+        case Category::kSleeping:   return 1000;
+        case Category::kMeasure:    return 3500;
+        case Category::kTransmit:   return 3500;
+        case Category::kDeepSleep:  return 20;
+        case Category::kRadioTx:    return 44000;
+        case Category::kRadioRx:    return 11000;
+        default:                    return 0;
+            }
+        }
+
+    void setCurrent(Category c, std::uint32_t uA)
+        {
+        if (c < Category::kCount)
+            this->m_currentUa[unsigned(c)] = uA;
+        }
+
+    std::uint32_t getCurrent(Category c) const
+        {
+        return c < Category::kCount ? this->m_currentUa[unsigned(c)] : 0;
+        }
+
+    // charge ms milliseconds to a category.
+    void account(Category c, std::uint32_t ms)
+        {
+        if (c >= Category::kCount)
+            return;
+
+        this->m_stats.ms[unsigned(c)] += ms;
+        this->m_stats.uAs[unsigned(c)] +=
+            std::uint64_t(ms) * this->m_currentUa[unsigned(c)] / 1000;
+        }
+
+    // the same, at uA rather than the category's current (e.g. the CPU
+    // was running at a lower clock).
+    void account(Category c, std::uint32_t ms, std::uint32_t uA)
+        {
+        if (c >= Category::kCount)
+            return;
+
+        this->m_stats.ms[unsigned(c)] += ms;
+        this->m_stats.uAs[unsigned(c)] += std::uint64_t(ms) * uA / 1000;
+        }
+
+    // account one uplink. sf is 7..12; bwKhz is 125, 250 or 500.
+    void accountUplink(std::uint8_t sf, std::uint32_t bwKhz, std::uint8_t nPayload)
+        {
+        std::uint32_t const usTx = getAirtimeUs(sf, bwKhz, nPayload + kLoRaWANOverhead);
+        std::uint32_t const usRx = 2 * kRxWindowSymbols * getSymbolUs(sf, bwKhz);
+
+        this->accountUs(Category::kRadioTx, usTx);
+        this->accountUs(Category::kRadioRx, usRx);
+        ++this->m_stats.nUplinks;
+        }
+
+    // LoRa time on air, in microseconds, for an explicit-header frame
+    // with CRC, coding rate 4/5 and an 8-symbol preamble.
+    static std::uint32_t getAirtimeUs(std::uint8_t sf, std::uint32_t bwKhz, std::uint32_t nBytes)
+        {
+        std::uint32_t const usSymbol = getSymbolUs(sf, bwKhz);
+        // low data-rate optimization is used when a symbol exceeds 16 ms.
+        std::int32_t const de = usSymbol > 16000 ? 1 : 0;
+        std::int32_t const num = 8 * std::int32_t(nBytes) - 4 * sf + 28 + 16;
+        std::int32_t const den = 4 * (sf - 2 * de);
+        std::int32_t const nBlocks = num > 0 ? (num + den - 1) / den : 0;
+        std::uint32_t const nPayloadSymbols = 8 + std::uint32_t(nBlocks) * (1 + 4);
+
+        // preamble is 8 + 4.25 symbols: count in quarter symbols.
+        return ((8 * 4 + 17) + 4 * nPayloadSymbols) * usSymbol / 4;
+        }
+
+    static std::uint32_t getSymbolUs(std::uint8_t sf, std::uint32_t bwKhz)
+        {
+        return bwKhz == 0 ? 0 : (std::uint32_t(1) << sf) * 1000 / bwKhz;
+        }
+
+    const Stats &getStats() const
+        {
+        return this->m_stats;
+        }
+
+    std::uint64_t getTotalUas() const
+        {
+        std::uint64_t total = 0;
+
+        for (auto uAs : this->m_stats.uAs)
+            total += uAs;
+        return total;
+        }
+
+    // time accounted. Radio time overlaps CPU time, so isn't included.
+    std::uint64_t getElapsedMs() const
+        {
+        std::uint64_t ms = 0;
+
+        for (std::size_t i = 0; i < kCategories; ++i)
+            {
+            if (i != unsigned(Category::kRadioTx) && i != unsigned(Category::kRadioRx))
+                ms += this->m_stats.ms[i];
+            }
+        return ms;
+        }
+
+    // average current over the time accounted, in microamps.
+    std::uint32_t getAverageUa() const
+        {
+        std::uint64_t const ms = this->getElapsedMs();
+
+        return ms == 0 ? 0 : std::uint32_t(this->getTotalUas() * 1000 / ms);
+        }
+
+    // days a battery of capacityMah would last at the average current.
+    std::uint32_t getProjectedLifeDays(std::uint32_t capacityMah) const
+        {
+        std::uint32_t const uA = this->getAverageUa();
+
+        return uA == 0 ? ~std::uint32_t(0)
+                       : std::uint32_t(std::uint64_t(capacityMah) * 1000 / uA / 24);
+        }
+
+private:
+    void accountUs(Category c, std::uint32_t us)
+        {
+        this->m_stats.ms[unsigned(c)] += (us + 500) / 1000;
+        this->m_stats.uAs[unsigned(c)] +=
+            std::uint64_t(us) * this->m_currentUa[unsigned(c)] / 1000000;
+        }
+
+    Stats           m_stats;
+    std::uint32_t   m_currentUa[kCategories];
+    };
+
+} // namespace McciCatena4610
+
+#endif /* _Catena4610_cEnergyMeter_h_ */
@@ -0,0 +1,76 @@
+/*
+
+Module: Catena4610_cI2cBus.h
+
+Function:
+        cI2cBus: the interface to an I2C bus that reads in the background.
+
+Copyright:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#ifndef _Catena4610_cI2cBus_h_
+# define _Catena4610_cI2cBus_h_
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace McciCatena4610 {
+
+/****************************************************************************\
+|
+|   An I2C bus that reads without blocking.
+|
+|   startRead() writes the register address and starts reading a block of
+|   registers in one transaction (a repeated start, then a burst read),
+|   and returns at once. When the transfer ends, the driver calls the
+|   completion function exactly once: from an interrupt, or from poll(),
+|   but never from inside startRead(). One transfer at a time.
+|
+|   The device driver is cI2cDmaBus; extra/ has a mock for the host.
+|
+\****************************************************************************/
+
+class cI2cBus
+    {
+public:
+    enum class Status : std::uint8_t
+        {
+        kOk,
+        kNack,          // no acknowledge from the device
+        kBusError,      // bus error, lost arbitration, or DMA error
+        kAborted,       // abort() was called
+        };
+
+    using CompletionFn = void (*)(void *pClientData, Status status);
+
+    // returns false, without calling pDone, if the transfer can't start.
+    virtual bool startRead(
+        std::uint8_t address,
+        std::uint8_t reg,
+        std::uint8_t *pBuffer,
+        std::size_t nBuffer,
+        CompletionFn pDone,
+        void *pClientData
+        ) = 0;
+
+    virtual bool isBusy() const = 0;
+
+    // give up on the transfer in progress, if any; its completion
+    // function is called with Status::kAborted.
+    virtual void abort() = 0;
+
+    // drivers that notice some events in the foreground do so here.
+    virtual void poll()
+        {}
+    };
+
+} // namespace McciCatena4610
+
+#endif /* _Catena4610_cI2cBus_h_ */
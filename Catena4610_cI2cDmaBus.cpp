@@ -0,0 +1,264 @@
+/*
+
+Module: Catena4610_cI2cDmaBus.cpp
+
+Function:
+        cI2cDmaBus: the hardware side of the DMA I2C driver.
+
+Copyright:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#include "Catena4610_cI2cDmaBus.h"
+
+#include <Arduino.h>
+
+using namespace McciCatena4610;
+
+// DMA1 channel 3 serves I2C1_RX when its request select is 6.
+static constexpr std::uint32_t kDmaRequestI2c1Rx = 6;
+
+// the address phase is done with the CPU; give up if it takes longer.
+static constexpr std::uint32_t kAddressTimeoutUs = 1000;
+
+static constexpr std::uint32_t kI2cErrors = I2C_ISR_NACKF | I2C_ISR_BERR | I2C_ISR_ARLO;
+
+#if CATENA4610_DMA_IRQ_HANDLER
+// the driver the DMA interrupt is for.
+static cI2cDmaBus *s_pDmaBus;
+
+extern "C" void DMA1_Channel2_3_IRQHandler(void)
+    {
+    if (s_pDmaBus != nullptr)
+        s_pDmaBus->dmaInterrupt();
+    }
+#endif
+
+// wait for any of the flags in ISR; return them, or 0 on timeout.
+static std::uint32_t waitForI2c(std::uint32_t flags)
+    {
+    std::uint32_t const tStart = micros();
+
+    do  {
+        std::uint32_t const isr = I2C1->ISR & flags;
+
+        if (isr != 0)
+            return isr;
+        } while (micros() - tStart < kAddressTimeoutUs);
+
+    return 0;
+    }
+
+// stop the bus after a failed address phase.
+static void stopI2c()
+    {
+    if (I2C1->ISR & I2C_ISR_BUSY)
+        I2C1->CR2 |= I2C_CR2_STOP;
+    waitForI2c(I2C_ISR_STOPF);
+    I2C1->ICR = I2C_ICR_NACKCF | I2C_ICR_STOPCF | I2C_ICR_BERRCF | I2C_ICR_ARLOCF;
+    }
+
+/*
+
+Name:   McciCatena4610::cI2cDmaBus::begin()
+
+Function:
+        Connect DMA1 channel 3 to I2C1 receive.
+
+Definition:
+        bool McciCatena4610::cI2cDmaBus::begin(
+                void
+                );
+
+Description:
+        Enables the DMA clock, and selects the I2C1_RX request for channel
+        3. With CATENA4610_DMA_IRQ_HANDLER, also enables the channel's
+        interrupt. Wire.begin() must have been called already.
+
+Returns:
+        true.
+
+*/
+
+bool cI2cDmaBus::begin()
+    {
+    __HAL_RCC_DMA1_CLK_ENABLE();
+    DMA1_Channel3->CCR = 0;
+    DMA1_CSELR->CSELR = (DMA1_CSELR->CSELR & ~DMA_CSELR_C3S) |
+                        (kDmaRequestI2c1Rx << DMA_CSELR_C3S_Pos);
+
+#if CATENA4610_DMA_IRQ_HANDLER
+    s_pDmaBus = this;
+    NVIC_SetPriority(DMA1_Channel2_3_IRQn, 3);
+    NVIC_EnableIRQ(DMA1_Channel2_3_IRQn);
+#endif
+    return true;
+    }
+
+/*
+
+Name:   McciCatena4610::cI2cDmaBus::startRead()
+
+Function:
+        Start a register read, finishing in the background.
+
+Definition:
+        bool McciCatena4610::cI2cDmaBus::startRead(
+                std::uint8_t address,
+                std::uint8_t reg,
+                std::uint8_t *pBuffer,
+                std::size_t nBuffer,
+                CompletionFn pDone,
+                void *pClientData
+                ) override;
+
+Description:
+        Writes reg to the device at the 7-bit address (waiting for that
+        one byte), then starts a read of nBuffer bytes into pBuffer,
+        with a repeated start, by DMA. pDone is called from poll() (or
+        the DMA interrupt, if it's ours) when the read finishes, or from
+        abort().
+
+Returns:
+        true if the read was started; false if a read is already in
+        progress, nBuffer is 0 or more than 255, the bus is busy, or the
+        device didn't acknowledge the register address.
+
+*/
+
+bool cI2cDmaBus::startRead(
+    std::uint8_t address,
+    std::uint8_t reg,
+    std::uint8_t *pBuffer,
+    std::size_t nBuffer,
+    CompletionFn pDone,
+    void *pClientData
+    )
+    {
+    if (this->m_fBusy || nBuffer == 0 || nBuffer > 255)
+        return false;
+
+    if (I2C1->ISR & I2C_ISR_BUSY)
+        return false;
+
+    I2C1->ICR = I2C_ICR_NACKCF | I2C_ICR_STOPCF | I2C_ICR_BERRCF | I2C_ICR_ARLOCF;
+
+    // the address phase: one byte, no STOP.
+    I2C1->CR2 = (std::uint32_t(address) << 1) |
+                (1u << I2C_CR2_NBYTES_Pos) |
+                I2C_CR2_START;
+
+    if ((waitForI2c(I2C_ISR_TXIS | kI2cErrors) & I2C_ISR_TXIS) == 0)
+        {
+        stopI2c();
+        return false;
+        }
+
+    I2C1->TXDR = reg;
+
+    if ((waitForI2c(I2C_ISR_TC | kI2cErrors) & I2C_ISR_TC) == 0)
+        {
+        stopI2c();
+        return false;
+        }
+
+    // the burst: DMA receives, and the I2C sends the STOP itself.
+    DMA1_Channel3->CCR = 0;
+    DMA1->IFCR = DMA_IFCR_CGIF3;
+    DMA1_Channel3->CPAR = std::uint32_t(std::uintptr_t(&I2C1->RXDR));
+    DMA1_Channel3->CMAR = std::uint32_t(std::uintptr_t(pBuffer));
+    DMA1_Channel3->CNDTR = nBuffer;
+    // without our handler, the flags are polled; an enabled interrupt
+    // would go to the core's handler, which doesn't clear them.
+    DMA1_Channel3->CCR = DMA_CCR_MINC | DMA_CCR_PL_0 |
+                         (kDmaInterrupt ? DMA_CCR_TCIE | DMA_CCR_TEIE : 0);
+    DMA1_Channel3->CCR |= DMA_CCR_EN;
+
+    this->m_pDone = pDone;
+    this->m_pClientData = pClientData;
+    this->m_fBusy = true;
+
+    I2C1->CR1 |= I2C_CR1_RXDMAEN;
+    I2C1->CR2 = (std::uint32_t(address) << 1) |
+                I2C_CR2_RD_WRN |
+                (std::uint32_t(nBuffer) << I2C_CR2_NBYTES_Pos) |
+                I2C_CR2_AUTOEND |
+                I2C_CR2_START;
+
+    return true;
+    }
+
+// the burst is complete, or DMA failed: from the DMA interrupt, or from
+// poll() with interrupts masked.
+void cI2cDmaBus::dmaInterrupt()
+    {
+    std::uint32_t const isr = DMA1->ISR;
+
+    // the handler is shared with channel 2.
+    if ((isr & (DMA_ISR_TCIF3 | DMA_ISR_TEIF3)) == 0)
+        return;
+
+    DMA1->IFCR = DMA_IFCR_CGIF3;
+    if (this->m_fBusy)
+        this->finish((isr & DMA_ISR_TEIF3) ? Status::kBusError : Status::kOk);
+    }
+
+// the end of the DMA transfer, if the interrupt isn't ours; and a NACK
+// or bus error, which ends the I2C transfer, but not the DMA.
+void cI2cDmaBus::poll()
+    {
+    if (! this->m_fBusy)
+        return;
+
+    if (DMA1->ISR & (DMA_ISR_TCIF3 | DMA_ISR_TEIF3))
+        {
+        noInterrupts();
+        this->dmaInterrupt();
+        interrupts();
+        return;
+        }
+
+    if ((I2C1->ISR & kI2cErrors) == 0)
+        return;
+
+    noInterrupts();
+    if (this->m_fBusy)
+        {
+        Status const status = (I2C1->ISR & I2C_ISR_NACKF) ? Status::kNack : Status::kBusError;
+
+        stopI2c();
+        this->finish(status);
+        }
+    interrupts();
+    }
+
+void cI2cDmaBus::abort()
+    {
+    noInterrupts();
+    if (this->m_fBusy)
+        {
+        // clearing PE resets the I2C state machine, releasing the bus.
+        I2C1->CR1 &= ~I2C_CR1_PE;
+        while (I2C1->CR1 & I2C_CR1_PE)
+            /* wait */;
+        I2C1->CR1 |= I2C_CR1_PE;
+
+        this->finish(Status::kAborted);
+        }
+    interrupts();
+    }
+
+// called with the DMA interrupt masked or from it.
+void cI2cDmaBus::finish(Status status)
+    {
+    DMA1_Channel3->CCR = 0;
+    I2C1->CR1 &= ~I2C_CR1_RXDMAEN;
+    this->m_fBusy = false;
+
+    if (this->m_pDone != nullptr)
+        this->m_pDone(this->m_pClientData, status);
+    }
@@ -0,0 +1,104 @@
+/*
+
+Module: Catena4610_cI2cDmaBus.h
+
+Function:
+        cI2cDmaBus: background I2C register reads on the STM32L0, by DMA.
+
+Copyright:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#ifndef _Catena4610_cI2cDmaBus_h_
+# define _Catena4610_cI2cDmaBus_h_
+
+#pragma once
+
+#include "Catena4610_cI2cBus.h"
+
+// 1 to define DMA1_Channel2_3_IRQHandler() here, and finish reads from
+// the DMA interrupt. Only for a core that doesn't define that handler
+// itself; set it on the command line, e.g. -DCATENA4610_DMA_IRQ_HANDLER=1.
+#ifndef CATENA4610_DMA_IRQ_HANDLER
+# define CATENA4610_DMA_IRQ_HANDLER 0
+#endif
+
+namespace McciCatena4610 {
+
+/****************************************************************************\
+|
+|   The DMA bus driver.
+|
+|   This shares I2C1 with Wire, which must have been begun: Wire sets up
+|   the pins and the bus timing, and only enables the peripheral's
+|   interrupts during its own (blocking) transfers, so between them the
+|   peripheral is ours.
+|
+|   startRead() writes the register address with the CPU (one byte, a few
+|   tens of microseconds), then hands the burst read to DMA1 channel 3
+|   with an automatic STOP, and returns. poll() notices the end of the
+|   DMA transfer and calls the completion function; with
+|   CATENA4610_DMA_IRQ_HANDLER, the DMA interrupt does that instead. A
+|   NACK or bus error stops the I2C without finishing the DMA, so poll()
+|   looks for those too.
+|
+|   Don't call Wire while a read is in progress.
+|
+\****************************************************************************/
+
+class cI2cDmaBus : public cI2cBus
+    {
+public:
+    // true if the DMA interrupt finishes reads; otherwise only poll().
+    static constexpr bool kDmaInterrupt = CATENA4610_DMA_IRQ_HANDLER != 0;
+
+    cI2cDmaBus()
+        : m_pDone(nullptr)
+        , m_pClientData(nullptr)
+        , m_fBusy(false)
+        {}
+
+    // neither copyable nor movable
+    cI2cDmaBus(const cI2cDmaBus&) = delete;
+    cI2cDmaBus& operator=(const cI2cDmaBus&) = delete;
+    cI2cDmaBus(const cI2cDmaBus&&) = delete;
+    cI2cDmaBus& operator=(const cI2cDmaBus&&) = delete;
+
+    // set up the DMA channel; call after Wire.begin().
+    bool begin();
+
+    virtual bool startRead(
+        std::uint8_t address,
+        std::uint8_t reg,
+        std::uint8_t *pBuffer,
+        std::size_t nBuffer,
+        CompletionFn pDone,
+        void *pClientData
+        ) override;
+
+    virtual bool isBusy() const override
+        {
+        return this->m_fBusy;
+        }
+
+    virtual void abort() override;
+    virtual void poll() override;
+
+    // called by the DMA interrupt handler, and by poll().
+    void dmaInterrupt();
+
+private:
+    void finish(Status status);
+
+    CompletionFn        m_pDone;
+    void                *m_pClientData;
+    volatile bool       m_fBusy;
+    };
+
+} // namespace McciCatena4610
+
+#endif /* _Catena4610_cI2cDmaBus_h_ */
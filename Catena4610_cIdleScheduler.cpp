@@ -0,0 +1,69 @@
+/*
+
+Module: Catena4610_cIdleScheduler.cpp
+
+Function:
+        cIdleScheduler::idle(): the hardware side of the idle scheduler.
+
+Copyright:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#include "Catena4610_cIdleScheduler.h"
+
+#include <Arduino.h>
+#include <arduino_lmic.h>
+
+using namespace McciCatena4610;
+
+/*
+
+Name:   McciCatena4610::cIdleScheduler::idle()
+
+Function:
+        Put the CPU in sleep mode until the next deadline.
+
+Definition:
+        void McciCatena4610::cIdleScheduler::idle(
+                void
+                );
+
+Description:
+        Executes WFI repeatedly until the idle budget is used up or there
+        is serial input to process. Every interrupt, including the core's
+        millisecond tick, ends a WFI, so the deadline is checked at least
+        once per tick. Idle is skipped entirely while the LMIC is busy,
+        since it polls the radio's DIO lines rather than using interrupts.
+
+Returns:
+        No explicit result.
+
+*/
+
+void cIdleScheduler::idle()
+    {
+    std::uint32_t const tStartUs = micros();
+    std::uint32_t const tStart = millis();
+    std::uint32_t const budget = this->getIdleBudget(tStart);
+
+    if (budget == 0 ||
+        ! LMIC_queryTxReady() ||
+        os_queryTimeCriticalJobs(ms2osticks(budget)))
+        return;
+
+    while (std::uint32_t(millis() - tStart) < budget &&
+           Serial.available() <= 0)
+        {
+        __WFI();
+        }
+
+    // time since the end of the last idle period was spent awake.
+    std::uint32_t const tEndUs = micros();
+
+    this->account(tStartUs - this->m_tLastWakeUs, tEndUs - tStartUs);
+    this->m_tLastWakeUs = tEndUs;
+    }
@@ -0,0 +1,171 @@
+/*
+
+Module: Catena4610_cIdleScheduler.h
+
+Function:
+        cIdleScheduler: sleep the CPU until the next deadline.
+
+Copyright:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#ifndef _Catena4610_cIdleScheduler_h_
+# define _Catena4610_cIdleScheduler_h_
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace McciCatena4610 {
+
+/****************************************************************************\
+|
+|   Objects that know when they next need to be polled.
+|
+\****************************************************************************/
+
+class cDeadlineSource
+    {
+public:
+    // set msRemaining to the time until the object next needs a poll
+    // (0 means now). Return false if nothing is pending; the object then
+    // only needs a poll after an interrupt.
+    virtual bool getNextDeadline(std::uint32_t tNow, std::uint32_t &msRemaining) = 0;
+    };
+
+/****************************************************************************\
+|
+|   The idle scheduler.
+|
+|   After each pass of gCatena.poll(), idle() asks the registered sources
+|   for their deadlines and waits for interrupts (WFI) until the earliest
+|   one. The wait is capped at kMaxIdleMs so that objects which can't report
+|   a deadline (the status LED, the command stream) are still polled often
+|   enough, and is skipped while the LMIC has a transmission in progress
+|   or a time-critical job due.
+|
+|   Time awake and time in WFI are accumulated, giving the CPU duty cycle
+|   and, from per-mode currents, an estimate of average CPU current. The
+|   policy and accounting methods take the time as a parameter, so they
+|   can be driven from a host simulation; only idle() touches hardware.
+|
+\****************************************************************************/
+
+class cIdleScheduler
+    {
+public:
+    static constexpr std::size_t kMaxSources = 4;
+    static constexpr std::uint32_t kMaxIdleMs = 100;
+
+    // defaults for the STM32L0 at 32 MHz: run mode, and sleep mode (WFI).
+    static constexpr std::uint32_t kRunCurrentUa = 3500;
+    static constexpr std::uint32_t kSleepCurrentUa = 1000;
+
+    struct Stats
+        {
+        std::uint64_t   usAwake;        // time spent running
+        std::uint64_t   usIdle;         // time spent in WFI
+        std::uint32_t   nIdle;          // number of idle periods
+        };
+
+    cIdleScheduler()
+        : m_nSources(0)
+        , m_runCurrentUa(kRunCurrentUa)
+        , m_sleepCurrentUa(kSleepCurrentUa)
+        , m_tLastWakeUs(0)
+        , m_stats {}
+        , m_pSources {}
+        {}
+
+    // neither copyable nor movable
+    cIdleScheduler(const cIdleScheduler&) = delete;
+    cIdleScheduler& operator=(const cIdleScheduler&) = delete;
+    cIdleScheduler(const cIdleScheduler&&) = delete;
+    cIdleScheduler& operator=(const cIdleScheduler&&) = delete;
+
+    bool registerSource(cDeadlineSource *pSource)
+        {
+        if (this->m_nSources >= kMaxSources)
+            return false;
+
+        this->m_pSources[this->m_nSources++] = pSource;
+        return true;
+        }
+
+    // how long may we sleep, in milliseconds? Zero means poll again now.
+    std::uint32_t getIdleBudget(std::uint32_t tNow) const
+        {
+        std::uint32_t budget = kMaxIdleMs;
+
+        for (std::size_t i = 0; i < this->m_nSources; ++i)
+            {
+            std::uint32_t ms;
+
+            if (this->m_pSources[i]->getNextDeadline(tNow, ms) && ms < budget)
+                budget = ms;
+            }
+        return budget;
+        }
+
+    // record a pass: usAwake spent running, then usIdle in WFI.
+    void account(std::uint32_t usAwake, std::uint32_t usIdle)
+        {
+        this->m_stats.usAwake += usAwake;
+        this->m_stats.usIdle += usIdle;
+        if (usIdle != 0)
+            ++this->m_stats.nIdle;
+        }
+
+    void setCurrents(std::uint32_t runCurrentUa, std::uint32_t sleepCurrentUa)
+        {
+        this->m_runCurrentUa = runCurrentUa;
+        this->m_sleepCurrentUa = sleepCurrentUa;
+        }
+
+    const Stats &getStats() const
+        {
+        return this->m_stats;
+        }
+
+    void resetStats()
+        {
+        this->m_stats = Stats {};
+        }
+
+    // fraction of time awake, in tenths of a percent.
+    std::uint32_t getDutyCyclePermille() const
+        {
+        std::uint64_t const total = this->m_stats.usAwake + this->m_stats.usIdle;
+
+        return total == 0 ? 1000 : std::uint32_t(this->m_stats.usAwake * 1000 / total);
+        }
+
+    // estimated average CPU current, in microamps.
+    std::uint32_t getAverageCurrentUa() const
+        {
+        std::uint32_t const permille = this->getDutyCyclePermille();
+
+        return (this->m_runCurrentUa * permille +
+                this->m_sleepCurrentUa * (1000 - permille)) / 1000;
+        }
+
+    // wait for interrupts until the next deadline; call from loop().
+    void idle();
+
+private:
+    std::uint8_t        m_nSources;
+    std::uint32_t       m_runCurrentUa;
+    std::uint32_t       m_sleepCurrentUa;
+    std::uint32_t       m_tLastWakeUs;
+    Stats               m_stats;
+    cDeadlineSource     *m_pSources[kMaxSources];
+    };
+
+} // namespace McciCatena4610
+
+#endif /* _Catena4610_cIdleScheduler_h_ */
@@ -0,0 +1,237 @@
+/*
+
+Module: Catena4610_cIqs620aReader.h
+
+Function:
+        cIqs620aReader: read the IQS620A's results in one background burst.
+
+Copyright:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#ifndef _Catena4610_cIqs620aReader_h_
+# define _Catena4610_cIqs620aReader_h_
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "Catena4610_cI2cBus.h"
+
+namespace McciCatena4610 {
+
+/****************************************************************************\
+|
+|   The IQS620A burst reader.
+|
+|   The sensor's driver reads the channel counts and the Hall amplitude
+|   with a separate blocking transaction each. Instead, start() reads the
+|   whole block of result registers in one transaction on a cI2cBus, and
+|   returns at once; the CPU is free (or asleep) while the bus runs. When
+|   getResult() returns true, getCh0Data() and the rest report the new
+|   values, as the driver's getters do, so cTouchChannels::read() works on
+|   either.
+|
+|   The completion function may run in an interrupt: it only notes the
+|   time and the status. Decoding is done by getResult().
+|
+|   For each read, the stats keep the time from start() to completion,
+|   and the CPU time spent on it: in start(), in the completion function,
+|   and in getResult().
+|
+|   Nothing here touches the hardware, so extra/ runs it with a mock bus.
+|
+\****************************************************************************/
+
+class cIqs620aReader
+    {
+public:
+    // the IQS620A's I2C address.
+    static constexpr std::uint8_t kAddress = 0x44;
+
+    // the result block: channel counts from 0x20, two bytes each, low
+    // byte first; then the Hall amplitude, signed, at 0x2E.
+    static constexpr std::uint8_t kFirstRegister = 0x20;
+    static constexpr std::size_t kBurstBytes = 0x30 - kFirstRegister;
+    static constexpr std::size_t kChannelOffset = 0x20 - kFirstRegister;
+    static constexpr std::size_t kAmplitudeOffset = 0x2E - kFirstRegister;
+
+    // microseconds, free running.
+    using ClockFn = std::uint32_t (*)();
+
+    struct Stats
+        {
+        std::uint32_t   nReads;         // completed successfully
+        std::uint32_t   nErrors;        // completed with an error, or aborted
+        std::uint32_t   nBusy;          // start() found the last read unfinished
+        std::uint32_t   usMax;          // longest read, start to completion
+        std::uint32_t   usCpuMax;       // most CPU time taken by a read
+        std::uint64_t   usTotal;        // sum of the read times
+        std::uint64_t   usCpuTotal;     // sum of the CPU times
+        };
+
+    cIqs620aReader()
+        : m_pBus(nullptr)
+        , m_pClock(nullptr)
+        , m_tStart(0)
+        , m_usCpu(0)
+        , m_tDone(0)
+        , m_usIsr(0)
+        , m_status(cI2cBus::Status::kOk)
+        , m_fBusy(false)
+        , m_fDone(false)
+        , m_stats {}
+        , m_ch {}
+        , m_amplitude(0)
+        , m_buffer {}
+        {}
+
+    // neither copyable nor movable
+    cIqs620aReader(const cIqs620aReader&) = delete;
+    cIqs620aReader& operator=(const cIqs620aReader&) = delete;
+    cIqs620aReader(const cIqs620aReader&&) = delete;
+    cIqs620aReader& operator=(const cIqs620aReader&&) = delete;
+
+    void begin(cI2cBus &bus, ClockFn pClock)
+        {
+        this->m_pBus = &bus;
+        this->m_pClock = pClock;
+        }
+
+    // start a read. If the last one hasn't been collected by
+    // getResult(), it's abandoned and counted as busy.
+    bool start()
+        {
+        if (this->m_fBusy)
+            {
+            ++this->m_stats.nBusy;
+            this->m_pBus->abort();
+            // abort() completed it, as an error, if it hadn't completed.
+            this->getResult();
+            }
+
+        std::uint32_t const tStart = this->m_pClock();
+
+        this->m_fDone.store(false, std::memory_order_relaxed);
+        this->m_fBusy = true;
+        this->m_tStart = tStart;
+
+        if (! this->m_pBus->startRead(
+                kAddress, kFirstRegister,
+                this->m_buffer, sizeof(this->m_buffer),
+                onComplete, this))
+            {
+            this->m_fBusy = false;
+            ++this->m_stats.nErrors;
+            return false;
+            }
+
+        this->m_usCpu = this->m_pClock() - tStart;
+        return true;
+        }
+
+    bool isBusy() const
+        {
+        return this->m_fBusy;
+        }
+
+    // let the bus check on the read.
+    void poll()
+        {
+        if (this->m_fBusy)
+            this->m_pBus->poll();
+        }
+
+    // true once for each read that completes successfully; the getters
+    // then return its values.
+    bool getResult()
+        {
+        if (! this->m_fBusy || ! this->m_fDone.load(std::memory_order_acquire))
+            return false;
+
+        std::uint32_t const tStart = this->m_pClock();
+        auto &stats = this->m_stats;
+
+        this->m_fBusy = false;
+        if (this->m_status != cI2cBus::Status::kOk)
+            {
+            ++stats.nErrors;
+            return false;
+            }
+
+        for (std::size_t i = 0; i < kChannels; ++i)
+            {
+            std::size_t const j = kChannelOffset + 2 * i;
+            this->m_ch[i] = std::int16_t(this->m_buffer[j] | (this->m_buffer[j + 1] << 8));
+            }
+        this->m_amplitude = std::int16_t(
+            this->m_buffer[kAmplitudeOffset] | (this->m_buffer[kAmplitudeOffset + 1] << 8)
+            );
+
+        std::uint32_t const usRead = this->m_tDone - this->m_tStart;
+        std::uint32_t const usCpu = this->m_usCpu + this->m_usIsr + (this->m_pClock() - tStart);
+
+        ++stats.nReads;
+        stats.usTotal += usRead;
+        stats.usCpuTotal += usCpu;
+        if (usRead > stats.usMax)
+            stats.usMax = usRead;
+        if (usCpu > stats.usCpuMax)
+            stats.usCpuMax = usCpu;
+        return true;
+        }
+
+    std::int16_t getCh0Data() const { return this->m_ch[0]; }
+    std::int16_t getCh1Data() const { return this->m_ch[1]; }
+    std::int16_t getCh2Data() const { return this->m_ch[2]; }
+    std::int16_t getAmplitude() const { return this->m_amplitude; }
+
+    const Stats &getStats() const
+        {
+        return this->m_stats;
+        }
+
+    void resetStats()
+        {
+        this->m_stats = Stats {};
+        }
+
+private:
+    static constexpr std::size_t kChannels = 3;
+
+    static void onComplete(void *pClientData, cI2cBus::Status status)
+        {
+        cIqs620aReader * const pThis = static_cast<cIqs620aReader *>(pClientData);
+        std::uint32_t const tDone = pThis->m_pClock();
+
+        pThis->m_status = status;
+        pThis->m_tDone = tDone;
+        pThis->m_usIsr = pThis->m_pClock() - tDone;
+        pThis->m_fDone.store(true, std::memory_order_release);
+        }
+
+    cI2cBus                 *m_pBus;
+    ClockFn                 m_pClock;
+    std::uint32_t           m_tStart;
+    std::uint32_t           m_usCpu;        // spent in start()
+    // set by onComplete(), before m_fDone.
+    std::uint32_t           m_tDone;
+    std::uint32_t           m_usIsr;
+    cI2cBus::Status         m_status;
+    bool                    m_fBusy;        // started, not yet collected
+    std::atomic<bool>       m_fDone;
+    Stats                   m_stats;
+    std::int16_t            m_ch[kChannels];
+    std::int16_t            m_amplitude;
+    std::uint8_t            m_buffer[kBurstBytes];
+    };
+
+} // namespace McciCatena4610
+
+#endif /* _Catena4610_cIqs620aReader_h_ */
@@ -0,0 +1,151 @@
+/*
+
+Module: Catena4610_cLoRaWANSession.cpp
+
+Function:
+        Save and restore the LMIC session across resets.
+
+Copyright:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#include "Catena4610_cLoRaWANSession.h"
+
+#include <arduino_lmic.h>
+
+using namespace McciCatena4610;
+using namespace McciCatena;
+
+/****************************************************************************\
+|
+|   The region-specific channel plan is kept as an opaque blob.
+|
+\****************************************************************************/
+
+template <typename T>
+static void xferChannelState(
+    bool fSave,
+    std::uint8_t *pBlob,
+    std::size_t &offset,
+    T &lmicField
+    )
+    {
+    if (fSave)
+        std::memcpy(pBlob + offset, &lmicField, sizeof(lmicField));
+    else
+        std::memcpy(&lmicField, pBlob + offset, sizeof(lmicField));
+
+    offset += sizeof(lmicField);
+    }
+
+static void xferChannelState(bool fSave, std::uint8_t *pBlob)
+    {
+    std::size_t offset = 0;
+
+    xferChannelState(fSave, pBlob, offset, LMIC.channelMap);
+#if CFG_LMIC_EU_like
+    xferChannelState(fSave, pBlob, offset, LMIC.channelFreq);
+    xferChannelState(fSave, pBlob, offset, LMIC.channelDrMap);
+#endif
+    }
+
+static_assert(
+    sizeof(LMIC.channelMap)
+#if CFG_LMIC_EU_like
+    + sizeof(LMIC.channelFreq) + sizeof(LMIC.channelDrMap)
+#endif
+    <= cLoRaWANSession::Store::kChannelStateBytes,
+    "channel plan doesn't fit in the stored session"
+    );
+
+void cLoRaWANSession::getLmicSession(Session &s)
+    {
+    std::memset(&s, 0, sizeof(s));
+
+    LMIC_getSessionKeys(&s.netId, &s.devAddr, s.nwkSKey, s.appSKey);
+    s.seqnoUp = LMIC.seqnoUp;
+    s.seqnoDn = LMIC.seqnoDn;
+    s.datarate = LMIC.datarate;
+    s.txPower = LMIC.adrTxPow;
+    s.dn2Dr = LMIC.dn2Dr;
+    s.dn2Freq = LMIC.dn2Freq;
+    s.rxDelay = LMIC.rxDelay;
+    xferChannelState(true, s.channelState);
+    }
+
+void cLoRaWANSession::setLmicSession(const Session &s)
+    {
+    // this also cancels any join in progress.
+    LMIC_setSession(s.netId, s.devAddr, s.nwkSKey, s.appSKey);
+    LMIC.seqnoUp = s.seqnoUp;
+    LMIC.seqnoDn = s.seqnoDn;
+    LMIC_setDrTxpow(s.datarate, s.txPower);
+    LMIC.dn2Dr = s.dn2Dr;
+    LMIC.dn2Freq = s.dn2Freq;
+    LMIC.rxDelay = s.rxDelay;
+    xferChannelState(false, const_cast<std::uint8_t *>(s.channelState));
+    }
+
+/****************************************************************************\
+|
+|   The public methods.
+|
+\****************************************************************************/
+
+void cLoRaWANSession::begin()
+    {
+    this->m_fEnabled = true;
+
+    this->m_power.acquire(cPowerManager::Peripheral::kFlash);
+    this->m_store.begin();
+    this->m_power.release(cPowerManager::Peripheral::kFlash);
+    }
+
+bool cLoRaWANSession::restore()
+    {
+    Session s;
+
+    if (! this->m_fEnabled)
+        return false;
+
+    this->m_power.acquire(cPowerManager::Peripheral::kFlash);
+    bool const fFound = this->m_store.resume(s);
+    this->m_power.release(cPowerManager::Peripheral::kFlash);
+
+    if (! fFound)
+        return false;
+
+    setLmicSession(s);
+    return true;
+    }
+
+void cLoRaWANSession::update()
+    {
+    // nothing to save until we've joined.
+    if (! this->m_fEnabled || LMIC.devaddr == 0)
+        return;
+
+    Session s;
+    getLmicSession(s);
+
+    this->m_power.acquire(cPowerManager::Peripheral::kFlash);
+    this->m_store.update(s);
+    this->m_power.release(cPowerManager::Peripheral::kFlash);
+    }
+
+void cLoRaWANSession::erase()
+    {
+    if (! this->m_fEnabled)
+        return;
+
+    Session s;
+    getLmicSession(s);
+
+    this->m_power.acquire(cPowerManager::Peripheral::kFlash);
+    this->m_store.erase(s);
+    this->m_power.release(cPowerManager::Peripheral::kFlash);
+    }
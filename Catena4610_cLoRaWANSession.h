@@ -0,0 +1,90 @@
+/*
+
+Module: Catena4610_cLoRaWANSession.h
+
+Function:
+        cLoRaWANSession: save and restore the LMIC session across resets.
+
+Copyright:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#ifndef _Catena4610_cLoRaWANSession_h_
+# define _Catena4610_cLoRaWANSession_h_
+
+#pragma once
+
+#include <Catena_Mx25v8035f.h>
+
+#include "Catena4610_cPowerManager.h"
+#include "Catena4610_cSessionStore.h"
+
+namespace McciCatena4610 {
+
+/****************************************************************************\
+|
+|   Glue between the LMIC and the session store.
+|
+|   The flash is kept powered down except while the store is accessed.
+|
+\****************************************************************************/
+
+class cLoRaWANSession
+    {
+public:
+    using Store = cSessionStore<McciCatena::Catena_Mx25v8035f>;
+    using Session = Store::Session;
+
+    cLoRaWANSession(McciCatena::Catena_Mx25v8035f &flash, cPowerManager &power)
+        : m_power(power)
+        , m_store(flash)
+        , m_fEnabled(false)
+        {}
+
+    // neither copyable nor movable
+    cLoRaWANSession(const cLoRaWANSession&) = delete;
+    cLoRaWANSession& operator=(const cLoRaWANSession&) = delete;
+    cLoRaWANSession(const cLoRaWANSession&&) = delete;
+    cLoRaWANSession& operator=(const cLoRaWANSession&&) = delete;
+
+    // call once the flash is known to be present; reads the stored session.
+    void begin();
+
+    // load the stored session into the LMIC (after the LMIC is reset).
+    // Returns true if the node can transmit without joining.
+    bool restore();
+
+    // call after each uplink: saves the session or journals the counters.
+    // This programs flash: call it from poll(), not from an LMIC callback.
+    void update();
+
+    // forget the stored session; the next reset will join. The running
+    // session isn't saved again until it's replaced by a join.
+    void erase();
+
+    bool isEnabled() const
+        {
+        return this->m_fEnabled;
+        }
+
+    const Store &getStore() const
+        {
+        return this->m_store;
+        }
+
+private:
+    static void getLmicSession(Session &s);
+    static void setLmicSession(const Session &s);
+
+    cPowerManager                   &m_power;
+    Store                           m_store;
+    bool                            m_fEnabled;
+    };
+
+} // namespace McciCatena4610
+
+#endif /* _Catena4610_cLoRaWANSession_h_ */
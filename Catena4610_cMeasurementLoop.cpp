@@ -18,6 +18,8 @@ Author:
 #include <arduino_lmic.h>
 #include <TouchSense-Lorawan.h>
 
+#include <cstring>
+
 using namespace McciCatena4610;
 using namespace McciCatena;
 using namespace McciCatenaIqs620a;
@@ -38,10 +40,20 @@ void cMeasurementLoop::begin()
         gCatena.registerObject(this);
 
         this->m_UplinkTimer.begin(this->m_txCycleSec * 1000);
+
+        // de-synchronize retry backoff from other nodes on the same site.
+        std::uint32_t bootCount;
+        if (! gCatena.getBootCount(bootCount))
+            bootCount = 0;
+        this->m_UplinkQueue.setSeed(micros() ^ (bootCount << 16));
         }
 
-    Wire.begin();
+    // the sensors stay in use; after deep sleep, poll() brings the bus back.
+    gPowerManager.acquire(cPowerManager::Peripheral::kI2c);
 
+#if CATENA4610_ARRAY_SENSORS != 0
+    this->m_fProximity = this->beginSensorArray();
+#else
     if(!gIqs620a.begin())
         {
         gCatena.SafePrintf("No IQS620A Sensor found: check wiring\n");
@@ -52,9 +64,13 @@ void cMeasurementLoop::begin()
         gCatena.SafePrintf("IQS620A Sensor found!\n");
         this->m_fProximity = true;
 
-        this->m_data.touchData.touchCountLeft = 0;
-        this->m_data.touchData.touchCountRight = 0;
+        if (kEnableBurstRead)
+            {
+            gI2cBus.begin();
+            this->m_SensorReader.begin(gI2cBus, micros);
+            }
         }
+#endif
 
     // start (or restart) the FSM.
     if (! this->m_running)
@@ -64,6 +80,69 @@ void cMeasurementLoop::begin()
         }
     }
 
+#if CATENA4610_ARRAY_SENSORS != 0
+// select a channel of the mux, or none; Wire is ours between array reads.
+static bool selectMux(void *, std::uint8_t channel)
+    {
+    Wire.beginTransmission(cMeasurementLoop::kMuxAddress);
+    Wire.write(channel == cMeasurementLoop::SensorArray_t::kNoMux ? 0 : std::uint8_t(1u << channel));
+    return Wire.endTransmission() == 0;
+    }
+
+/*
+
+Name:   McciCatena4610::cMeasurementLoop::beginSensorArray()
+
+Function:
+        Find and set up the sensors of the array.
+
+Definition:
+        bool McciCatena4610::cMeasurementLoop::beginSensorArray(
+                void
+                );
+
+Description:
+        Each sensor is set up by the IQS620A driver, which only knows
+        the sensor's default address; so it's done with the mux switched
+        to the sensor's channel. Sensors that aren't found are still read
+        in turn, in case they come back; the uplinks say which answered.
+
+Returns:
+        true if any sensor was found.
+
+*/
+
+bool cMeasurementLoop::beginSensorArray()
+    {
+    auto &array = this->m_SensorArray;
+    std::uint8_t found = 0;
+
+    gI2cBus.begin();
+    array.begin(gI2cBus, selectMux, nullptr);
+    array.setSchedule(
+        kArrayUsePriority ? SensorArray_t::Policy::kPriority : SensorArray_t::Policy::kRoundRobin,
+        kArrayReadsPerRound
+        );
+    array.setThresholds(this->getThresholds());
+    array.setDetection(this->m_Config.touchHysteresis, std::uint8_t(this->m_Config.touchDebounce));
+
+    for (std::size_t i = 0; i < kArraySensors; ++i)
+        {
+        array.addSensor(
+            cIqs620aReader::kAddress,
+            std::uint8_t(i),
+            i == 0 ? kArrayPrimaryPriority : 1
+            );
+
+        if (selectMux(nullptr, std::uint8_t(i)) && gIqs620a.begin())
+            found |= 1u << i;
+        }
+
+    gCatena.SafePrintf("IQS620A sensor array: found %02x of %u\n", found, unsigned(kArraySensors));
+    return found != 0;
+    }
+#endif
+
 void cMeasurementLoop::end()
     {
     if (this->m_running)
@@ -91,6 +170,18 @@ cMeasurementLoop::fsmDispatch(
     {
     State newState = State::stNoChange;
 
+    if (fEntry)
+        {
+        this->accountEnergy(millis());
+        this->m_energyCategory = getEnergyCategory(currentState);
+
+        if (kEnableClockScaling)
+            {
+            this->m_ClockPolicy.setTarget(cClockPolicy::getLevelFor(this->m_energyCategory));
+            this->updateClock(millis());
+            }
+        }
+
     if (fEntry && this->isTraceEnabled(this->DebugFlags::kTrace))
         {
         gCatena.SafePrintf("cMeasurementLoop::fsmDispatch: enter %s\n",
@@ -128,6 +219,10 @@ cMeasurementLoop::fsmDispatch(
             gLed.Set(McciCatena::LedPattern::Sleeping);
             }
 
+        // finish waking up from deep sleep before anything else.
+        if (this->m_wakeTask.isRunning() && ! this->deepSleepRecovery())
+            break;
+
         if (this->m_rqInactive)
             {
             this->m_rqActive = this->m_rqInactive = false;
@@ -136,7 +231,9 @@ cMeasurementLoop::fsmDispatch(
             }
         else if (this->m_UplinkTimer.isready())
             newState = State::stMeasure;
-        else if (this->m_UplinkTimer.getRemaining() > 1500)
+        else if (this->m_UplinkQueue.peekReady(millis()) != nullptr)
+            newState = State::stTransmit;
+        else if (this->getSleepRemaining() > 1500)
             this->sleep();
         break;
 
@@ -145,34 +242,47 @@ cMeasurementLoop::fsmDispatch(
         if (fEntry)
             {
             //start the timer
-            this->setTimer(5 * 1000);
+            this->setTimer(Timeout::kWarmup, 5 * 1000);
+            this->m_nStableSamples = 0;
             }
-        if (this->timedOut())
+        if (this->timedOut(Timeout::kWarmup) ||
+            (this->m_fFastWarmup && this->isWarmupStable()))
+            {
+            this->clearTimer(Timeout::kWarmup);
+            gBootProfile.mark(cBootProfile::Phase::kWarmup, millis());
             newState = State::stMeasure;
+            }
         break;
 
     // fill in the measurement
     case State::stMeasure:
         if (fEntry)
+            this->m_measureTask.reset();
+
+        if (this->updateSynchronousMeasurements())
             {
-            this->updateSynchronousMeasurements();
-            this->setTimer(1000);
+            if (++this->m_nUplinksSinceDiag >= kDiagnosticsInterval)
+                {
+                this->m_data.flags |= Flags::Diag;
+                this->m_nUplinksSinceDiag = 0;
+                }
+
+            this->m_tMeasured = millis();
+            this->queueUplink(this->m_data, UplinkPriority::kPeriodic);
+            this->resetMeasurements();
+
+            // calculate the new sleep interval.
+            this->updateTxCycleTime();
+
             newState = State::stTransmit;
             }
         break;
 
+    // send the most important frame that is due, if any.
     case State::stTransmit:
-        if (fEntry)
+        if (fEntry && this->startTransmission())
             {
-            TxBuffer_t b;
-            this->fillTxBuffer(b, this->m_data);
-
-            this->m_FileTxBuffer.begin();
-            for (auto i = 0; i < b.getn(); ++i)
-                this->m_FileTxBuffer.put(b.getbase()[i]);
-
-            this->resetMeasurements();
-            this->startTransmission(b);
+            auto const site = gStallMonitor.enter(cStallMonitor::Site::kTxSpin);
 
             while (true)
                 {
@@ -187,16 +297,17 @@ cMeasurementLoop::fsmDispatch(
                     break;
                     }
 
+                // a join or a duty-cycle wait may keep us here for
+                // minutes; each pass that gets this far is progress.
+                gStallMonitor.progress();
                 gCatena.poll();
                 yield();
                 }
+            gStallMonitor.leave(site);
             }
         if (this->txComplete())
             {
             newState = State::stSleeping;
-
-            // calculate the new sleep interval.
-            this->updateTxCycleTime();
             }
         break;
 
@@ -207,6 +318,10 @@ cMeasurementLoop::fsmDispatch(
         break;
         }
 
+    // the sleep alert belongs to stSleeping; it starts over next time.
+    if (newState != State::stNoChange)
+        this->m_sleepAlertTask.reset();
+
     return newState;
     }
 
@@ -222,12 +337,42 @@ void cMeasurementLoop::resetMeasurements()
     this->m_data.flags = Flags(0);
     }
 
-void cMeasurementLoop::updateSynchronousMeasurements()
+// count consecutive sensor readings that barely moved.
+void cMeasurementLoop::updateWarmupStability()
+    {
+    auto const &ch = this->m_data.touchData.ChData;
+
+    if (TouchChannels::isStable(ch, this->m_warmupCh, kWarmupStableDelta))
+        {
+        if (this->m_nStableSamples < 0xFF)
+            ++this->m_nStableSamples;
+        }
+    else
+        {
+        this->m_nStableSamples = 0;
+        }
+
+    this->m_warmupCh = ch;
+    }
+
+// without a sensor, there is nothing to settle.
+bool cMeasurementLoop::isWarmupStable() const
+    {
+    return ! this->m_fProximity ||
+           this->m_nStableSamples >= kWarmupStableSamples;
+    }
+
+// a task: returns true when the measurements are complete.
+bool cMeasurementLoop::updateSynchronousMeasurements()
     {
-    this->m_data.Vbat = gCatena.ReadVbat();
+    TASK_BEGIN(this->m_measureTask);
+
+    this->m_data.Vbat = voltsToMv(gCatena.ReadVbat());
     this->m_data.flags |= Flags::Vbat;
+    if (gStreamPort.isRunning())
+        gStreamPort.pushVbat(millis(), this->m_data.Vbat);
 
-    this->m_data.Vbus = gCatena.ReadVbus();
+    this->m_data.Vbus = voltsToMv(gCatena.ReadVbus());
     this->m_data.flags |= Flags::Vcc;
 
     if (gCatena.getBootCount(this->m_data.BootCount))
@@ -235,12 +380,23 @@ void cMeasurementLoop::updateSynchronousMeasurements()
         this->m_data.flags |= Flags::Boot;
         }
 
-    // enable boost regulator if no USB power and VBat is less than 3.1V
-    if (!m_fUsbPower && (this->m_data.Vbat < 3.10f))
+    this->m_Battery.sampleVbat(this->m_data.Vbat);
+    this->updateBatteryModel(millis());
+
+    // switch the boost regulator, with hysteresis; give it time to
+    // settle when it comes on.
+    if (this->m_Battery.isBoostOn())
+        {
+        if (! this->m_Battery.updateBoost(this->m_data.Vbat, this->m_fUsbPower))
+            gPowerManager.release(cPowerManager::Peripheral::kBoost);
+        }
+    else if (this->m_Battery.updateBoost(this->m_data.Vbat, this->m_fUsbPower))
         {
-        boostPowerOn();
-        delay(50);
+        gPowerManager.acquire(cPowerManager::Peripheral::kBoost);
+        TASK_WAIT_UNTIL(this->m_measureTask, gPowerManager.isReady(cPowerManager::Peripheral::kBoost));
         }
+
+    TASK_END(this->m_measureTask);
     }
 
 /****************************************************************************\
@@ -249,11 +405,192 @@ void cMeasurementLoop::updateSynchronousMeasurements()
 |
 \****************************************************************************/
 
-void cMeasurementLoop::startTransmission(
-    cMeasurementLoop::TxBuffer_t &b
+/*
+
+Name:   McciCatena4610::cMeasurementLoop::queueUplink()
+
+Function:
+        Encode a measurement and put it in the uplink queue.
+
+Definition:
+        void McciCatena4610::cMeasurementLoop::queueUplink(
+                Measurement &mData,
+                UplinkPriority priority
+                );
+
+Description:
+        If the newest frame of the same priority class is still waiting
+        in the queue, it is replaced. No touches are lost by this: the
+        touch counts are filled in again when the frame is sent (see
+        startTransmission()). A frame carrying diagnostics is neither
+        replaced nor replaces another, so no report is lost; the maximum
+        poll time restarts once it has been queued.
+
+*/
+
+void cMeasurementLoop::queueUplink(
+    Measurement &mData,
+    UplinkPriority priority
     )
     {
-    auto const savedLed = gLed.Set(McciCatena::LedPattern::Off);
+    if ((mData.flags & Flags::TouchCount) != Flags(0))
+        {
+        gTouchCounters.getUnacked(
+            mData.touchData.touchCountLeft,
+            mData.touchData.touchCountRight
+            );
+        }
+
+    TxBuffer_t b;
+    this->fillTxBuffer(b, mData);
+
+    bool const fCoalesce = (mData.flags & Flags::Diag) == Flags(0);
+
+    if (! this->m_UplinkQueue.put(
+                b.getbase(), b.getn(), kUplinkPort, priority,
+                fCoalesce, millis()
+                ))
+        {
+        if (this->isTraceEnabled(this->DebugFlags::kError))
+            gCatena.SafePrintf("uplink queue full: frame dropped\n");
+        }
+    else if ((mData.flags & Flags::Diag) != Flags(0))
+        {
+        // the maximum poll time is per report; start over only once the
+        // report is queued, so a dropped frame doesn't lose it.
+        this->m_Diagnostics.msMaxPoll = 0;
+        }
+    }
+
+// queue a touch-count frame (with the array bitmaps, if any) at touch-event
+// priority.
+void cMeasurementLoop::queueTouchEvent()
+    {
+    Measurement event {};
+
+    event.flags = Flags::TouchCount;
+#if CATENA4610_ARRAY_SENSORS != 0
+    event.flags |= Flags::Sensors;
+    event.sensors = this->m_data.sensors;
+#endif
+    this->queueUplink(event, UplinkPriority::kTouchEvent);
+    }
+
+/*
+
+Name:   McciCatena4610::cMeasurementLoop::queueWaveformFragment()
+
+Function:
+        Move the next waveform fragment into the uplink queue.
+
+Definition:
+        bool McciCatena4610::cMeasurementLoop::queueWaveformFragment(
+                void
+                );
+
+Description:
+        Fragments are queued one at a time, at the lowest priority, so a
+        capture never holds more than one queue slot and periodic and
+        touch frames always go first; if the queue fills, a waiting
+        fragment is the first thing evicted. The next fragment is queued
+        only once the previous one has been sent (or given up on), and
+        not before kWaveformFragmentSpacingMs, so a capture's airtime is
+        spread out. A fragment that is dropped is not resent; the
+        backend discards a capture with missing pieces, so the rest of
+        that capture is abandoned rather than sent.
+
+Returns:
+        true if a fragment was queued.
+
+*/
+
+bool cMeasurementLoop::queueWaveformFragment()
+    {
+    std::uint32_t const nDropped = this->m_UplinkQueue.getDropped(UplinkPriority::kWaveform);
+
+    if (nDropped != this->m_nWaveformDropped)
+        {
+        this->m_nWaveformDropped = nDropped;
+
+        // if a fragment of this capture has been taken, the one lost was
+        // ours; otherwise it was the end of the capture before.
+        if (this->m_Waveform.hasFragment() && this->m_Waveform.getFragmentIndex() != 0)
+            {
+            if (this->isTraceEnabled(this->DebugFlags::kError))
+                gCatena.SafePrintf("waveform: fragment lost, capture abandoned\n");
+            this->m_Waveform.abort();
+            }
+        }
+
+    if (! this->m_Waveform.hasFragment() ||
+        this->m_UplinkQueue.isQueued(UplinkPriority::kWaveform))
+        return false;
+
+    std::uint32_t const tNotBefore = millis() +
+        (this->m_Waveform.getFragmentIndex() == 0 ? 0 : kWaveformFragmentSpacingMs);
+    std::uint8_t fragment[MeasurementFormat::kTxBufferSize];
+    std::size_t const nFragment = this->m_Waveform.getFragment(fragment);
+
+    // put() holds the frame until the time given.
+    return this->m_UplinkQueue.put(
+            fragment, nFragment, kWaveformPort, UplinkPriority::kWaveform,
+            /* fCoalesce */ false, tNotBefore
+            );
+    }
+
+// time until something needs attention: the next measurement or the next
+// queued frame, whichever is sooner.
+std::uint32_t cMeasurementLoop::getSleepRemaining() const
+    {
+    std::uint32_t remaining = this->m_UplinkTimer.getRemaining();
+    std::uint32_t msDue;
+
+    if (this->m_UplinkQueue.getNextDue(millis(), msDue) && msDue < remaining)
+        remaining = msDue;
+
+    return remaining;
+    }
+
+/*
+
+Name:   McciCatena4610::cMeasurementLoop::startTransmission()
+
+Function:
+        Launch the uplink of the next frame that is due.
+
+Definition:
+        bool McciCatena4610::cMeasurementLoop::startTransmission(
+                void
+                );
+
+Description:
+        The highest-priority frame that is due is taken from the uplink
+        queue and handed to the LoRaWAN stack. When the uplink completes,
+        the queue is told the result: failed (or unacknowledged confirmed)
+        uplinks stay queued and are retried with backoff.
+
+        The touch counts in the frame are replaced by the touches not yet
+        covered by a completed uplink, as of now; the stack copies the
+        frame, so the queued copy is left alone.
+
+Returns:
+        true if an uplink was launched. Otherwise, the transmit is
+        marked complete and false is returned.
+
+*/
+
+bool cMeasurementLoop::startTransmission()
+    {
+    auto const pEntry = this->m_UplinkQueue.startSend(millis());
+
+    if (pEntry == nullptr)
+        {
+        this->m_txpending = this->m_txerr = false;
+        this->m_txcomplete = true;
+        return false;
+        }
+
+    gLed.Set(McciCatena::LedPattern::Off);
     gLed.Set(McciCatena::LedPattern::Sending);
 
     // by using a lambda, we can access the private contents
@@ -261,41 +598,238 @@ void cMeasurementLoop::startTransmission(
         [](void *pClientData, bool fSuccess)
             {
             auto const pThis = (cMeasurementLoop *)pClientData;
-            pThis->m_txpending = false;
-            pThis->m_txcomplete = true;
-            pThis->m_txerr = ! fSuccess;
-            pThis->m_fsm.eval();
+            pThis->sendBufferDone(fSuccess);
             };
 
     bool fConfirmed = false;
     if (gCatena.GetOperatingFlags() &
         static_cast<uint32_t>(gCatena.OPERATING_FLAGS::fConfirmedUplink))
         {
-        gCatena.SafePrintf("requesting confirmed tx\n");
+        if (this->isTraceEnabled(this->DebugFlags::kTrace))
+            gCatena.SafePrintf("requesting confirmed tx\n");
         fConfirmed = true;
         }
 
     this->m_txpending = true;
     this->m_txcomplete = this->m_txerr = false;
+    this->m_fTxPeriodic = pEntry->priority == UplinkPriority::kPeriodic;
+
+    std::uint8_t frame[MeasurementFormat::kTxBufferSize];
+    std::uint16_t touchLeft, touchRight;
+
+    std::memcpy(frame, pEntry->data, pEntry->nData);
+    gTouchCounters.getUnacked(touchLeft, touchRight);
+    if (pEntry->port != kUplinkPort ||
+        ! patchTouchCounts(frame, pEntry->nData, touchLeft, touchRight))
+        touchLeft = touchRight = 0;
+    else if (this->isTraceEnabled(this->DebugFlags::kTrace))
+        gCatena.SafePrintf("TOUCH COUNT LEFT:  %u  RIGHT:  %u\n", touchLeft, touchRight);
+    gTouchCounters.startSend(touchLeft, touchRight);
 
-    constexpr unsigned kUplinkPort = 1;
-    if (! gLoRaWAN.SendBuffer(b.getbase(), b.getn(), sendBufferDoneCb, (void *)this, fConfirmed, kUplinkPort))
+    if (! gLoRaWAN.SendBuffer(frame, pEntry->nData, sendBufferDoneCb, (void *)this, fConfirmed, pEntry->port))
         {
         // uplink wasn't launched.
-        this->m_txcomplete = true;
-        this->m_txerr = true;
-        this->m_fsm.eval();
+        this->sendBufferDone(false);
+        return false;
         }
+
+    // account the airtime at the data rate the LMIC will use.
+    rps_t const rps = LMIC_updr2rps(LMIC.datarate);
+    if (getSf(rps) != FSK)
+        {
+        this->m_Energy.accountUplink(
+            std::uint8_t(7 + getSf(rps) - SF7),
+            std::uint32_t(125) << getBw(rps),
+            pEntry->nData
+            );
+        }
+
+    return true;
     }
 
 void cMeasurementLoop::sendBufferDone(bool fSuccess)
     {
+    this->m_UplinkQueue.sendDone(fSuccess, millis());
+    gTouchCounters.sendDone(fSuccess);
+    if (fSuccess)
+        gBootProfile.mark(cBootProfile::Phase::kFirstUplink, millis());
+
+    if (! fSuccess)
+        {
+        if (this->m_Diagnostics.nTxFail < 0xFFFF)
+            ++this->m_Diagnostics.nTxFail;
+        }
+    else if (this->m_fTxPeriodic)
+        {
+        std::uint32_t const msLatency = millis() - this->m_tMeasured;
+
+        this->m_Diagnostics.msTxLatency = msLatency > 0xFFFF ? 0xFFFF : std::uint16_t(msLatency);
+        }
+
+    // keep the saved session's frame counters ahead of the LMIC's; this
+    // programs flash, so poll() does it, outside the LMIC callback.
+    this->m_fSaveSession = true;
+
+    if (! fSuccess && this->isTraceEnabled(this->DebugFlags::kError))
+        {
+        auto const &stats = this->m_UplinkQueue.getStats();
+        gCatena.SafePrintf("uplink failed: %u queued, %u retries, %u dropped\n",
+                stats.depth, unsigned(stats.nRetries), unsigned(stats.nDropped)
+                );
+        }
+
     this->m_txpending = false;
     this->m_txcomplete = true;
     this->m_txerr = ! fSuccess;
     this->m_fsm.eval();
     }
 
+// save the session if an uplink has completed since the last save.
+void cMeasurementLoop::saveSession()
+    {
+    if (! this->m_fSaveSession)
+        return;
+
+    this->m_fSaveSession = false;
+    gLoRaWANSession.update();
+    }
+
+/****************************************************************************\
+|
+|   Sample the touch sensor
+|
+\****************************************************************************/
+
+// a task: start a sensor read, and return true once the results can be
+// fetched.
+bool cMeasurementLoop::sampleSensor()
+    {
+    TASK_BEGIN(this->m_sampleTask);
+
+    // the burst runs while we wait; processSample() collects it.
+#if CATENA4610_ARRAY_SENSORS != 0
+    this->m_SensorArray.startRound();
+#else
+    if (kEnableBurstRead)
+        this->m_SensorReader.start();
+    else
+        gIqs620a.iqsRead();
+#endif
+    TASK_DELAY(this->m_sampleTask, millis(), this->m_Config.samplePeriodMs);
+
+    TASK_END(this->m_sampleTask);
+    }
+
+// process the latest sensor results. Returns true if the FSM should be
+// evaluated.
+bool cMeasurementLoop::processSample()
+    {
+    bool fEvent = false;
+
+    auto &ch = this->m_data.touchData.ChData;
+
+#if CATENA4610_ARRAY_SENSORS != 0
+    auto &array = this->m_SensorArray;
+    std::uint8_t const fresh = array.endRound();
+
+    this->m_data.sensors.present = array.getPresent();
+    this->m_data.sensors.active |= array.getNewTouches();
+    this->m_data.flags |= Flags::Sensors;
+
+    // sensor 0 is handled below; the others only raise events.
+    if ((array.getNewTouches() & ~1u) != 0 &&
+        (gCatena.GetOperatingFlags() &
+            static_cast<uint32_t>(OPERATING_FLAGS::fTouchEventUplink)))
+        {
+        this->queueTouchEvent();
+        fEvent = true;
+        }
+
+    // sensor 0 wasn't read this round.
+    if ((fresh & 1) == 0)
+        return fEvent;
+
+    array.getReadings(0, ch);
+    this->m_data.amplitude.Amplitude = array.getAmplitude(0);
+#else
+    if (kEnableBurstRead)
+        {
+        // a whole sampling period wasn't enough: skip this sample; the
+        // next start() abandons the read.
+        if (! this->m_SensorReader.getResult())
+            return false;
+
+        TouchChannels::read(this->m_SensorReader, ch);
+        this->m_data.amplitude.Amplitude = this->m_SensorReader.getAmplitude();
+        }
+    else
+        {
+        TouchChannels::read(gIqs620a, ch);
+        this->m_data.amplitude.Amplitude = gIqs620a.getAmplitude();
+        }
+#endif
+
+    if (this->m_fFastWarmup)
+        {
+        this->updateWarmupStability();
+        if (this->m_nStableSamples == kWarmupStableSamples)
+            fEvent = true;
+        }
+
+    auto const touch = this->m_TouchDetector.update<TouchChannels::kChannels>(
+        ch,
+        this->getThresholds(),
+        this->m_Config.touchHysteresis,
+        std::uint8_t(this->m_Config.touchDebounce)
+        );
+
+    if (touch.fLeft || touch.fRight)
+        gTouchCounters.count(touch.fLeft, touch.fRight);
+
+    this->m_data.flags |= Flags::TouchCount;
+
+    // on a new touch, queue an event frame if asked to.
+    if (touch.fNewTouch &&
+        (gCatena.GetOperatingFlags() &
+            static_cast<uint32_t>(OPERATING_FLAGS::fTouchEventUplink)))
+        {
+        this->queueTouchEvent();
+        fEvent = true;
+        }
+
+    this->m_data.flags |= Flags::TouchProx;
+
+    this->m_Waveform.push(WaveformCapture_t::Sample {
+        this->m_tLastSample,
+        ch[0],
+        ch[1],
+        this->m_data.amplitude.Amplitude
+        });
+    if (touch.fNewTouch)
+        this->m_Waveform.trigger(this->m_tLastSample, WaveformCapture_t::Reason::kTouch);
+
+    if (gStreamPort.isRunning())
+        gStreamPort.push(
+            this->m_tLastSample,
+            ch[0],
+            ch[1],
+            this->m_data.amplitude.Amplitude
+            );
+
+    return fEvent;
+    }
+
+// only the two sides are configured; other channels are sampled and sent,
+// but cTouchDetector never counts them.
+cMeasurementLoop::TouchChannels::Thresholds cMeasurementLoop::getThresholds() const
+    {
+    TouchChannels::Thresholds thresholds {};
+
+    thresholds[0] = this->m_Config.thresholdRight;
+    thresholds[1] = this->m_Config.thresholdLeft;
+    return thresholds;
+    }
+
 /****************************************************************************\
 |
 |   The Polling function --
@@ -304,11 +838,37 @@ void cMeasurementLoop::sendBufferDone(bool fSuccess)
 
 void cMeasurementLoop::poll()
     {
+    std::uint32_t const tStart = millis();
     bool fEvent;
 
     // no need to evaluate unless something happens.
     fEvent = false;
 
+    // a clock switch put off by a busy peripheral.
+    if (kEnableClockScaling)
+        this->updateClock(tStart);
+
+    // put a downlink into effect; this is kept out of the LMIC callback,
+    // which runs inside the FSM.
+    if (this->m_fConfigPending || this->m_fDiagRequested)
+        {
+        if (this->applyDownlink())
+            fEvent = true;
+        }
+
+    // save the session after an uplink.
+    this->saveSession();
+
+    // journal the touch counters; this programs flash, so it's kept out
+    // of the sampling path and the LMIC callback.
+    if (gTouchCounters.isFlushDue())
+        {
+        auto const site = gStallMonitor.enter(cStallMonitor::Site::kCounters);
+
+        gTouchCounters.flush(/* fForce */ false);
+        gStallMonitor.leave(site);
+        }
+
     // if we're not active, and no request, nothing to do.
     if (! this->m_active)
         {
@@ -319,57 +879,49 @@ void cMeasurementLoop::poll()
         fEvent = true;
         }
 
-    if (this->m_fProximity)
+    // the sensor bus is powered on first use after deep sleep, once the
+    // boost regulator (if it's in use) has settled.
+    bool const fSensor = this->m_fProximity &&
+                         gPowerManager.ensureSensor();
+
+    // notice a failed background read; keep the array's reads going.
+#if CATENA4610_ARRAY_SENSORS != 0
+    if (fSensor)
+        this->m_SensorArray.poll();
+#else
+    if (kEnableBurstRead && fSensor)
+        this->m_SensorReader.poll();
+#endif
+
+    if (fSensor && this->sampleSensor())
         {
-        gIqs620a.iqsRead();
-        delay (50);
-        this->m_data.touchData.Ch1Data = gIqs620a.getCh1Data();
-        this->m_data.touchData.Ch2Data = gIqs620a.getCh2Data();
-
-        if (this->m_data.touchData.Ch1Data < 400 &&
-            this->m_data.touchData.Ch2Data < 270 &&
-            this->m_fTouchCount == false
-            )
-            {
-            this->m_data.touchData.touchCountLeft = this->m_data.touchData.touchCountLeft + 1;
-            this->m_data.touchData.touchCountRight = this->m_data.touchData.touchCountRight + 1;
-            this->m_fTouchCount = true;
-            }
-        else if (
-            this->m_data.touchData.Ch1Data < 400 &&
-            this->m_fTouchCount == false
-            )
-            {
-            this->m_data.touchData.touchCountRight = this->m_data.touchData.touchCountRight + 1;
-            this->m_fTouchCount = true;
-            }
-        else if (
-            this->m_data.touchData.Ch2Data < 270 &&
-            this->m_fTouchCount == false
-            )
-            {
-            this->m_data.touchData.touchCountLeft = this->m_data.touchData.touchCountLeft + 1;
-            this->m_fTouchCount = true;
-            }
-        else
-            {
-            this->m_fTouchCount = false;
-            }
+        std::uint32_t const tNow = millis();
 
-        this->m_data.flags |= Flags::TouchCount;
+        if (this->m_fLastSampleValid &&
+            tNow - this->m_tLastSample > kSampleOverrunPeriods * this->m_Config.samplePeriodMs &&
+            this->m_Diagnostics.nSampleOverruns < 0xFF)
+            ++this->m_Diagnostics.nSampleOverruns;
 
-        this->m_data.amplitude.Amplitude = gIqs620a.getAmplitude();
-        this->m_data.flags |= Flags::TouchProx;
+        this->m_tLastSample = tNow;
+        this->m_fLastSampleValid = true;
+        gPowerManager.noteSample();
+
+        if (this->processSample())
+            fEvent = true;
         }
 
-    if (this->m_fTimerActive)
+    // keep the FSM moving while one of its tasks is waiting.
+    if (this->m_measureTask.isRunning() ||
+        this->m_sleepAlertTask.isRunning() ||
+        this->m_wakeTask.isRunning())
         {
-        if ((millis() - this->m_timer_start) >= this->m_timer_delay)
-            {
-            this->m_fTimerActive = false;
-            this->m_fTimerEvent = true;
-            fEvent = true;
-            }
+        fEvent = true;
+        }
+
+    // expire any timeouts that are due.
+    if (this->m_Timers.advance(millis()) != 0)
+        {
+        fEvent = true;
         }
 
     // check the transmit time.
@@ -378,11 +930,118 @@ void cMeasurementLoop::poll()
         fEvent = true;
         }
 
+    // feed the next waveform fragment to the queue.
+    this->queueWaveformFragment();
+
+    // check for queued frames that are due.
+    if (this->m_UplinkQueue.peekReady(millis()) != nullptr)
+        {
+        fEvent = true;
+        }
+
     if (fEvent)
+        {
+        auto const site = gStallMonitor.enter(cStallMonitor::Site::kFsm);
+
         this->m_fsm.eval();
+        gStallMonitor.leave(site);
+        }
 
-    this->m_data.Vbus = gCatena.ReadVbus();
+    this->m_data.Vbus = voltsToMv(gCatena.ReadVbus());
     setVbus(this->m_data.Vbus);
+    // bring USB serial back once there's a host to talk to.
+    if (this->m_fUsbPower)
+        gPowerManager.ensure(cPowerManager::Peripheral::kSerial);
+    if (gStreamPort.isRunning())
+        gStreamPort.pushVbus(millis(), this->m_data.Vbus);
+
+    std::uint32_t const msPoll = millis() - tStart;
+    if (msPoll > this->m_Diagnostics.msMaxPoll)
+        this->m_Diagnostics.msMaxPoll = msPoll > 0xFFFF ? 0xFFFF : std::uint16_t(msPoll);
+    }
+
+/*
+
+Name:   McciCatena4610::cMeasurementLoop::getNextDeadline()
+
+Function:
+        Report when the measurement loop next needs to be polled.
+
+Definition:
+        bool McciCatena4610::cMeasurementLoop::getNextDeadline(
+                std::uint32_t tNow,
+                std::uint32_t &msRemaining
+                ) override;
+
+Description:
+        The deadline is the earliest of: the next sensor sample, the
+        FSM timeouts, the uplink timer, the next queued frame, and any task
+        that is waiting. Pending requests make it due now. While the
+        sensor array has reads to do, and the DMA interrupt isn't ours,
+        it's due in a millisecond.
+
+Returns:
+        false if inactive with nothing requested; otherwise true, with
+        msRemaining set.
+
+*/
+
+bool cMeasurementLoop::getNextDeadline(
+    std::uint32_t tNow,
+    std::uint32_t &msRemaining
+    )
+    {
+    if (this->m_rqActive || this->m_rqInactive ||
+        this->m_fConfigPending || this->m_fDiagRequested ||
+        this->m_fSaveSession || gTouchCounters.isFlushDue())
+        {
+        msRemaining = 0;
+        return true;
+        }
+
+    if (! this->m_active)
+        return false;
+
+    std::uint32_t ms = this->m_UplinkTimer.getRemaining();
+
+    auto const sooner =
+        [&ms](std::uint32_t t)
+            {
+            if (t < ms)
+                ms = t;
+            };
+
+    if (this->m_UplinkTimer.peekTicks() != 0)
+        sooner(0);
+
+    if (this->m_fProximity)
+        sooner(this->m_sampleTask.isRunning() ? this->m_sampleTask.getRemaining(tNow) : 0);
+
+#if CATENA4610_ARRAY_SENSORS != 0
+    // without the DMA interrupt, only poll() moves a round along.
+    if (! cI2cDmaBus::kDmaInterrupt &&
+        this->m_fProximity && ! this->m_SensorArray.isRoundDone())
+        sooner(1);
+#endif
+
+    std::uint32_t msDue;
+    if (this->m_Timers.getNextDeadline(tNow, msDue))
+        sooner(msDue);
+
+    if (this->m_UplinkQueue.getNextDue(tNow, msDue))
+        sooner(msDue);
+
+    cTask const * const pTasks[] =
+        { &this->m_measureTask, &this->m_sleepAlertTask, &this->m_wakeTask };
+
+    for (auto pTask : pTasks)
+        {
+        if (pTask->isRunning())
+            sooner(pTask->getRemaining(tNow));
+        }
+
+    msRemaining = ms;
+    return true;
     }
 
 /****************************************************************************\
@@ -404,13 +1063,168 @@ void cMeasurementLoop::updateTxCycleTime()
     else if (txCycleCount == 1)
         {
         // it's now one (otherwise we couldn't be here.)
-        gCatena.SafePrintf("resetting tx cycle to default: %u\n", this->m_txCycleSec_Permanent);
+        if (this->isTraceEnabled(this->DebugFlags::kTrace))
+            gCatena.SafePrintf("resetting tx cycle to default: %u\n", this->m_txCycleSec_Permanent);
 
         this->setTxCycleTime(this->m_txCycleSec_Permanent, 0);
         }
     else
         {
-        // it's zero. Leave it alone.
+        // it's zero: stretch the default to meet the battery life target.
+        std::uint32_t const txCycleSec =
+            this->m_txCycleSec_Permanent * this->m_Battery.getStretch();
+
+        if (txCycleSec != this->m_txCycleSec)
+            {
+            if (this->isTraceEnabled(this->DebugFlags::kTrace))
+                gCatena.SafePrintf("battery: tx cycle now %u\n", unsigned(txCycleSec));
+            this->setTxCycleTime(txCycleSec, 0);
+            }
+        }
+    }
+
+/*
+
+Name:   McciCatena4610::cMeasurementLoop::applyConfig()
+
+Function:
+        Put a configuration into effect.
+
+Definition:
+        void McciCatena4610::cMeasurementLoop::applyConfig(
+                const Config &c
+                );
+
+Description:
+        Thresholds, sampling period and debug flags take effect at the
+        next sample. Before begin(), the uplink cycle starts with the
+        configured fast uplinks. Once running, a change to the fast cycle
+        starts a new run of fast uplinks; otherwise, a new uplink interval
+        takes effect now if the fast uplinks are over, or when they end.
+
+        The caller is expected to have checked c with isValidConfig().
+
+Returns:
+        No explicit result.
+
+*/
+
+void cMeasurementLoop::applyConfig(const Config &c)
+    {
+    Config const old = this->m_Config;
+
+    this->m_Config = c;
+    this->m_DebugFlags = DebugFlags(c.debugFlags);
+    this->m_txCycleSec_Permanent = c.txCycleSec;
+#if CATENA4610_ARRAY_SENSORS != 0
+    this->m_SensorArray.setThresholds(this->getThresholds());
+    this->m_SensorArray.setDetection(c.touchHysteresis, std::uint8_t(c.touchDebounce));
+#endif
+
+    if (! this->m_registered)
+        {
+        this->m_txCycleCount = c.fastTxCycleCount;
+        this->m_txCycleSec = c.fastTxCycleCount != 0 ? c.fastTxCycleSec : c.txCycleSec;
+        return;
+        }
+
+    if (c.fastTxCycleCount != 0 &&
+        (c.fastTxCycleCount != old.fastTxCycleCount || c.fastTxCycleSec != old.fastTxCycleSec))
+        {
+        this->setTxCycleTime(c.fastTxCycleSec, c.fastTxCycleCount);
+        }
+    else if (this->m_txCycleCount == 0)
+        {
+        this->setTxCycleTime(c.txCycleSec * this->m_Battery.getStretch(), 0);
+        }
+    }
+
+/****************************************************************************\
+|
+|   Energy accounting
+|
+\****************************************************************************/
+
+cEnergyMeter::Category cMeasurementLoop::getEnergyCategory(State s)
+    {
+    switch (s)
+        {
+    case State::stSleeping:     return cEnergyMeter::Category::kSleeping;
+    case State::stMeasure:      return cEnergyMeter::Category::kMeasure;
+    case State::stTransmit:     return cEnergyMeter::Category::kTransmit;
+    default:                    return cEnergyMeter::Category::kIdle;
+        }
+    }
+
+// charge the time since the last call to the current activity, at the
+// current for the clock level.
+void cMeasurementLoop::accountEnergy(std::uint32_t tNow)
+    {
+    cEnergyMeter::Category const c = this->m_energyCategory;
+
+    this->m_Energy.account(
+        c,
+        tNow - this->m_tEnergyMs,
+        cClockPolicy::scaleCurrent(this->m_Energy.getCurrent(c), this->m_ClockPolicy.getLevel())
+        );
+    this->m_tEnergyMs = tNow;
+    }
+
+// switch the clock to the policy's target, if it isn't there.
+void cMeasurementLoop::updateClock(std::uint32_t tNow)
+    {
+    if (! this->m_ClockPolicy.isSwitchPending())
+        return;
+
+    // the time so far was at the old clock.
+    this->accountEnergy(tNow);
+
+    if (this->m_ClockPolicy.poll(tNow) && this->isTraceEnabled(this->DebugFlags::kTrace))
+        {
+        cClockPolicy::Level const l = this->m_ClockPolicy.getLevel();
+
+        gCatena.SafePrintf("cMeasurementLoop::updateClock: %s, %u MHz\n",
+            cClockPolicy::getLevelName(l),
+            unsigned(cClockPolicy::getHz(l) / (1000 * 1000))
+            );
+        }
+    }
+
+/*
+
+Name:   McciCatena4610::cMeasurementLoop::updateBatteryModel()
+
+Function:
+        Bring the battery model up to date with the energy meter.
+
+Definition:
+        void McciCatena4610::cMeasurementLoop::updateBatteryModel(
+                std::uint32_t tNow
+                );
+
+Description:
+        The charge the energy meter has accounted since the last call is
+        passed to the battery model, which then advances to the total
+        time accounted.
+
+Returns:
+        No explicit result.
+
+*/
+
+void cMeasurementLoop::updateBatteryModel(std::uint32_t tNow)
+    {
+    this->accountEnergy(tNow);
+
+    std::uint64_t const uAs = this->m_Energy.getTotalUas();
+
+    this->m_Battery.consume(uAs - this->m_batteryUas);
+    this->m_batteryUas = uAs;
+
+    if (this->m_Battery.update(std::uint32_t(this->m_Energy.getElapsedMs() / 1000)) &&
+        this->isTraceEnabled(this->DebugFlags::kInfo))
+        {
+        gCatena.SafePrintf("battery: interval stretch %u\n", this->m_Battery.getStretch());
         }
     }
 
@@ -424,8 +1238,9 @@ void cMeasurementLoop::sleep()
     {
     const bool fDeepSleep = checkDeepSleep();
 
-    if (! this->m_fPrintedSleeping)
-        this->doSleepAlert(fDeepSleep);
+    // the alert counts down across several calls.
+    if (! this->m_fPrintedSleeping && ! this->doSleepAlert(fDeepSleep))
+        return;
 
     if (fDeepSleep)
         this->doDeepSleep();
@@ -439,7 +1254,7 @@ bool cMeasurementLoop::checkDeepSleep()
     bool const fDeepSleepTest = gCatena.GetOperatingFlags() &
             static_cast<uint32_t>(gCatena.OPERATING_FLAGS::fDeepSleepTest);
     bool fDeepSleep;
-    std::uint32_t const sleepInterval = this->m_UplinkTimer.getRemaining() / 1000;
+    std::uint32_t const sleepInterval = this->getSleepRemaining() / 1000;
 
     if (! this->kEnableDeepSleep)
         {
@@ -476,68 +1291,74 @@ bool cMeasurementLoop::checkDeepSleep()
     return fDeepSleep;
     }
 
-void cMeasurementLoop::doSleepAlert(bool fDeepSleep)
+// a task: returns true once the alert is complete. The kind of sleep is
+// latched on the first call.
+bool cMeasurementLoop::doSleepAlert(bool fDeepSleep)
     {
-    this->m_fPrintedSleeping = true;
+    TASK_BEGIN(this->m_sleepAlertTask);
 
-    if (fDeepSleep)
+    this->m_fSleepAlertDeep = fDeepSleep;
+    if (this->m_fSleepAlertDeep)
         {
-        bool const fDeepSleepTest =
-                gCatena.GetOperatingFlags() &
-                static_cast<uint32_t>(gCatena.OPERATING_FLAGS::fDeepSleepTest);
-        const uint32_t deepSleepDelay = fDeepSleepTest ? 10 : 30;
+        this->m_sleepAlertCount =
+                (gCatena.GetOperatingFlags() &
+                 static_cast<uint32_t>(gCatena.OPERATING_FLAGS::fDeepSleepTest))
+                        ? 10 : 30;
 
         gCatena.SafePrintf("using deep sleep in %u secs"
 #ifdef USBCON
                             " (USB will disconnect while asleep)"
 #endif
                             ": ",
-                            deepSleepDelay
+                            this->m_sleepAlertCount
                             );
 
         // sleep and print
         gLed.Set(McciCatena::LedPattern::TwoShort);
 
-        for (auto n = deepSleepDelay; n > 0; --n)
+        for (; this->m_sleepAlertCount > 0; --this->m_sleepAlertCount)
             {
-            uint32_t tNow = millis();
-
-            while (uint32_t(millis() - tNow) < 1000)
-                {
-                gCatena.poll();
-                yield();
-                }
+            TASK_DELAY(this->m_sleepAlertTask, millis(), 1000);
             gCatena.SafePrintf(".");
             }
         gCatena.SafePrintf("\nStarting deep sleep.\n");
-        uint32_t tNow = millis();
-        while (uint32_t(millis() - tNow) < 100)
-            {
-            gCatena.poll();
-            yield();
-            }
+        TASK_DELAY(this->m_sleepAlertTask, millis(), 100);
         }
-    else
+    else if (this->isTraceEnabled(this->DebugFlags::kTrace))
         gCatena.SafePrintf("using light sleep\n");
+
+    this->m_fPrintedSleeping = true;
+    TASK_END(this->m_sleepAlertTask);
     }
 
 void cMeasurementLoop::doDeepSleep()
     {
     // bool const fDeepSleepTest = gCatena.GetOperatingFlags() &
     //             static_cast<uint32_t>(gCatena.OPERATING_FLAGS::fDeepSleepTest);
-    std::uint32_t const sleepInterval = this->m_UplinkTimer.getRemaining() / 1000;
+    std::uint32_t const sleepInterval = this->getSleepRemaining() / 1000;
 
     if (sleepInterval == 0)
         return;
 
     /* ok... now it's time for a deep sleep */
     gLed.Set(McciCatena::LedPattern::Off);
+    this->m_fLastSampleValid = false;
+    gTouchCounters.flush(/* fForce */ true);
+    this->saveSession();
     this->deepSleepPrepare();
 
-    /* sleep */
+    /* sleep; the time asleep is accounted as such whether or not
+       millis() advances across it */
+    this->accountEnergy(millis());
     gCatena.Sleep(sleepInterval);
-
-    /* recover from sleep */
+    this->m_Energy.account(cEnergyMeter::Category::kDeepSleep, sleepInterval * 1000);
+    this->m_tEnergyMs = millis();
+    // waking up restores the boot clock.
+    this->m_ClockPolicy.setLevel(millis(), cClockPolicy::Level::kHigh, /* fSwitch */ false);
+    gPowerManager.resume();
+
+    /* recover from sleep; this continues from the FSM */
+    this->m_wakeTask.reset();
     this->deepSleepRecovery();
 
     /* and now... we're awake again. trigger another measurement */
@@ -546,15 +1367,8 @@ void cMeasurementLoop::doDeepSleep()
 
 void cMeasurementLoop::deepSleepPrepare(void)
     {
-    Serial.end();
-    Wire.end();
     SPI.end();
-    if (this->m_pSPI2 && this->m_fSpi2Active)
-        {
-        this->m_pSPI2->end();
-        this->m_fSpi2Active = false;
-        }
-    boostPowerOff();
+    gPowerManager.suspend();
     }
 
 //
@@ -577,21 +1391,20 @@ void fixLmicTimeCalculationAfterWakeup(void)
 #endif
     }
 
-void cMeasurementLoop::deepSleepRecovery(void)
+// a task: returns true once the radio, and the boost regulator if it's
+// in use, are back. The rest comes back when it's next used.
+bool cMeasurementLoop::deepSleepRecovery(void)
     {
-    delay(10);
+    TASK_BEGIN(this->m_wakeTask);
 
-    if (!m_fUsbPower && (this->m_data.Vbat < 3.10f))
-        {
-        boostPowerOn();
-        delay(20);
-        }
+    // everything else runs from the boost regulator when it's on.
+    TASK_WAIT_UNTIL(this->m_wakeTask, gPowerManager.ensure(cPowerManager::Peripheral::kBoost));
 
-    Serial.begin();
-    Wire.begin();
     SPI.begin();
 
     fixLmicTimeCalculationAfterWakeup();
+
+    TASK_END(this->m_wakeTask);
     }
 
 /****************************************************************************\
@@ -600,24 +1413,18 @@ void cMeasurementLoop::deepSleepRecovery(void)
 |
 \****************************************************************************/
 
-// set the timer
-void cMeasurementLoop::setTimer(std::uint32_t ms)
+// arm a named timeout
+void cMeasurementLoop::setTimer(Timeout id, std::uint32_t ms)
     {
-    this->m_timer_start = millis();
-    this->m_timer_delay = ms;
-    this->m_fTimerActive = true;
-    this->m_fTimerEvent = false;
+    this->m_Timers.arm(id, millis(), ms);
     }
 
-void cMeasurementLoop::clearTimer()
+void cMeasurementLoop::clearTimer(Timeout id)
     {
-    this->m_fTimerActive = false;
-    this->m_fTimerEvent = false;
+    this->m_Timers.cancel(id);
     }
 
-bool cMeasurementLoop::timedOut()
+bool cMeasurementLoop::timedOut(Timeout id)
     {
-    bool result = this->m_fTimerEvent;
-    this->m_fTimerEvent = false;
-    return result;
+    return this->m_Timers.timedOut(id);
     }
@@ -33,6 +33,37 @@ Author:
 
 #include <cstdint>
 
+#include "Catena4610_MeasurementDefaults.h"
+#include "Catena4610_cBatteryModel.h"
+#include "Catena4610_cClockPolicy.h"
+#include "Catena4610_cDownlinkParser.h"
+#include "Catena4610_cEnergyMeter.h"
+#include "Catena4610_cIdleScheduler.h"
+#include "Catena4610_cIqs620aReader.h"
+#include "Catena4610_cSensorArray.h"
+#include "Catena4610_cTask.h"
+#include "Catena4610_cTimerWheel.h"
+#include "Catena4610_cTouchChannels.h"
+#include "Catena4610_cTouchDetector.h"
+#include "Catena4610_cUplinkQueue.h"
+#include "Catena4610_cWaveformCapture.h"
+
+// the least severe trace level compiled in: 0 for errors only, 1 adds
+// warnings, 2 trace and 3 info. Traces below it compile to nothing,
+// format strings and all; production builds can set it on the command
+// line, e.g. -DCATENA4610_TRACE_LEVEL=0.
+#ifndef CATENA4610_TRACE_LEVEL
+# define CATENA4610_TRACE_LEVEL 3
+#endif
+
+// IQS620As in the sensor array (see cSensorArray), 1 to 8; or 0 for the
+// single sensor of a standard Catena 4610, in which case neither the
+// array nor its uplink field is compiled in. Set it on the command line,
+// e.g. -DCATENA4610_ARRAY_SENSORS=4.
+#ifndef CATENA4610_ARRAY_SENSORS
+# define CATENA4610_ARRAY_SENSORS 0
+#endif
+
 extern McciCatena::Catena gCatena;
 extern McciCatena::Catena::LoRaWAN gLoRaWAN;
 extern McciCatena::StatusLed gLed;
@@ -67,8 +98,15 @@ class cMeasurementBase
 class cMeasurementFormat : public cMeasurementBase
     {
 public:
-    // buffer size for uplink data
-    static constexpr size_t kTxBufferSize = 18;
+    // IQS620A channels sampled and sent: 2, or 3 to add channel 0.
+    static constexpr std::size_t kTouchChannels = 2;
+    using TouchChannels = cTouchChannels<kTouchChannels>;
+
+    // IQS620As in the sensor array; see CATENA4610_ARRAY_SENSORS.
+    static constexpr std::size_t kArraySensors = CATENA4610_ARRAY_SENSORS;
+
+    // buffer size for uplink data: the largest message, with every field.
+    static constexpr size_t kTxBufferSize = 22 + 2 * kTouchChannels + (kArraySensors != 0 ? 2 : 0);
 
     // message format
     static constexpr uint8_t kMessageFormat = 0x30;
@@ -80,6 +118,8 @@ public:
             Boot = 1 << 2,          // boot count
             TouchProx = 1 << 3,     // touch channel data
             TouchCount = 1 << 4,    // touch counter
+            Diag = 1 << 5,          // diagnostics
+            Sensors = 1 << 6,       // sensor array bitmaps
             };
 
     // the structure of a measurement
@@ -92,10 +132,11 @@ public:
         // Touch Channel Data
         struct TouchData
             {
-            int16_t                     Ch1Data;
-            int16_t                     Ch2Data;
-            int16_t                     touchCountLeft;
-            int16_t                     touchCountRight;
+            // see cTouchChannels for the channel order.
+            TouchChannels::Readings     ChData;
+            // touches not yet covered by a completed uplink
+            std::uint16_t               touchCountLeft;
+            std::uint16_t               touchCountRight;
             };
 
         // Hall Effect Amplitude
@@ -104,36 +145,113 @@ public:
             int16_t                     Amplitude;
             };
 
+#if CATENA4610_ARRAY_SENSORS != 0
+        // Sensor Array, bit i for sensor i
+        struct SensorArray
+            {
+            std::uint8_t                present;    // last read succeeded
+            std::uint8_t                active;     // touched since the last periodic uplink
+            };
+#endif
+
         //---------------------------
         // the actual members as POD
         //---------------------------
 
-        // flags of entries that are valid.
-        Flags                   	flags;
-        // measured battery voltage, in volts
-        float                       Vbat;
-        // measured system Vdd voltage, in volts
-        float                       Vsystem;
-        // measured USB bus voltage, in volts.
-        float                       Vbus;
+        // members are ordered by decreasing alignment, so the only
+        // padding is at the end. Don't use __attribute__((packed)):
+        // unaligned accesses fault on the Cortex-M0+.
+
         // boot count
         uint32_t                    BootCount;
+        // measured battery voltage, in millivolts
+        std::uint16_t               Vbat;
+        // measured USB bus voltage, in millivolts.
+        std::uint16_t               Vbus;
         // touch channel data
         TouchData                   touchData;
         // hall effect amplitude
         HallEffect                  amplitude;
+#if CATENA4610_ARRAY_SENSORS != 0
+        // sensor array bitmaps
+        SensorArray                 sensors;
+#endif
+        // flags of entries that are valid.
+        Flags                       flags;
         };
     };
 
-class cMeasurementLoop : public McciCatena::cPollableObject
+static_assert(
+    sizeof(cMeasurementFormat::Measurement) ==
+        (4 + 2 + 2 + 2 * cMeasurementFormat::kTouchChannels + 2 + 2 + 2 +
+         (cMeasurementFormat::kArraySensors != 0 ? 2 : 0) + 1 + 3) / 4 * 4,
+    "Measurement layout changed: check member order and padding"
+    );
+
+class cMeasurementLoop : public McciCatena::cPollableObject,
+                         public cDeadlineSource
     {
 public:
     // some parameters
     using MeasurementFormat = McciCatena4610::cMeasurementFormat;
     using Measurement = MeasurementFormat::Measurement;
     using Flags = MeasurementFormat::Flags;
+    using TouchChannels = MeasurementFormat::TouchChannels;
     static constexpr bool kEnableDeepSleep = false;
+    // read the sensor with one background burst (cIqs620aReader), rather
+    // than with the driver's blocking reads. Off until the result register
+    // map (0x20..0x2F) has been checked on a board.
+    static constexpr bool kEnableBurstRead = false;
+    // run the CPU at cClockPolicy::kLowHz while only sampling, and at
+    // kHighHz to measure and transmit (not on USB power). Off until it
+    // has been run on a board.
+    static constexpr bool kEnableClockScaling = false;
+    // the sensor array, if MeasurementFormat::kArraySensors isn't 0.
+    // Sensor i is the IQS620A on channel i of a TCA9548A mux; sensor 0
+    // is the one the touch counters and the waveform follow.
+    static constexpr std::size_t kArraySensors = MeasurementFormat::kArraySensors;
+    static constexpr std::uint8_t kMuxAddress = 0x70;
+    // sensors read per sampling period (0: all), and how they're chosen.
+    static constexpr std::size_t kArrayReadsPerRound = 0;
+    static constexpr bool kArrayUsePriority = false;
+    // with kArrayUsePriority, sensor 0's share of the reads against 1
+    // for each of the others.
+    static constexpr std::uint8_t kArrayPrimaryPriority = 4;
+    // above this bus voltage (mV), we're running from USB.
+    static constexpr std::uint16_t kVbusPresentMv = MeasurementDefaults::kVbusPresentMv;
+    // fast warmup ends after this many consecutive sensor readings that
+    // are each within kWarmupStableDelta counts of the previous one.
+    static constexpr std::uint8_t kWarmupStableSamples = 4;
+    static constexpr std::int16_t kWarmupStableDelta = 8;
+    // time from starting a sensor read to fetching its results; the
+    // shortest sampling period.
+    static constexpr std::uint32_t kSensorSettleMs = MeasurementDefaults::kSensorSettleMs;
     static constexpr std::uint8_t kMessageFormat = MeasurementFormat::kMessageFormat;
+    static constexpr std::uint8_t kUplinkPort = 1;
+    // waveform fragments go on their own port, at least this far apart.
+    static constexpr std::uint8_t kWaveformPort = 3;
+    static constexpr std::uint32_t kWaveformFragmentSpacingMs = 60 * 1000;
+    static constexpr std::size_t kWaveformFragmentBytes = 26;
+    static constexpr std::size_t kUplinkQueueSlots = 4;
+    // a diagnostics field is added to every kDiagnosticsInterval'th
+    // periodic uplink.
+    static constexpr std::uint8_t kDiagnosticsInterval = 10;
+    // a sensor sample completing this many sampling periods after the
+    // previous one means the loop was held up and samples were missed.
+    static constexpr std::uint32_t kSampleOverrunPeriods = 4;
+
+    // configuration defaults and limits (see Catena4610_MeasurementDefaults.h).
+    static constexpr std::uint32_t kDefaultTxCycleSec = MeasurementDefaults::kTxCycleSec;
+    static constexpr std::uint32_t kDefaultFastTxCycleSec = MeasurementDefaults::kFastTxCycleSec;
+    static constexpr std::uint32_t kDefaultFastTxCycleCount = MeasurementDefaults::kFastTxCycleCount;
+    static constexpr std::uint16_t kDefaultThresholdRight = MeasurementDefaults::kThresholdRight;
+    static constexpr std::uint16_t kDefaultThresholdLeft = MeasurementDefaults::kThresholdLeft;
+    static constexpr std::uint32_t kDefaultSamplePeriodMs = MeasurementDefaults::kSamplePeriodMs;
+    static constexpr std::uint16_t kDefaultTouchHysteresis = MeasurementDefaults::kTouchHysteresis;
+    static constexpr std::uint16_t kDefaultTouchDebounce = MeasurementDefaults::kTouchDebounce;
+    static constexpr std::uint32_t kMinTxCycleSec = MeasurementDefaults::kMinTxCycleSec;
+    static constexpr std::uint32_t kMaxSamplePeriodMs = MeasurementDefaults::kMaxSamplePeriodMs;
+    static constexpr std::uint16_t kMaxTouchDebounce = MeasurementDefaults::kMaxTouchDebounce;
 
     enum OPERATING_FLAGS : uint32_t
         {
@@ -143,6 +261,7 @@ public:
         fDisableDeepSleep = 1 << 17,
         fQuickLightSleep = 1 << 18,
         fDeepSleepTest = 1 << 19,
+        fTouchEventUplink = 1 << 20,
         };
 
     enum DebugFlags : std::uint32_t
@@ -153,13 +272,66 @@ public:
         kInfo       = 1 << 3,
         };
 
+    static_assert(CATENA4610_TRACE_LEVEL >= 0 && CATENA4610_TRACE_LEVEL <= 3,
+        "CATENA4610_TRACE_LEVEL must be 0 (errors) to 3 (info)");
+
+    // the DebugFlags compiled in: kError up to CATENA4610_TRACE_LEVEL.
+    static constexpr std::uint32_t kCompiledDebugFlags =
+        (std::uint32_t(1) << (CATENA4610_TRACE_LEVEL + 1)) - 1;
+
+    // the tunables, which can be changed at runtime and are saved in
+    // flash (see cConfiguration). Add new fields at the end; change
+    // kVersion if the meaning of a field changes.
+    struct Config
+        {
+        static constexpr std::uint16_t kVersion = 1;
+
+        std::uint32_t   txCycleSec;         // uplink interval
+        std::uint32_t   fastTxCycleSec;     // uplink interval after boot...
+        std::uint32_t   fastTxCycleCount;   // ... for this many uplinks
+        std::uint32_t   debugFlags;         // DebugFlags
+        std::uint16_t   thresholdRight;     // Ch1 below this is a right touch
+        std::uint16_t   thresholdLeft;      // Ch2 below this is a left touch
+        std::uint16_t   samplePeriodMs;     // sensor sampling period
+        std::uint16_t   reserved;
+        std::uint16_t   touchHysteresis;    // a touch is held until above threshold + this
+        std::uint16_t   touchDebounce;      // samples in a row to touch or release
+        };
+
+    static Config getDefaultConfig()
+        {
+        Config c {};
+
+        c.txCycleSec = kDefaultTxCycleSec;
+        c.fastTxCycleSec = kDefaultFastTxCycleSec;
+        c.fastTxCycleCount = kDefaultFastTxCycleCount;
+        c.debugFlags = kError | kTrace;
+        c.thresholdRight = kDefaultThresholdRight;
+        c.thresholdLeft = kDefaultThresholdLeft;
+        c.samplePeriodMs = kDefaultSamplePeriodMs;
+        c.touchHysteresis = kDefaultTouchHysteresis;
+        c.touchDebounce = kDefaultTouchDebounce;
+        return c;
+        }
+
+    static bool isValidConfig(const Config &c)
+        {
+        return c.txCycleSec >= kMinTxCycleSec &&
+               c.fastTxCycleSec >= kMinTxCycleSec &&
+               c.samplePeriodMs >= kSensorSettleMs &&
+               c.samplePeriodMs <= kMaxSamplePeriodMs &&
+               c.touchDebounce >= 1 &&
+               c.touchDebounce <= kMaxTouchDebounce;
+        }
+
     // constructor
     cMeasurementLoop(
             )
-        : m_txCycleSec_Permanent(6 * 60)        // default uplink interval
-        , m_txCycleSec(30)                      // initial uplink interval
-        , m_txCycleCount(10)                    // initial count of fast uplinks
-        , m_DebugFlags(DebugFlags(kError | kTrace))
+        : m_DebugFlags(DebugFlags(kError | kTrace))
+        , m_txCycleSec_Permanent(kDefaultTxCycleSec)    // default uplink interval
+        , m_txCycleSec(kDefaultFastTxCycleSec)          // initial uplink interval
+        , m_txCycleCount(kDefaultFastTxCycleCount)      // initial count of fast uplinks
+        , m_Config(getDefaultConfig())
         {};
 
     // neither copyable nor movable
@@ -180,6 +352,11 @@ public:
         stFinal,        // this name must be present, it's the terminal state.
         };
 
+    State getState()
+        {
+        return this->m_fsm.getState();
+        }
+
     static constexpr const char *getStateName(State s)
         {
         switch (s)
@@ -199,6 +376,29 @@ public:
     // concrete type for uplink data buffer
     using TxBuffer_t = McciCatena::AbstractTxBuffer_t<MeasurementFormat::kTxBufferSize>;
 
+    // concrete type for the uplink queue
+    using UplinkQueue_t = cUplinkQueue<kUplinkQueueSlots, MeasurementFormat::kTxBufferSize>;
+    using UplinkPriority = UplinkQueue_t::Priority;
+
+#if CATENA4610_ARRAY_SENSORS != 0
+    // concrete type for the sensor array
+    using SensorArray_t = cSensorArray<kArraySensors, TouchChannels::kChannels>;
+#endif
+
+    // concrete type for the waveform capture; fragments are the size of
+    // a 2-channel uplink in every build.
+    using WaveformCapture_t = cWaveformCapture<kWaveformFragmentBytes>;
+
+    // named timeouts the FSM can wait on; add new ones before kCount.
+    enum class Timeout : std::uint8_t
+        {
+        kWarmup,        // end of sensor warmup
+        kCount
+        };
+
+    // concrete type for the timeouts
+    using Timers_t = cTimerWheel<Timeout>;
+
     // initialize measurement FSM.
     void begin();
     void end();
@@ -220,47 +420,163 @@ public:
         return this->m_txCycleSec;
         }
 
+    // use a (valid) configuration from now on. Can be called before
+    // begin(), to set the initial uplink cycle.
+    void applyConfig(const Config &c);
+
+    const Config &getConfig() const
+        {
+        return this->m_Config;
+        }
+
+    // LoRaWAN receive callback; pContext is the cMeasurementLoop.
+    static void receiveMessageCb(
+        void *pContext,
+        std::uint8_t port,
+        const std::uint8_t *pMessage,
+        std::size_t nMessage
+        );
+
     virtual void poll() override;
+    virtual bool getNextDeadline(std::uint32_t tNow, std::uint32_t &msRemaining) override;
 
-    void setVbus(float Vbus)
+    void setVbus(std::uint16_t VbusMv)
         {
         // set threshold value as 4.0V as there is reverse voltage
         // in vbus(~3.5V) while powered from battery in 4801.
-        this->m_fUsbPower = (Vbus > 4.0f) ? true : false;
+        this->m_fUsbPower = (VbusMv > kVbusPresentMv) ? true : false;
+        this->m_ClockPolicy.setHold(this->m_fUsbPower);
+        }
+
+    // convert a platform voltage reading to millivolts. The platform
+    // returns volts as float; this is the only place the voltage path
+    // uses floating point.
+    static std::uint16_t voltsToMv(float volts)
+        {
+        std::int32_t const mV = std::int32_t(volts * 1000.0f + 0.5f);
+
+        return mV <= 0 ? 0 : mV >= 0xFFFF ? 0xFFFF : std::uint16_t(mV);
         }
 
     // request that the measurement loop be active/inactive
     void requestActive(bool fEnable);
 
-    // return true if a given debug mask is enabled.
+    // return true if a given debug mask is compiled in. It's a constant
+    // for a constant mask, so a trace that isn't is dropped entirely.
+    static constexpr bool isTraceCompiled(DebugFlags mask)
+        {
+        return (mask & kCompiledDebugFlags) != 0;
+        }
+
+    // return true if a given debug mask is compiled in and enabled.
     bool isTraceEnabled(DebugFlags mask) const
         {
-        return this->m_DebugFlags & mask;
+        return isTraceCompiled(mask) && (this->m_DebugFlags & mask) != 0;
+        }
+
+    // end warmup as soon as the sensor is stable, rather than waiting
+    // the full warmup time. Can be called before begin().
+    void setFastWarmup(bool fFastWarmup)
+        {
+        this->m_fFastWarmup = fFastWarmup;
+        }
+
+    // get the uplink queue (for instrumentation)
+    const UplinkQueue_t &getUplinkQueue() const
+        {
+        return this->m_UplinkQueue;
+        }
+
+    // get the sensor burst reader (for the "sensor" command)
+    const cIqs620aReader &getSensorReader() const
+        {
+        return this->m_SensorReader;
+        }
+
+#if CATENA4610_ARRAY_SENSORS != 0
+    // get the sensor array (for the "sensor" command)
+    const SensorArray_t &getSensorArray() const
+        {
+        return this->m_SensorArray;
         }
+#endif
 
-    // register an additional SPI for sleep/resume
-    // can be called before begin().
-    void registerSecondSpi(SPIClass *pSpi)
+    void resetSensorStats()
         {
-        this->m_pSPI2 = pSpi;
+        this->m_SensorReader.resetStats();
+#if CATENA4610_ARRAY_SENSORS != 0
+        this->m_SensorArray.resetStats();
+#endif
         }
+
+    // get the waveform capture (for the "waveform" command)
+    WaveformCapture_t &getWaveformCapture()
+        {
+        return this->m_Waveform;
+        }
+
+    // operational counters, sent in the diagnostics field.
+    struct Diagnostics
+        {
+        std::uint16_t   nTxFail;            // uplinks failed, since boot
+        std::uint16_t   msTxLatency;        // measurement to TX complete, last periodic uplink
+        std::uint16_t   msMaxPoll;          // longest poll(), since last sent
+        std::uint8_t    nSampleOverruns;    // late sensor samples, since boot
+        };
+
+    const Diagnostics &getDiagnostics() const
+        {
+        return this->m_Diagnostics;
+        }
+
+    // energy accounting
+    cEnergyMeter &getEnergyMeter()
+        {
+        return this->m_Energy;
+        }
+
+    // clock scaling (for the "clock" command)
+    cClockPolicy &getClockPolicy()
+        {
+        return this->m_ClockPolicy;
+        }
+
+    const cBatteryModel &getBatteryModel() const
+        {
+        return this->m_Battery;
+        }
+
 private:
     // sleep handling
     void sleep();
     bool checkDeepSleep();
-    void doSleepAlert(bool fDeepSleep);
+    bool doSleepAlert(bool fDeepSleep);
     void doDeepSleep();
     void deepSleepPrepare();
-    void deepSleepRecovery();
+    bool deepSleepRecovery();
 
     // read data
-    void updateSynchronousMeasurements();
+    bool sampleSensor();
+    bool processSample();
+#if CATENA4610_ARRAY_SENSORS != 0
+    bool beginSensorArray();
+#endif
+    TouchChannels::Thresholds getThresholds() const;
+    bool updateSynchronousMeasurements();
     void resetMeasurements();
+    void updateWarmupStability();
+    bool isWarmupStable() const;
 
     // telemetry handling.
     void fillTxBuffer(TxBuffer_t &b, Measurement const & mData);
-    void startTransmission(TxBuffer_t &b);
+    static bool patchTouchCounts(std::uint8_t *pFrame, std::size_t nFrame, std::uint16_t left, std::uint16_t right);
+    void queueUplink(Measurement &mData, UplinkPriority priority);
+    void queueTouchEvent();
+    bool queueWaveformFragment();
+    bool startTransmission();
     void sendBufferDone(bool fSuccess);
+    void saveSession();
+    std::uint32_t getSleepRemaining() const;
 
     bool txComplete()
         {
@@ -269,12 +585,20 @@ private:
 
     void updateTxCycleTime();
 
-    // set the timer
-    void setTimer(std::uint32_t ms);
-    // clear the timer
-    void clearTimer();
-    // test (and clear) the timed-out flag.
-    bool timedOut();
+    // downlink handling.
+    void receiveMessage(std::uint8_t port, const std::uint8_t *pMessage, std::size_t nMessage);
+    bool applyDownlink();
+    void updateBatteryModel(std::uint32_t tNow);
+    void accountEnergy(std::uint32_t tNow);
+    void updateClock(std::uint32_t tNow);
+    static cEnergyMeter::Category getEnergyCategory(State s);
+
+    // arm a named timeout
+    void setTimer(Timeout id, std::uint32_t ms);
+    // cancel a named timeout
+    void clearTimer(Timeout id);
+    // test (and clear) the timed-out flag of a named timeout.
+    bool timedOut(Timeout id);
 
     // instance data
 private:
@@ -282,12 +606,75 @@ private:
     // evaluate the control FSM.
     State fsmDispatch(State currentState, bool fEntry);
 
-    // second SPI class
-    SPIClass                        *m_pSPI2;
-
     // debug flags
     DebugFlags                      m_DebugFlags;
 
+    // uplink time control
+    McciCatena::cTimer              m_UplinkTimer;
+    std::uint32_t                   m_txCycleSec_Permanent;
+    std::uint32_t                   m_txCycleSec;
+    std::uint32_t                   m_txCycleCount;
+
+    // the tunables in use.
+    Config                          m_Config;
+    // the tunables from a downlink, until poll() applies them.
+    Config                          m_pendingConfig;
+
+    // operational counters, and their bookkeeping.
+    Diagnostics                     m_Diagnostics;
+    std::uint32_t                   m_tMeasured;
+    std::uint32_t                   m_tLastSample;
+    std::uint8_t                    m_nUplinksSinceDiag;
+
+    // charge used, by activity; the activity now, and since when.
+    cEnergyMeter                    m_Energy;
+    cEnergyMeter::Category          m_energyCategory;
+    std::uint32_t                   m_tEnergyMs;
+
+    // the CPU clock level, and the one wanted.
+    cClockPolicy                    m_ClockPolicy;
+
+    // battery state, and the charge reported to it so far.
+    cBatteryModel                   m_Battery;
+    std::uint64_t                   m_batteryUas;
+
+    // named timeouts for the FSM.
+    Timers_t                        m_Timers;
+
+    // the current measurement
+    Measurement                     m_data;
+
+    // reads the sensor in the background, if kEnableBurstRead.
+    cIqs620aReader                  m_SensorReader;
+
+#if CATENA4610_ARRAY_SENSORS != 0
+    // reads the sensors in turn.
+    SensorArray_t                   m_SensorArray;
+#endif
+
+    // decides when a sample is a touch.
+    cTouchDetector                  m_TouchDetector;
+
+    // frames waiting for uplink
+    UplinkQueue_t                   m_UplinkQueue;
+
+    // recent samples, and the captured window being uploaded.
+    WaveformCapture_t               m_Waveform;
+    // waveform fragments the uplink queue had dropped, when last checked.
+    std::uint32_t                   m_nWaveformDropped;
+
+    // previous sensor reading and run of stable readings, for fast warmup.
+    TouchChannels::Readings         m_warmupCh;
+    std::uint8_t                    m_nStableSamples;
+
+    // tasks for sequences that wait; see Catena4610_cTask.h.
+    cTask                           m_sampleTask;
+    cTask                           m_measureTask;
+    cTask                           m_sleepAlertTask;
+    cTask                           m_wakeTask;
+    // seconds left in the deep-sleep countdown.
+    std::uint8_t                    m_sleepAlertCount;
+
     // true if object is registered for polling.
     bool                            m_registered : 1;
     // true if object is running.
@@ -302,10 +689,6 @@ private:
     // set true to request transition to inactive uplink mode; cleared by FSM
     bool                            m_rqInactive : 1;
 
-    // set true if event timer times out
-    bool                            m_fTimerEvent : 1;
-    // set true while evenet timer is active.
-    bool                            m_fTimerActive : 1;
     // set true if USB power is present.
     bool                            m_fUsbPower : 1;
 
@@ -317,29 +700,31 @@ private:
     bool                            m_txerr : 1;
     // set true when we've printed how we plan to sleep
     bool                            m_fPrintedSleeping : 1;
-    // set true when SPI2 is active
-    bool                            m_fSpi2Active: 1;
     // set true when touch sensor is active
     bool                            m_fProximity: 1;
-    // set true when there is touch
-    bool                            m_fTouchCount: 1;
-
-    // uplink time control
-    McciCatena::cTimer              m_UplinkTimer;
-    std::uint32_t                   m_txCycleSec;
-    std::uint32_t                   m_txCycleCount;
-    std::uint32_t                   m_txCycleSec_Permanent;
-
-    // simple timer for timing-out sensors.
-    std::uint32_t                   m_timer_start;
-    std::uint32_t                   m_timer_delay;
-
-    // the current measurement
-    Measurement                     m_data;
-
-    TxBuffer_t                      m_FileTxBuffer;
+    // set true to end warmup when the sensor is stable
+    bool                            m_fFastWarmup: 1;
+    // set true if the sleep alert is for deep sleep
+    bool                            m_fSleepAlertDeep: 1;
+    // set true if m_tLastSample is valid
+    bool                            m_fLastSampleValid: 1;
+    // set true while the frame in flight is a periodic measurement
+    bool                            m_fTxPeriodic: 1;
+    // set true when a downlink has left a configuration in m_pendingConfig
+    bool                            m_fConfigPending: 1;
+    // set true when a downlink has asked for a diagnostics frame
+    bool                            m_fDiagRequested: 1;
+    // set true when an uplink has completed and the session is to be saved
+    bool                            m_fSaveSession: 1;
     };
 
+// the uplink queue dominates our RAM use; keep its slots tight.
+static_assert(
+    sizeof(cMeasurementLoop::UplinkQueue_t::Entry) <=
+        (8 + cMeasurementLoop::MeasurementFormat::kTxBufferSize + 6 + 3) / 4 * 4,
+    "uplink queue entry grew: check member order and padding"
+    );
+
 //
 // operator overloads for ORing structured flags
 //
@@ -0,0 +1,156 @@
+/*
+
+Module: Catena4610_cMeasurementLoop_downlink.cpp
+
+Function:
+        Downlink handling for the measurement loop.
+
+Copyright:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#include "Catena4610_cMeasurementLoop.h"
+
+#include <TouchSense-Lorawan.h>
+
+using namespace McciCatena4610;
+using namespace McciCatena;
+
+/*
+
+Name:   McciCatena4610::cMeasurementLoop::receiveMessage()
+
+Function:
+        Accept a downlink from the LoRaWAN stack.
+
+Definition:
+        static void McciCatena4610::cMeasurementLoop::receiveMessageCb(
+                void *pContext,
+                std::uint8_t port,
+                const std::uint8_t *pMessage,
+                std::size_t nMessage
+                );
+
+        void McciCatena4610::cMeasurementLoop::receiveMessage(
+                std::uint8_t port,
+                const std::uint8_t *pMessage,
+                std::size_t nMessage
+                );
+
+Description:
+        Downlinks on cDownlinkParser::kPort are decoded into a copy of the
+        configuration, which is checked and then left for poll() to put
+        into effect; this is called by the LMIC from inside the FSM, so
+        nothing is changed here. A message that doesn't decode, or that
+        gives a configuration that isn't valid, is ignored as a whole.
+        Downlinks on other ports are ignored.
+
+        If several downlinks arrive before poll() runs, each applies on
+        top of the last.
+
+Returns:
+        No explicit result.
+
+*/
+
+void cMeasurementLoop::receiveMessageCb(
+    void *pContext,
+    std::uint8_t port,
+    const std::uint8_t *pMessage,
+    std::size_t nMessage
+    )
+    {
+    static_cast<cMeasurementLoop *>(pContext)->receiveMessage(port, pMessage, nMessage);
+    }
+
+void cMeasurementLoop::receiveMessage(
+    std::uint8_t port,
+    const std::uint8_t *pMessage,
+    std::size_t nMessage
+    )
+    {
+    if (port != cDownlinkParser::kPort)
+        return;
+
+    Config c = this->m_fConfigPending ? this->m_pendingConfig : this->m_Config;
+    auto const result = cDownlinkParser::parse(pMessage, nMessage, c);
+
+    if (result.status != cDownlinkParser::Status::kSuccess)
+        {
+        if (this->isTraceEnabled(this->DebugFlags::kError))
+            gCatena.SafePrintf("downlink: %s at byte %u\n",
+                cDownlinkParser::getStatusName(result.status),
+                unsigned(result.iError)
+                );
+        return;
+        }
+
+    if (result.fConfig && ! isValidConfig(c))
+        {
+        if (this->isTraceEnabled(this->DebugFlags::kError))
+            gCatena.SafePrintf("downlink: configuration not valid\n");
+        return;
+        }
+
+    if (result.fConfig)
+        {
+        this->m_pendingConfig = c;
+        this->m_fConfigPending = true;
+        }
+
+    if (result.fDiagnostics)
+        this->m_fDiagRequested = true;
+
+    if (this->isTraceEnabled(this->DebugFlags::kTrace))
+        gCatena.SafePrintf("downlink: %u commands accepted\n", unsigned(result.nCommands));
+    }
+
+/*
+
+Name:   McciCatena4610::cMeasurementLoop::applyDownlink()
+
+Function:
+        Put the effects of accepted downlinks into effect.
+
+Definition:
+        bool McciCatena4610::cMeasurementLoop::applyDownlink();
+
+Description:
+        Called from poll(), outside the FSM. A pending configuration is
+        applied in one step and saved, as if set by the "config" command.
+        A requested diagnostics frame is queued at touch-event priority,
+        with the touch counts. It is sent in addition to any touch event
+        frame already queued; being a diagnostics frame, it is never
+        coalesced with one.
+
+Returns:
+        true if the FSM should be evaluated.
+
+*/
+
+bool cMeasurementLoop::applyDownlink()
+    {
+    bool fEvent = false;
+
+    if (this->m_fConfigPending)
+        {
+        this->m_fConfigPending = false;
+        gConfiguration.update(this->m_pendingConfig);
+        }
+
+    if (this->m_fDiagRequested)
+        {
+        Measurement diag {};
+
+        this->m_fDiagRequested = false;
+        diag.flags = Flags::Diag | Flags::TouchCount;
+        this->queueUplink(diag, UplinkPriority::kTouchEvent);
+        fEvent = true;
+        }
+
+    return fEvent;
+    }
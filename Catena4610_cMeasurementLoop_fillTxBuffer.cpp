@@ -26,6 +26,39 @@ using namespace McciCatenaIqs620a;
 
 /*
 
+Name:   putMillivolts()
+
+Function:
+        Put a voltage in the buffer in the same int16 format as putV().
+
+Definition:
+        static void putMillivolts(
+                cMeasurementLoop::TxBuffer_t& b,
+                std::uint16_t mV
+                );
+
+Description:
+        The voltage is sent as volts * 4096, rounded to nearest, but is
+        computed from millivolts with integer arithmetic only, so no
+        floating-point support is needed on the Cortex-M0+.
+
+*/
+
+static void putMillivolts(
+    cMeasurementLoop::TxBuffer_t& b, std::uint16_t mV
+    )
+    {
+    std::int32_t v = (std::int32_t(mV) * 4096 + 500) / 1000;
+
+    if (v > 0x7FFF)
+        v = 0x7FFF;
+
+    b.put(std::uint8_t(v >> 8));
+    b.put(std::uint8_t(v));
+    }
+
+/*
+
 Name:   McciCatena4610::cMeasurementLoop::fillTxBuffer()
 
 Function:
@@ -47,6 +80,8 @@ cMeasurementLoop::fillTxBuffer(
     cMeasurementLoop::TxBuffer_t& b, Measurement const &mData
     )
     {
+    bool const fTrace = this->isTraceEnabled(this->DebugFlags::kTrace);
+
     gLed.Set(McciCatena::LedPattern::Measuring);
 
     // initialize the message buffer to an empty state
@@ -56,63 +91,153 @@ cMeasurementLoop::fillTxBuffer(
     b.put(kMessageFormat);
 
     // the flags in Measurement correspond to the over-the-air flags.
-    b.put(std::uint8_t(this->m_data.flags));
+    b.put(std::uint8_t(mData.flags));
 
     // send Vbat
-    if ((this->m_data.flags & Flags::Vbat) !=  Flags(0))
+    if ((mData.flags & Flags::Vbat) !=  Flags(0))
         {
-        float Vbat = mData.Vbat;
-        gCatena.SafePrintf("Vbat:    %d mV\n", (int) (Vbat * 1000.0f));
-        b.putV(Vbat);
+        std::uint16_t Vbat = mData.Vbat;
+        if (fTrace)
+            gCatena.SafePrintf("Vbat:    %u mV\n", Vbat);
+        putMillivolts(b, Vbat);
         }
 
     // send Vdd if we can measure it.
 
-    // Vbus is sent as 5000 * v
-    if ((this->m_data.flags & Flags::Vcc) !=  Flags(0))
+    // Vbus is sent as 4096 * v
+    if ((mData.flags & Flags::Vcc) !=  Flags(0))
         {
-        float Vbus = mData.Vbus;
-        gCatena.SafePrintf("Vbus:    %d mV\n", (int) (Vbus * 1000.0f));
-        b.putV(Vbus);
+        std::uint16_t Vbus = mData.Vbus;
+        if (fTrace)
+            gCatena.SafePrintf("Vbus:    %u mV\n", Vbus);
+        putMillivolts(b, Vbus);
         }
 
     // send boot count
-    if ((this->m_data.flags & Flags::Boot) !=  Flags(0))
+    if ((mData.flags & Flags::Boot) !=  Flags(0))
         {
         b.putBootCountLsb(mData.BootCount);
         }
 
-    if ((this->m_data.flags & Flags::TouchProx) !=  Flags(0))
+    if ((mData.flags & Flags::TouchProx) !=  Flags(0))
         {
-        int16_t channel1 = mData.touchData.Ch1Data;
-        int16_t channel2 = mData.touchData.Ch2Data;
+        auto const &ch = mData.touchData.ChData;
         int16_t amplitude = mData.amplitude.Amplitude;
         // // Touch Channel Data and Hall Effect Amplitude
-        gCatena.SafePrintf("IQS620A:     Ch1: %d  Ch2: %d  Amplitude: %d\n",
-                channel1,
-                channel2,
-                amplitude
-                );
-        b.put2uf(channel1);
-        b.put2uf(channel2);
+        if (fTrace)
+            gCatena.SafePrintf("IQS620A:    ");
+        TouchChannels::forEach([&](std::size_t i)
+            {
+            // channel index i is IQS620A channel 1, 2, 0.
+            if (fTrace)
+                gCatena.SafePrintf(" Ch%u: %d ", unsigned((i + 1) % 3), ch[i]);
+            b.put2uf(ch[i]);
+            });
+        if (fTrace)
+            gCatena.SafePrintf(" Amplitude: %d\n", amplitude);
         b.put2sf(amplitude);
         }
 
-    if ((this->m_data.flags & Flags::TouchCount) !=  Flags(0))
+    if ((mData.flags & Flags::TouchCount) !=  Flags(0))
         {
-        int16_t leftTouchCounter = mData.touchData.touchCountLeft;
-        // Touch Channel Data
-        gCatena.SafePrintf("TOUCH COUNT LEFT:  %d\n",
-                leftTouchCounter
-                );
-        b.put2uf(leftTouchCounter);
+        // placeholders; see patchTouchCounts().
+        b.put2u(mData.touchData.touchCountLeft);
+        b.put2u(mData.touchData.touchCountRight);
+        }
 
-        int16_t rightTouchCounter = mData.touchData.touchCountRight;
-        // Touch Channel Data
-        gCatena.SafePrintf("TOUCH COUNT RIGHT:  %d\n",
-                rightTouchCounter
-                );
-        b.put2uf(rightTouchCounter);
+    if ((mData.flags & Flags::Diag) !=  Flags(0))
+        {
+        auto const &diag = this->m_Diagnostics;
+        std::uint64_t const uAh = this->m_Energy.getTotalUas() / 3600;
+        std::uint16_t const mAh = uAh / 1000 > 0xFFFF ? 0xFFFF : std::uint16_t(uAh / 1000);
+
+        if (fTrace)
+            gCatena.SafePrintf("DIAG:    txfail %u  latency %u ms  maxpoll %u ms  overruns %u  used %u mAh\n",
+                    diag.nTxFail,
+                    diag.msTxLatency,
+                    diag.msMaxPoll,
+                    diag.nSampleOverruns,
+                    mAh
+                    );
+        b.put2u(diag.nTxFail);
+        b.put2u(diag.msTxLatency);
+        b.put2u(diag.msMaxPoll);
+        b.put(diag.nSampleOverruns);
+        b.put2u(mAh);
+        }
+
+#if CATENA4610_ARRAY_SENSORS != 0
+    if ((mData.flags & Flags::Sensors) !=  Flags(0))
+        {
+        if (fTrace)
+            gCatena.SafePrintf("SENSORS: present %02x  active %02x\n",
+                    mData.sensors.present,
+                    mData.sensors.active
+                    );
+        b.put(mData.sensors.present);
+        b.put(mData.sensors.active);
         }
+#endif
     gLed.Set(McciCatena::LedPattern::Off);
     }
+
+/*
+
+Name:   McciCatena4610::cMeasurementLoop::patchTouchCounts()
+
+Function:
+        Replace the touch counts in a prepared format 0x30 message.
+
+Definition:
+        static bool McciCatena4610::cMeasurementLoop::patchTouchCounts(
+                std::uint8_t *pFrame,
+                std::size_t nFrame,
+                std::uint16_t left,
+                std::uint16_t right
+                );
+
+Description:
+        The counts in a queued message may be stale by the time it is
+        sent; this overwrites them with current values. The offset of
+        the Touch Count field is found from the flags byte, following
+        the layout written by fillTxBuffer().
+
+Returns:
+        true if the message has a Touch Count field and it was patched.
+
+*/
+
+bool
+cMeasurementLoop::patchTouchCounts(
+    std::uint8_t *pFrame, std::size_t nFrame,
+    std::uint16_t left, std::uint16_t right
+    )
+    {
+    if (nFrame < 2 || pFrame[0] != kMessageFormat)
+        return false;
+
+    Flags const flags = Flags(pFrame[1]);
+    std::size_t offset = 2;
+
+    if ((flags & Flags::TouchCount) == Flags(0))
+        return false;
+
+    if ((flags & Flags::Vbat) != Flags(0))
+        offset += 2;
+    if ((flags & Flags::Vcc) != Flags(0))
+        offset += 2;
+    if ((flags & Flags::Boot) != Flags(0))
+        offset += 1;
+    if ((flags & Flags::TouchProx) != Flags(0))
+        offset += 2 * MeasurementFormat::kTouchChannels + 2;
+
+    if (offset + 4 > nFrame)
+        return false;
+
+    pFrame[offset + 0] = std::uint8_t(left >> 8);
+    pFrame[offset + 1] = std::uint8_t(left);
+    pFrame[offset + 2] = std::uint8_t(right >> 8);
+    pFrame[offset + 3] = std::uint8_t(right);
+
+    return true;
+    }
@@ -0,0 +1,90 @@
+/*
+
+Module: Catena4610_cPowerManager.cpp
+
+Function:
+        cPowerManager: switching the peripherals.
+
+Copyright:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#include "Catena4610_cPowerManager.h"
+
+#include <TouchSense-Lorawan.h>
+
+using namespace McciCatena4610;
+using namespace McciCatena;
+
+/*
+
+Name:   McciCatena4610::cPowerManager::setHardwarePower()
+
+Function:
+        Switch a peripheral on or off.
+
+Definition:
+        static void McciCatena4610::cPowerManager::setHardwarePower(
+                Peripheral p,
+                bool fOn
+                );
+
+Description:
+        This is the PowerFn the sketch passes to begin(). The flash is
+        taken out of (or put into) deep power-down along with SPI2, and
+        USB serial is flushed before it's ended.
+
+Returns:
+        No explicit result.
+
+*/
+
+void cPowerManager::setHardwarePower(Peripheral p, bool fOn)
+    {
+    switch (p)
+        {
+    case Peripheral::kI2c:
+        if (fOn)
+            Wire.begin();
+        else
+            Wire.end();
+        break;
+
+    case Peripheral::kFlash:
+        if (fOn)
+            {
+            gSPI2.begin();
+            gFlash.powerUp();
+            }
+        else
+            {
+            gFlash.powerDown();
+            gSPI2.end();
+            }
+        break;
+
+    case Peripheral::kBoost:
+        if (fOn)
+            boostPowerOn();
+        else
+            boostPowerOff();
+        break;
+
+    case Peripheral::kSerial:
+        if (fOn)
+            Serial.begin();
+        else
+            {
+            Serial.flush();
+            Serial.end();
+            }
+        break;
+
+    default:
+        break;
+        }
+    }
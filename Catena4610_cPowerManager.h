@@ -0,0 +1,313 @@
+/*
+
+Module: Catena4610_cPowerManager.h
+
+Function:
+        cPowerManager: power the peripherals only while they're in use.
+
+Copyright:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#ifndef _Catena4610_cPowerManager_h_
+# define _Catena4610_cPowerManager_h_
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace McciCatena4610 {
+
+/****************************************************************************\
+|
+|   The peripheral power manager.
+|
+|   Each user of a peripheral brackets its use with acquire() and
+|   release(). The peripheral is powered up when the first reference is
+|   taken, and powered down when the last is dropped.
+|
+|   Deep sleep calls suspend(), which powers everything down but keeps
+|   the references; after waking, resume() starts the clock on the wake.
+|   Nothing is powered up again until its user next asks, with ensure(),
+|   rather than all of it on every wake. A peripheral isn't ready until
+|   it has settled (the boost regulator takes kBoostSettleMs).
+|
+|   The time each peripheral spends powered, and the time from each wake
+|   to the first sensor sample, are kept for the "power" command.
+|
+|   The clock and the switch are functions passed to begin(), so a host
+|   test can drive all of it; only setHardwarePower() touches hardware.
+|
+\****************************************************************************/
+
+class cPowerManager
+    {
+public:
+    enum class Peripheral : std::uint8_t
+        {
+        kI2c,           // Wire: the touch sensors
+        kFlash,         // SPI2 and the flash on it
+        kBoost,         // the boost regulator
+        kSerial,        // USB serial
+        kCount
+        };
+
+    static constexpr std::size_t kPeripherals = std::size_t(Peripheral::kCount);
+
+    // the boost regulator's output takes this long to come up.
+    static constexpr std::uint32_t kBoostSettleMs = 50;
+
+    // milliseconds; switch a peripheral on or off.
+    using ClockFn = std::uint32_t (*)();
+    using PowerFn = void (*)(Peripheral p, bool fOn);
+
+    struct Stats
+        {
+        std::uint64_t   msOn;           // time powered
+        std::uint32_t   nPowerUps;
+        };
+
+    struct WakeStats
+        {
+        std::uint32_t   nWakes;
+        std::uint32_t   nSampled;       // wakes followed by a sample
+        std::uint32_t   msLast;         // wake to first sample
+        std::uint32_t   msMax;
+        std::uint64_t   msTotal;
+        };
+
+    cPowerManager()
+        : m_pClock(nullptr)
+        , m_pPower(nullptr)
+        , m_onMask(0)
+        , m_absentMask(0)
+        , m_fAwaitingSample(false)
+        , m_tWake(0)
+        , m_refs {}
+        , m_tUp {}
+        , m_tCharged {}
+        , m_stats {}
+        , m_wake {}
+        {}
+
+    // neither copyable nor movable
+    cPowerManager(const cPowerManager&) = delete;
+    cPowerManager& operator=(const cPowerManager&) = delete;
+    cPowerManager(const cPowerManager&&) = delete;
+    cPowerManager& operator=(const cPowerManager&&) = delete;
+
+    static const char *getPeripheralName(Peripheral p)
+        {
+        switch (p)
+            {
+        case Peripheral::kI2c:      return "i2c";
+        case Peripheral::kFlash:    return "flash";
+        case Peripheral::kBoost:    return "boost";
+        case Peripheral::kSerial:   return "serial";
+        default:                    return "<<unknown>>";
+            }
+        }
+
+    static constexpr std::uint8_t getMask(Peripheral p)
+        {
+        return std::uint8_t(1u << unsigned(p));
+        }
+
+    // time from power-up until p may be used.
+    static constexpr std::uint32_t getSettleMs(Peripheral p)
+        {
+        return p == Peripheral::kBoost ? kBoostSettleMs : 0;
+        }
+
+    // onMask: the peripherals already powered, with no references yet.
+    void begin(ClockFn pClock, PowerFn pPower, std::uint8_t onMask)
+        {
+        std::uint32_t const tNow = pClock();
+
+        this->m_pClock = pClock;
+        this->m_pPower = pPower;
+        this->m_onMask = onMask;
+        for (std::size_t i = 0; i < kPeripherals; ++i)
+            this->m_tUp[i] = this->m_tCharged[i] = tNow;
+        }
+
+    // a peripheral that isn't fitted is counted but never switched.
+    void setPresent(Peripheral p, bool fPresent)
+        {
+        if (fPresent)
+            this->m_absentMask &= ~getMask(p);
+        else
+            this->m_absentMask |= getMask(p);
+        }
+
+    void acquire(Peripheral p)
+        {
+        ++this->m_refs[unsigned(p)];
+        if (! this->isOn(p))
+            this->powerUp(p);
+        }
+
+    void release(Peripheral p)
+        {
+        auto &refs = this->m_refs[unsigned(p)];
+
+        if (refs == 0)
+            return;
+        if (--refs == 0 && this->isOn(p))
+            this->powerDown(p);
+        }
+
+    // power p up again if it's in use but suspend() powered it down.
+    // Returns true if p may be used now: it's powered and settled, or
+    // not in use at all.
+    bool ensure(Peripheral p)
+        {
+        if (this->m_refs[unsigned(p)] == 0)
+            return true;
+        if (! this->isOn(p))
+            this->powerUp(p);
+        return this->isReady(p);
+        }
+
+    // the sensor bus, and the boost regulator it runs from if that's in
+    // use. The boost regulator comes first, so the bus isn't powered up
+    // until it has settled. Returns true if the sensors may be read now.
+    bool ensureSensor()
+        {
+        return this->ensure(Peripheral::kBoost) &&
+               this->ensure(Peripheral::kI2c);
+        }
+
+    bool isOn(Peripheral p) const
+        {
+        return (this->m_onMask & getMask(p)) != 0;
+        }
+
+    bool isReady(Peripheral p) const
+        {
+        return this->isOn(p) &&
+               this->m_pClock() - this->m_tUp[unsigned(p)] >= getSettleMs(p);
+        }
+
+    std::uint8_t getRefs(Peripheral p) const
+        {
+        return this->m_refs[unsigned(p)];
+        }
+
+    // before deep sleep: power everything down, keeping the references.
+    void suspend()
+        {
+        for (std::size_t i = 0; i < kPeripherals; ++i)
+            {
+            if (this->isOn(Peripheral(i)))
+                this->powerDown(Peripheral(i));
+            }
+        }
+
+    // after deep sleep: nothing is powered until it's used.
+    void resume()
+        {
+        this->m_tWake = this->m_pClock();
+        this->m_fAwaitingSample = true;
+        ++this->m_wake.nWakes;
+        }
+
+    // a sensor sample was taken.
+    void noteSample()
+        {
+        if (! this->m_fAwaitingSample)
+            return;
+
+        std::uint32_t const ms = this->m_pClock() - this->m_tWake;
+        auto &wake = this->m_wake;
+
+        this->m_fAwaitingSample = false;
+        ++wake.nSampled;
+        wake.msLast = ms;
+        wake.msTotal += ms;
+        if (ms > wake.msMax)
+            wake.msMax = ms;
+        }
+
+    // charge the time powered so far.
+    void account()
+        {
+        std::uint32_t const tNow = this->m_pClock();
+
+        for (std::size_t i = 0; i < kPeripherals; ++i)
+            {
+            if (this->isOn(Peripheral(i)))
+                this->charge(i, tNow);
+            }
+        }
+
+    const Stats &getStats(Peripheral p) const
+        {
+        return this->m_stats[unsigned(p)];
+        }
+
+    const WakeStats &getWakeStats() const
+        {
+        return this->m_wake;
+        }
+
+    void resetStats()
+        {
+        this->account();
+        for (auto &stats : this->m_stats)
+            stats = Stats {};
+        this->m_wake = WakeStats {};
+        this->m_fAwaitingSample = false;
+        }
+
+    // switch the hardware.
+    static void setHardwarePower(Peripheral p, bool fOn);
+
+private:
+    void charge(std::size_t i, std::uint32_t tNow)
+        {
+        this->m_stats[i].msOn += tNow - this->m_tCharged[i];
+        this->m_tCharged[i] = tNow;
+        }
+
+    void powerUp(Peripheral p)
+        {
+        unsigned const i = unsigned(p);
+
+        if ((this->m_absentMask & getMask(p)) != 0)
+            return;
+
+        this->m_pPower(p, true);
+        this->m_onMask |= getMask(p);
+        this->m_tUp[i] = this->m_tCharged[i] = this->m_pClock();
+        ++this->m_stats[i].nPowerUps;
+        }
+
+    void powerDown(Peripheral p)
+        {
+        this->charge(unsigned(p), this->m_pClock());
+        this->m_pPower(p, false);
+        this->m_onMask &= ~getMask(p);
+        }
+
+    ClockFn                 m_pClock;
+    PowerFn                 m_pPower;
+    std::uint8_t            m_onMask;
+    std::uint8_t            m_absentMask;
+    bool                    m_fAwaitingSample;
+    std::uint32_t           m_tWake;
+    std::uint8_t            m_refs[kPeripherals];
+    std::uint32_t           m_tUp[kPeripherals];
+    std::uint32_t           m_tCharged[kPeripherals];
+    Stats                   m_stats[kPeripherals];
+    WakeStats               m_wake;
+    };
+
+} // namespace McciCatena4610
+
+#endif /* _Catena4610_cPowerManager_h_ */
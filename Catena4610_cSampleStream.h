@@ -0,0 +1,327 @@
+/*
+
+Module: Catena4610_cSampleStream.h
+
+Function:
+        cSampleStream: raw touch sensor samples as framed binary.
+
+Copyright:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#ifndef _Catena4610_cSampleStream_h_
+# define _Catena4610_cSampleStream_h_
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Catena4610_Crc.h"
+
+namespace McciCatena4610 {
+
+/****************************************************************************\
+|
+|   The sample stream.
+|
+|   The sampling path push()es each sample into a small ring; push() never
+|   waits, and a sample that finds the ring full is counted as dropped.
+|   Battery and bus voltage readings go through the same ring as events,
+|   so they stay in time order with the samples. The output side takes up
+|   to kSamplesPerFrame entries at a time and builds a frame:
+|
+|       u8      version (kFrameVersion)
+|       u8      number of entries
+|       u16     frame sequence number
+|       u32     entries dropped since start
+|       n x     u32 millis(), u8 kind, i16 a, i16 b, i16 c
+|       u32     CRC-32 of all the above
+|
+|   For a sample, a, b and c are Ch1, Ch2 and amplitude; for a voltage,
+|   a is the reading in mV (as a u16) and b and c are zero.
+|
+|   all little-endian. The frame is COBS-encoded, so it holds no zero
+|   bytes, and a zero byte is put before and after it. Text written to
+|   the same port between frames thus lands in chunks of its own, which
+|   fail the CRC and are skipped by the reader.
+|
+|   Nothing here touches the hardware; the capture tool in extra/ uses
+|   the same code to decode frames.
+|
+\****************************************************************************/
+
+class cSampleStream
+    {
+public:
+    static constexpr std::uint8_t kFrameVersion = 2;
+    // ring size; a power of two.
+    static constexpr std::size_t kQueueSamples = 32;
+    static constexpr std::size_t kSamplesPerFrame = 4;
+
+    static constexpr std::size_t kHeaderBytes = 8;
+    static constexpr std::size_t kSampleBytes = 11;
+    static constexpr std::size_t kCrcBytes = 4;
+    static constexpr std::size_t kMaxFrameBytes =
+        kHeaderBytes + kSamplesPerFrame * kSampleBytes + kCrcBytes;
+    // COBS adds one byte per 254, plus the two delimiters.
+    static constexpr std::size_t kMaxEncodedBytes =
+        kMaxFrameBytes + kMaxFrameBytes / 254 + 1 + 2;
+
+    static_assert((kQueueSamples & (kQueueSamples - 1)) == 0, "ring size must be a power of two");
+
+    enum class Kind : std::uint8_t
+        {
+        kSample = 0,            // touch sensor sample
+        kVbat = 1,              // battery voltage
+        kVbus = 2,              // bus voltage
+        };
+
+    struct Sample
+        {
+        std::uint32_t   tMs;
+        Kind            kind;
+        std::int16_t    ch1;
+        std::int16_t    ch2;
+        std::int16_t    amplitude;
+        };
+
+    struct FrameInfo
+        {
+        std::uint8_t    nSamples;
+        std::uint16_t   sequence;
+        std::uint32_t   nDropped;
+        };
+
+    struct Stats
+        {
+        std::uint32_t   nSamples;       // entries pushed, including dropped
+        std::uint32_t   nDropped;       // entries dropped, ring full
+        std::uint32_t   nFrames;        // frames built
+        std::uint32_t   nBytes;         // encoded bytes built
+        };
+
+    cSampleStream()
+        : m_stats {}
+        , m_iHead(0)
+        , m_iTail(0)
+        , m_sequence(0)
+        , m_fRunning(false)
+        {}
+
+    // neither copyable nor movable
+    cSampleStream(const cSampleStream&) = delete;
+    cSampleStream& operator=(const cSampleStream&) = delete;
+    cSampleStream(const cSampleStream&&) = delete;
+    cSampleStream& operator=(const cSampleStream&&) = delete;
+
+    // start streaming, with fresh statistics.
+    void start()
+        {
+        this->m_stats = Stats {};
+        this->m_iHead = this->m_iTail = 0;
+        this->m_sequence = 0;
+        this->m_fRunning = true;
+        }
+
+    void stop()
+        {
+        this->m_fRunning = false;
+        }
+
+    bool isRunning() const
+        {
+        return this->m_fRunning;
+        }
+
+    bool isEmpty() const
+        {
+        return this->m_iHead == this->m_iTail;
+        }
+
+    const Stats &getStats() const
+        {
+        return this->m_stats;
+        }
+
+    // queue a sample; never waits.
+    void push(const Sample &s)
+        {
+        if (! this->m_fRunning)
+            return;
+
+        ++this->m_stats.nSamples;
+        if (this->m_iHead - this->m_iTail >= kQueueSamples)
+            {
+            ++this->m_stats.nDropped;
+            return;
+            }
+
+        this->m_ring[this->m_iHead % kQueueSamples] = s;
+        ++this->m_iHead;
+        }
+
+    // build the next encoded frame into pBuf, which must have room for
+    // kMaxEncodedBytes. Returns the number of bytes, or 0 if nothing is
+    // queued.
+    std::size_t getFrame(std::uint8_t *pBuf)
+        {
+        std::size_t const nQueued = this->m_iHead - this->m_iTail;
+
+        if (nQueued == 0)
+            return 0;
+
+        std::size_t const nSamples = nQueued < kSamplesPerFrame ? nQueued : kSamplesPerFrame;
+        std::uint8_t frame[kMaxFrameBytes];
+        std::uint8_t *p = frame;
+
+        *p++ = kFrameVersion;
+        *p++ = std::uint8_t(nSamples);
+        p = put16(p, this->m_sequence++);
+        p = put32(p, this->m_stats.nDropped);
+        for (std::size_t i = 0; i < nSamples; ++i)
+            {
+            Sample const &s = this->m_ring[this->m_iTail % kQueueSamples];
+
+            ++this->m_iTail;
+            p = put32(p, s.tMs);
+            *p++ = std::uint8_t(s.kind);
+            p = put16(p, std::uint16_t(s.ch1));
+            p = put16(p, std::uint16_t(s.ch2));
+            p = put16(p, std::uint16_t(s.amplitude));
+            }
+        p = put32(p, crc32(frame, p - frame));
+
+        pBuf[0] = 0;
+        std::size_t const nEncoded = cobsEncode(frame, p - frame, pBuf + 1);
+        pBuf[1 + nEncoded] = 0;
+
+        ++this->m_stats.nFrames;
+        this->m_stats.nBytes += 2 + nEncoded;
+        return 2 + nEncoded;
+        }
+
+    // decode a frame (after COBS decoding). pSamples must have room for
+    // kSamplesPerFrame samples. Returns false if the frame is not valid.
+    static bool decodeFrame(const std::uint8_t *pFrame, std::size_t nFrame, FrameInfo &info, Sample *pSamples)
+        {
+        if (nFrame < kHeaderBytes + kCrcBytes || pFrame[0] != kFrameVersion)
+            return false;
+
+        info.nSamples = pFrame[1];
+        if (info.nSamples > kSamplesPerFrame ||
+            nFrame != kHeaderBytes + info.nSamples * kSampleBytes + kCrcBytes)
+            return false;
+
+        if (get32(pFrame + nFrame - kCrcBytes) != crc32(pFrame, nFrame - kCrcBytes))
+            return false;
+
+        info.sequence = get16(pFrame + 2);
+        info.nDropped = get32(pFrame + 4);
+
+        const std::uint8_t *p = pFrame + kHeaderBytes;
+        for (unsigned i = 0; i < info.nSamples; ++i, p += kSampleBytes)
+            {
+            pSamples[i].tMs = get32(p);
+            pSamples[i].kind = Kind(p[4]);
+            pSamples[i].ch1 = std::int16_t(get16(p + 5));
+            pSamples[i].ch2 = std::int16_t(get16(p + 7));
+            pSamples[i].amplitude = std::int16_t(get16(p + 9));
+            }
+        return true;
+        }
+
+    // COBS-encode nIn bytes; pOut needs nIn + nIn / 254 + 1 bytes.
+    // Returns the number of bytes written.
+    static std::size_t cobsEncode(const std::uint8_t *pIn, std::size_t nIn, std::uint8_t *pOut)
+        {
+        std::size_t iCode = 0;
+        std::size_t iOut = 1;
+        std::uint8_t code = 1;
+
+        for (std::size_t i = 0; i < nIn; ++i)
+            {
+            if (pIn[i] != 0)
+                {
+                pOut[iOut++] = pIn[i];
+                ++code;
+                }
+
+            if (pIn[i] == 0 || code == 0xFF)
+                {
+                pOut[iCode] = code;
+                code = 1;
+                iCode = iOut++;
+                }
+            }
+
+        pOut[iCode] = code;
+        return iOut;
+        }
+
+    // COBS-decode nIn bytes (no delimiters) into pOut, which needs nIn
+    // bytes. Returns the number of bytes, or 0 if the input is malformed.
+    static std::size_t cobsDecode(const std::uint8_t *pIn, std::size_t nIn, std::uint8_t *pOut)
+        {
+        std::size_t iOut = 0;
+        std::size_t i = 0;
+
+        while (i < nIn)
+            {
+            std::uint8_t const code = pIn[i++];
+
+            if (code == 0 || i + code - 1 > nIn)
+                return 0;
+
+            for (unsigned j = 1; j < code; ++j)
+                {
+                if (pIn[i] == 0)
+                    return 0;
+                pOut[iOut++] = pIn[i++];
+                }
+
+            if (code != 0xFF && i < nIn)
+                pOut[iOut++] = 0;
+            }
+
+        return iOut;
+        }
+
+private:
+    static std::uint8_t *put16(std::uint8_t *p, std::uint16_t v)
+        {
+        p[0] = std::uint8_t(v);
+        p[1] = std::uint8_t(v >> 8);
+        return p + 2;
+        }
+
+    static std::uint8_t *put32(std::uint8_t *p, std::uint32_t v)
+        {
+        return put16(put16(p, std::uint16_t(v)), std::uint16_t(v >> 16));
+        }
+
+    static std::uint16_t get16(const std::uint8_t *p)
+        {
+        return std::uint16_t(p[0] | (p[1] << 8));
+        }
+
+    static std::uint32_t get32(const std::uint8_t *p)
+        {
+        return get16(p) | (std::uint32_t(get16(p + 2)) << 16);
+        }
+
+    Sample          m_ring[kQueueSamples];
+    Stats           m_stats;
+    std::uint32_t   m_iHead;
+    std::uint32_t   m_iTail;
+    std::uint16_t   m_sequence;
+    bool            m_fRunning;
+    };
+
+} // namespace McciCatena4610
+
+#endif /* _Catena4610_cSampleStream_h_ */
@@ -0,0 +1,648 @@
+/*
+
+Module: Catena4610_cSensorArray.h
+
+Function:
+        cSensorArray: several IQS620A sensors sharing one I2C bus.
+
+Copyright:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#ifndef _Catena4610_cSensorArray_h_
+# define _Catena4610_cSensorArray_h_
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "Catena4610_cI2cBus.h"
+#include "Catena4610_cIqs620aReader.h"
+#include "Catena4610_cTouchChannels.h"
+
+namespace McciCatena4610 {
+
+/****************************************************************************\
+|
+|   The sensor array.
+|
+|   Up to eight IQS620As, each at its own address or behind an I2C mux
+|   (such as a TCA9548A), read with the same one-burst transaction as
+|   cIqs620aReader. Sensors are numbered in the order they're added, and
+|   sets of sensors are bitmaps, bit i for sensor i.
+|
+|   Reads are done in rounds, one per sampling period. startRound()
+|   chooses which sensors to read, up to readsPerRound of them:
+|
+|       kRoundRobin     each sensor in turn.
+|       kPriority       each in proportion to its priority (a smooth
+|                       weighted round robin), but never twice in a round;
+|                       a sensor due more often is read every round.
+|
+|   Sensors left unread when a round runs out of time go first in the
+|   next. startRound() sorts the round's sensors by mux channel, so the
+|   mux switches at most once per channel, and starts the first read; poll() collects each read as it
+|   completes and starts the next, so a round is one batch of back-to-back
+|   transfers. endRound() abandons anything still unread, and updates the
+|   touch state of every sensor read in the round, together.
+|
+|   The per-sensor state is kept as a structure of arrays: each channel's
+|   readings for all sensors in one array, and the touch state as
+|   bitmaps. Detection for the whole array is then a loop over the
+|   channels, each comparing two small arrays, with no per-sensor object.
+|   A sensor counts as touched the way cTouchDetector counts a touch: when
+|   any channel has read below its threshold on debounce reads of the
+|   sensor in a row; and it's released when every channel has read at or
+|   above its threshold raised by hysteresis, on debounce reads in a row.
+|
+|   Nothing here touches the hardware, so extra/ simulates it.
+|
+\****************************************************************************/
+
+template <std::size_t a_nSensors, std::size_t a_nChannels>
+class cSensorArray
+    {
+    static_assert(a_nSensors >= 1 && a_nSensors <= 8, "sensor sets are one-byte bitmaps");
+
+public:
+    static constexpr std::size_t kSensors = a_nSensors;
+
+    using Channels = cTouchChannels<a_nChannels>;
+    using Readings = typename Channels::Readings;
+    using Thresholds = typename Channels::Thresholds;
+    using Bitmap = std::uint8_t;
+
+    // a sensor not behind the mux.
+    static constexpr std::uint8_t kNoMux = 0xFF;
+
+    enum class Policy : std::uint8_t
+        {
+        kRoundRobin,
+        kPriority,
+        };
+
+    // select a mux channel, or kNoMux for none, blocking. Only called
+    // while the bus is idle.
+    using MuxFn = bool (*)(void *pContext, std::uint8_t channel);
+
+    struct Stats
+        {
+        std::uint32_t   nRounds;
+        std::uint32_t   nOverruns;      // rounds that ended with sensors unread
+        std::uint32_t   nMuxSwitches;
+        };
+
+    cSensorArray()
+        : m_pBus(nullptr)
+        , m_pMux(nullptr)
+        , m_pMuxContext(nullptr)
+        , m_nSensors(0)
+        , m_policy(Policy::kRoundRobin)
+        , m_readsPerRound(0)
+        , m_cursor(0)
+        , m_nPicked(0)
+        , m_iNext(0)
+        , m_total(0)
+        , m_iReading(0)
+        , m_muxSelected(kMuxUnknown)
+        , m_status(cI2cBus::Status::kOk)
+        , m_fRound(false)
+        , m_fReading(false)
+        , m_fDone(false)
+        , m_fresh(0)
+        , m_present(0)
+        , m_touching(0)
+        , m_newTouches(0)
+        , m_stats {}
+        , m_address {}
+        , m_mux {}
+        , m_priority {}
+        , m_credit {}
+        , m_order {}
+        , m_ch {}
+        , m_amplitude {}
+        , m_threshold {}
+        , m_hysteresis(0)
+        , m_debounce(1)
+        , m_nRun {}
+        , m_nReads {}
+        , m_nErrors {}
+        , m_buffer {}
+        {}
+
+    // neither copyable nor movable
+    cSensorArray(const cSensorArray&) = delete;
+    cSensorArray& operator=(const cSensorArray&) = delete;
+    cSensorArray(const cSensorArray&&) = delete;
+    cSensorArray& operator=(const cSensorArray&&) = delete;
+
+    // pMux may be nullptr if no sensor is behind a mux.
+    void begin(cI2cBus &bus, MuxFn pMux, void *pMuxContext)
+        {
+        this->m_pBus = &bus;
+        this->m_pMux = pMux;
+        this->m_pMuxContext = pMuxContext;
+        this->m_muxSelected = kMuxUnknown;
+        }
+
+    // add a sensor; priority counts only for kPriority. Returns its
+    // number, or -1 if the array is full.
+    int addSensor(std::uint8_t address, std::uint8_t muxChannel, std::uint8_t priority)
+        {
+        if (this->m_nSensors == kSensors)
+            return -1;
+
+        std::size_t const i = this->m_nSensors++;
+
+        this->m_address[i] = address;
+        this->m_mux[i] = muxChannel;
+        this->m_priority[i] = priority != 0 ? priority : 1;
+        this->m_credit[i] = 0;
+        return int(i);
+        }
+
+    std::size_t getSensorCount() const
+        {
+        return this->m_nSensors;
+        }
+
+    // readsPerRound 0 means every sensor, every round.
+    void setSchedule(Policy policy, std::size_t readsPerRound)
+        {
+        this->m_policy = policy;
+        this->m_readsPerRound = readsPerRound;
+        }
+
+    void setThresholds(std::size_t i, const Thresholds &thresholds)
+        {
+        Channels::forEach([&](std::size_t c)
+            {
+            this->m_threshold[c][i] = thresholds[c];
+            });
+        }
+
+    // the same thresholds for every sensor.
+    void setThresholds(const Thresholds &thresholds)
+        {
+        for (std::size_t i = 0; i < kSensors; ++i)
+            this->setThresholds(i, thresholds);
+        }
+
+    // the same hysteresis and debounce as cTouchDetector::update().
+    void setDetection(std::uint16_t hysteresis, std::uint8_t debounce)
+        {
+        this->m_hysteresis = hysteresis;
+        this->m_debounce = debounce;
+        }
+
+    // end the round in progress, if any; choose the sensors for the next
+    // and start reading them.
+    void startRound()
+        {
+        if (this->m_fRound)
+            this->endRound();
+
+        if (this->m_pBus == nullptr || this->m_nSensors == 0)
+            return;
+
+        this->pick();
+        this->m_iNext = 0;
+        this->m_fresh = 0;
+        this->m_fRound = true;
+        ++this->m_stats.nRounds;
+        this->startNext();
+        }
+
+    // collect a completed read and start the next.
+    void poll()
+        {
+        if (! this->m_fReading)
+            return;
+
+        this->m_pBus->poll();
+        if (! this->m_fDone.load(std::memory_order_acquire))
+            return;
+
+        this->collect();
+        this->startNext();
+        }
+
+    bool isRoundDone() const
+        {
+        return ! this->m_fReading && this->m_iNext == this->m_nPicked;
+        }
+
+    // end the round: abandon any reads not done, and update the touch
+    // state of the sensors read. Returns the sensors read.
+    Bitmap endRound()
+        {
+        if (! this->m_fRound)
+            return 0;
+
+        if (this->m_fReading && ! this->m_fDone.load(std::memory_order_acquire))
+            {
+            // the completion is called with kAborted.
+            this->m_pBus->abort();
+            ++this->m_stats.nOverruns;
+            this->requeue(this->m_iNext - 1);
+            }
+        else if (this->m_iNext != this->m_nPicked)
+            {
+            ++this->m_stats.nOverruns;
+            this->requeue(this->m_iNext);
+            }
+
+        if (this->m_fReading)
+            this->collect();
+
+        this->m_iNext = this->m_nPicked;
+        this->m_fRound = false;
+        this->detect();
+        return this->m_fresh;
+        }
+
+    // sensors whose last read succeeded.
+    Bitmap getPresent() const
+        {
+        return this->m_present;
+        }
+
+    Bitmap getTouching() const
+        {
+        return this->m_touching;
+        }
+
+    // sensors whose touch began in the last round.
+    Bitmap getNewTouches() const
+        {
+        return this->m_newTouches;
+        }
+
+    // the last values read from sensor i.
+    void getReadings(std::size_t i, Readings &r) const
+        {
+        Channels::forEach([&](std::size_t c)
+            {
+            r[c] = this->m_ch[c][i];
+            });
+        }
+
+    std::int16_t getAmplitude(std::size_t i) const
+        {
+        return this->m_amplitude[i];
+        }
+
+    std::uint32_t getReads(std::size_t i) const
+        {
+        return this->m_nReads[i];
+        }
+
+    std::uint32_t getErrors(std::size_t i) const
+        {
+        return this->m_nErrors[i];
+        }
+
+    const Stats &getStats() const
+        {
+        return this->m_stats;
+        }
+
+    void resetStats()
+        {
+        this->m_stats = Stats {};
+        this->m_nReads.fill(0);
+        this->m_nErrors.fill(0);
+        }
+
+private:
+    // the mux state after begin(), or a failed switch.
+    static constexpr std::uint8_t kMuxUnknown = 0xFE;
+
+    static Bitmap bit(std::size_t i)
+        {
+        return Bitmap(1u << i);
+        }
+
+    // fill m_order with the sensors to read this round, by mux channel.
+    void pick()
+        {
+        std::size_t const n = this->m_nSensors;
+        std::size_t nPick = this->m_readsPerRound;
+
+        if (nPick == 0 || nPick > n)
+            nPick = n;
+
+        if (this->m_policy == Policy::kRoundRobin)
+            {
+            for (std::size_t j = 0; j < nPick; ++j)
+                this->m_order[j] = std::uint8_t((this->m_cursor + j) % n);
+            this->m_cursor = std::uint8_t((this->m_cursor + nPick) % n);
+            }
+        else
+            {
+            this->pickByPriority(nPick);
+            }
+
+        // a stable insertion sort by mux channel, counting from the first
+        // pick's channel and wrapping around: the first pick is still
+        // read first, should the round run out of time.
+        std::uint8_t const firstMux = this->m_mux[this->m_order[0]];
+        auto const key = [this, firstMux](std::uint8_t i)
+            {
+            return std::uint8_t(this->m_mux[i] - firstMux);
+            };
+
+        for (std::size_t j = 1; j < nPick; ++j)
+            {
+            std::uint8_t const i = this->m_order[j];
+            std::size_t k = j;
+
+            for (; k > 0 && key(this->m_order[k - 1]) > key(i); --k)
+                this->m_order[k] = this->m_order[k - 1];
+            this->m_order[k] = i;
+            }
+
+        this->m_nPicked = nPick;
+        }
+
+    // a smooth weighted round robin, without repeats.
+    void pickByPriority(std::size_t nPick)
+        {
+        std::size_t const n = this->m_nSensors;
+        Bitmap always = 0;
+        std::size_t nAlways = 0;
+        std::int32_t total = 0;
+
+        // a sensor whose share is a read every round or more is read
+        // every round; the others share the rest in proportion.
+        for (bool fChanged = true; fChanged; )
+            {
+            fChanged = false;
+            total = 0;
+            for (std::size_t i = 0; i < n; ++i)
+                {
+                if ((always & bit(i)) == 0)
+                    total += this->m_priority[i];
+                }
+
+            for (std::size_t i = 0; i < n; ++i)
+                {
+                if ((always & bit(i)) == 0 &&
+                    std::int32_t(this->m_priority[i] * (nPick - nAlways)) >= total)
+                    {
+                    always |= bit(i);
+                    ++nAlways;
+                    fChanged = true;
+                    }
+                }
+            }
+
+        std::size_t const nShared = nPick - nAlways;
+        std::size_t j = 0;
+        std::int32_t sum = 0;
+
+        // everyone sharing earns credit by priority; each pick spends
+        // the total, so the credits add up to nothing.
+        for (std::size_t i = 0; i < n; ++i)
+            {
+            if (always & bit(i))
+                {
+                this->m_credit[i] = 0;
+                this->m_order[j++] = std::uint8_t(i);
+                }
+            else
+                {
+                this->m_credit[i] += std::int32_t(this->m_priority[i] * nShared);
+                sum += this->m_credit[i];
+                }
+            }
+
+        // ...unless endRound() gave some back: take it from everyone.
+        if (n != nAlways)
+            {
+            std::int32_t const mean = sum / std::int32_t(n - nAlways);
+
+            for (std::size_t i = 0; i < n; ++i)
+                {
+                if ((always & bit(i)) == 0)
+                    this->m_credit[i] -= mean;
+                }
+            }
+
+        for (Bitmap picked = always; j < nPick; ++j)
+            {
+            std::size_t best = n;
+
+            for (std::size_t i = 0; i < n; ++i)
+                {
+                if ((picked & bit(i)) == 0 &&
+                    (best == n || this->m_credit[i] > this->m_credit[best]))
+                    best = i;
+                }
+
+            picked |= bit(best);
+            this->m_credit[best] -= total;
+            this->m_order[j] = std::uint8_t(best);
+            }
+
+        this->m_total = total;
+        }
+
+    // the round ran out of time before the reads from m_order[iFirst]
+    // on: give them the first turn next round.
+    void requeue(std::size_t iFirst)
+        {
+        if (this->m_policy == Policy::kRoundRobin)
+            {
+            this->m_cursor = this->m_order[iFirst];
+            return;
+            }
+
+        for (std::size_t j = iFirst; j < this->m_nPicked; ++j)
+            this->m_credit[this->m_order[j]] += this->m_total;
+        }
+
+    // start the next read of the round that can be started.
+    void startNext()
+        {
+        while (this->m_iNext < this->m_nPicked)
+            {
+            std::size_t const i = this->m_order[this->m_iNext++];
+            std::uint8_t const mux = this->m_mux[i];
+
+            if (this->m_pMux != nullptr && mux != this->m_muxSelected)
+                {
+                ++this->m_stats.nMuxSwitches;
+                if (! this->m_pMux(this->m_pMuxContext, mux))
+                    {
+                    this->m_muxSelected = kMuxUnknown;
+                    this->fail(i);
+                    continue;
+                    }
+                this->m_muxSelected = mux;
+                }
+
+            this->m_fDone.store(false, std::memory_order_relaxed);
+            this->m_iReading = std::uint8_t(i);
+            this->m_fReading = true;
+
+            if (this->m_pBus->startRead(
+                    this->m_address[i], cIqs620aReader::kFirstRegister,
+                    this->m_buffer, sizeof(this->m_buffer),
+                    onComplete, this))
+                return;
+
+            this->m_fReading = false;
+            this->fail(i);
+            }
+        }
+
+    void fail(std::size_t i)
+        {
+        this->m_present &= ~bit(i);
+        ++this->m_nErrors[i];
+        }
+
+    // take the completed read into sensor m_iReading's column.
+    void collect()
+        {
+        std::size_t const i = this->m_iReading;
+
+        this->m_fReading = false;
+
+        // abandoned by endRound(), which counted it.
+        if (this->m_status == cI2cBus::Status::kAborted)
+            return;
+
+        if (this->m_status != cI2cBus::Status::kOk)
+            {
+            this->fail(i);
+            return;
+            }
+
+        Channels::forEach([&](std::size_t c)
+            {
+            // channel c is IQS620A channel (c + 1) % 3; see cTouchChannels.
+            std::size_t const j = cIqs620aReader::kChannelOffset + 2 * ((c + 1) % 3);
+
+            this->m_ch[c][i] = std::int16_t(this->m_buffer[j] | (this->m_buffer[j + 1] << 8));
+            });
+        this->m_amplitude[i] = std::int16_t(
+            this->m_buffer[cIqs620aReader::kAmplitudeOffset] |
+            (this->m_buffer[cIqs620aReader::kAmplitudeOffset + 1] << 8)
+            );
+
+        this->m_fresh |= bit(i);
+        this->m_present |= bit(i);
+        ++this->m_nReads[i];
+        }
+
+    // update the touch state of the sensors read this round.
+    void detect()
+        {
+        Bitmap below = 0;
+        Bitmap held = 0;
+
+        Channels::forEach([&](std::size_t c)
+            {
+            auto const &ch = this->m_ch[c];
+            auto const &threshold = this->m_threshold[c];
+
+            for (std::size_t i = 0; i < kSensors; ++i)
+                {
+                below |= Bitmap(ch[i] < threshold[i]) << i;
+                held |= Bitmap(std::int32_t(ch[i]) < std::int32_t(threshold[i]) + this->m_hysteresis) << i;
+                }
+            });
+
+        // read and touching: against if nothing is held. Read and not
+        // touching: against if below. Not read: as it was. A run of
+        // debounce reads against the state changes it.
+        Bitmap const fresh = this->m_fresh;
+        Bitmap const against = fresh & ((this->m_touching & ~held) | (~this->m_touching & below));
+        Bitmap flip = 0;
+
+        for (std::size_t i = 0; i < kSensors; ++i)
+            {
+            if (! (fresh & bit(i)))
+                continue;
+
+            if (! (against & bit(i)))
+                this->m_nRun[i] = 0;
+            else if (++this->m_nRun[i] >= this->m_debounce)
+                {
+                this->m_nRun[i] = 0;
+                flip |= bit(i);
+                }
+            }
+
+        this->m_newTouches = flip & ~this->m_touching;
+        this->m_touching ^= flip;
+        }
+
+    // may be called from an interrupt.
+    static void onComplete(void *pClientData, cI2cBus::Status status)
+        {
+        cSensorArray * const pThis = static_cast<cSensorArray *>(pClientData);
+
+        pThis->m_status = status;
+        pThis->m_fDone.store(true, std::memory_order_release);
+        }
+
+    cI2cBus                     *m_pBus;
+    MuxFn                       m_pMux;
+    void                        *m_pMuxContext;
+    std::size_t                 m_nSensors;
+
+    // scheduling.
+    Policy                      m_policy;
+    std::size_t                 m_readsPerRound;
+    std::uint8_t                m_cursor;       // kRoundRobin: next to read
+    std::size_t                 m_nPicked;
+    std::size_t                 m_iNext;        // into m_order
+    std::int32_t                m_total;        // kPriority: spent per pick
+
+    // the read in progress.
+    std::uint8_t                m_iReading;
+    std::uint8_t                m_muxSelected;
+    cI2cBus::Status             m_status;       // set by onComplete()
+    bool                        m_fRound;
+    bool                        m_fReading;
+    std::atomic<bool>           m_fDone;
+
+    // the touch state, by sensor.
+    Bitmap                      m_fresh;        // read this round
+    Bitmap                      m_present;
+    Bitmap                      m_touching;
+    Bitmap                      m_newTouches;
+
+    Stats                       m_stats;
+
+    // per-sensor state, as a structure of arrays.
+    std::array<std::uint8_t, kSensors>      m_address;
+    std::array<std::uint8_t, kSensors>      m_mux;
+    std::array<std::uint8_t, kSensors>      m_priority;
+    std::array<std::int32_t, kSensors>      m_credit;
+    std::array<std::uint8_t, kSensors>      m_order;
+    std::array<std::array<std::int16_t, kSensors>, a_nChannels>     m_ch;
+    std::array<std::int16_t, kSensors>      m_amplitude;
+    std::array<std::array<std::uint16_t, kSensors>, a_nChannels>    m_threshold;
+    std::uint16_t                           m_hysteresis;
+    std::uint8_t                            m_debounce;
+    std::array<std::uint8_t, kSensors>      m_nRun;     // reads in a row against m_touching
+    std::array<std::uint32_t, kSensors>     m_nReads;
+    std::array<std::uint32_t, kSensors>     m_nErrors;
+
+    std::uint8_t                m_buffer[cIqs620aReader::kBurstBytes];
+    };
+
+} // namespace McciCatena4610
+
+#endif /* _Catena4610_cSensorArray_h_ */
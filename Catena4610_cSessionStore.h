@@ -0,0 +1,245 @@
+/*
+
+Module: Catena4610_cSessionStore.h
+
+Function:
+        cSessionStore: LoRaWAN session and frame-counter journal in flash.
+
+Copyright:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#ifndef _Catena4610_cSessionStore_h_
+# define _Catena4610_cSessionStore_h_
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "Catena4610_FlashMap.h"
+#include "Catena4610_cTwoSectorStore.h"
+
+namespace McciCatena4610 {
+
+/****************************************************************************\
+|
+|   The session store.
+|
+|   The session record (keys, addresses, channel plan) is kept in a
+|   cTwoSectorStore; the rest of its sector is a journal of frame
+|   counters, one 16-byte entry per kJournalInterval uplinks. The session
+|   record is only rewritten when the session itself changes (join, ADR)
+|   or the journal fills, so a reset part-way through leaves either the
+|   old or the new session, never neither.
+|
+|   With 244 journal entries per sector, each sector is erased once per
+|   7808 uplinks, well inside the part's 100k-cycle endurance for any
+|   realistic service life.
+|
+\****************************************************************************/
+
+template <class Flash>
+class cSessionStore
+    {
+public:
+    // number of uplinks between journal entries.
+    static constexpr std::uint32_t kJournalInterval = 16;
+    // opaque region-specific channel plan, filled in by the caller.
+    static constexpr std::size_t kChannelStateBytes = 112;
+
+    struct Session
+        {
+        std::uint32_t   netId;
+        std::uint32_t   devAddr;
+        std::uint32_t   seqnoUp;
+        std::uint32_t   seqnoDn;
+        std::uint32_t   dn2Freq;
+        std::uint8_t    nwkSKey[16];
+        std::uint8_t    appSKey[16];
+        std::uint8_t    datarate;
+        std::int8_t     txPower;
+        std::uint8_t    dn2Dr;
+        std::uint8_t    rxDelay;
+        std::uint8_t    channelState[kChannelStateBytes];
+        };
+
+    static_assert(
+        sizeof(Session) == 5 * 4 + 2 * 16 + 4 + kChannelStateBytes,
+        "Session must not contain padding; it's compared with memcmp"
+        );
+
+    cSessionStore(Flash &flash, std::uint32_t base = FlashMap::kSessionBase)
+        : m_store(flash, base, kMagic)
+        , m_session {}
+        , m_heldDevAddr(0)
+        , m_heldNwkSKey {}
+        , m_fHeld(false)
+        {}
+
+    // neither copyable nor movable
+    cSessionStore(const cSessionStore&) = delete;
+    cSessionStore& operator=(const cSessionStore&) = delete;
+    cSessionStore(const cSessionStore&&) = delete;
+    cSessionStore& operator=(const cSessionStore&&) = delete;
+
+    // scan flash for the newest session. Returns true if one was found.
+    bool begin()
+        {
+        JournalEntry e;
+
+        if (! this->m_store.begin(this->m_session))
+            return false;
+
+        if (this->m_store.scanJournal(e))
+            {
+            this->m_session.seqnoUp = e.seqnoUp;
+            this->m_session.seqnoDn = e.seqnoDn;
+            }
+        return true;
+        }
+
+    bool isValid() const
+        {
+        return this->m_store.isValid();
+        }
+
+    // get the session to restore. The uplink counter is advanced past any
+    // value that might have been used since the last journal entry.
+    bool getSession(Session &s) const
+        {
+        if (! this->isValid())
+            return false;
+
+        s = this->m_session;
+        s.seqnoUp += 2 * kJournalInterval;
+        return true;
+        }
+
+    // get the session to restore, as getSession(), and journal the
+    // advanced counter before any uplink uses it; otherwise a reset
+    // before the next update() would hand out the same counter again.
+    bool resume(Session &s)
+        {
+        if (! this->getSession(s))
+            return false;
+
+        this->appendJournal(s.seqnoUp, s.seqnoDn);
+        return true;
+        }
+
+    // record the current session state. Writes a new record if anything
+    // but the counters changed, otherwise journals the counters if due.
+    // Nothing is written while the running session is held by erase().
+    void update(const Session &s)
+        {
+        if (this->isHeld(s))
+            return;
+
+        if (! this->isValid() || ! this->isSameSession(s))
+            this->save(s);
+        else if (s.seqnoUp - this->m_session.seqnoUp >= kJournalInterval)
+            this->appendJournal(s.seqnoUp, s.seqnoDn);
+        }
+
+    // forget the stored session; the next boot will join. The running
+    // session, current, is not saved again: update() ignores it until a
+    // join replaces it (a join always brings new session keys).
+    void erase(const Session &current)
+        {
+        this->m_store.erase();
+
+        this->m_fHeld = true;
+        this->m_heldDevAddr = current.devAddr;
+        std::memcpy(this->m_heldNwkSKey, current.nwkSKey, sizeof(this->m_heldNwkSKey));
+        }
+
+    // true if erase() is keeping the running session from being saved.
+    bool isHeld() const
+        {
+        return this->m_fHeld;
+        }
+
+    // instrumentation
+    std::uint32_t getGeneration() const { return this->m_store.getGeneration(); }
+    std::uint32_t getJournalCount() const { return this->m_store.getJournalCount(); }
+    static constexpr std::uint32_t getJournalCapacity() { return Store::template getJournalCapacity<JournalEntry>(); }
+
+private:
+    static constexpr std::uint32_t kMagic = 0x31534553; // "SES1"
+
+    // journal entries carry their own complement, so an entry torn by a
+    // reset while programming is recognized and skipped.
+    struct JournalEntry
+        {
+        std::uint32_t   seqnoUp;
+        std::uint32_t   seqnoDn;
+        std::uint32_t   notSeqnoUp;
+        std::uint32_t   notSeqnoDn;
+
+        bool isValid() const
+            {
+            return seqnoUp == ~notSeqnoUp && seqnoDn == ~notSeqnoDn;
+            }
+        };
+
+    using Store = cTwoSectorStore<Flash, Session>;
+
+    static_assert(FlashMap::kSessionSectors == Store::kSectors, "the flash map must give the store two sectors");
+
+    // s is the session that was running when the store was erased; once
+    // it isn't, the hold is over.
+    bool isHeld(const Session &s)
+        {
+        if (this->m_fHeld &&
+            (s.devAddr != this->m_heldDevAddr ||
+             std::memcmp(s.nwkSKey, this->m_heldNwkSKey, sizeof(s.nwkSKey)) != 0))
+            this->m_fHeld = false;
+
+        return this->m_fHeld;
+        }
+
+    bool isSameSession(const Session &s) const
+        {
+        Session t = s;
+
+        t.seqnoUp = this->m_session.seqnoUp;
+        t.seqnoDn = this->m_session.seqnoDn;
+        return std::memcmp(&t, &this->m_session, sizeof(t)) == 0;
+        }
+
+    // write a new record; its journal starts empty.
+    void save(const Session &s)
+        {
+        this->m_store.write(s);
+        this->m_session = s;
+        }
+
+    void appendJournal(std::uint32_t seqnoUp, std::uint32_t seqnoDn)
+        {
+        Session s = this->m_session;
+
+        s.seqnoUp = seqnoUp;
+        s.seqnoDn = seqnoDn;
+
+        // when the journal is full, the record takes the counters.
+        if (! this->m_store.appendJournal(JournalEntry { seqnoUp, seqnoDn, ~seqnoUp, ~seqnoDn }))
+            this->m_store.write(s);
+        this->m_session = s;
+        }
+
+    Store           m_store;
+    Session         m_session;
+    std::uint32_t   m_heldDevAddr;
+    std::uint8_t    m_heldNwkSKey[16];
+    bool            m_fHeld;
+    };
+
+} // namespace McciCatena4610
+
+#endif /* _Catena4610_cSessionStore_h_ */
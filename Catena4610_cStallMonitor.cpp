@@ -0,0 +1,77 @@
+/*
+
+Module: Catena4610_cStallMonitor.cpp
+
+Function:
+        cStallMonitor: the independent watchdog.
+
+Copyright:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#include "Catena4610_cStallMonitor.h"
+
+#include <Arduino.h>
+
+using namespace McciCatena4610;
+
+// the IWDG runs from the LSI, which on the STM32L0 may be anywhere from
+// 26 to 56 kHz. The reload is sized for the fastest, so the timeout is
+// never shorter than asked; divided by 256, the 12-bit reload then
+// allows up to about 18 seconds.
+static constexpr std::uint32_t kLsiMaxHz = 56000;
+static constexpr std::uint32_t kPrescalerDiv256 = 6;
+static constexpr std::uint32_t kMaxReload = 0xFFF;
+
+static constexpr std::uint32_t kKeyStart = 0xCCCC;
+static constexpr std::uint32_t kKeyUnlock = 0x5555;
+static constexpr std::uint32_t kKeyReload = 0xAAAA;
+
+/*
+
+Name:   McciCatena4610::cStallMonitor::startWatchdog()
+
+Function:
+        Start the independent watchdog.
+
+Definition:
+        static void McciCatena4610::cStallMonitor::startWatchdog(
+                std::uint32_t ms
+                );
+
+Description:
+        Starts the IWDG, with a timeout of at least ms (at most about 18
+        seconds). The LSI isn't trimmed, so with a slow one the timeout
+        may be up to about twice that. Once started it can't be stopped,
+        and it keeps running in Stop mode, so it's only to be used
+        without deep sleep.
+
+Returns:
+        No explicit result.
+
+*/
+
+void cStallMonitor::startWatchdog(std::uint32_t ms)
+    {
+    std::uint32_t reload = std::uint32_t(std::uint64_t(ms) * kLsiMaxHz / 256 / 1000);
+
+    if (reload > kMaxReload)
+        reload = kMaxReload;
+
+    IWDG->KR = kKeyStart;
+    IWDG->KR = kKeyUnlock;
+    IWDG->PR = kPrescalerDiv256;
+    IWDG->RLR = reload;
+    while (IWDG->SR != 0)
+        /* wait for the registers to update */;
+    IWDG->KR = kKeyReload;
+    }
+
+void cStallMonitor::kickWatchdog()
+    {
+    IWDG->KR = kKeyReload;
+    }
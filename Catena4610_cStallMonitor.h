@@ -0,0 +1,311 @@
+/*
+
+Module: Catena4610_cStallMonitor.h
+
+Function:
+        cStallMonitor: find the loop iterations that take too long, and
+        what they were doing.
+
+Copyright:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#ifndef _Catena4610_cStallMonitor_h_
+# define _Catena4610_cStallMonitor_h_
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace McciCatena4610 {
+
+/****************************************************************************\
+|
+|   The stall monitor.
+|
+|   loop() brackets each pass of gCatena.poll() with beginIteration() and
+|   endIteration(); the time between them is the time the loop couldn't
+|   respond. Code that may block for long marks itself with enter() and
+|   leave(), naming a Site; the time in each site is counted exclusive of
+|   the sites entered from it. An iteration of kStallMs or more is a stall:
+|   it's charged to the site that took most of it, with the FSM state
+|   when that site was entered, and the kRecords worst are kept.
+|
+|   The watchdog is kicked at the end of each iteration shorter than
+|   kHealthyMs, and only then: a hung loop never gets there, and a loop
+|   that stalls for kHealthyMs twice in a row is reset. A site that
+|   legitimately runs for longer (the transmit spin, through a join or a
+|   duty-cycle wait) calls progress() on each pass; that kicks too, if
+|   the pass since the last kick was shorter than kHealthyMs, so only the
+|   time between marks counts.
+|
+|   The clock and the FSM state are functions passed to begin(), and the
+|   kick one passed to setKick(), so a host test can drive all of it; only
+|   startWatchdog() and kickWatchdog() touch the hardware.
+|
+\****************************************************************************/
+
+class cStallMonitor
+    {
+public:
+    enum class Site : std::uint8_t
+        {
+        kLoop,          // gCatena.poll(), not otherwise marked
+        kSetup,         // setup()
+        kUsbWait,       // waiting for USB at startup
+        kFsm,           // the measurement FSM
+        kTxSpin,        // running the LMIC until a transmission is done
+        kCounters,      // saving the touch counters
+        kCount
+        };
+
+    static constexpr std::size_t kSites = std::size_t(Site::kCount);
+    static constexpr std::size_t kRecords = 8;
+
+    static constexpr std::uint32_t kStallMs = 100;
+    static constexpr std::uint32_t kHealthyMs = 8000;
+    // the watchdog must outlast two healthy iterations.
+    static constexpr std::uint32_t kWatchdogMs = 2 * kHealthyMs;
+
+    // milliseconds; the FSM state; kick the watchdog.
+    using ClockFn = std::uint32_t (*)();
+    using StateFn = std::uint8_t (*)();
+    using KickFn = void (*)();
+
+    struct Record
+        {
+        std::uint32_t   ms;             // length of the iteration
+        std::uint32_t   tStart;         // when it started
+        Site            site;           // where most of it went
+        std::uint8_t    state;          // FSM state on entering the site
+        };
+
+    struct Stats
+        {
+        std::uint32_t   nIterations;
+        std::uint32_t   nStalls;        // iterations of kStallMs or more
+        std::uint32_t   nKicks;         // watchdog kicks
+        std::uint32_t   nMissedKicks;   // iterations (or passes) too long to kick
+        std::uint32_t   msMax;          // longest iteration
+        };
+
+    cStallMonitor()
+        : m_pClock(nullptr)
+        , m_pState(nullptr)
+        , m_pKick(nullptr)
+        , m_site(Site::kLoop)
+        , m_fInIteration(false)
+        , m_tStart(0)
+        , m_tCharged(0)
+        , m_tProgress(0)
+        , m_nRecords(0)
+        , m_stats {}
+        , m_siteMs {}
+        , m_siteState {}
+        , m_records {}
+        {}
+
+    // neither copyable nor movable
+    cStallMonitor(const cStallMonitor&) = delete;
+    cStallMonitor& operator=(const cStallMonitor&) = delete;
+    cStallMonitor(const cStallMonitor&&) = delete;
+    cStallMonitor& operator=(const cStallMonitor&&) = delete;
+
+    static const char *getSiteName(Site s)
+        {
+        switch (s)
+            {
+        case Site::kLoop:       return "loop";
+        case Site::kSetup:      return "setup";
+        case Site::kUsbWait:    return "usbwait";
+        case Site::kFsm:        return "fsm";
+        case Site::kTxSpin:     return "txspin";
+        case Site::kCounters:   return "counters";
+        default:                return "<<unknown>>";
+            }
+        }
+
+    void begin(ClockFn pClock, StateFn pState)
+        {
+        this->m_pClock = pClock;
+        this->m_pState = pState;
+        }
+
+    // kick the watchdog with pKick from now on.
+    void setKick(KickFn pKick)
+        {
+        this->m_pKick = pKick;
+        }
+
+    void beginIteration(Site base = Site::kLoop)
+        {
+        std::uint32_t const tNow = this->m_pClock();
+
+        this->m_fInIteration = true;
+        this->m_tStart = this->m_tCharged = this->m_tProgress = tNow;
+        this->m_site = base;
+        for (auto &ms : this->m_siteMs)
+            ms = 0;
+        this->m_siteState[unsigned(base)] = this->m_pState();
+        }
+
+    // mark the start of a site; pass the result to leave().
+    Site enter(Site s)
+        {
+        Site const previous = this->m_site;
+
+        this->m_site = s;
+        if (this->m_fInIteration)
+            {
+            this->charge(previous);
+            this->m_siteState[unsigned(s)] = this->m_pState();
+            }
+        return previous;
+        }
+
+    void leave(Site previous)
+        {
+        if (this->m_fInIteration)
+            this->charge(this->m_site);
+        this->m_site = previous;
+        }
+
+    // a long-running site is still making progress; kick the watchdog if
+    // the time since the last kick was healthy.
+    void progress()
+        {
+        if (! this->m_fInIteration || this->m_pKick == nullptr)
+            return;
+
+        std::uint32_t const tNow = this->m_pClock();
+
+        if (tNow - this->m_tProgress < kHealthyMs)
+            {
+            this->m_pKick();
+            ++this->m_stats.nKicks;
+            }
+        else
+            ++this->m_stats.nMissedKicks;
+        this->m_tProgress = tNow;
+        }
+
+    void endIteration()
+        {
+        if (! this->m_fInIteration)
+            return;
+
+        this->charge(this->m_site);
+        this->m_fInIteration = false;
+
+        std::uint32_t const ms = this->m_tCharged - this->m_tStart;
+        auto &stats = this->m_stats;
+
+        ++stats.nIterations;
+        if (ms > stats.msMax)
+            stats.msMax = ms;
+
+        if (ms >= kStallMs)
+            {
+            ++stats.nStalls;
+            this->record(ms);
+            }
+
+        if (this->m_pKick == nullptr)
+            return;
+
+        if (this->m_tCharged - this->m_tProgress < kHealthyMs)
+            {
+            this->m_pKick();
+            ++stats.nKicks;
+            }
+        else
+            ++stats.nMissedKicks;
+        }
+
+    // the worst stalls, longest first.
+    std::size_t getCount() const
+        {
+        return this->m_nRecords;
+        }
+
+    const Record &getRecord(std::size_t i) const
+        {
+        return this->m_records[i < this->m_nRecords ? i : 0];
+        }
+
+    const Stats &getStats() const
+        {
+        return this->m_stats;
+        }
+
+    void resetStats()
+        {
+        this->m_stats = Stats {};
+        this->m_nRecords = 0;
+        }
+
+    // start the IWDG with a timeout of ms; it can't be stopped again.
+    static void startWatchdog(std::uint32_t ms);
+    static void kickWatchdog();
+
+private:
+    // charge the time since the last change of site to site s.
+    void charge(Site s)
+        {
+        std::uint32_t const tNow = this->m_pClock();
+
+        this->m_siteMs[unsigned(s)] += tNow - this->m_tCharged;
+        this->m_tCharged = tNow;
+        }
+
+    // keep the stall if it's among the worst.
+    void record(std::uint32_t ms)
+        {
+        std::size_t n = this->m_nRecords;
+
+        if (n == kRecords)
+            {
+            if (ms <= this->m_records[n - 1].ms)
+                return;
+            --n;
+            }
+
+        std::size_t worst = 0;
+        for (std::size_t s = 1; s < kSites; ++s)
+            {
+            if (this->m_siteMs[s] > this->m_siteMs[worst])
+                worst = s;
+            }
+
+        // insertion, keeping the records longest first.
+        std::size_t i = n;
+        for (; i > 0 && this->m_records[i - 1].ms < ms; --i)
+            this->m_records[i] = this->m_records[i - 1];
+
+        this->m_records[i] = Record { ms, this->m_tStart, Site(worst), this->m_siteState[worst] };
+        this->m_nRecords = n + 1;
+        }
+
+    ClockFn                 m_pClock;
+    StateFn                 m_pState;
+    KickFn                  m_pKick;
+    Site                    m_site;
+    bool                    m_fInIteration;
+    std::uint32_t           m_tStart;
+    std::uint32_t           m_tCharged;
+    std::uint32_t           m_tProgress;
+    std::uint8_t            m_nRecords;
+    Stats                   m_stats;
+    std::uint32_t           m_siteMs[kSites];
+    std::uint8_t            m_siteState[kSites];
+    Record                  m_records[kRecords];
+    };
+
+} // namespace McciCatena4610
+
+#endif /* _Catena4610_cStallMonitor_h_ */
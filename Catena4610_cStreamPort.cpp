@@ -0,0 +1,78 @@
+/*
+
+Module: Catena4610_cStreamPort.cpp
+
+Function:
+        Send the sample stream to the serial port.
+
+Copyright:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#include "Catena4610_cStreamPort.h"
+
+#include <TouchSense-Lorawan.h>
+
+using namespace McciCatena4610;
+using namespace McciCatena;
+
+void cStreamPort::begin()
+    {
+    if (this->m_fRegistered)
+        return;
+
+    this->m_fRegistered = true;
+    gCatena.registerObject(this);
+    gIdleScheduler.registerSource(this);
+    }
+
+void cStreamPort::start()
+    {
+    this->m_tStart = millis();
+    this->m_fVbusSent = false;
+    this->m_stream.start();
+    }
+
+void cStreamPort::stop()
+    {
+    if (! this->m_stream.isRunning())
+        return;
+
+    this->m_tStop = millis();
+    this->m_stream.stop();
+    }
+
+void cStreamPort::poll()
+    {
+    std::uint8_t buf[cSampleStream::kMaxEncodedBytes];
+
+    // drain what was queued, even after stop().
+    while (! this->m_stream.isEmpty() &&
+           Serial.availableForWrite() >= int(sizeof(buf)))
+        {
+        std::size_t const nBuf = this->m_stream.getFrame(buf);
+
+        Serial.write(buf, nBuf);
+        }
+
+    // note when the port last turned frames away.
+    this->m_tBlocked = millis();
+    this->m_fBlocked = ! this->m_stream.isEmpty();
+    }
+
+// samples the port hasn't seen yet are due now; samples it turned away
+// are tried again kRetryMs later.
+bool cStreamPort::getNextDeadline(std::uint32_t tNow, std::uint32_t &msRemaining)
+    {
+    if (this->m_stream.isEmpty())
+        return false;
+
+    std::uint32_t const msBlocked = tNow - this->m_tBlocked;
+
+    msRemaining = (! this->m_fBlocked || msBlocked >= kRetryMs) ? 0 : kRetryMs - msBlocked;
+    return true;
+    }
@@ -0,0 +1,126 @@
+/*
+
+Module: Catena4610_cStreamPort.h
+
+Function:
+        cStreamPort: send the sample stream to the serial port.
+
+Copyright:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#ifndef _Catena4610_cStreamPort_h_
+# define _Catena4610_cStreamPort_h_
+
+#pragma once
+
+#include <Catena_PollableInterface.h>
+
+#include "Catena4610_cIdleScheduler.h"
+#include "Catena4610_cSampleStream.h"
+
+namespace McciCatena4610 {
+
+/****************************************************************************\
+|
+|   Glue between the sample stream and the USB serial port.
+|
+|   Frames are written whole, and only when the port can take a whole
+|   frame without waiting, so neither the sampling path nor the poll loop
+|   ever blocks on the host. If the host doesn't keep up, the ring fills
+|   and samples are dropped (and counted).
+|
+\****************************************************************************/
+
+class cStreamPort : public McciCatena::cPollableObject,
+                    public cDeadlineSource
+    {
+public:
+    // while samples are waiting for room in the port, try this often.
+    static constexpr std::uint32_t kRetryMs = 2;
+    // smallest change in bus voltage that's sent.
+    static constexpr std::uint16_t kVbusDeltaMv = 100;
+
+    cStreamPort()
+        : m_tStart(0)
+        , m_tStop(0)
+        , m_tBlocked(0)
+        , m_lastVbusMv(0)
+        , m_fRegistered(false)
+        , m_fVbusSent(false)
+        , m_fBlocked(false)
+        {}
+
+    // neither copyable nor movable
+    cStreamPort(const cStreamPort&) = delete;
+    cStreamPort& operator=(const cStreamPort&) = delete;
+    cStreamPort(const cStreamPort&&) = delete;
+    cStreamPort& operator=(const cStreamPort&&) = delete;
+
+    void begin();
+    void start();
+    void stop();
+
+    bool isRunning() const
+        {
+        return this->m_stream.isRunning();
+        }
+
+    // called from the sampling path.
+    void push(std::uint32_t tMs, std::int16_t ch1, std::int16_t ch2, std::int16_t amplitude)
+        {
+        this->m_stream.push(cSampleStream::Sample { tMs, cSampleStream::Kind::kSample, ch1, ch2, amplitude });
+        }
+
+    // voltage readings, for replay.
+    void pushVbat(std::uint32_t tMs, std::uint16_t mV)
+        {
+        this->m_stream.push(cSampleStream::Sample { tMs, cSampleStream::Kind::kVbat, std::int16_t(mV), 0, 0 });
+        }
+
+    // bus voltage is read on every poll; only changes of kVbusDeltaMv or
+    // more are sent.
+    void pushVbus(std::uint32_t tMs, std::uint16_t mV)
+        {
+        std::uint16_t const delta = mV > this->m_lastVbusMv ? mV - this->m_lastVbusMv : this->m_lastVbusMv - mV;
+
+        if (this->m_fVbusSent && delta < kVbusDeltaMv)
+            return;
+
+        this->m_lastVbusMv = mV;
+        this->m_fVbusSent = true;
+        this->m_stream.push(cSampleStream::Sample { tMs, cSampleStream::Kind::kVbus, std::int16_t(mV), 0, 0 });
+        }
+
+    const cSampleStream::Stats &getStats() const
+        {
+        return this->m_stream.getStats();
+        }
+
+    // time streamed, in milliseconds.
+    std::uint32_t getElapsedMs(std::uint32_t tNow) const
+        {
+        return (this->isRunning() ? tNow : this->m_tStop) - this->m_tStart;
+        }
+
+    virtual void poll() override;
+    virtual bool getNextDeadline(std::uint32_t tNow, std::uint32_t &msRemaining) override;
+
+private:
+    cSampleStream   m_stream;
+    std::uint32_t   m_tStart;
+    std::uint32_t   m_tStop;
+    std::uint32_t   m_tBlocked;     // when poll() last left frames queued
+    std::uint16_t   m_lastVbusMv;
+    bool            m_fRegistered;
+    bool            m_fVbusSent;
+    bool            m_fBlocked;
+    };
+
+} // namespace McciCatena4610
+
+#endif /* _Catena4610_cStreamPort_h_ */
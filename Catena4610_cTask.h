@@ -0,0 +1,119 @@
+/*
+
+Module: Catena4610_cTask.h
+
+Function:
+        cTask: stackless cooperative tasks (protothreads).
+
+Copyright:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#ifndef _Catena4610_cTask_h_
+# define _Catena4610_cTask_h_
+
+#pragma once
+
+#include <cstdint>
+
+namespace McciCatena4610 {
+
+/****************************************************************************\
+|
+|   Stackless tasks.
+|
+|   A task is a method that is called repeatedly from a poll() routine and
+|   returns true once it has run to completion. Between TASK_BEGIN() and
+|   TASK_END() it is written as straight-line code; TASK_YIELD(),
+|   TASK_WAIT_UNTIL() and TASK_DELAY() return to the caller, and the next
+|   call resumes at the same place. The resume point is kept in a cTask
+|   object (a few bytes); no stack or heap is used.
+|
+|   Because resuming is done with a switch statement:
+|   - local variables do not survive a wait; keep state in members.
+|   - a task body must not itself contain a switch statement.
+|   - only one wait per source line.
+|
+|   The time used by TASK_DELAY() is an expression evaluated at each
+|   resume, normally millis(); a host build can supply a simulated clock.
+|
+\****************************************************************************/
+
+class cTask
+    {
+public:
+    cTask()
+        : m_line(0)
+        , m_tStart(0)
+        , m_msDelay(0)
+        {}
+
+    // arrange for the next call to start from the top.
+    void reset()
+        {
+        this->m_line = 0;
+        }
+
+    // true if the task has started and not yet finished.
+    bool isRunning() const
+        {
+        return this->m_line != 0;
+        }
+
+    // milliseconds until the task next needs to run: what's left of a
+    // TASK_DELAY(), otherwise zero.
+    std::uint32_t getRemaining(std::uint32_t tNow) const
+        {
+        std::uint32_t const elapsed = tNow - this->m_tStart;
+
+        return elapsed < this->m_msDelay ? this->m_msDelay - elapsed : 0;
+        }
+
+    // the rest is for use by the TASK_xxx() macros only.
+    std::uint16_t   m_line;         // resume point: source line, or 0.
+    std::uint32_t   m_tStart;       // TASK_DELAY(): start time
+    std::uint32_t   m_msDelay;      // TASK_DELAY(): duration
+    };
+
+#define TASK_BEGIN(t)                                                   \
+        switch ((t).m_line) { case 0:
+
+#define TASK_YIELD(t)                                                   \
+        do  {                                                           \
+            (t).m_msDelay = 0;                                          \
+            (t).m_line = __LINE__;                                      \
+            return false;                                               \
+            case __LINE__:;                                             \
+            } while (0)
+
+#define TASK_WAIT_UNTIL_(t, cond)                                       \
+        do  {                                                           \
+            (t).m_line = __LINE__;                                      \
+            case __LINE__:                                              \
+            if (! (cond))                                               \
+                return false;                                           \
+            } while (0)
+
+#define TASK_WAIT_UNTIL(t, cond)                                        \
+        do  {                                                           \
+            (t).m_msDelay = 0;                                          \
+            TASK_WAIT_UNTIL_(t, cond);                                  \
+            } while (0)
+
+#define TASK_DELAY(t, now, ms)                                          \
+        do  {                                                           \
+            (t).m_tStart = (now);                                       \
+            (t).m_msDelay = (ms);                                       \
+            TASK_WAIT_UNTIL_(t, std::uint32_t((now) - (t).m_tStart) >= (t).m_msDelay); \
+            } while (0)
+
+#define TASK_END(t)                                                     \
+        } (t).m_line = 0; return true
+
+} // namespace McciCatena4610
+
+#endif /* _Catena4610_cTask_h_ */
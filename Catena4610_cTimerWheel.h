@@ -0,0 +1,238 @@
+/*
+
+Module: Catena4610_cTimerWheel.h
+
+Function:
+        cTimerWheel: a fixed set of named timeouts on a hashed timer wheel.
+
+Copyright:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#ifndef _Catena4610_cTimerWheel_h_
+# define _Catena4610_cTimerWheel_h_
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace McciCatena4610 {
+
+/****************************************************************************\
+|
+|   The timer wheel.
+|
+|   There is one timer per value of the enum Id (which must end with
+|   kCount), so a timer is named rather than allocated. Armed timers are
+|   kept in doubly-linked lists, one per wheel bucket; the bucket is the
+|   expiry tick modulo the number of buckets. Arming and cancelling are
+|   O(1). advance() visits only the buckets for the ticks that have gone
+|   by, and expires every due timer in them in one pass, returning a
+|   bitmask of the timers that fired; the "fired" flags are held until
+|   consumed by timedOut().
+|
+|   All comparisons are on signed differences of millis() values, and the
+|   tick size and bucket count are powers of two, so the wheel is correct
+|   across the 49.7-day wrap of millis(). Delays must be less than 2^31 ms.
+|
+|   Nothing here touches the hardware: the caller passes in the time.
+|
+\****************************************************************************/
+
+template <typename Id, std::size_t a_nBuckets = 16, std::uint32_t a_msPerTick = 64>
+class cTimerWheel
+    {
+public:
+    static constexpr std::size_t kTimers = std::size_t(Id::kCount);
+    static constexpr std::size_t kBuckets = a_nBuckets;
+    static constexpr std::uint32_t kMsPerTick = a_msPerTick;
+
+    static_assert(kTimers > 0 && kTimers <= 32, "1 to 32 timers supported");
+    static_assert((kBuckets & (kBuckets - 1)) == 0, "bucket count must be a power of two");
+    static_assert((kMsPerTick & (kMsPerTick - 1)) == 0, "tick size must be a power of two");
+
+    using Mask = std::uint32_t;
+
+    cTimerWheel()
+        : m_armed(0)
+        , m_fired(0)
+        , m_lastTick(0)
+        , m_fStarted(false)
+        {
+        for (auto &head : this->m_buckets)
+            head = kNone;
+        }
+
+    // neither copyable nor movable
+    cTimerWheel(const cTimerWheel&) = delete;
+    cTimerWheel& operator=(const cTimerWheel&) = delete;
+    cTimerWheel(const cTimerWheel&&) = delete;
+    cTimerWheel& operator=(const cTimerWheel&&) = delete;
+
+    static constexpr Mask bit(Id id)
+        {
+        return Mask(1) << unsigned(id);
+        }
+
+    // (re)arm a timer to fire ms milliseconds after tNow.
+    void arm(Id id, std::uint32_t tNow, std::uint32_t ms)
+        {
+        this->cancel(id);
+
+        if (! this->m_fStarted)
+            {
+            this->m_lastTick = tNow / kMsPerTick;
+            this->m_fStarted = true;
+            }
+
+        auto &t = this->m_timers[unsigned(id)];
+        t.expiry = tNow + ms;
+        this->link(unsigned(id), this->bucketOf(t.expiry));
+        this->m_armed |= bit(id);
+        }
+
+    // stop a timer and forget that it fired.
+    void cancel(Id id)
+        {
+        if (this->m_armed & bit(id))
+            this->unlink(unsigned(id));
+
+        this->m_armed &= ~bit(id);
+        this->m_fired &= ~bit(id);
+        }
+
+    bool isArmed(Id id) const
+        {
+        return (this->m_armed & bit(id)) != 0;
+        }
+
+    // test and clear the fired flag of a timer.
+    bool timedOut(Id id)
+        {
+        bool const result = (this->m_fired & bit(id)) != 0;
+
+        this->m_fired &= ~bit(id);
+        return result;
+        }
+
+    // expire all timers that are due; returns the mask of those that fired
+    // during this call.
+    Mask advance(std::uint32_t tNow)
+        {
+        if (this->m_armed == 0)
+            {
+            this->m_lastTick = tNow / kMsPerTick;
+            return 0;
+            }
+
+        std::uint32_t const nowTick = tNow / kMsPerTick;
+        std::uint32_t nTicks = nowTick - this->m_lastTick;
+        Mask fired = 0;
+
+        // visit the current bucket again, as timers due later in the
+        // current tick share it; and never visit a bucket twice.
+        if (nTicks >= kBuckets)
+            nTicks = kBuckets - 1;
+
+        for (std::uint32_t i = 0; i <= nTicks; ++i)
+            {
+            unsigned iTimer = this->m_buckets[(nowTick - i) % kBuckets];
+
+            while (iTimer != kNone)
+                {
+                unsigned const iNext = this->m_timers[iTimer].next;
+
+                if (std::int32_t(tNow - this->m_timers[iTimer].expiry) >= 0)
+                    {
+                    this->unlink(iTimer);
+                    fired |= Mask(1) << iTimer;
+                    }
+                iTimer = iNext;
+                }
+            }
+
+        this->m_lastTick = nowTick;
+        this->m_armed &= ~fired;
+        this->m_fired |= fired;
+        return fired;
+        }
+
+    // time until the earliest armed timer fires. Returns false if none
+    // is armed.
+    bool getNextDeadline(std::uint32_t tNow, std::uint32_t &msRemaining) const
+        {
+        bool fAny = false;
+
+        msRemaining = 0;
+        for (unsigned i = 0; i < kTimers; ++i)
+            {
+            if (! (this->m_armed & (Mask(1) << i)))
+                continue;
+
+            std::int32_t const delta = std::int32_t(this->m_timers[i].expiry - tNow);
+            std::uint32_t const ms = delta > 0 ? std::uint32_t(delta) : 0;
+
+            if (! fAny || ms < msRemaining)
+                msRemaining = ms;
+            fAny = true;
+            }
+        return fAny;
+        }
+
+private:
+    static constexpr std::uint8_t kNone = 0xFF;
+
+    struct Timer
+        {
+        std::uint32_t   expiry;
+        std::uint8_t    next;
+        std::uint8_t    prev;
+        std::uint8_t    bucket;
+        };
+
+    static unsigned bucketOf(std::uint32_t expiry)
+        {
+        return (expiry / kMsPerTick) % kBuckets;
+        }
+
+    void link(unsigned i, unsigned iBucket)
+        {
+        auto &t = this->m_timers[i];
+
+        t.bucket = std::uint8_t(iBucket);
+        t.prev = kNone;
+        t.next = this->m_buckets[iBucket];
+        if (t.next != kNone)
+            this->m_timers[t.next].prev = std::uint8_t(i);
+        this->m_buckets[iBucket] = std::uint8_t(i);
+        }
+
+    void unlink(unsigned i)
+        {
+        auto &t = this->m_timers[i];
+
+        if (t.prev != kNone)
+            this->m_timers[t.prev].next = t.next;
+        else
+            this->m_buckets[t.bucket] = t.next;
+
+        if (t.next != kNone)
+            this->m_timers[t.next].prev = t.prev;
+        }
+
+    Mask            m_armed;
+    Mask            m_fired;
+    std::uint32_t   m_lastTick;
+    bool            m_fStarted;
+    std::uint8_t    m_buckets[kBuckets];
+    Timer           m_timers[kTimers];
+    };
+
+} // namespace McciCatena4610
+
+#endif /* _Catena4610_cTimerWheel_h_ */
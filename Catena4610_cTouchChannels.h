@@ -0,0 +1,166 @@
+/*
+
+Module: Catena4610_cTouchChannels.h
+
+Function:
+        cTouchChannels: per-channel handling of IQS620A readings, for a
+        channel count fixed at compile time.
+
+Copyright:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#ifndef _Catena4610_cTouchChannels_h_
+# define _Catena4610_cTouchChannels_h_
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace McciCatena4610 {
+
+/****************************************************************************\
+|
+|   The touch channels.
+|
+|   Readings are kept in fixed-size arrays, indexed by channel:
+|
+|       0       IQS620A channel 1, the right side
+|       1       IQS620A channel 2, the left side
+|       2       IQS620A channel 0 (3-channel builds only)
+|
+|   so the first two channels are the same in every build. Per-channel
+|   work is done by forEach(), which the compiler unrolls completely: a
+|   template recursion, not a loop, so every index is a constant and the
+|   arrays stay in registers. That makes a 2-channel instance cost the
+|   same as code written out for Ch1 and Ch2.
+|
+|   Nothing here touches the hardware except through read(), which takes
+|   the sensor as a template parameter, so the host tools in extra/ can
+|   use the rest.
+|
+\****************************************************************************/
+
+template <std::size_t a_nChannels>
+class cTouchChannels
+    {
+    static_assert(a_nChannels >= 2 && a_nChannels <= 3, "the IQS620A has 2 or 3 touch channels");
+
+public:
+    static constexpr std::size_t kChannels = a_nChannels;
+
+    using Readings = std::array<std::int16_t, a_nChannels>;
+    using Thresholds = std::array<std::uint16_t, a_nChannels>;
+
+    // call f(i) for each channel i, in order.
+    template <typename F>
+    static void forEach(F &&f)
+        {
+        Unroll<0>::apply(f);
+        }
+
+    // fetch the latest results of an iqsRead().
+    template <typename Sensor>
+    static void read(Sensor &sensor, Readings &r)
+        {
+        Reader<0>::apply(sensor, r);
+        }
+
+    // true if no channel moved more than delta.
+    static bool isStable(const Readings &now, const Readings &last, std::int16_t delta)
+        {
+        bool fStable = true;
+
+        forEach([&](std::size_t i)
+            {
+            // |d| <= delta, as one unsigned compare.
+            std::int32_t const d = std::int32_t(now[i]) - last[i];
+
+            fStable &= std::uint32_t(d + delta) <= std::uint32_t(2 * delta);
+            });
+        return fStable;
+        }
+
+    // a bitmap of the channels reading below their thresholds, each
+    // raised by hysteresis.
+    static std::uint8_t below(const Readings &r, const Thresholds &thresholds, std::uint16_t hysteresis = 0)
+        {
+        std::uint8_t mask = 0;
+
+        forEach([&](std::size_t i)
+            {
+            mask |= std::uint8_t(std::int32_t(r[i]) < std::int32_t(thresholds[i]) + hysteresis) << i;
+            });
+        return mask;
+        }
+
+private:
+    template <std::size_t a_i, bool a_fDone = (a_i == a_nChannels)>
+    struct Unroll
+        {
+        template <typename F>
+        static void apply(F &f)
+            {
+            f(a_i);
+            Unroll<a_i + 1>::apply(f);
+            }
+        };
+
+    template <std::size_t a_i>
+    struct Unroll<a_i, true>
+        {
+        template <typename F>
+        static void apply(F &)
+            {}
+        };
+
+    // the sensor is a template parameter, so getCh0Data() is only
+    // needed by 3-channel builds.
+    template <typename Sensor>
+    static std::int16_t get(Sensor &sensor, std::integral_constant<std::size_t, 0>)
+        {
+        return sensor.getCh1Data();
+        }
+
+    template <typename Sensor>
+    static std::int16_t get(Sensor &sensor, std::integral_constant<std::size_t, 1>)
+        {
+        return sensor.getCh2Data();
+        }
+
+    template <typename Sensor>
+    static std::int16_t get(Sensor &sensor, std::integral_constant<std::size_t, 2>)
+        {
+        return sensor.getCh0Data();
+        }
+
+    template <std::size_t a_i, bool a_fDone = (a_i == a_nChannels)>
+    struct Reader
+        {
+        template <typename Sensor>
+        static void apply(Sensor &sensor, Readings &r)
+            {
+            r[a_i] = get(sensor, std::integral_constant<std::size_t, a_i>());
+            Reader<a_i + 1>::apply(sensor, r);
+            }
+        };
+
+    template <std::size_t a_i>
+    struct Reader<a_i, true>
+        {
+        template <typename Sensor>
+        static void apply(Sensor &, Readings &)
+            {}
+        };
+    };
+
+} // namespace McciCatena4610
+
+#endif /* _Catena4610_cTouchChannels_h_ */
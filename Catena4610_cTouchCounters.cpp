@@ -0,0 +1,121 @@
+/*
+
+Module: Catena4610_cTouchCounters.cpp
+
+Function:
+        cTouchCounters: lifetime touch counters, persisted in flash.
+
+Copyright:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#include "Catena4610_cTouchCounters.h"
+
+using namespace McciCatena4610;
+using namespace McciCatena;
+
+void cTouchCounters::begin()
+    {
+    Journal::Record r {};
+
+    this->m_fEnabled = true;
+
+    this->m_power.acquire(cPowerManager::Peripheral::kFlash);
+    bool const fFound = this->m_journal.begin() && this->m_journal.getRecord(r);
+    this->m_power.release(cPowerManager::Peripheral::kFlash);
+
+    if (! fFound)
+        return;
+
+    this->m_left = this->m_savedLeft = r.left;
+    this->m_right = this->m_savedRight = r.right;
+    this->m_ackedLeft = r.left - r.unackedLeft;
+    this->m_ackedRight = r.right - r.unackedRight;
+    }
+
+void cTouchCounters::count(bool fLeft, bool fRight)
+    {
+    if (fLeft)
+        ++this->m_left;
+    if (fRight)
+        ++this->m_right;
+    }
+
+void cTouchCounters::getUnacked(std::uint16_t &left, std::uint16_t &right) const
+    {
+    left = saturate(this->m_left - this->m_ackedLeft);
+    right = saturate(this->m_right - this->m_ackedRight);
+    }
+
+void cTouchCounters::startSend(std::uint16_t left, std::uint16_t right)
+    {
+    this->m_sendingLeft = left;
+    this->m_sendingRight = right;
+    this->m_fSending = true;
+    }
+
+void cTouchCounters::sendDone(bool fSuccess)
+    {
+    if (! this->m_fSending)
+        return;
+
+    this->m_fSending = false;
+    if (! fSuccess || (this->m_sendingLeft | this->m_sendingRight) == 0)
+        return;
+
+    // a saturated value leaves the rest for the next uplink.
+    this->m_ackedLeft += this->m_sendingLeft;
+    this->m_ackedRight += this->m_sendingRight;
+    this->m_fAckPending = true;
+    }
+
+bool cTouchCounters::isFlushDue() const
+    {
+    return this->m_fEnabled &&
+           (this->m_fAckPending ||
+            this->m_left - this->m_savedLeft >= kBatch ||
+            this->m_right - this->m_savedRight >= kBatch);
+    }
+
+void cTouchCounters::flush(bool fForce)
+    {
+    bool const fChanged =
+        this->m_fAckPending ||
+        this->m_left != this->m_savedLeft ||
+        this->m_right != this->m_savedRight;
+
+    if (! this->m_fEnabled || ! (this->isFlushDue() || (fForce && fChanged)))
+        return;
+
+    Journal::Record r {};
+    r.left = this->m_left;
+    r.right = this->m_right;
+    this->getUnacked(r.unackedLeft, r.unackedRight);
+
+    this->m_power.acquire(cPowerManager::Peripheral::kFlash);
+    this->m_journal.append(r);
+    this->m_power.release(cPowerManager::Peripheral::kFlash);
+
+    this->m_savedLeft = this->m_left;
+    this->m_savedRight = this->m_right;
+    this->m_fAckPending = false;
+    }
+
+void cTouchCounters::erase()
+    {
+    this->m_left = this->m_right = 0;
+    this->m_ackedLeft = this->m_ackedRight = 0;
+    this->m_savedLeft = this->m_savedRight = 0;
+    this->m_fAckPending = false;
+
+    if (! this->m_fEnabled)
+        return;
+
+    this->m_power.acquire(cPowerManager::Peripheral::kFlash);
+    this->m_journal.erase();
+    this->m_power.release(cPowerManager::Peripheral::kFlash);
+    }
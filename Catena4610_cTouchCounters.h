@@ -0,0 +1,144 @@
+/*
+
+Module: Catena4610_cTouchCounters.h
+
+Function:
+        cTouchCounters: lifetime touch counters, persisted in flash.
+
+Copyright:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#ifndef _Catena4610_cTouchCounters_h_
+# define _Catena4610_cTouchCounters_h_
+
+#pragma once
+
+#include <Catena_Mx25v8035f.h>
+
+#include "Catena4610_cCounterJournal.h"
+#include "Catena4610_cPowerManager.h"
+
+namespace McciCatena4610 {
+
+/****************************************************************************\
+|
+|   Lifetime touch counters.
+|
+|   Touches are counted in 32-bit lifetime counters that survive resets.
+|   Uplinks carry the touches not yet covered by a completed uplink: the
+|   values are taken when the frame is handed to the LMIC (not when it is
+|   queued), and are marked as sent only when the uplink completes. A
+|   failed uplink's touches are therefore carried by the next one, and
+|   the network side can simply add up the values it receives.
+|
+|   The counters are journaled to flash in batches: when either has
+|   advanced by kBatch since the last write, when an uplink completes,
+|   and before deep sleep. count() and sendDone() only note that a write
+|   is due; the owner's poll() calls flush(), so flash is never
+|   programmed from the sampling path or the LMIC callback. A reset
+|   loses at most kBatch - 1 touches per side (plus any not yet
+|   flushed). Without flash, the counters work but are lost at reset.
+|
+\****************************************************************************/
+
+class cTouchCounters
+    {
+public:
+    using Journal = cCounterJournal<McciCatena::Catena_Mx25v8035f>;
+
+    // touches per side between journal writes.
+    static constexpr std::uint32_t kBatch = 16;
+
+    cTouchCounters(McciCatena::Catena_Mx25v8035f &flash, cPowerManager &power)
+        : m_power(power)
+        , m_journal(flash)
+        , m_left(0)
+        , m_right(0)
+        , m_ackedLeft(0)
+        , m_ackedRight(0)
+        , m_savedLeft(0)
+        , m_savedRight(0)
+        , m_sendingLeft(0)
+        , m_sendingRight(0)
+        , m_fEnabled(false)
+        , m_fSending(false)
+        , m_fAckPending(false)
+        {}
+
+    // neither copyable nor movable
+    cTouchCounters(const cTouchCounters&) = delete;
+    cTouchCounters& operator=(const cTouchCounters&) = delete;
+    cTouchCounters(const cTouchCounters&&) = delete;
+    cTouchCounters& operator=(const cTouchCounters&&) = delete;
+
+    // call once the flash is known to be present; reads the counters.
+    void begin();
+
+    // count a touch on either or both sides.
+    void count(bool fLeft, bool fRight);
+
+    // touches not yet covered by a completed uplink, as sent.
+    void getUnacked(std::uint16_t &left, std::uint16_t &right) const;
+
+    // an uplink carrying the given values is being launched...
+    void startSend(std::uint16_t left, std::uint16_t right);
+    // ... and has completed.
+    void sendDone(bool fSuccess);
+
+    // true if a batch is due, or an uplink has completed, since the last
+    // write.
+    bool isFlushDue() const;
+
+    // write the counters to flash if isFlushDue(), or if anything
+    // changed and fForce is set.
+    void flush(bool fForce);
+
+    // forget the counters, in flash too.
+    void erase();
+
+    std::uint32_t getLeft() const { return this->m_left; }
+    std::uint32_t getRight() const { return this->m_right; }
+
+    bool isEnabled() const
+        {
+        return this->m_fEnabled;
+        }
+
+    const Journal &getJournal() const
+        {
+        return this->m_journal;
+        }
+
+private:
+    static std::uint16_t saturate(std::uint32_t v)
+        {
+        return v > 0xFFFF ? 0xFFFF : std::uint16_t(v);
+        }
+
+    cPowerManager                   &m_power;
+    Journal                         m_journal;
+    std::uint32_t                   m_left;
+    std::uint32_t                   m_right;
+    // lifetime values covered by completed uplinks.
+    std::uint32_t                   m_ackedLeft;
+    std::uint32_t                   m_ackedRight;
+    // lifetime values last written to flash.
+    std::uint32_t                   m_savedLeft;
+    std::uint32_t                   m_savedRight;
+    // values carried by the uplink in flight.
+    std::uint16_t                   m_sendingLeft;
+    std::uint16_t                   m_sendingRight;
+    bool                            m_fEnabled;
+    bool                            m_fSending;
+    // an uplink completed since the last write.
+    bool                            m_fAckPending;
+    };
+
+} // namespace McciCatena4610
+
+#endif /* _Catena4610_cTouchCounters_h_ */
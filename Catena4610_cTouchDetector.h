@@ -0,0 +1,137 @@
+/*
+
+Module: Catena4610_cTouchDetector.h
+
+Function:
+        cTouchDetector: decide from IQS620A readings when to count a touch.
+
+Copyright:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#ifndef _Catena4610_cTouchDetector_h_
+# define _Catena4610_cTouchDetector_h_
+
+#pragma once
+
+#include <cstdint>
+
+#include "Catena4610_cTouchChannels.h"
+
+namespace McciCatena4610 {
+
+/****************************************************************************\
+|
+|   The touch detector.
+|
+|   A Ch1 reading below the right threshold is a right-side touch; a Ch2
+|   reading below the left threshold is a left-side touch; both at once
+|   count on both sides. A touch is counted once, when debounce samples
+|   in a row have read below a threshold; it then stays held, counting
+|   nothing more, until debounce samples in a row have read at or above
+|   both thresholds raised by hysteresis. A debounce of 0 is taken as 1.
+|
+|   With more channels, channel 0 is still the right side and channel 1
+|   the left; the others are never compared, whatever they read or their
+|   thresholds hold.
+|
+|   This is the decision cMeasurementLoop::processSample() makes for each
+|   sample; it's kept free of the hardware so that the trace replay tool
+|   in extra/ runs the very same code.
+|
+\****************************************************************************/
+
+class cTouchDetector
+    {
+public:
+    struct Result
+        {
+        bool    fLeft;          // count a left-side touch
+        bool    fRight;         // count a right-side touch
+        bool    fNewTouch;      // a touch began with this sample
+        std::uint8_t channels;  // bitmap of the channels counted
+        };
+
+    // the channels that are sides, and so can count.
+    static constexpr std::uint8_t kSideChannels = (1 << 0) | (1 << 1);
+
+    cTouchDetector()
+        : m_fTouching(false)
+        , m_nRun(0)
+        {}
+
+    Result update(
+        std::int16_t ch1,
+        std::int16_t ch2,
+        std::uint16_t thresholdRight,
+        std::uint16_t thresholdLeft,
+        std::uint16_t hysteresis,
+        std::uint8_t debounce
+        )
+        {
+        using Channels = cTouchChannels<2>;
+
+        return this->update<2>(
+            Channels::Readings {{ ch1, ch2 }},
+            Channels::Thresholds {{ thresholdRight, thresholdLeft }},
+            hysteresis,
+            debounce
+            );
+        }
+
+    template <std::size_t a_nChannels>
+    Result update(
+        const typename cTouchChannels<a_nChannels>::Readings &readings,
+        const typename cTouchChannels<a_nChannels>::Thresholds &thresholds,
+        std::uint16_t hysteresis,
+        std::uint8_t debounce
+        )
+        {
+        using Channels = cTouchChannels<a_nChannels>;
+
+        Result r { false, false, false, 0 };
+        std::uint8_t const below = Channels::below(
+            readings,
+            thresholds,
+            this->m_fTouching ? hysteresis : 0
+            ) & kSideChannels;
+
+        // count the samples in a row that would change the state.
+        if (this->m_fTouching ? below != 0 : below == 0)
+            {
+            this->m_nRun = 0;
+            return r;
+            }
+
+        if (++this->m_nRun < debounce)
+            return r;
+
+        this->m_nRun = 0;
+        this->m_fTouching = ! this->m_fTouching;
+        if (this->m_fTouching)
+            {
+            r.channels = below;
+            r.fRight = (below & (1 << 0)) != 0;
+            r.fLeft = (below & (1 << 1)) != 0;
+            r.fNewTouch = true;
+            }
+        return r;
+        }
+
+    bool isTouching() const
+        {
+        return this->m_fTouching;
+        }
+
+private:
+    bool            m_fTouching;
+    std::uint8_t    m_nRun;         // samples in a row against m_fTouching
+    };
+
+} // namespace McciCatena4610
+
+#endif /* _Catena4610_cTouchDetector_h_ */
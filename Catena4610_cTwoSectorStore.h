@@ -0,0 +1,286 @@
+/*
+
+Module: Catena4610_cTwoSectorStore.h
+
+Function:
+        cTwoSectorStore: a record in two alternating flash sectors, with
+        an optional journal after it.
+
+Copyright:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#ifndef _Catena4610_cTwoSectorStore_h_
+# define _Catena4610_cTwoSectorStore_h_
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Catena4610_Crc.h"
+#include "Catena4610_FlashMap.h"
+
+namespace McciCatena4610 {
+
+/****************************************************************************\
+|
+|   The two-sector store.
+|
+|   This is the scheme shared by the session, counter and configuration
+|   stores. Each of two sectors starts with a header: a magic number, a
+|   generation number, the Record, and a CRC over all of them. A write()
+|   erases the sector not holding the current header, then programs the
+|   new header there with the next generation; the old sector is left
+|   alone until it is reused, so it still holds the previous record if a
+|   reset comes before the new header is complete. At boot the header
+|   with a good CRC and the highest generation wins.
+|
+|   After the header, the rest of the sector may be used as a journal of
+|   fixed-size entries, appended into erased flash, for small updates
+|   that don't need a new header. An entry type provides isValid(), so
+|   an entry torn by a reset while programming can be recognized; the
+|   last valid entry is current. When the journal is full, the caller
+|   writes a new header, which starts an empty journal in the other
+|   sector. So every update programs one header or one entry, and each
+|   sector is erased once per two headers.
+|
+|   Flash is any class providing the Catena_Mx25v8035f methods
+|   read(addr, buf, n), program(addr, buf, n) and eraseSector(addr), so
+|   the stores can be run on a host against an in-memory stand-in.
+|
+\****************************************************************************/
+
+template <class Flash, class Record>
+class cTwoSectorStore
+    {
+private:
+    struct Header
+        {
+        std::uint32_t   magic;
+        std::uint32_t   generation;
+        Record          record;
+        std::uint32_t   crc;
+        };
+
+public:
+    static constexpr unsigned kSectors = 2;
+
+    static_assert(
+        sizeof(Header) == 3 * sizeof(std::uint32_t) + sizeof(Record),
+        "Record must be a multiple of 4 bytes, without padding; it's checked with a CRC"
+        );
+    static_assert(sizeof(Header) <= FlashMap::kPageSize, "the header must fit in one page");
+
+    // journal entries start here, aligned for entries of up to 16 bytes.
+    static constexpr std::uint32_t kJournalBase = (sizeof(Header) + 15) / 16 * 16;
+
+    struct Stats
+        {
+        std::uint32_t   nWrites;        // headers and entries programmed
+        std::uint32_t   nErases;        // sectors erased
+        };
+
+    cTwoSectorStore(Flash &flash, std::uint32_t base, std::uint32_t magic)
+        : m_flash(flash)
+        , m_base(base)
+        , m_magic(magic)
+        , m_generation(0)
+        , m_nJournal(0)
+        , m_stats {}
+        , m_iSector(0)
+        , m_fValid(false)
+        {}
+
+    // neither copyable nor movable
+    cTwoSectorStore(const cTwoSectorStore&) = delete;
+    cTwoSectorStore& operator=(const cTwoSectorStore&) = delete;
+    cTwoSectorStore(const cTwoSectorStore&&) = delete;
+    cTwoSectorStore& operator=(const cTwoSectorStore&&) = delete;
+
+    // find the newest header, and copy its record to r. Returns true if
+    // one was found. The journal, if any, is read with scanJournal().
+    bool begin(Record &r)
+        {
+        Header h;
+
+        this->m_fValid = false;
+        this->m_nJournal = 0;
+        for (unsigned iSector = 0; iSector < kSectors; ++iSector)
+            {
+            if (! this->readHeader(iSector, h))
+                continue;
+
+            if (this->m_fValid &&
+                std::int32_t(h.generation - this->m_generation) <= 0)
+                continue;
+
+            this->m_fValid = true;
+            this->m_iSector = std::uint8_t(iSector);
+            this->m_generation = h.generation;
+            r = h.record;
+            }
+
+        return this->m_fValid;
+        }
+
+    bool isValid() const
+        {
+        return this->m_fValid;
+        }
+
+    // write r as a new header in the other sector; its journal is empty.
+    void write(const Record &r)
+        {
+        unsigned const iNew = this->m_fValid ? (this->m_iSector + 1) % kSectors : 0;
+        Header h;
+
+        h.magic = this->m_magic;
+        h.generation = this->m_fValid ? this->m_generation + 1 : 0;
+        h.record = r;
+        h.crc = crc32(&h, offsetof(Header, crc));
+
+        this->m_flash.eraseSector(this->sectorBase(iNew));
+        ++this->m_stats.nErases;
+        this->m_flash.program(this->sectorBase(iNew), (const std::uint8_t *)&h, sizeof(h));
+        ++this->m_stats.nWrites;
+
+        this->m_fValid = true;
+        this->m_iSector = std::uint8_t(iNew);
+        this->m_generation = h.generation;
+        this->m_nJournal = 0;
+        }
+
+    // forget the record; begin() will find nothing.
+    void erase()
+        {
+        for (unsigned iSector = 0; iSector < kSectors; ++iSector)
+            this->m_flash.eraseSector(this->sectorBase(iSector));
+
+        this->m_stats.nErases += kSectors;
+        this->m_fValid = false;
+        this->m_nJournal = 0;
+        }
+
+    template <class Entry>
+    static constexpr std::uint32_t getJournalCapacity()
+        {
+        return (FlashMap::kSectorSize - kJournalBase) / sizeof(Entry);
+        }
+
+    // find the end of the current header's journal, and copy the last
+    // valid entry to e. Returns true if there was one.
+    template <class Entry>
+    bool scanJournal(Entry &e)
+        {
+        checkEntry<Entry>();
+
+        if (! this->m_fValid)
+            return false;
+
+        // entries are appended in order, so binary-search for the first
+        // erased slot; then walk back over any torn entries.
+        std::uint32_t lo = 0;
+        std::uint32_t hi = getJournalCapacity<Entry>();
+
+        while (lo < hi)
+            {
+            std::uint32_t const mid = lo + (hi - lo) / 2;
+
+            if (this->template isErasedEntry<Entry>(mid))
+                hi = mid;
+            else
+                lo = mid + 1;
+            }
+
+        this->m_nJournal = lo;
+
+        for (std::uint32_t i = lo; i > 0; --i)
+            {
+            this->m_flash.read(this->template entryAddress<Entry>(i - 1), (std::uint8_t *)&e, sizeof(e));
+            if (e.isValid())
+                return true;
+            }
+        return false;
+        }
+
+    // append e to the journal. Returns false, writing nothing, if there's
+    // no header or the journal is full; the caller then write()s.
+    template <class Entry>
+    bool appendJournal(const Entry &e)
+        {
+        checkEntry<Entry>();
+
+        if (! this->m_fValid || this->m_nJournal >= getJournalCapacity<Entry>())
+            return false;
+
+        this->m_flash.program(this->template entryAddress<Entry>(this->m_nJournal), (const std::uint8_t *)&e, sizeof(e));
+        ++this->m_nJournal;
+        ++this->m_stats.nWrites;
+        return true;
+        }
+
+    // instrumentation
+    const Stats &getStats() const { return this->m_stats; }
+    std::uint32_t getGeneration() const { return this->m_generation; }
+    unsigned getSector() const { return this->m_iSector; }
+    std::uint32_t getJournalCount() const { return this->m_nJournal; }
+
+private:
+    template <class Entry>
+    static void checkEntry()
+        {
+        static_assert(
+            FlashMap::kPageSize % sizeof(Entry) == 0 && kJournalBase % sizeof(Entry) == 0,
+            "journal entries must not straddle pages"
+            );
+        }
+
+    std::uint32_t sectorBase(unsigned iSector) const
+        {
+        return this->m_base + iSector * FlashMap::kSectorSize;
+        }
+
+    template <class Entry>
+    std::uint32_t entryAddress(std::uint32_t iEntry) const
+        {
+        return this->sectorBase(this->m_iSector) + kJournalBase + iEntry * sizeof(Entry);
+        }
+
+    bool readHeader(unsigned iSector, Header &h)
+        {
+        this->m_flash.read(this->sectorBase(iSector), (std::uint8_t *)&h, sizeof(h));
+
+        return h.magic == this->m_magic &&
+               h.crc == crc32(&h, offsetof(Header, crc));
+        }
+
+    template <class Entry>
+    bool isErasedEntry(std::uint32_t iEntry)
+        {
+        std::uint8_t buf[sizeof(Entry)];
+        std::uint8_t all = 0xFF;
+
+        this->m_flash.read(this->template entryAddress<Entry>(iEntry), buf, sizeof(buf));
+        for (auto b : buf)
+            all &= b;
+        return all == 0xFF;
+        }
+
+    Flash           &m_flash;
+    std::uint32_t   m_base;
+    std::uint32_t   m_magic;
+    std::uint32_t   m_generation;
+    std::uint32_t   m_nJournal;
+    Stats           m_stats;
+    std::uint8_t    m_iSector;
+    bool            m_fValid;
+    };
+
+} // namespace McciCatena4610
+
+#endif /* _Catena4610_cTwoSectorStore_h_ */
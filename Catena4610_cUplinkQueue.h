@@ -0,0 +1,385 @@
+/*
+
+Module: Catena4610_cUplinkQueue.h
+
+Function:
+        cUplinkQueue: fixed-size prioritized uplink queue with retry backoff.
+
+Copyright:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#ifndef _Catena4610_cUplinkQueue_h_
+# define _Catena4610_cUplinkQueue_h_
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace McciCatena4610 {
+
+/****************************************************************************\
+|
+|   The uplink queue.
+|
+|   Frames are held in a fixed array of slots; nothing is allocated. The
+|   queue never looks at the clock or the radio itself: the caller passes
+|   in the current time in milliseconds and reports the result of each
+|   send. That keeps this header free of Arduino dependencies, so it can
+|   be compiled and exercised on a host against a simulated link.
+|
+\****************************************************************************/
+
+template <std::size_t a_nSlots, std::size_t a_nBytes>
+class cUplinkQueue
+    {
+public:
+    static constexpr std::size_t kSlots = a_nSlots;
+    static constexpr std::size_t kMaxMessage = a_nBytes;
+
+    // retry policy: exponential backoff starting at kRetryBaseMs, capped
+    // at kRetryMaxMs, plus up to 50% random jitter. After kMaxRetries
+    // failed attempts, the frame is dropped.
+    static constexpr std::uint32_t kRetryBaseMs = 10 * 1000;
+    static constexpr std::uint32_t kRetryMaxMs = 10 * 60 * 1000;
+    static constexpr std::uint8_t kMaxRetries = 6;
+
+    static_assert(kSlots > 0 && kSlots <= 255, "slot count must be 1..255");
+    static_assert(kMaxMessage <= 255, "message size must fit in a byte");
+
+    // priority classes; lower values are sent first.
+    enum class Priority : std::uint8_t
+        {
+        kTouchEvent = 0,        // touch events
+        kPeriodic = 1,          // periodic status
+        kWaveform = 2,          // waveform capture fragments
+        kCount                  // number of priority classes.
+        };
+
+    // instrumentation
+    struct Stats
+        {
+        std::uint32_t   nQueued;        // frames accepted
+        std::uint32_t   nCoalesced;     // frames merged into a queued frame
+        std::uint32_t   nSent;          // frames sent successfully
+        std::uint32_t   nRetries;       // failed attempts that were rescheduled
+        std::uint32_t   nDropped;       // frames discarded (full or out of retries)
+        std::uint8_t    depth;          // current number of queued frames
+        std::uint8_t    maxDepth;       // high-water mark of depth
+        };
+
+    struct Entry
+        {
+        std::uint32_t   tNotBefore;     // earliest time for next attempt
+        std::uint32_t   seq;            // arrival order, for FIFO within a class
+        std::uint8_t    data[kMaxMessage];
+        std::uint8_t    nData;
+        std::uint8_t    port;
+        Priority        priority;
+        std::uint8_t    nRetries;
+        bool            fInUse;
+        bool            fCoalesce;      // may be replaced by a newer frame
+        };
+
+    cUplinkQueue()
+        : m_pInFlight(nullptr)
+        , m_seq(0)
+        , m_rand(0x2545F491u)
+        , m_stats {}
+        , m_nDropped {}
+        , m_slots {}
+        {}
+
+    // neither copyable nor movable
+    cUplinkQueue(const cUplinkQueue&) = delete;
+    cUplinkQueue& operator=(const cUplinkQueue&) = delete;
+    cUplinkQueue(const cUplinkQueue&&) = delete;
+    cUplinkQueue& operator=(const cUplinkQueue&&) = delete;
+
+    // seed the jitter generator; zero is replaced by a fixed seed.
+    void setSeed(std::uint32_t seed)
+        {
+        this->m_rand = seed != 0 ? seed : 0x2545F491u;
+        }
+
+    // true if a frame of the given class is queued and not yet in flight.
+    bool isPending(Priority priority) const
+        {
+        for (auto const &e : this->m_slots)
+            {
+            if (e.fInUse && e.priority == priority && &e != this->m_pInFlight)
+                return true;
+            }
+        return false;
+        }
+
+    // true if a frame of the given class is queued or in flight.
+    bool isQueued(Priority priority) const
+        {
+        for (auto const &e : this->m_slots)
+            {
+            if (e.fInUse && e.priority == priority)
+                return true;
+            }
+        return false;
+        }
+
+    // queue a frame. If fCoalesce is set and the newest frame of the same
+    // class that is waiting (not in flight) was also queued with
+    // fCoalesce, its contents are replaced by the new frame; the caller is
+    // responsible for having merged any cumulative data into the new
+    // frame. A frame queued without fCoalesce is never replaced. Returns
+    // false if the frame was dropped.
+    bool put(
+        const std::uint8_t *pData,
+        std::size_t nData,
+        std::uint8_t port,
+        Priority priority,
+        bool fCoalesce,
+        std::uint32_t tNow
+        )
+        {
+        if (nData > kMaxMessage)
+            {
+            this->drop(priority);
+            return false;
+            }
+
+        Entry *pEntry = fCoalesce ? this->findPending(priority) : nullptr;
+
+        if (pEntry != nullptr)
+            {
+            ++this->m_stats.nCoalesced;
+            }
+        else
+            {
+            pEntry = this->allocate(priority);
+            if (pEntry == nullptr)
+                {
+                this->drop(priority);
+                return false;
+                }
+
+            pEntry->fInUse = true;
+            pEntry->seq = this->m_seq++;
+            pEntry->priority = priority;
+            ++this->m_stats.nQueued;
+            this->setDepth(this->m_stats.depth + 1);
+            }
+
+        std::memcpy(pEntry->data, pData, nData);
+        pEntry->nData = std::uint8_t(nData);
+        pEntry->port = port;
+        pEntry->fCoalesce = fCoalesce;
+        pEntry->nRetries = 0;
+        pEntry->tNotBefore = tNow;
+        return true;
+        }
+
+    // true if a frame is in flight.
+    bool isBusy() const
+        {
+        return this->m_pInFlight != nullptr;
+        }
+
+    // return the frame that should be sent now, or nullptr if none is due
+    // (or one is already in flight).
+    const Entry *peekReady(std::uint32_t tNow) const
+        {
+        if (this->m_pInFlight != nullptr)
+            return nullptr;
+
+        const Entry *pBest = nullptr;
+        for (auto const &e : this->m_slots)
+            {
+            if (! e.fInUse || std::int32_t(tNow - e.tNotBefore) < 0)
+                continue;
+
+            if (pBest == nullptr ||
+                e.priority < pBest->priority ||
+                (e.priority == pBest->priority &&
+                 std::int32_t(e.seq - pBest->seq) < 0))
+                pBest = &e;
+            }
+        return pBest;
+        }
+
+    // mark the frame returned by peekReady() as in flight.
+    const Entry *startSend(std::uint32_t tNow)
+        {
+        const Entry *pEntry = this->peekReady(tNow);
+
+        this->m_pInFlight = const_cast<Entry *>(pEntry);
+        return pEntry;
+        }
+
+    // report the outcome of the frame started by startSend().
+    void sendDone(bool fSuccess, std::uint32_t tNow)
+        {
+        Entry * const pEntry = this->m_pInFlight;
+
+        if (pEntry == nullptr)
+            return;
+
+        this->m_pInFlight = nullptr;
+        if (fSuccess)
+            {
+            ++this->m_stats.nSent;
+            this->release(pEntry);
+            }
+        else if (pEntry->nRetries >= kMaxRetries)
+            {
+            this->drop(pEntry->priority);
+            this->release(pEntry);
+            }
+        else
+            {
+            ++pEntry->nRetries;
+            ++this->m_stats.nRetries;
+            pEntry->tNotBefore = tNow + this->backoff(pEntry->nRetries);
+            }
+        }
+
+    // compute milliseconds until the next frame is due. Returns false if
+    // the queue is empty or a frame is in flight.
+    bool getNextDue(std::uint32_t tNow, std::uint32_t &msDue) const
+        {
+        if (this->m_pInFlight != nullptr)
+            return false;
+
+        bool fAny = false;
+        msDue = 0;
+        for (auto const &e : this->m_slots)
+            {
+            if (! e.fInUse)
+                continue;
+
+            std::int32_t const delta = std::int32_t(e.tNotBefore - tNow);
+            std::uint32_t const ms = delta > 0 ? std::uint32_t(delta) : 0;
+
+            if (! fAny || ms < msDue)
+                msDue = ms;
+            fAny = true;
+            }
+        return fAny;
+        }
+
+    const Stats &getStats() const
+        {
+        return this->m_stats;
+        }
+
+    // frames of the given class discarded so far; a caller that sends a
+    // sequence of frames can tell from this that one was lost.
+    std::uint32_t getDropped(Priority priority) const
+        {
+        return this->m_nDropped[unsigned(priority)];
+        }
+
+private:
+    // the newest waiting frame of the class, if it may be replaced. An
+    // older one is being retried; replacing it would reorder the class.
+    Entry *findPending(Priority priority) const
+        {
+        const Entry *pNewest = nullptr;
+
+        for (auto const &e : this->m_slots)
+            {
+            if (! e.fInUse || e.priority != priority || &e == this->m_pInFlight)
+                continue;
+            if (pNewest == nullptr || std::int32_t(e.seq - pNewest->seq) > 0)
+                pNewest = &e;
+            }
+
+        if (pNewest == nullptr || ! pNewest->fCoalesce)
+            return nullptr;
+        return const_cast<Entry *>(pNewest);
+        }
+
+    // find a free slot; if full, evict the oldest waiting frame of the
+    // lowest class that is not more important than the new frame.
+    Entry *allocate(Priority priority)
+        {
+        Entry *pVictim = nullptr;
+
+        for (auto &e : this->m_slots)
+            {
+            if (! e.fInUse)
+                return &e;
+            if (&e == this->m_pInFlight || e.priority < priority)
+                continue;
+            if (pVictim == nullptr ||
+                e.priority > pVictim->priority ||
+                (e.priority == pVictim->priority &&
+                 std::int32_t(e.seq - pVictim->seq) < 0))
+                pVictim = &e;
+            }
+
+        if (pVictim != nullptr)
+            {
+            this->drop(pVictim->priority);
+            this->release(pVictim);
+            }
+        return pVictim;
+        }
+
+    void drop(Priority priority)
+        {
+        ++this->m_stats.nDropped;
+        ++this->m_nDropped[unsigned(priority)];
+        }
+
+    void release(Entry *pEntry)
+        {
+        pEntry->fInUse = false;
+        this->setDepth(this->m_stats.depth - 1);
+        }
+
+    void setDepth(unsigned depth)
+        {
+        this->m_stats.depth = std::uint8_t(depth);
+        if (depth > this->m_stats.maxDepth)
+            this->m_stats.maxDepth = std::uint8_t(depth);
+        }
+
+    std::uint32_t backoff(std::uint8_t nRetries)
+        {
+        std::uint32_t delay = kRetryBaseMs;
+
+        for (auto i = 1u; i < nRetries && delay < kRetryMaxMs; ++i)
+            delay <<= 1;
+        if (delay > kRetryMaxMs)
+            delay = kRetryMaxMs;
+
+        return delay + this->nextRandom() % (delay / 2 + 1);
+        }
+
+    // xorshift32; good enough to de-synchronize retries across a site.
+    std::uint32_t nextRandom()
+        {
+        std::uint32_t x = this->m_rand;
+
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        this->m_rand = x;
+        return x;
+        }
+
+    Entry           *m_pInFlight;
+    std::uint32_t   m_seq;
+    std::uint32_t   m_rand;
+    Stats           m_stats;
+    std::uint32_t   m_nDropped[unsigned(Priority::kCount)];
+    Entry           m_slots[kSlots];
+    };
+
+} // namespace McciCatena4610
+
+#endif /* _Catena4610_cUplinkQueue_h_ */
@@ -0,0 +1,511 @@
+/*
+
+Module: Catena4610_cWaveformCapture.h
+
+Function:
+        cWaveformCapture: pre/post-trigger capture of touch sensor samples,
+        compressed and cut into uplink fragments.
+
+Copyright:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#ifndef _Catena4610_cWaveformCapture_h_
+# define _Catena4610_cWaveformCapture_h_
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Catena4610_Crc.h"
+
+namespace McciCatena4610 {
+
+/****************************************************************************\
+|
+|   The waveform capture.
+|
+|   Every sample is push()ed into a ring of kWindowSamples. On a trigger
+|   (a new touch, reported by the caller, or a jump in amplitude of at
+|   least the spike threshold between successive samples), kPostSamples
+|   more are taken, and the window, up to kPreSamples up to and
+|   including the triggering sample and the kPostSamples after it, is
+|   frozen for upload. Nothing is captured while a window is being
+|   collected or uploaded, nor within the holdoff time of the last
+|   trigger; such triggers are counted as suppressed.
+|
+|   The window is sent as a blob, big-endian:
+|
+|       u8      version (kBlobVersion)
+|       u8      reason (Reason)
+|       u8      samples before the trigger, including it
+|       u8      samples after the trigger
+|       u32     millis() of the first sample
+|       n-1 x   varint: ms from the previous sample
+|       3 x     Ch1, then Ch2, then amplitude: zigzag varint of the first
+|               value, then zigzag varints of the differences
+|       u32     CRC-32 of all the above
+|
+|   Varints are 7 bits per byte, low-order group first, with the top bit
+|   set on all but the last byte. The blob is cut into fragments of at
+|   most a_nFragmentBytes:
+|
+|       u8      kFragmentFormat
+|       u8      capture number (wraps)
+|       u8      fragment index, from 0
+|       u8      fragment count
+|       ...     the next piece of the blob
+|
+|   The blob isn't stored: the ring stays frozen until the last fragment
+|   is taken, and each fragment is encoded from it afresh. Nothing here
+|   touches the hardware or the radio; see extra/ for the host test and
+|   the backend reassembly.
+|
+\****************************************************************************/
+
+template <std::size_t a_nFragmentBytes>
+class cWaveformCapture
+    {
+public:
+    static constexpr std::uint8_t kPreSamples = 24;
+    static constexpr std::uint8_t kPostSamples = 40;
+    static constexpr std::size_t kWindowSamples = kPreSamples + kPostSamples;
+    static constexpr std::uint8_t kBlobVersion = 1;
+    static constexpr std::uint8_t kFragmentFormat = 0x31;
+    static constexpr std::size_t kFragmentHeaderBytes = 4;
+    static constexpr std::size_t kFragmentDataBytes = a_nFragmentBytes - kFragmentHeaderBytes;
+    // header, worst-case varints (5 bytes for a time step, 3 for a
+    // difference of 16-bit values), CRC.
+    static constexpr std::size_t kMaxBlobBytes =
+        8 + (kWindowSamples - 1) * 5 + 3 * kWindowSamples * 3 + 4;
+
+    static constexpr std::uint32_t kDefaultHoldoffMs = 60 * 60 * 1000;
+    static constexpr std::uint16_t kDefaultSpikeDelta = 64;
+
+    static_assert((kWindowSamples & (kWindowSamples - 1)) == 0, "window must be a power of two");
+    static_assert(a_nFragmentBytes > kFragmentHeaderBytes, "fragments must have room for data");
+    static_assert((kMaxBlobBytes + kFragmentDataBytes - 1) / kFragmentDataBytes <= 255,
+        "fragment count must fit in a byte");
+
+    enum class Reason : std::uint8_t
+        {
+        kTouch = 1,             // a new touch
+        kAmplitude = 2,         // an amplitude spike
+        kManual = 3,            // asked for by command
+        };
+
+    enum class State : std::uint8_t
+        {
+        kIdle,                  // waiting for a trigger
+        kPost,                  // collecting samples after a trigger
+        kUpload,                // fragments waiting to be taken
+        };
+
+    struct Sample
+        {
+        std::uint32_t   tMs;
+        std::int16_t    ch1;
+        std::int16_t    ch2;
+        std::int16_t    amplitude;
+        };
+
+    struct Stats
+        {
+        std::uint32_t   nTriggers;      // triggers accepted
+        std::uint32_t   nSuppressed;    // triggers ignored: busy or holdoff
+        std::uint32_t   nFragments;     // fragments taken
+        std::uint32_t   nAborted;       // uploads abandoned part way
+        std::uint16_t   lastBlobBytes;  // size of the last blob
+        };
+
+    cWaveformCapture()
+        : m_stats {}
+        , m_holdoffMs(kDefaultHoldoffMs)
+        , m_tTrigger(0)
+        , m_crc(0)
+        , m_iHead(0)
+        , m_nFresh(0)
+        , m_nBlob(0)
+        , m_spikeDelta(kDefaultSpikeDelta)
+        , m_lastAmplitude(0)
+        , m_state(State::kIdle)
+        , m_reason(Reason::kTouch)
+        , m_nPre(0)
+        , m_nPostLeft(0)
+        , m_captureId(0)
+        , m_iFragment(0)
+        , m_nFragments(0)
+        , m_fEnabled(false)
+        , m_fTriggered(false)
+        {}
+
+    // neither copyable nor movable
+    cWaveformCapture(const cWaveformCapture&) = delete;
+    cWaveformCapture& operator=(const cWaveformCapture&) = delete;
+    cWaveformCapture(const cWaveformCapture&&) = delete;
+    cWaveformCapture& operator=(const cWaveformCapture&&) = delete;
+
+    void setEnabled(bool fEnabled)
+        {
+        this->m_fEnabled = fEnabled;
+        }
+
+    bool isEnabled() const
+        {
+        return this->m_fEnabled;
+        }
+
+    void setHoldoff(std::uint32_t ms)
+        {
+        this->m_holdoffMs = ms;
+        }
+
+    std::uint32_t getHoldoff() const
+        {
+        return this->m_holdoffMs;
+        }
+
+    // 0 turns off amplitude triggers.
+    void setSpikeDelta(std::uint16_t delta)
+        {
+        this->m_spikeDelta = delta;
+        }
+
+    std::uint16_t getSpikeDelta() const
+        {
+        return this->m_spikeDelta;
+        }
+
+    State getState() const
+        {
+        return this->m_state;
+        }
+
+    const Stats &getStats() const
+        {
+        return this->m_stats;
+        }
+
+    // record a sample; may trigger on an amplitude spike.
+    void push(const Sample &s)
+        {
+        if (this->m_state == State::kUpload)
+            return;
+
+        this->m_ring[this->m_iHead % kWindowSamples] = s;
+        ++this->m_iHead;
+        if (this->m_nFresh < kWindowSamples)
+            ++this->m_nFresh;
+
+        if (this->m_state == State::kPost)
+            {
+            if (--this->m_nPostLeft == 0)
+                this->freeze();
+            return;
+            }
+
+        std::int32_t const delta = std::int32_t(s.amplitude) - this->m_lastAmplitude;
+        bool const fSpike = this->m_nFresh > 1 && this->m_spikeDelta != 0 &&
+                            (delta >= this->m_spikeDelta || -delta >= this->m_spikeDelta);
+
+        this->m_lastAmplitude = s.amplitude;
+        if (fSpike)
+            this->trigger(s.tMs, Reason::kAmplitude);
+        }
+
+    // start a capture at the sample just pushed. fForce skips the holdoff.
+    // Returns true if a capture started.
+    bool trigger(std::uint32_t tMs, Reason reason, bool fForce = false)
+        {
+        if (! this->m_fEnabled || this->m_nFresh == 0)
+            return false;
+
+        if (this->m_state != State::kIdle ||
+            (! fForce && this->m_fTriggered && tMs - this->m_tTrigger < this->m_holdoffMs))
+            {
+            ++this->m_stats.nSuppressed;
+            return false;
+            }
+
+        ++this->m_stats.nTriggers;
+        this->m_tTrigger = tMs;
+        this->m_fTriggered = true;
+        this->m_reason = reason;
+        this->m_nPre = std::uint8_t(this->m_nFresh < kPreSamples ? this->m_nFresh : kPreSamples);
+        this->m_nPostLeft = kPostSamples;
+        this->m_state = State::kPost;
+        return true;
+        }
+
+    bool hasFragment() const
+        {
+        return this->m_state == State::kUpload;
+        }
+
+    // index of the next fragment, and how many there are.
+    std::uint8_t getFragmentIndex() const
+        {
+        return this->m_iFragment;
+        }
+
+    std::uint8_t getFragmentCount() const
+        {
+        return this->m_nFragments;
+        }
+
+    // build the next fragment into pBuf (a_nFragmentBytes long). Returns
+    // its length, or 0 if there is none. After the last fragment, the
+    // ring is released.
+    std::size_t getFragment(std::uint8_t *pBuf)
+        {
+        if (this->m_state != State::kUpload)
+            return 0;
+
+        std::size_t const offset = std::size_t(this->m_iFragment) * kFragmentDataBytes;
+        std::size_t const nLeft = this->m_nBlob - offset;
+        std::size_t const nData = nLeft < kFragmentDataBytes ? nLeft : kFragmentDataBytes;
+
+        pBuf[0] = kFragmentFormat;
+        pBuf[1] = this->m_captureId;
+        pBuf[2] = this->m_iFragment;
+        pBuf[3] = this->m_nFragments;
+
+        RangeSink sink { pBuf + kFragmentHeaderBytes, offset, offset + nData, 0 };
+        this->encode(sink);
+        putCrc(sink, this->m_crc);
+
+        ++this->m_stats.nFragments;
+        if (++this->m_iFragment == this->m_nFragments)
+            this->release();
+
+        return kFragmentHeaderBytes + nData;
+        }
+
+    // give up on the capture being uploaded, e.g. because one of its
+    // fragments was lost and the rest can't be reassembled.
+    void abort()
+        {
+        if (this->m_state != State::kUpload)
+            return;
+
+        ++this->m_stats.nAborted;
+        this->release();
+        }
+
+    // decode a complete blob; pSamples needs room for kWindowSamples.
+    // Returns false if the blob is damaged.
+    static bool decodeBlob(
+        const std::uint8_t *pBlob,
+        std::size_t nBlob,
+        Reason &reason,
+        std::uint8_t &nPre,
+        std::uint8_t &nPost,
+        Sample *pSamples
+        )
+        {
+        if (nBlob < 12 || pBlob[0] != kBlobVersion)
+            return false;
+
+        std::uint32_t const crc = getBe32(pBlob + nBlob - 4);
+        if (crc != crc32(pBlob, nBlob - 4))
+            return false;
+
+        reason = Reason(pBlob[1]);
+        nPre = pBlob[2];
+        nPost = pBlob[3];
+
+        std::size_t const n = std::size_t(nPre) + nPost;
+        if (n == 0 || n > kWindowSamples)
+            return false;
+
+        const std::uint8_t *p = pBlob + 8;
+        const std::uint8_t * const pEnd = pBlob + nBlob - 4;
+        std::uint32_t v;
+
+        pSamples[0].tMs = getBe32(pBlob + 4);
+        for (std::size_t i = 1; i < n; ++i)
+            {
+            if (! getVarint(p, pEnd, v))
+                return false;
+            pSamples[i].tMs = pSamples[i - 1].tMs + v;
+            }
+
+        std::int16_t Sample::* const fields[] = { &Sample::ch1, &Sample::ch2, &Sample::amplitude };
+        for (auto field : fields)
+            {
+            std::int32_t last = 0;
+
+            for (std::size_t i = 0; i < n; ++i)
+                {
+                if (! getVarint(p, pEnd, v))
+                    return false;
+                last += std::int32_t(v >> 1) ^ -std::int32_t(v & 1);
+                pSamples[i].*field = std::int16_t(last);
+                }
+            }
+
+        return p == pEnd;
+        }
+
+private:
+    // receives the blob a byte at a time; only bytes in [begin, end) are
+    // kept.
+    struct RangeSink
+        {
+        std::uint8_t    *pBuf;
+        std::size_t     begin;
+        std::size_t     end;
+        std::size_t     pos;
+
+        void put(std::uint8_t b)
+            {
+            if (this->pos >= this->begin && this->pos < this->end)
+                this->pBuf[this->pos - this->begin] = b;
+            ++this->pos;
+            }
+        };
+
+    // sizes the blob and computes its CRC.
+    struct CrcSink
+        {
+        std::uint32_t   crc;
+        std::size_t     pos;
+
+        void put(std::uint8_t b)
+            {
+            this->crc = crc32(&b, 1, this->crc);
+            ++this->pos;
+            }
+        };
+
+    const Sample &windowSample(std::size_t i) const
+        {
+        std::uint32_t const iFirst = this->m_iHead - this->m_nPre - kPostSamples;
+
+        return this->m_ring[(iFirst + i) % kWindowSamples];
+        }
+
+    // emit the blob, less its CRC.
+    template <class Sink>
+    void encode(Sink &sink) const
+        {
+        std::size_t const n = std::size_t(this->m_nPre) + kPostSamples;
+        std::uint32_t const t0 = this->windowSample(0).tMs;
+
+        sink.put(kBlobVersion);
+        sink.put(std::uint8_t(this->m_reason));
+        sink.put(this->m_nPre);
+        sink.put(kPostSamples);
+        for (unsigned i = 0; i < 4; ++i)
+            sink.put(std::uint8_t(t0 >> (24 - 8 * i)));
+
+        for (std::size_t i = 1; i < n; ++i)
+            putVarint(sink, this->windowSample(i).tMs - this->windowSample(i - 1).tMs);
+
+        std::int16_t Sample::* const fields[] = { &Sample::ch1, &Sample::ch2, &Sample::amplitude };
+        for (auto field : fields)
+            {
+            std::int32_t last = 0;
+
+            for (std::size_t i = 0; i < n; ++i)
+                {
+                std::int32_t const v = this->windowSample(i).*field;
+                std::int32_t const delta = v - last;
+
+                putVarint(sink, (std::uint32_t(delta) << 1) ^ std::uint32_t(delta >> 31));
+                last = v;
+                }
+            }
+        }
+
+    template <class Sink>
+    static void putVarint(Sink &sink, std::uint32_t v)
+        {
+        while (v >= 0x80)
+            {
+            sink.put(std::uint8_t(v | 0x80));
+            v >>= 7;
+            }
+        sink.put(std::uint8_t(v));
+        }
+
+    template <class Sink>
+    static void putCrc(Sink &sink, std::uint32_t crc)
+        {
+        for (unsigned i = 0; i < 4; ++i)
+            sink.put(std::uint8_t(crc >> (24 - 8 * i)));
+        }
+
+    static bool getVarint(const std::uint8_t *&p, const std::uint8_t *pEnd, std::uint32_t &v)
+        {
+        v = 0;
+        for (unsigned shift = 0; shift < 35; shift += 7)
+            {
+            if (p == pEnd)
+                return false;
+
+            std::uint8_t const b = *p++;
+            v |= std::uint32_t(b & 0x7F) << shift;
+            if ((b & 0x80) == 0)
+                return true;
+            }
+        return false;
+        }
+
+    static std::uint32_t getBe32(const std::uint8_t *p)
+        {
+        return (std::uint32_t(p[0]) << 24) | (std::uint32_t(p[1]) << 16) |
+               (std::uint32_t(p[2]) << 8) | p[3];
+        }
+
+    // the window is complete: size it and get ready to send.
+    void freeze()
+        {
+        CrcSink sink { 0, 0 };
+
+        this->encode(sink);
+        this->m_crc = sink.crc;
+        this->m_nBlob = std::uint16_t(sink.pos + 4);
+        this->m_nFragments = std::uint8_t((this->m_nBlob + kFragmentDataBytes - 1) / kFragmentDataBytes);
+        this->m_iFragment = 0;
+        this->m_stats.lastBlobBytes = this->m_nBlob;
+        this->m_state = State::kUpload;
+        }
+
+    // the upload is over: release the ring, and number the next capture.
+    void release()
+        {
+        ++this->m_captureId;
+        this->m_nFresh = 0;
+        this->m_state = State::kIdle;
+        }
+
+    Sample          m_ring[kWindowSamples];
+    Stats           m_stats;
+    std::uint32_t   m_holdoffMs;
+    std::uint32_t   m_tTrigger;
+    std::uint32_t   m_crc;
+    std::uint32_t   m_iHead;
+    std::uint16_t   m_nFresh;
+    std::uint16_t   m_nBlob;
+    std::uint16_t   m_spikeDelta;
+    std::int16_t    m_lastAmplitude;
+    State           m_state;
+    Reason          m_reason;
+    std::uint8_t    m_nPre;
+    std::uint8_t    m_nPostLeft;
+    std::uint8_t    m_captureId;
+    std::uint8_t    m_iFragment;
+    std::uint8_t    m_nFragments;
+    bool            m_fEnabled;
+    bool            m_fTriggered;
+    };
+
+} // namespace McciCatena4610
+
+#endif /* _Catena4610_cWaveformCapture_h_ */
@@ -20,5 +20,18 @@ Author:
 #include <Catena_CommandStream.h>
 
 McciCatena::cCommandStream::CommandFn cmdLog;
+McciCatena::cCommandStream::CommandFn cmdQueue;
+McciCatena::cCommandStream::CommandFn cmdBoot;
+McciCatena::cCommandStream::CommandFn cmdSession;
+McciCatena::cCommandStream::CommandFn cmdIdle;
+McciCatena::cCommandStream::CommandFn cmdEnergy;
+McciCatena::cCommandStream::CommandFn cmdCounters;
+McciCatena::cCommandStream::CommandFn cmdConfig;
+McciCatena::cCommandStream::CommandFn cmdStream;
+McciCatena::cCommandStream::CommandFn cmdWaveform;
+McciCatena::cCommandStream::CommandFn cmdSensor;
+McciCatena::cCommandStream::CommandFn cmdClock;
+McciCatena::cCommandStream::CommandFn cmdStall;
+McciCatena::cCommandStream::CommandFn cmdPower;
 
 #endif /* _Catena4610_cmd_h_ */
\ No newline at end of file
@@ -24,7 +24,16 @@ Author:
 #include <Catena_Timer.h>
 #include <MCCI_Catena_Iqs620a.h>
 #include <SPI.h>
+#include "Catena4610_cBootProfile.h"
+#include "Catena4610_cConfiguration.h"
+#include "Catena4610_cI2cDmaBus.h"
+#include "Catena4610_cIdleScheduler.h"
+#include "Catena4610_cLoRaWANSession.h"
 #include "Catena4610_cMeasurementLoop.h"
+#include "Catena4610_cPowerManager.h"
+#include "Catena4610_cStallMonitor.h"
+#include "Catena4610_cStreamPort.h"
+#include "Catena4610_cTouchCounters.h"
 
 using namespace McciCatenaIqs620a;
 
@@ -41,7 +50,34 @@ extern  McciCatena4610::cMeasurementLoop        gMeasurementLoop;
 // The Touch Sensor
 extern cIQS620A                                 gIqs620a;
 
+//  Background reads of the touch sensor
+extern  McciCatena4610::cI2cDmaBus              gI2cBus;
+
 //  The flash
 extern  McciCatena::Catena_Mx25v8035f           gFlash;
 
+//  The peripheral power manager
+extern  McciCatena4610::cPowerManager           gPowerManager;
+
+//  The boot-time profile
+extern  McciCatena4610::cBootProfile            gBootProfile;
+
+//  The saved LoRaWAN session
+extern  McciCatena4610::cLoRaWANSession         gLoRaWANSession;
+
+//  The idle scheduler
+extern  McciCatena4610::cIdleScheduler          gIdleScheduler;
+
+//  The loop stall monitor
+extern  McciCatena4610::cStallMonitor           gStallMonitor;
+
+//  The lifetime touch counters
+extern  McciCatena4610::cTouchCounters          gTouchCounters;
+
+//  The saved configuration
+extern  McciCatena4610::cConfiguration          gConfiguration;
+
+//  The raw sample stream
+extern  McciCatena4610::cStreamPort             gStreamPort;
+
 #endif // !defined(_Catena4610-TouchSense-Lorawan_h_)
@@ -38,6 +38,10 @@ static_assert(
 
 static const char sVersion[] = "1.1.0";
 
+// reset if the loop hangs. The watchdog runs on in Stop mode, so it's
+// only used without deep sleep.
+static constexpr bool kEnableWatchdog = ! cMeasurementLoop::kEnableDeepSleep;
+
 /****************************************************************************\
 |
 |   Variables.
@@ -61,9 +65,42 @@ SPIClass gSPI2(
 /* instantiate the flash */
 Catena_Mx25v8035f gFlash;
 
+/* powers the peripherals while they're in use */
+cPowerManager gPowerManager;
+
 /* instantiate the touch sensor */
 cIQS620A gIqs620a;
 
+/* reads the touch sensor in the background */
+cI2cDmaBus gI2cBus;
+
+/* the boot-time profile */
+cBootProfile gBootProfile;
+
+/* the saved LoRaWAN session */
+cLoRaWANSession gLoRaWANSession { gFlash, gPowerManager };
+
+/* sleeps the CPU between deadlines */
+cIdleScheduler gIdleScheduler;
+
+/* finds loop stalls, and kicks the watchdog */
+cStallMonitor gStallMonitor;
+
+// the measurement FSM's state, for the stall records.
+static std::uint8_t getLoopState()
+    {
+    return std::uint8_t(gMeasurementLoop.getState());
+    }
+
+/* the lifetime touch counters */
+cTouchCounters gTouchCounters { gFlash, gPowerManager };
+
+/* the saved configuration */
+cConfiguration gConfiguration { gFlash, gPowerManager };
+
+/* the raw sample stream */
+cStreamPort gStreamPort;
+
 /****************************************************************************\
 |
 |   User commands
@@ -74,6 +111,19 @@ cIQS620A gIqs620a;
 static const cCommandStream::cEntry sMyExtraCommmands[] =
         {
         { "log", cmdLog },
+        { "queue", cmdQueue },
+        { "boot", cmdBoot },
+        { "session", cmdSession },
+        { "idle", cmdIdle },
+        { "energy", cmdEnergy },
+        { "counters", cmdCounters },
+        { "config", cmdConfig },
+        { "stream", cmdStream },
+        { "waveform", cmdWaveform },
+        { "sensor", cmdSensor },
+        { "clock", cmdClock },
+        { "stall", cmdStall },
+        { "power", cmdPower },
         // other commands go here....
         };
 
@@ -93,29 +143,87 @@ sMyExtraCommands_top(
 |
 \****************************************************************************/
 
+//
+// Unattended units boot fast: no sign-on banner, and the command setup
+// (not needed to take the first measurement) runs after the measurement
+// loop has been started, overlapping with sensor warmup. Warmup itself
+// ends as soon as the sensor readings settle. The flash holds the saved
+// LoRaWAN session, so it's always set up before the radio.
+//
 void setup()
     {
+    using Phase = cBootProfile::Phase;
+
+    gStallMonitor.begin(millis, getLoopState);
+    gStallMonitor.beginIteration(cStallMonitor::Site::kSetup);
+
     setup_platform();
-    setup_printSignOn();
+    gBootProfile.mark(Phase::kPlatform, millis());
+
+    bool const fFastBoot = gCatena.GetOperatingFlags() &
+        static_cast<uint32_t>(gCatena.OPERATING_FLAGS::fUnattended);
+
+    gBootProfile.setFastBoot(fFastBoot);
+    gMeasurementLoop.setFastWarmup(fFastBoot);
+
+    if (! fFastBoot)
+        {
+        setup_printSignOn();
+        gBootProfile.mark(Phase::kSignOn, millis());
+        }
 
     setup_flash();
+    gBootProfile.mark(Phase::kFlash, millis());
+
     setup_measurement();
+    gBootProfile.mark(Phase::kMeasurement, millis());
+
     setup_radio();
-    setup_commands();
+    gBootProfile.mark(Phase::kRadio, millis());
+
+    if (! fFastBoot)
+        {
+        setup_commands();
+        gBootProfile.mark(Phase::kCommands, millis());
+        }
+
     setup_start();
+    gBootProfile.mark(Phase::kStart, millis());
+
+    gStallMonitor.endIteration();
+    if (kEnableWatchdog)
+        {
+        cStallMonitor::startWatchdog(cStallMonitor::kWatchdogMs);
+        gStallMonitor.setKick(cStallMonitor::kickWatchdog);
+        }
+
+    if (fFastBoot)
+        {
+        setup_commands();
+        gBootProfile.mark(Phase::kCommands, millis());
+        }
     }
 
 void setup_platform()
     {
     gCatena.begin();
 
+    // USB serial is up; the rest is powered on first use.
+    gPowerManager.begin(millis, cPowerManager::setHardwarePower,
+                        cPowerManager::getMask(cPowerManager::Peripheral::kSerial));
+    gPowerManager.acquire(cPowerManager::Peripheral::kSerial);
+
     // if running unattended, don't wait for USB connect.
     if (! (gCatena.GetOperatingFlags() &
         static_cast<uint32_t>(gCatena.OPERATING_FLAGS::fUnattended)))
         {
+        auto const site = gStallMonitor.enter(cStallMonitor::Site::kUsbWait);
+
         while (!Serial)
             /* wait for USB attach */
             yield();
+
+        gStallMonitor.leave(site);
         }
 
     // set up the LED
@@ -200,11 +308,18 @@ void setup_printSignOn()
 void setup_flash(void)
     {
     gSPI2.begin();
-    if (gFlash.begin(&gSPI2, Catena::PIN_SPI2_FLASH_SS))
+    bool const fFlash = gFlash.begin(&gSPI2, Catena::PIN_SPI2_FLASH_SS);
+
+    // from here on, the power manager switches SPI2 with the flash.
+    gPowerManager.setPresent(cPowerManager::Peripheral::kFlash, fFlash);
+    if (fFlash)
         {
-        gMeasurementLoop.registerSecondSpi(&gSPI2);
         gFlash.powerDown();
+        gSPI2.end();
         gCatena.SafePrintf("FLASH found, put power down\n");
+        gLoRaWANSession.begin();
+        gTouchCounters.begin();
+        gConfiguration.begin();
         }
     else
         {
@@ -219,11 +334,20 @@ void setup_radio()
     gLoRaWAN.begin(&gCatena);
     gCatena.registerObject(&gLoRaWAN);
     LMIC_setClockError(5 * MAX_CLOCK_ERROR / 100);
+
+    // configuration downlinks go to the measurement loop.
+    gLoRaWAN.SetReceiveBufferBufferCb(cMeasurementLoop::receiveMessageCb, &gMeasurementLoop);
+
+    // resume the session from before the reset, if any, to skip the join.
+    if (gLoRaWANSession.restore())
+        gCatena.SafePrintf("LoRaWAN session restored from FLASH\n");
     }
 
 void setup_measurement()
     {
     gMeasurementLoop.begin();
+    gIdleScheduler.registerSource(&gMeasurementLoop);
+    gStreamPort.begin();
     }
 
 void setup_commands()
@@ -254,5 +378,10 @@ void setup_start()
 
 void loop()
     {
+    gStallMonitor.beginIteration();
     gCatena.poll();
+    gStallMonitor.endIteration();
+
+    // sleep until something is due.
+    gIdleScheduler.idle();
     }
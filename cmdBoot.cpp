@@ -0,0 +1,80 @@
+/*
+
+Module:	cmdBoot.cpp
+
+Function:
+        Process the "boot" command
+
+Copyright and License:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#include "Catena4610_cmd.h"
+
+#include "TouchSense-Lorawan.h"
+
+using namespace McciCatena;
+using namespace McciCatena4610;
+
+/*
+
+Name:   ::cmdBoot()
+
+Function:
+        Command dispatcher for "boot" command.
+
+Definition:
+        McciCatena::cCommandStream::CommandFn cmdBoot;
+
+        McciCatena::cCommandStream::CommandStatus cmdBoot(
+            cCommandStream *pThis,
+            void *pContext,
+            int argc,
+            char **argv
+            );
+
+Description:
+        The "boot" command has the following syntax:
+
+        boot
+            Display the time at which each boot phase completed, in
+            milliseconds since reset, and the time taken by the phase.
+
+Returns:
+        cCommandStream::CommandStatus::kSuccess if successful.
+        Some other value for failure.
+
+*/
+
+// argv[0] is "boot"
+cCommandStream::CommandStatus cmdBoot(
+    cCommandStream *pThis,
+    void *pContext,
+    int argc,
+    char **argv
+    )
+    {
+    if (argc > 1)
+        return cCommandStream::CommandStatus::kInvalidParameter;
+
+    pThis->printf("%s boot\n", gBootProfile.isFastBoot() ? "fast" : "normal");
+
+    std::uint32_t msPrevious = 0;
+    for (std::size_t i = 0; i < gBootProfile.getCount(); ++i)
+        {
+        auto const &r = gBootProfile.getRecord(i);
+
+        pThis->printf("%-14s %8u ms (+%u)\n",
+            cBootProfile::getPhaseName(r.phase),
+            unsigned(r.ms),
+            unsigned(r.ms - msPrevious)
+            );
+        msPrevious = r.ms;
+        }
+
+    return cCommandStream::CommandStatus::kSuccess;
+    }
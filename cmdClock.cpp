@@ -0,0 +1,118 @@
+/*
+
+Module:	cmdClock.cpp
+
+Function:
+        Process the "clock" command
+
+Copyright and License:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#include "Catena4610_cmd.h"
+
+#include "TouchSense-Lorawan.h"
+
+#include <cstring>
+
+using namespace McciCatena;
+using namespace McciCatena4610;
+
+/*
+
+Name:   ::cmdClock()
+
+Function:
+        Command dispatcher for "clock" command.
+
+Definition:
+        McciCatena::cCommandStream::CommandFn cmdClock;
+
+        McciCatena::cCommandStream::CommandStatus cmdClock(
+            cCommandStream *pThis,
+            void *pContext,
+            int argc,
+            char **argv
+            );
+
+Description:
+        The "clock" command has the following syntax:
+
+        clock
+            Display the CPU clock level, the level wanted, and the time
+            spent at each level since boot (or the last reset).
+
+        clock on
+        clock off
+            Enable or disable clock scaling. While disabled, the clock
+            stays at the high level.
+
+        clock reset
+            Reset the counters.
+
+Returns:
+        cCommandStream::CommandStatus::kSuccess if successful.
+        Some other value for failure.
+
+*/
+
+// argv[0] is "clock"
+// argv[1], if present, is "on", "off" or "reset"
+cCommandStream::CommandStatus cmdClock(
+    cCommandStream *pThis,
+    void *pContext,
+    int argc,
+    char **argv
+    )
+    {
+    if (argc > 2)
+        return cCommandStream::CommandStatus::kInvalidParameter;
+
+    if (! gMeasurementLoop.kEnableClockScaling)
+        {
+        pThis->printf("clock scaling is disabled\n");
+        return cCommandStream::CommandStatus::kSuccess;
+        }
+
+    cClockPolicy &policy = gMeasurementLoop.getClockPolicy();
+
+    if (argc == 2)
+        {
+        if (std::strcmp(argv[1], "on") == 0)
+            policy.setEnabled(true);
+        else if (std::strcmp(argv[1], "off") == 0)
+            policy.setEnabled(false);
+        else if (std::strcmp(argv[1], "reset") == 0)
+            policy.resetStats(millis());
+        else
+            return cCommandStream::CommandStatus::kInvalidParameter;
+
+        return cCommandStream::CommandStatus::kSuccess;
+        }
+
+    policy.account(millis());
+
+    auto const &stats = policy.getStats();
+    cClockPolicy::Level const level = policy.getLevel();
+    cClockPolicy::Level const target = policy.getTarget();
+
+    pThis->printf("clock: %s (%u MHz)  wanted: %s  scaling: %s%s\n",
+        cClockPolicy::getLevelName(level),
+        unsigned(cClockPolicy::getHz(level) / (1000 * 1000)),
+        cClockPolicy::getLevelName(target),
+        policy.isEnabled() ? "on" : "off",
+        policy.isHeld() ? " (held high: USB power)" : ""
+        );
+    pThis->printf("low: %u s  high: %u s  switches: %u  deferred: %u\n",
+        unsigned(stats.ms[unsigned(cClockPolicy::Level::kLow)] / 1000),
+        unsigned(stats.ms[unsigned(cClockPolicy::Level::kHigh)] / 1000),
+        unsigned(stats.nSwitches),
+        unsigned(stats.nDeferred)
+        );
+
+    return cCommandStream::CommandStatus::kSuccess;
+    }
@@ -0,0 +1,179 @@
+/*
+
+Module:	cmdConfig.cpp
+
+Function:
+        Process the "config" command
+
+Copyright and License:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#include "Catena4610_cmd.h"
+
+#include "TouchSense-Lorawan.h"
+
+#include <cstring>
+
+using namespace McciCatena;
+using namespace McciCatena4610;
+
+using Config = cConfiguration::Config;
+
+// the settable fields, by name. Each is either 32 or 16 bits wide.
+struct ConfigField
+    {
+    const char              *pName;
+    std::uint32_t Config::  *p32;
+    std::uint16_t Config::  *p16;
+    };
+
+static const ConfigField sConfigFields[] =
+    {
+    { "txcycle",    &Config::txCycleSec,        nullptr },
+    { "fastcycle",  &Config::fastTxCycleSec,    nullptr },
+    { "fastcount",  &Config::fastTxCycleCount,  nullptr },
+    { "debug",      &Config::debugFlags,        nullptr },
+    { "right",      nullptr,                    &Config::thresholdRight },
+    { "left",       nullptr,                    &Config::thresholdLeft },
+    { "sample",     nullptr,                    &Config::samplePeriodMs },
+    { "hysteresis", nullptr,                    &Config::touchHysteresis },
+    { "debounce",   nullptr,                    &Config::touchDebounce },
+    };
+
+static std::uint32_t getField(const Config &c, const ConfigField &f)
+    {
+    return f.p32 != nullptr ? c.*f.p32 : c.*f.p16;
+    }
+
+/*
+
+Name:   ::cmdConfig()
+
+Function:
+        Command dispatcher for "config" command.
+
+Definition:
+        McciCatena::cCommandStream::CommandFn cmdConfig;
+
+        McciCatena::cCommandStream::CommandStatus cmdConfig(
+            cCommandStream *pThis,
+            void *pContext,
+            int argc,
+            char **argv
+            );
+
+Description:
+        The "config" command has the following syntax:
+
+        config
+            Display the configuration in use, and the state of the
+            copy saved in flash.
+
+        config {name} {value}
+            Set a value. The change takes effect at once and is saved.
+            The names are:
+                txcycle     uplink interval, in seconds
+                fastcycle   uplink interval after boot, in seconds
+                fastcount   number of uplinks at the fast interval
+                debug       measurement loop debug flags: 1 errors,
+                            2 warnings, 4 trace, 8 info; levels above
+                            CATENA4610_TRACE_LEVEL aren't compiled in
+                right       Ch1 touch threshold (right side)
+                left        Ch2 touch threshold (left side)
+                sample      sensor sampling period, in milliseconds
+                hysteresis  a touch is released only above its
+                            threshold plus this
+                debounce    samples in a row, 1 to 10, to count a
+                            touch or to release it
+
+        config defaults
+            Go back to the defaults, and forget the saved configuration.
+
+Returns:
+        cCommandStream::CommandStatus::kSuccess if successful.
+        Some other value for failure.
+
+*/
+
+// argv[0] is "config"
+// argv[1], if present, is a field name or "defaults"
+// argv[2], if present, is the new value.
+cCommandStream::CommandStatus cmdConfig(
+    cCommandStream *pThis,
+    void *pContext,
+    int argc,
+    char **argv
+    )
+    {
+    if (argc > 3)
+        return cCommandStream::CommandStatus::kInvalidParameter;
+
+    if (argc == 2)
+        {
+        if (std::strcmp(argv[1], "defaults") != 0)
+            return cCommandStream::CommandStatus::kInvalidParameter;
+
+        gConfiguration.reset();
+        pThis->printf("configuration set to defaults\n");
+        return cCommandStream::CommandStatus::kSuccess;
+        }
+
+    if (argc == 3)
+        {
+        const ConfigField *pField = nullptr;
+
+        for (auto const &f : sConfigFields)
+            {
+            if (std::strcmp(argv[1], f.pName) == 0)
+                {
+                pField = &f;
+                break;
+                }
+            }
+        if (pField == nullptr)
+            return cCommandStream::CommandStatus::kInvalidParameter;
+
+        cCommandStream::CommandStatus status;
+        std::uint32_t value;
+
+        status = cCommandStream::getuint32(argc, argv, 2, /* radix */ 0, value, /* default */ 0);
+        if (status != cCommandStream::CommandStatus::kSuccess)
+            return status;
+
+        Config c = gMeasurementLoop.getConfig();
+        if (pField->p32 != nullptr)
+            c.*pField->p32 = value;
+        else if (value <= 0xFFFF)
+            c.*pField->p16 = std::uint16_t(value);
+        else
+            return cCommandStream::CommandStatus::kInvalidParameter;
+
+        if (! gConfiguration.update(c))
+            {
+            pThis->printf("%s: value not allowed\n", argv[1]);
+            return cCommandStream::CommandStatus::kInvalidParameter;
+            }
+        }
+
+    Config const &c = gMeasurementLoop.getConfig();
+    for (auto const &f : sConfigFields)
+        pThis->printf("%-10s %u\n", f.pName, unsigned(getField(c, f)));
+
+    auto const &store = gConfiguration.getStore();
+    if (! gConfiguration.isEnabled())
+        pThis->printf("no FLASH: configuration not saved\n");
+    else if (! store.isValid())
+        pThis->printf("no saved configuration: defaults\n");
+    else
+        pThis->printf("saved: generation %u, sector %u\n",
+            unsigned(store.getGeneration()),
+            store.getSector()
+            );
+
+    return cCommandStream::CommandStatus::kSuccess;
+    }
@@ -0,0 +1,110 @@
+/*
+
+Module:	cmdCounters.cpp
+
+Function:
+        Process the "counters" command
+
+Copyright and License:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#include "Catena4610_cmd.h"
+
+#include "TouchSense-Lorawan.h"
+
+#include <cstring>
+
+using namespace McciCatena;
+using namespace McciCatena4610;
+
+/*
+
+Name:   ::cmdCounters()
+
+Function:
+        Command dispatcher for "counters" command.
+
+Definition:
+        McciCatena::cCommandStream::CommandFn cmdCounters;
+
+        McciCatena::cCommandStream::CommandStatus cmdCounters(
+            cCommandStream *pThis,
+            void *pContext,
+            int argc,
+            char **argv
+            );
+
+Description:
+        The "counters" command has the following syntax:
+
+        counters
+            Display the lifetime touch counts, the counts not yet covered
+            by a completed uplink, and the counter journal's statistics.
+
+        counters flush
+            Write the counters to flash now.
+
+        counters erase
+            Zero the counters, in flash too.
+
+Returns:
+        cCommandStream::CommandStatus::kSuccess if successful.
+        Some other value for failure.
+
+*/
+
+// argv[0] is "counters"
+// argv[1], if present, is "flush" or "erase"
+cCommandStream::CommandStatus cmdCounters(
+    cCommandStream *pThis,
+    void *pContext,
+    int argc,
+    char **argv
+    )
+    {
+    if (argc > 2)
+        return cCommandStream::CommandStatus::kInvalidParameter;
+
+    if (argc == 2)
+        {
+        if (std::strcmp(argv[1], "flush") == 0)
+            gTouchCounters.flush(/* fForce */ true);
+        else if (std::strcmp(argv[1], "erase") == 0)
+            gTouchCounters.erase();
+        else
+            return cCommandStream::CommandStatus::kInvalidParameter;
+        }
+
+    std::uint16_t unackedLeft, unackedRight;
+    gTouchCounters.getUnacked(unackedLeft, unackedRight);
+
+    pThis->printf("left: %u (%u unacked)  right: %u (%u unacked)\n",
+        unsigned(gTouchCounters.getLeft()),
+        unsigned(unackedLeft),
+        unsigned(gTouchCounters.getRight()),
+        unsigned(unackedRight)
+        );
+
+    if (! gTouchCounters.isEnabled())
+        {
+        pThis->printf("no flash: counters are not saved\n");
+        return cCommandStream::CommandStatus::kSuccess;
+        }
+
+    auto const &journal = gTouchCounters.getJournal();
+    auto const &stats = journal.getStats();
+    pThis->printf("journal: generation %u, %u/%u entries; %u writes, %u erases since boot\n",
+        unsigned(journal.getGeneration()),
+        unsigned(journal.getJournalCount()),
+        unsigned(journal.getJournalCapacity()),
+        unsigned(stats.nWrites),
+        unsigned(stats.nErases)
+        );
+
+    return cCommandStream::CommandStatus::kSuccess;
+    }
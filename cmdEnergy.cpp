@@ -0,0 +1,149 @@
+/*
+
+Module:	cmdEnergy.cpp
+
+Function:
+        Process the "energy" command
+
+Copyright and License:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#include "Catena4610_cmd.h"
+
+#include "TouchSense-Lorawan.h"
+
+#include <cstring>
+
+using namespace McciCatena;
+using namespace McciCatena4610;
+
+// print a charge in microamp-seconds as mAh, to three places.
+static void printMah(cCommandStream *pThis, std::uint64_t uAs)
+    {
+    std::uint32_t const uAh = std::uint32_t(uAs / 3600);
+
+    pThis->printf("%u.%03u mAh", unsigned(uAh / 1000), unsigned(uAh % 1000));
+    }
+
+/*
+
+Name:   ::cmdEnergy()
+
+Function:
+        Command dispatcher for "energy" command.
+
+Definition:
+        McciCatena::cCommandStream::CommandFn cmdEnergy;
+
+        McciCatena::cCommandStream::CommandStatus cmdEnergy(
+            cCommandStream *pThis,
+            void *pContext,
+            int argc,
+            char **argv
+            );
+
+Description:
+        The "energy" command has the following syntax:
+
+        energy
+            Display the time and charge accounted to each activity since
+            boot, the average current, the projected battery life, and
+            the battery model's estimate.
+
+        energy current {category} [{uA}]
+            Display or set the current used for an activity.
+
+Returns:
+        cCommandStream::CommandStatus::kSuccess if successful.
+        Some other value for failure.
+
+*/
+
+// argv[0] is "energy"
+// argv[1], if present, must be "current"
+cCommandStream::CommandStatus cmdEnergy(
+    cCommandStream *pThis,
+    void *pContext,
+    int argc,
+    char **argv
+    )
+    {
+    auto &meter = gMeasurementLoop.getEnergyMeter();
+
+    if (argc > 1)
+        {
+        if (argc > 4 || std::strcmp(argv[1], "current") != 0)
+            return cCommandStream::CommandStatus::kInvalidParameter;
+
+        if (argc < 3)
+            return cCommandStream::CommandStatus::kInvalidParameter;
+
+        // find the category by name.
+        std::size_t i;
+        for (i = 0; i < cEnergyMeter::kCategories; ++i)
+            {
+            if (std::strcmp(argv[2], cEnergyMeter::getCategoryName(cEnergyMeter::Category(i))) == 0)
+                break;
+            }
+        if (i == cEnergyMeter::kCategories)
+            return cCommandStream::CommandStatus::kInvalidParameter;
+
+        auto const category = cEnergyMeter::Category(i);
+        if (argc == 4)
+            {
+            cCommandStream::CommandStatus status;
+            std::uint32_t uA;
+
+            status = cCommandStream::getuint32(argc, argv, 3, /* radix */ 0, uA, /* default */ 0);
+            if (status != cCommandStream::CommandStatus::kSuccess)
+                return status;
+
+            meter.setCurrent(category, uA);
+            }
+
+        pThis->printf("%s: %u uA\n", argv[2], unsigned(meter.getCurrent(category)));
+        return cCommandStream::CommandStatus::kSuccess;
+        }
+
+    auto const &stats = meter.getStats();
+    for (std::size_t i = 0; i < cEnergyMeter::kCategories; ++i)
+        {
+        pThis->printf("%-10s %8u s %6u uA  ",
+            cEnergyMeter::getCategoryName(cEnergyMeter::Category(i)),
+            unsigned(stats.ms[i] / 1000),
+            unsigned(meter.getCurrent(cEnergyMeter::Category(i)))
+            );
+        printMah(pThis, stats.uAs[i]);
+        pThis->printf("\n");
+        }
+
+    pThis->printf("total: ");
+    printMah(pThis, meter.getTotalUas());
+    pThis->printf(" over %u uplinks; average %u uA\n",
+        unsigned(stats.nUplinks),
+        unsigned(meter.getAverageUa())
+        );
+
+    auto const &battery = gMeasurementLoop.getBatteryModel();
+    cBatteryModel::Estimate e;
+
+    battery.getEstimate(e);
+    pThis->printf("projected life: %u days on %u mAh\n",
+        unsigned(meter.getProjectedLifeDays(battery.getCapacity())),
+        unsigned(battery.getCapacity())
+        );
+    pThis->printf("battery: %u mV (%d mV/day), %u%% left, ~%u days, interval x%u\n",
+        unsigned(e.vbatMv),
+        int(e.slopeMvPerDay),
+        unsigned(e.percent),
+        unsigned(e.remainingDays),
+        unsigned(e.stretch)
+        );
+
+    return cCommandStream::CommandStatus::kSuccess;
+    }
@@ -0,0 +1,93 @@
+/*
+
+Module:	cmdIdle.cpp
+
+Function:
+        Process the "idle" command
+
+Copyright and License:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#include "Catena4610_cmd.h"
+
+#include "TouchSense-Lorawan.h"
+
+#include <cstring>
+
+using namespace McciCatena;
+
+/*
+
+Name:   ::cmdIdle()
+
+Function:
+        Command dispatcher for "idle" command.
+
+Definition:
+        McciCatena::cCommandStream::CommandFn cmdIdle;
+
+        McciCatena::cCommandStream::CommandStatus cmdIdle(
+            cCommandStream *pThis,
+            void *pContext,
+            int argc,
+            char **argv
+            );
+
+Description:
+        The "idle" command has the following syntax:
+
+        idle
+            Display the CPU duty cycle and estimated average CPU current
+            since boot (or the last reset of the counters).
+
+        idle reset
+            Reset the counters.
+
+Returns:
+        cCommandStream::CommandStatus::kSuccess if successful.
+        Some other value for failure.
+
+*/
+
+// argv[0] is "idle"
+// argv[1], if present, must be "reset"
+cCommandStream::CommandStatus cmdIdle(
+    cCommandStream *pThis,
+    void *pContext,
+    int argc,
+    char **argv
+    )
+    {
+    if (argc > 2)
+        return cCommandStream::CommandStatus::kInvalidParameter;
+
+    if (argc == 2)
+        {
+        if (std::strcmp(argv[1], "reset") != 0)
+            return cCommandStream::CommandStatus::kInvalidParameter;
+
+        gIdleScheduler.resetStats();
+        return cCommandStream::CommandStatus::kSuccess;
+        }
+
+    auto const &stats = gIdleScheduler.getStats();
+    std::uint32_t const permille = gIdleScheduler.getDutyCyclePermille();
+
+    pThis->printf("awake: %u ms  idle: %u ms  (%u idle periods)\n",
+        unsigned(stats.usAwake / 1000),
+        unsigned(stats.usIdle / 1000),
+        unsigned(stats.nIdle)
+        );
+    pThis->printf("duty cycle: %u.%u%%  average CPU current: %u uA\n",
+        unsigned(permille / 10),
+        unsigned(permille % 10),
+        unsigned(gIdleScheduler.getAverageCurrentUa())
+        );
+
+    return cCommandStream::CommandStatus::kSuccess;
+    }
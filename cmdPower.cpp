@@ -0,0 +1,109 @@
+/*
+
+Module:	cmdPower.cpp
+
+Function:
+        Process the "power" command
+
+Copyright and License:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#include "Catena4610_cmd.h"
+
+#include "TouchSense-Lorawan.h"
+
+#include <cstring>
+
+using namespace McciCatena;
+using namespace McciCatena4610;
+
+/*
+
+Name:   ::cmdPower()
+
+Function:
+        Command dispatcher for "power" command.
+
+Definition:
+        McciCatena::cCommandStream::CommandFn cmdPower;
+
+        McciCatena::cCommandStream::CommandStatus cmdPower(
+            cCommandStream *pThis,
+            void *pContext,
+            int argc,
+            char **argv
+            );
+
+Description:
+        The "power" command has the following syntax:
+
+        power
+            Display, for each peripheral, whether it's powered, its
+            references, how often it was powered up and for how long;
+            and the time from waking to the first sensor sample.
+
+        power reset
+            Reset the counters.
+
+Returns:
+        cCommandStream::CommandStatus::kSuccess if successful.
+        Some other value for failure.
+
+*/
+
+// argv[0] is "power"
+// argv[1], if present, is "reset"
+cCommandStream::CommandStatus cmdPower(
+    cCommandStream *pThis,
+    void *pContext,
+    int argc,
+    char **argv
+    )
+    {
+    using Peripheral = cPowerManager::Peripheral;
+
+    if (argc > 2)
+        return cCommandStream::CommandStatus::kInvalidParameter;
+
+    if (argc == 2)
+        {
+        if (std::strcmp(argv[1], "reset") != 0)
+            return cCommandStream::CommandStatus::kInvalidParameter;
+
+        gPowerManager.resetStats();
+        return cCommandStream::CommandStatus::kSuccess;
+        }
+
+    gPowerManager.account();
+
+    for (std::size_t i = 0; i < cPowerManager::kPeripherals; ++i)
+        {
+        auto const p = Peripheral(i);
+        auto const &stats = gPowerManager.getStats(p);
+
+        pThis->printf("%-8s %-3s refs %u  power-ups %u  on %u s\n",
+            cPowerManager::getPeripheralName(p),
+            gPowerManager.isOn(p) ? "on" : "off",
+            unsigned(gPowerManager.getRefs(p)),
+            unsigned(stats.nPowerUps),
+            unsigned(stats.msOn / 1000)
+            );
+        }
+
+    auto const &wake = gPowerManager.getWakeStats();
+
+    pThis->printf("wakes: %u  sampled: %u  wake to sample: last %u ms  max %u ms  avg %u ms\n",
+        unsigned(wake.nWakes),
+        unsigned(wake.nSampled),
+        unsigned(wake.msLast),
+        unsigned(wake.msMax),
+        unsigned(wake.nSampled ? wake.msTotal / wake.nSampled : 0)
+        );
+
+    return cCommandStream::CommandStatus::kSuccess;
+    }
@@ -0,0 +1,82 @@
+/*
+
+Module:	cmdQueue.cpp
+
+Function:
+        Process the "queue" command
+
+Copyright and License:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#include "Catena4610_cmd.h"
+
+#include "TouchSense-Lorawan.h"
+
+using namespace McciCatena;
+
+/*
+
+Name:   ::cmdQueue()
+
+Function:
+        Command dispatcher for "queue" command.
+
+Definition:
+        McciCatena::cCommandStream::CommandFn cmdQueue;
+
+        McciCatena::cCommandStream::CommandStatus cmdQueue(
+            cCommandStream *pThis,
+            void *pContext,
+            int argc,
+            char **argv
+            );
+
+Description:
+        The "queue" command has the following syntax:
+
+        queue
+            Display the uplink queue depth and counters.
+
+Returns:
+        cCommandStream::CommandStatus::kSuccess if successful.
+        Some other value for failure.
+
+*/
+
+// argv[0] is "queue"
+cCommandStream::CommandStatus cmdQueue(
+    cCommandStream *pThis,
+    void *pContext,
+    int argc,
+    char **argv
+    )
+    {
+    if (argc > 1)
+        return cCommandStream::CommandStatus::kInvalidParameter;
+
+    auto const &queue = gMeasurementLoop.getUplinkQueue();
+    auto const &stats = queue.getStats();
+
+    pThis->printf("depth: %u/%u (max %u)%s\n",
+        stats.depth,
+        unsigned(queue.kSlots),
+        stats.maxDepth,
+        queue.isBusy() ? ", sending" : ""
+        );
+    pThis->printf("queued: %u  coalesced: %u  sent: %u\n",
+        unsigned(stats.nQueued),
+        unsigned(stats.nCoalesced),
+        unsigned(stats.nSent)
+        );
+    pThis->printf("retries: %u  dropped: %u\n",
+        unsigned(stats.nRetries),
+        unsigned(stats.nDropped)
+        );
+
+    return cCommandStream::CommandStatus::kSuccess;
+    }
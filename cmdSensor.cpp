@@ -0,0 +1,135 @@
+/*
+
+Module:	cmdSensor.cpp
+
+Function:
+        Process the "sensor" command
+
+Copyright and License:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#include "Catena4610_cmd.h"
+
+#include "TouchSense-Lorawan.h"
+
+#include <cstring>
+
+using namespace McciCatena;
+
+/*
+
+Name:   ::cmdSensor()
+
+Function:
+        Command dispatcher for "sensor" command.
+
+Definition:
+        McciCatena::cCommandStream::CommandFn cmdSensor;
+
+        McciCatena::cCommandStream::CommandStatus cmdSensor(
+            cCommandStream *pThis,
+            void *pContext,
+            int argc,
+            char **argv
+            );
+
+Description:
+        The "sensor" command has the following syntax:
+
+        sensor
+            Display the touch sensor read statistics since boot (or the
+            last reset): the number of reads, errors and reads that
+            hadn't finished by the next sample; and the average and
+            longest time per read, and CPU time per read, in
+            microseconds.
+
+            With a sensor array, display instead, for each sensor,
+            whether it's present and touched, its reads and errors, and
+            its reads per hundred sampling periods; and the rounds,
+            overruns (rounds that ended with sensors unread) and mux
+            switches.
+
+        sensor reset
+            Reset the statistics.
+
+Returns:
+        cCommandStream::CommandStatus::kSuccess if successful.
+        Some other value for failure.
+
+*/
+
+// argv[0] is "sensor"
+// argv[1], if present, must be "reset"
+cCommandStream::CommandStatus cmdSensor(
+    cCommandStream *pThis,
+    void *pContext,
+    int argc,
+    char **argv
+    )
+    {
+    if (argc > 2)
+        return cCommandStream::CommandStatus::kInvalidParameter;
+
+    if (argc == 2)
+        {
+        if (std::strcmp(argv[1], "reset") != 0)
+            return cCommandStream::CommandStatus::kInvalidParameter;
+
+        gMeasurementLoop.resetSensorStats();
+        return cCommandStream::CommandStatus::kSuccess;
+        }
+
+#if CATENA4610_ARRAY_SENSORS != 0
+        {
+        auto const &array = gMeasurementLoop.getSensorArray();
+        auto const &stats = array.getStats();
+        std::uint32_t const nRounds = stats.nRounds != 0 ? stats.nRounds : 1;
+
+        for (std::size_t i = 0; i < array.getSensorCount(); ++i)
+            {
+            pThis->printf("%u: %s%s  reads: %u  errors: %u  per 100 periods: %u\n",
+                unsigned(i),
+                (array.getPresent() & (1u << i)) ? "present" : "missing",
+                (array.getTouching() & (1u << i)) ? " touched" : "",
+                unsigned(array.getReads(i)),
+                unsigned(array.getErrors(i)),
+                unsigned(std::uint64_t(array.getReads(i)) * 100 / nRounds)
+                );
+            }
+        pThis->printf("rounds: %u  overruns: %u  mux switches: %u\n",
+            unsigned(stats.nRounds),
+            unsigned(stats.nOverruns),
+            unsigned(stats.nMuxSwitches)
+            );
+        return cCommandStream::CommandStatus::kSuccess;
+        }
+#endif
+
+    if (! gMeasurementLoop.kEnableBurstRead)
+        {
+        pThis->printf("burst reads are disabled\n");
+        return cCommandStream::CommandStatus::kSuccess;
+        }
+
+    auto const &stats = gMeasurementLoop.getSensorReader().getStats();
+    std::uint32_t const n = stats.nReads != 0 ? stats.nReads : 1;
+
+    pThis->printf("reads: %u  errors: %u  late: %u\n",
+        unsigned(stats.nReads),
+        unsigned(stats.nErrors),
+        unsigned(stats.nBusy)
+        );
+    pThis->printf("time per read: %u us (max %u)  CPU time per read: %u us (max %u)\n",
+        unsigned(stats.usTotal / n),
+        unsigned(stats.usMax),
+        unsigned(stats.usCpuTotal / n),
+        unsigned(stats.usCpuMax)
+        );
+
+    return cCommandStream::CommandStatus::kSuccess;
+    }
@@ -0,0 +1,108 @@
+/*
+
+Module:	cmdSession.cpp
+
+Function:
+        Process the "session" command
+
+Copyright and License:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#include "Catena4610_cmd.h"
+
+#include "TouchSense-Lorawan.h"
+
+#include <arduino_lmic.h>
+#include <cstring>
+
+using namespace McciCatena;
+
+/*
+
+Name:   ::cmdSession()
+
+Function:
+        Command dispatcher for "session" command.
+
+Definition:
+        McciCatena::cCommandStream::CommandFn cmdSession;
+
+        McciCatena::cCommandStream::CommandStatus cmdSession(
+            cCommandStream *pThis,
+            void *pContext,
+            int argc,
+            char **argv
+            );
+
+Description:
+        The "session" command has the following syntax:
+
+        session
+            Display the state of the LoRaWAN session saved in flash.
+
+        session erase
+            Forget the saved session, so the next reset joins again.
+
+Returns:
+        cCommandStream::CommandStatus::kSuccess if successful.
+        Some other value for failure.
+
+*/
+
+// argv[0] is "session"
+// argv[1], if present, must be "erase"
+cCommandStream::CommandStatus cmdSession(
+    cCommandStream *pThis,
+    void *pContext,
+    int argc,
+    char **argv
+    )
+    {
+    if (argc > 2)
+        return cCommandStream::CommandStatus::kInvalidParameter;
+
+    if (! gLoRaWANSession.isEnabled())
+        {
+        pThis->printf("no FLASH: session not saved\n");
+        return cCommandStream::CommandStatus::kError;
+        }
+
+    if (argc == 2)
+        {
+        if (std::strcmp(argv[1], "erase") != 0)
+            return cCommandStream::CommandStatus::kInvalidParameter;
+
+        gLoRaWANSession.erase();
+        pThis->printf("saved session erased; not saved again until the next join\n");
+        return cCommandStream::CommandStatus::kSuccess;
+        }
+
+    auto const &store = gLoRaWANSession.getStore();
+
+    if (! store.isValid())
+        {
+        pThis->printf(store.isHeld() ? "no saved session (erased; saved again after the next join)\n"
+                                     : "no saved session\n");
+        }
+    else
+        {
+        pThis->printf("generation: %u  journal: %u/%u\n",
+            unsigned(store.getGeneration()),
+            unsigned(store.getJournalCount()),
+            unsigned(store.getJournalCapacity())
+            );
+        }
+
+    pThis->printf("devaddr: %08x  seqnoUp: %u  seqnoDn: %u\n",
+        unsigned(LMIC.devaddr),
+        unsigned(LMIC.seqnoUp),
+        unsigned(LMIC.seqnoDn)
+        );
+
+    return cCommandStream::CommandStatus::kSuccess;
+    }
@@ -0,0 +1,116 @@
+/*
+
+Module:	cmdStall.cpp
+
+Function:
+        Process the "stall" command
+
+Copyright and License:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#include "Catena4610_cmd.h"
+
+#include "TouchSense-Lorawan.h"
+
+#include <cstdlib>
+#include <cstring>
+
+using namespace McciCatena;
+using namespace McciCatena4610;
+
+/*
+
+Name:   ::cmdStall()
+
+Function:
+        Command dispatcher for "stall" command.
+
+Definition:
+        McciCatena::cCommandStream::CommandFn cmdStall;
+
+        McciCatena::cCommandStream::CommandStatus cmdStall(
+            cCommandStream *pThis,
+            void *pContext,
+            int argc,
+            char **argv
+            );
+
+Description:
+        The "stall" command has the following syntax:
+
+        stall [n]
+            Display the loop iteration counts, the watchdog kicks, and
+            the n worst stalls (default all that are kept), longest
+            first: how long, when, where, and the FSM state.
+
+        stall reset
+            Reset the counters and forget the stalls.
+
+Returns:
+        cCommandStream::CommandStatus::kSuccess if successful.
+        Some other value for failure.
+
+*/
+
+// argv[0] is "stall"
+// argv[1], if present, is a count or "reset"
+cCommandStream::CommandStatus cmdStall(
+    cCommandStream *pThis,
+    void *pContext,
+    int argc,
+    char **argv
+    )
+    {
+    std::size_t nShow = cStallMonitor::kRecords;
+
+    if (argc > 2)
+        return cCommandStream::CommandStatus::kInvalidParameter;
+
+    if (argc == 2)
+        {
+        if (std::strcmp(argv[1], "reset") == 0)
+            {
+            gStallMonitor.resetStats();
+            return cCommandStream::CommandStatus::kSuccess;
+            }
+
+        char *pEnd;
+        unsigned long const n = std::strtoul(argv[1], &pEnd, 0);
+
+        if (*pEnd != '\0' || n == 0)
+            return cCommandStream::CommandStatus::kInvalidParameter;
+        nShow = n;
+        }
+
+    auto const &stats = gStallMonitor.getStats();
+
+    pThis->printf("iterations: %u  stalls: %u  longest: %u ms\n",
+        unsigned(stats.nIterations),
+        unsigned(stats.nStalls),
+        unsigned(stats.msMax)
+        );
+    pThis->printf("watchdog kicks: %u  missed: %u\n",
+        unsigned(stats.nKicks),
+        unsigned(stats.nMissedKicks)
+        );
+
+    std::size_t const n = gStallMonitor.getCount();
+    for (std::size_t i = 0; i < n && i < nShow; ++i)
+        {
+        auto const &r = gStallMonitor.getRecord(i);
+
+        pThis->printf("%8u ms  at %8u ms  %-10s %s\n",
+            unsigned(r.ms),
+            unsigned(r.tStart),
+            cStallMonitor::getSiteName(r.site),
+            cMeasurementLoop::getStateName(cMeasurementLoop::State(r.state))
+            );
+        }
+
+    return cCommandStream::CommandStatus::kSuccess;
+    }
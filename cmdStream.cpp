@@ -0,0 +1,107 @@
+/*
+
+Module:	cmdStream.cpp
+
+Function:
+        Process the "stream" command
+
+Copyright and License:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#include "Catena4610_cmd.h"
+
+#include "TouchSense-Lorawan.h"
+
+#include <cstring>
+
+using namespace McciCatena;
+using namespace McciCatena4610;
+
+/*
+
+Name:   ::cmdStream()
+
+Function:
+        Command dispatcher for "stream" command.
+
+Definition:
+        McciCatena::cCommandStream::CommandFn cmdStream;
+
+        McciCatena::cCommandStream::CommandStatus cmdStream(
+            cCommandStream *pThis,
+            void *pContext,
+            int argc,
+            char **argv
+            );
+
+Description:
+        The "stream" command has the following syntax:
+
+        stream on
+            Start sending every touch sensor sample to this port as
+            binary frames (see Catena4610_cSampleStream.h), for capture
+            with extra/catena-stream-capture. Text written to the port
+            while streaming is skipped by the capture tool.
+
+        stream off
+            Stop sending samples.
+
+        stream
+            Display the samples sent and dropped, and the throughput.
+
+Returns:
+        cCommandStream::CommandStatus::kSuccess if successful.
+        Some other value for failure.
+
+*/
+
+// argv[0] is "stream"
+// argv[1], if present, is "on" or "off"
+cCommandStream::CommandStatus cmdStream(
+    cCommandStream *pThis,
+    void *pContext,
+    int argc,
+    char **argv
+    )
+    {
+    if (argc > 2)
+        return cCommandStream::CommandStatus::kInvalidParameter;
+
+    if (argc == 2)
+        {
+        if (std::strcmp(argv[1], "on") == 0)
+            {
+            gStreamPort.start();
+            return cCommandStream::CommandStatus::kSuccess;
+            }
+        else if (std::strcmp(argv[1], "off") == 0)
+            gStreamPort.stop();
+        else
+            return cCommandStream::CommandStatus::kInvalidParameter;
+        }
+
+    auto const &stats = gStreamPort.getStats();
+    std::uint32_t const ms = gStreamPort.getElapsedMs(millis());
+    std::uint32_t const bytesPerSec = ms == 0 ? 0 : std::uint32_t(std::uint64_t(stats.nBytes) * 1000 / ms);
+    std::uint32_t const centiHz = ms == 0 ? 0 : std::uint32_t(std::uint64_t(stats.nSamples - stats.nDropped) * 100000 / ms);
+
+    pThis->printf("stream %s: %u samples, %u dropped, %u frames in %u ms\n",
+        gStreamPort.isRunning() ? "on" : "off",
+        unsigned(stats.nSamples),
+        unsigned(stats.nDropped),
+        unsigned(stats.nFrames),
+        unsigned(ms)
+        );
+    pThis->printf("throughput: %u.%02u samples/s, %u bytes/s\n",
+        unsigned(centiHz / 100),
+        unsigned(centiHz % 100),
+        unsigned(bytesPerSec)
+        );
+
+    return cCommandStream::CommandStatus::kSuccess;
+    }
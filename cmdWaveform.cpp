@@ -0,0 +1,157 @@
+/*
+
+Module:	cmdWaveform.cpp
+
+Function:
+        Process the "waveform" command
+
+Copyright and License:
+        See accompanying LICENSE file for copyright and license information.
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#include "Catena4610_cmd.h"
+
+#include "TouchSense-Lorawan.h"
+
+#include <cstring>
+
+using namespace McciCatena;
+using namespace McciCatena4610;
+
+using Waveform = cMeasurementLoop::WaveformCapture_t;
+
+static const char *getStateName(Waveform::State s)
+    {
+    switch (s)
+        {
+    case Waveform::State::kIdle:    return "idle";
+    case Waveform::State::kPost:    return "capturing";
+    case Waveform::State::kUpload:  return "uploading";
+    default:                        return "<<unknown>>";
+        }
+    }
+
+/*
+
+Name:   ::cmdWaveform()
+
+Function:
+        Command dispatcher for "waveform" command.
+
+Definition:
+        McciCatena::cCommandStream::CommandFn cmdWaveform;
+
+        McciCatena::cCommandStream::CommandStatus cmdWaveform(
+            cCommandStream *pThis,
+            void *pContext,
+            int argc,
+            char **argv
+            );
+
+Description:
+        The "waveform" command has the following syntax:
+
+        waveform
+            Display the capture state and counters.
+
+        waveform on
+        waveform off
+            Enable or disable captures.
+
+        waveform trigger
+            Capture now, ignoring the holdoff.
+
+        waveform holdoff {minutes}
+            Set the least time between captures.
+
+        waveform spike {counts}
+            Set the change in amplitude between samples that triggers a
+            capture; 0 turns amplitude triggers off.
+
+        Settings last until the next reset.
+
+Returns:
+        cCommandStream::CommandStatus::kSuccess if successful.
+        Some other value for failure.
+
+*/
+
+// argv[0] is "waveform"
+// argv[1], if present, is the subcommand
+// argv[2], if present, is the value
+cCommandStream::CommandStatus cmdWaveform(
+    cCommandStream *pThis,
+    void *pContext,
+    int argc,
+    char **argv
+    )
+    {
+    auto &waveform = gMeasurementLoop.getWaveformCapture();
+
+    if (argc > 3)
+        return cCommandStream::CommandStatus::kInvalidParameter;
+
+    if (argc == 3)
+        {
+        cCommandStream::CommandStatus status;
+        std::uint32_t value;
+
+        status = cCommandStream::getuint32(argc, argv, 2, /* radix */ 0, value, /* default */ 0);
+        if (status != cCommandStream::CommandStatus::kSuccess)
+            return status;
+
+        if (std::strcmp(argv[1], "holdoff") == 0 && value <= 24 * 60)
+            waveform.setHoldoff(value * 60 * 1000);
+        else if (std::strcmp(argv[1], "spike") == 0 && value <= 0xFFFF)
+            waveform.setSpikeDelta(std::uint16_t(value));
+        else
+            return cCommandStream::CommandStatus::kInvalidParameter;
+        }
+    else if (argc == 2)
+        {
+        if (std::strcmp(argv[1], "on") == 0)
+            waveform.setEnabled(true);
+        else if (std::strcmp(argv[1], "off") == 0)
+            waveform.setEnabled(false);
+        else if (std::strcmp(argv[1], "trigger") == 0)
+            {
+            if (! waveform.trigger(millis(), Waveform::Reason::kManual, /* fForce */ true))
+                {
+                pThis->printf("can't capture now: %s\n",
+                    waveform.isEnabled() ? getStateName(waveform.getState()) : "off"
+                    );
+                return cCommandStream::CommandStatus::kError;
+                }
+            }
+        else
+            return cCommandStream::CommandStatus::kInvalidParameter;
+        }
+
+    auto const &stats = waveform.getStats();
+
+    pThis->printf("waveform %s: %s",
+        waveform.isEnabled() ? "on" : "off",
+        getStateName(waveform.getState())
+        );
+    if (waveform.hasFragment())
+        pThis->printf(", fragment %u of %u",
+            waveform.getFragmentIndex() + 1u,
+            unsigned(waveform.getFragmentCount())
+            );
+    pThis->printf("\n");
+    pThis->printf("holdoff %u min, spike %u; %u captures, %u suppressed, %u fragments, %u abandoned, last %u bytes\n",
+        unsigned(waveform.getHoldoff() / (60 * 1000)),
+        unsigned(waveform.getSpikeDelta()),
+        unsigned(stats.nTriggers),
+        unsigned(stats.nSuppressed),
+        unsigned(stats.nFragments),
+        unsigned(stats.nAborted),
+        unsigned(stats.lastBlobBytes)
+        );
+
+    return cCommandStream::CommandStatus::kSuccess;
+    }
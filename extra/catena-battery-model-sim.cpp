@@ -0,0 +1,233 @@
+/*
+
+Name:   catena-battery-model-sim.cpp
+
+Function:
+        Run cBatteryModel over months of virtual service, as the
+        measurement loop drives it, against a simulated cell.
+
+Copyright and License:
+        See accompanying LICENSE file
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+Usage:
+        g++ -std=c++14 -O2 -o catena-battery-model-sim catena-battery-model-sim.cpp
+
+        catena-battery-model-sim [capacity-mAh [target-days [error-percent [seed]]]]
+
+        Each uplink interval (6 minutes, times the model's stretch) is
+        accounted by a cEnergyMeter as the sketch accounts it: kMeasureMs
+        measuring, then transmitting at SF7 until the second receive window
+        has closed, then deep sleep for the rest. After each measurement
+        the model is given the charge the meter counted, the battery
+        voltage and the service time, and switches the boost regulator, as
+        updateSynchronousMeasurements() does.
+
+        The cell (default 300 mAh) really delivers error-percent (default
+        10) more charge than the meter's current figures say, as a unit
+        whose currents are underestimated would. Its voltage follows a
+        LiPo discharge curve from the charge really drawn, with +/-15 mV of
+        noise on each reading.
+
+        The run goes on until the cell is flat, and prints the model's
+        state every 30 days. The unit must last at least 90% of the target
+        life (default 365 days), the stretch must stay within 1 and
+        kMaxStretch, and the boost regulator must not chatter near its
+        threshold. A second run, with ten times the capacity, must never
+        stretch the interval at all.
+
+*/
+
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+#include "../Catena4610_cBatteryModel.h"
+#include "../Catena4610_cEnergyMeter.h"
+
+using McciCatena4610::cBatteryModel;
+using McciCatena4610::cEnergyMeter;
+
+using Category = cEnergyMeter::Category;
+
+// cMeasurementLoop::kDefaultTxCycleSec
+constexpr std::uint32_t kTxCycleSec = 6 * 60;
+constexpr std::uint32_t kMeasureMs = 100;
+constexpr std::uint8_t kPayloadBytes = 24;
+constexpr std::uint8_t kSf = 7;
+// the second receive window opens this long after the uplink ends.
+constexpr std::uint32_t kRx2DelayMs = 2000;
+constexpr std::uint32_t kSecPerDay = cBatteryModel::kSecPerDay;
+
+// open-circuit voltage of a LiPo cell by charge left, in percent.
+static std::uint32_t getCellMv(std::uint32_t percent)
+    {
+    static const struct { std::uint32_t percent, mV; } kCurve[] =
+        {
+        { 0, 3000 }, { 3, 3300 }, { 5, 3450 }, { 10, 3550 }, { 20, 3650 },
+        { 40, 3730 }, { 60, 3800 }, { 80, 3920 }, { 100, 4150 },
+        };
+
+    for (std::size_t i = 1; i < sizeof(kCurve) / sizeof(kCurve[0]); ++i)
+        {
+        if (percent <= kCurve[i].percent)
+            {
+            auto const &lo = kCurve[i - 1];
+            auto const &hi = kCurve[i];
+
+            return lo.mV + (hi.mV - lo.mV) * (percent - lo.percent) / (hi.percent - lo.percent);
+            }
+        }
+    return kCurve[sizeof(kCurve) / sizeof(kCurve[0]) - 1].mV;
+    }
+
+struct Result
+    {
+    std::uint32_t   lifeDays;
+    std::uint32_t   maxStretch;
+    std::uint32_t   nBoostSwitches;
+    unsigned        nFail;
+    };
+
+static Result run(
+    std::uint32_t capacityMah,
+    std::uint32_t targetDays,
+    std::uint32_t errorPercent,
+    bool fVerbose,
+    std::mt19937 &rng
+    )
+    {
+    cEnergyMeter meter;
+    cBatteryModel model;
+    Result r {};
+
+    std::uint32_t const msTx = cEnergyMeter::getAirtimeUs(kSf, 125, kPayloadBytes + cEnergyMeter::kLoRaWANOverhead) / 1000 +
+                               kRx2DelayMs +
+                               cEnergyMeter::kRxWindowSymbols * cEnergyMeter::getSymbolUs(kSf, 125) / 1000;
+    std::uint64_t const capacityUas = std::uint64_t(capacityMah) * cBatteryModel::kUasPerMah;
+    std::uniform_int_distribution<int> noise(-15, 15);
+
+    std::uint64_t msElapsed = 0;
+    std::uint64_t uAsModel = 0;
+    std::uint32_t nextReportDay = 0;
+    bool fBoost = false;
+
+    model.setCapacity(capacityMah);
+    model.setTargetLife(targetDays);
+
+    if (fVerbose)
+        std::cout << "  day  used mAh  avg uA  mV/day  predicted days  Vbat  %  stretch  boost\n";
+
+    for (;;)
+        {
+        std::uint32_t const txCycleSec = kTxCycleSec * model.getStretch();
+
+        meter.account(Category::kMeasure, kMeasureMs);
+        meter.account(Category::kTransmit, msTx);
+        meter.accountUplink(kSf, 125, kPayloadBytes);
+        meter.account(Category::kDeepSleep, txCycleSec * 1000 - kMeasureMs - msTx);
+        msElapsed += txCycleSec * 1000;
+
+        // the cell sees the real draw.
+        std::uint64_t const uAsReal = meter.getTotalUas() * (100 + errorPercent) / 100;
+        if (uAsReal >= capacityUas)
+            break;
+
+        std::uint32_t const percent = std::uint32_t((capacityUas - uAsReal) * 100 / capacityUas);
+        std::uint16_t const vbatMv = std::uint16_t(int(getCellMv(percent)) + noise(rng));
+
+        if (vbatMv < cBatteryModel::kEmptyMv)
+            break;
+
+        // as updateSynchronousMeasurements() and updateBatteryModel() do.
+        model.sampleVbat(vbatMv);
+        model.consume(meter.getTotalUas() - uAsModel);
+        uAsModel = meter.getTotalUas();
+        model.update(std::uint32_t(meter.getElapsedMs() / 1000));
+
+        if (model.updateBoost(vbatMv, false) != fBoost)
+            {
+            fBoost = ! fBoost;
+            ++r.nBoostSwitches;
+            }
+
+        if (model.getStretch() < 1 || model.getStretch() > cBatteryModel::kMaxStretch)
+            {
+            std::cerr << "stretch " << unsigned(model.getStretch()) << " out of range\n";
+            ++r.nFail;
+            }
+        if (model.getStretch() > r.maxStretch)
+            r.maxStretch = model.getStretch();
+
+        std::uint32_t const day = std::uint32_t(msElapsed / 1000 / kSecPerDay);
+        if (fVerbose && day >= nextReportDay)
+            {
+            cBatteryModel::Estimate e;
+
+            model.getEstimate(e);
+            std::cout << std::setw(5) << day << std::setw(10) << e.usedMah << std::setw(8) << e.averageUa
+                      << std::setw(8) << e.slopeMvPerDay << std::setw(16)
+                      << (e.remainingDays == ~std::uint32_t(0) ? std::string("-") : std::to_string(e.remainingDays))
+                      << std::setw(6) << e.vbatMv << std::setw(4) << unsigned(e.percent)
+                      << std::setw(9) << unsigned(e.stretch) << std::setw(7) << (fBoost ? "on" : "off") << "\n";
+            nextReportDay += 30;
+            }
+        }
+
+    r.lifeDays = std::uint32_t(msElapsed / 1000 / kSecPerDay);
+    return r;
+    }
+
+int main(int argc, char **argv)
+    {
+    std::uint32_t const capacityMah = argc > 1 ? std::uint32_t(std::strtoul(argv[1], nullptr, 0)) : 300;
+    std::uint32_t const targetDays = argc > 2 ? std::uint32_t(std::strtoul(argv[2], nullptr, 0)) : 365;
+    std::uint32_t const errorPercent = argc > 3 ? std::uint32_t(std::strtoul(argv[3], nullptr, 0)) : 10;
+    unsigned const seed = argc > 4 ? unsigned(std::strtoul(argv[4], nullptr, 0)) : 4610;
+
+    if (capacityMah == 0 || targetDays == 0 || errorPercent > 100)
+        {
+        std::cerr << "usage: catena-battery-model-sim [capacity-mAh [target-days [error-percent [seed]]]]\n";
+        return 2;
+        }
+
+    std::mt19937 rng(seed);
+    unsigned nFail = 0;
+
+    std::cout << capacityMah << " mAh, target " << targetDays << " days, currents "
+              << errorPercent << "% above the meter's figures:\n";
+    Result const r = run(capacityMah, targetDays, errorPercent, true, rng);
+
+    std::cout << "  flat after " << r.lifeDays << " days; stretch up to " << r.maxStretch
+              << ", boost switched " << r.nBoostSwitches << " times\n";
+    nFail += r.nFail;
+    if (r.lifeDays * 10 < targetDays * 9)
+        {
+        std::cerr << "lasted " << r.lifeDays << " days of " << targetDays << "\n";
+        ++nFail;
+        }
+    // on once near the end, and perhaps off again once: no more.
+    if (r.nBoostSwitches > 2)
+        {
+        std::cerr << "boost switched " << r.nBoostSwitches << " times\n";
+        ++nFail;
+        }
+
+    Result const ample = run(capacityMah * 10, targetDays, errorPercent, false, rng);
+
+    std::cout << capacityMah * 10 << " mAh: flat after " << ample.lifeDays << " days; stretch up to "
+              << ample.maxStretch << "\n";
+    nFail += ample.nFail;
+    if (ample.maxStretch != 1)
+        {
+        std::cerr << "stretched with ample capacity\n";
+        ++nFail;
+        }
+
+    std::cout << nFail << " failures\n";
+    return nFail == 0 ? 0 : 1;
+    }
@@ -0,0 +1,243 @@
+/*
+
+Name:   catena-clock-energy.cpp
+
+Function:
+        Project the energy saved by clock scaling, with the energy meter
+        and the clock policy the sketch uses; and check the register
+        arithmetic the policy does when it switches.
+
+Copyright and License:
+        See accompanying LICENSE file
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+Usage:
+        g++ -std=c++14 -O2 -o catena-clock-energy catena-clock-energy.cpp
+
+        catena-clock-energy [tx-cycle-sec [sf [capacity-mAh]]]
+
+        A day of uplinks is run through two energy meters, as the
+        measurement loop accounts it: each uplink interval (default 360 s)
+        is spent sleeping between uplinks (sampling the sensor), then
+        kMeasureMs measuring and encoding, then transmitting until the
+        second receive window has closed, at the given spreading factor
+        (default 7, 125 kHz). One meter has the CPU at 32 MHz throughout;
+        the other at the level the clock policy picks for each activity.
+        For each, this prints the charge by activity, the average current
+        and the life of a battery of the given capacity (default 1000).
+
+        Then, for some baud rates and I2C timings, the divisors are scaled
+        from 32 MHz to 16 MHz and back, and must keep the baud rate within
+        1%, and each I2C period no shorter than before and no more than
+        one kernel clock longer.
+
+*/
+
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+#include "../Catena4610_cClockPolicy.h"
+#include "../Catena4610_cEnergyMeter.h"
+
+using McciCatena4610::cClockPolicy;
+using McciCatena4610::cEnergyMeter;
+
+using Category = cEnergyMeter::Category;
+using Level = cClockPolicy::Level;
+
+constexpr std::uint32_t kMeasureMs = 100;
+constexpr std::uint8_t kPayloadBytes = 24;
+// the second receive window opens this long after the uplink ends.
+constexpr std::uint32_t kRx2DelayMs = 2000;
+constexpr std::uint32_t kSecPerDay = 24 * 60 * 60;
+
+// one day of uplinks; scaled, or all at kHigh.
+static void runDay(
+    cEnergyMeter &meter,
+    cClockPolicy &policy,
+    bool fScaled,
+    std::uint32_t txCycleSec,
+    std::uint8_t sf
+    )
+    {
+    std::uint32_t const msTx = cEnergyMeter::getAirtimeUs(sf, 125, kPayloadBytes + cEnergyMeter::kLoRaWANOverhead) / 1000 +
+                               kRx2DelayMs +
+                               cEnergyMeter::kRxWindowSymbols * cEnergyMeter::getSymbolUs(sf, 125) / 1000;
+    std::uint32_t const msSleep = txCycleSec * 1000 - kMeasureMs - msTx;
+    std::uint32_t const nUplinks = kSecPerDay / txCycleSec;
+    std::uint32_t t = 0;
+
+    policy.setEnabled(fScaled);
+
+    // as cMeasurementLoop::fsmDispatch() and accountEnergy() do it.
+    auto const activity = [&](Category c, std::uint32_t ms)
+        {
+        policy.setTarget(cClockPolicy::getLevelFor(c));
+        if (policy.isSwitchPending())
+            policy.setLevel(t, policy.getTarget());
+
+        meter.account(c, ms, cClockPolicy::scaleCurrent(meter.getCurrent(c), policy.getLevel()));
+        t += ms;
+        };
+
+    for (std::uint32_t i = 0; i < nUplinks; ++i)
+        {
+        activity(Category::kSleeping, msSleep);
+        activity(Category::kMeasure, kMeasureMs);
+        activity(Category::kTransmit, msTx);
+        meter.accountUplink(sf, 125, kPayloadBytes);
+        }
+    policy.account(t);
+    }
+
+static void report(const char *pTitle, const cEnergyMeter &meter, std::uint32_t capacityMah)
+    {
+    auto const &stats = meter.getStats();
+    std::uint32_t const averageUa = meter.getAverageUa();
+
+    std::cout << pTitle << ":\n";
+    for (std::size_t i = 0; i < cEnergyMeter::kCategories; ++i)
+        {
+        if (stats.ms[i] == 0)
+            continue;
+
+        std::cout << "  " << std::left << std::setw(10) << cEnergyMeter::getCategoryName(Category(i))
+                  << std::right << std::setw(8) << stats.ms[i] / 1000 << " s "
+                  << std::setw(8) << stats.uAs[i] / 3600 << " uAh\n";
+        }
+    std::cout << "  average " << averageUa << " uA; "
+              << (averageUa ? std::uint64_t(capacityMah) * 1000 / averageUa / 24 : 0)
+              << " days on " << capacityMah << " mAh\n\n";
+    }
+
+// the SCL low, SCL high, data hold and data setup times of a TIMINGR, in
+// nanoseconds at kernel clock hz.
+static void getI2cTimes(std::uint32_t timingr, std::uint32_t hz, double ns[4])
+    {
+    double const nsClock = 1e9 / hz * ((timingr >> 28) + 1);
+
+    ns[0] = ((timingr & 0xFF) + 1) * nsClock;
+    ns[1] = (((timingr >> 8) & 0xFF) + 1) * nsClock;
+    ns[2] = ((timingr >> 16) & 0xF) * nsClock;
+    ns[3] = (((timingr >> 20) & 0xF) + 1) * nsClock;
+    }
+
+static unsigned checkI2c(std::uint32_t timingr, std::uint32_t fromHz, std::uint32_t toHz)
+    {
+    std::uint32_t const scaled = cClockPolicy::scaleI2cTiming(timingr, fromHz, toHz);
+    double before[4], after[4];
+    unsigned nFail = 0;
+
+    getI2cTimes(timingr, fromHz, before);
+    getI2cTimes(scaled, toHz, after);
+
+    std::cout << "  I2C 0x" << std::hex << std::setw(8) << std::setfill('0') << timingr
+              << " -> 0x" << std::setw(8) << scaled << std::dec << std::setfill(' ')
+              << " at " << toHz / 1000000 << " MHz: SCL "
+              << std::fixed << std::setprecision(1)
+              << 1e6 / (before[0] + before[1]) << " -> " << 1e6 / (after[0] + after[1]) << " kHz\n";
+
+    double const nsClock = 1e9 / toHz * ((scaled >> 28) + 1);
+    for (unsigned i = 0; i < 4; ++i)
+        {
+        // the hold time rounds to nearest; the others round up.
+        double const lo = i == 2 ? before[i] - nsClock / 2 - 0.01 : before[i] - 0.01;
+        if (after[i] < lo || after[i] > before[i] + nsClock + 0.01)
+            {
+            std::cerr << "I2C 0x" << std::hex << timingr << std::dec << " field " << i << ": "
+                      << before[i] << " ns became " << after[i] << " ns\n";
+            ++nFail;
+            }
+        }
+    return nFail;
+    }
+
+static unsigned checkBaud(std::uint32_t baud, std::uint32_t fromHz, std::uint32_t toHz, bool fLpuart)
+    {
+    std::uint64_t const k = fLpuart ? 256 : 1;
+    std::uint32_t const brr = std::uint32_t(k * fromHz / baud);
+    std::uint32_t const scaled = cClockPolicy::scaleBaudDivisor(brr, fromHz, toHz);
+    double const actual = double(k) * toHz / scaled;
+    double const errorPercent = 100 * (actual - baud) / baud;
+
+    std::cout << "  " << (fLpuart ? "LPUART " : "USART  ") << std::setw(6) << baud
+              << " baud, BRR " << brr << " -> " << scaled << " at " << toHz / 1000000
+              << " MHz: " << std::setprecision(2) << errorPercent << "%\n";
+
+    if (errorPercent > 1 || errorPercent < -1)
+        {
+        std::cerr << baud << " baud: off by " << errorPercent << "%\n";
+        return 1;
+        }
+    return 0;
+    }
+
+int main(int argc, char **argv)
+    {
+    std::uint32_t const txCycleSec = argc > 1 ? std::uint32_t(std::strtoul(argv[1], nullptr, 0)) : 360;
+    std::uint8_t const sf = argc > 2 ? std::uint8_t(std::strtoul(argv[2], nullptr, 0)) : 7;
+    std::uint32_t const capacityMah = argc > 3 ? std::uint32_t(std::strtoul(argv[3], nullptr, 0)) : 1000;
+    unsigned nFail = 0;
+
+    if (txCycleSec < 10 || sf < 7 || sf > 12 || capacityMah == 0)
+        {
+        std::cerr << "usage: catena-clock-energy [tx-cycle-sec [sf [capacity-mAh]]]\n";
+        return 2;
+        }
+
+    std::cout << "uplink every " << txCycleSec << " s at SF" << unsigned(sf) << ", one day:\n\n";
+
+    cEnergyMeter fixedMeter, scaledMeter;
+    cClockPolicy fixedPolicy, scaledPolicy;
+
+    runDay(fixedMeter, fixedPolicy, false, txCycleSec, sf);
+    runDay(scaledMeter, scaledPolicy, true, txCycleSec, sf);
+
+    report("fixed 32 MHz", fixedMeter, capacityMah);
+    report("scaled", scaledMeter, capacityMah);
+
+    auto const &stats = scaledPolicy.getStats();
+    std::uint64_t const saved = fixedMeter.getTotalUas() - scaledMeter.getTotalUas();
+
+    std::cout << "scaled: " << stats.ms[unsigned(Level::kLow)] / 1000 << " s low, "
+              << stats.ms[unsigned(Level::kHigh)] / 1000 << " s high, "
+              << stats.nSwitches << " switches; "
+              << saved / 3600 << " uAh a day saved ("
+              << saved * 100 / fixedMeter.getTotalUas() << "%)\n\n";
+
+    // the policy's own accounting must agree with the meter's.
+    std::uint64_t const msHigh = scaledMeter.getStats().ms[unsigned(Category::kMeasure)] +
+                                 scaledMeter.getStats().ms[unsigned(Category::kTransmit)];
+    if (stats.ms[unsigned(Level::kHigh)] != msHigh ||
+        stats.ms[unsigned(Level::kLow)] != scaledMeter.getStats().ms[unsigned(Category::kSleeping)] ||
+        stats.nSwitches != 2 * (kSecPerDay / txCycleSec) ||
+        fixedPolicy.getStats().nSwitches != 0 ||
+        scaledMeter.getTotalUas() >= fixedMeter.getTotalUas())
+        {
+        std::cerr << "clock policy accounting doesn't match the energy meter\n";
+        ++nFail;
+        }
+
+    std::cout << "register scaling:\n";
+    for (std::uint32_t baud : { 9600u, 115200u })
+        {
+        nFail += checkBaud(baud, cClockPolicy::kHighHz, cClockPolicy::kLowHz, false);
+        nFail += checkBaud(baud, cClockPolicy::kHighHz, cClockPolicy::kLowHz, true);
+        }
+    // timings for 100 kHz, 400 kHz and 1 MHz at 32 MHz, there and back;
+    // and one for 100 kHz at 16 MHz.
+    for (std::uint32_t timingr : { 0x00707CBBu, 0x00300F38u, 0x00100413u })
+        {
+        nFail += checkI2c(timingr, cClockPolicy::kHighHz, cClockPolicy::kLowHz);
+        nFail += checkI2c(cClockPolicy::scaleI2cTiming(timingr, cClockPolicy::kHighHz, cClockPolicy::kLowHz),
+                          cClockPolicy::kLowHz, cClockPolicy::kHighHz);
+        }
+    nFail += checkI2c(0x00303D5Bu, cClockPolicy::kLowHz, cClockPolicy::kHighHz);
+
+    std::cout << "\n" << nFail << " failures\n";
+    return nFail == 0 ? 0 : 1;
+    }
@@ -0,0 +1,133 @@
+/*
+
+Name:   catena-counter-journal-bench.cpp
+
+Function:
+        Measure the flash write amplification of the touch counters, with
+        the sketch's cTouchCounters and counter journal.
+
+Copyright and License:
+        See accompanying LICENSE file
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+Usage:
+        g++ -std=c++14 -O2 -I host -o catena-counter-journal-bench \
+            catena-counter-journal-bench.cpp ../Catena4610_cTouchCounters.cpp
+
+        catena-counter-journal-bench [touches [seed]]
+
+        host/Catena_Mx25v8035f.h stands in for the flash. For some touches
+        (default 1000000), each on the left or the right at random,
+        cTouchCounters is driven as the measurement loop drives it:
+        count() for each touch, then flush() from poll() when it's due;
+        and, every so many touches, an uplink that carries the unacked
+        counts and completes. Three cases: no uplinks (batches only), an
+        uplink every 50 touches, and one every 8.
+
+        For each, this prints the journal entries written, bytes
+        programmed per touch, erases per sector, and how many touches the
+        journal would last at 100k erase cycles per sector. The counters
+        restored by a fresh begin() on the same flash must be the lifetime
+        counts, less at most a batch per side.
+
+*/
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+
+#include "../Catena4610_cTouchCounters.h"
+
+using McciCatena::Catena_Mx25v8035f;
+using McciCatena4610::cPowerManager;
+using McciCatena4610::cTouchCounters;
+namespace FlashMap = McciCatena4610::FlashMap;
+
+constexpr std::uint64_t kEraseCycles = 100000;
+
+static std::uint32_t clockNow() { return 0; }
+static void setPower(cPowerManager::Peripheral, bool) {}
+
+static unsigned run(const char *pTitle, std::uint32_t nTouches, std::uint32_t touchesPerUplink, std::mt19937 &rng)
+    {
+    Catena_Mx25v8035f flash;
+    cPowerManager power;
+    unsigned nFail = 0;
+
+    power.begin(clockNow, setPower, 0);
+
+    cTouchCounters counters(flash, power);
+    counters.begin();
+
+    for (std::uint32_t i = 1; i <= nTouches; ++i)
+        {
+        bool const fLeft = (rng() & 1) != 0;
+
+        counters.count(fLeft, ! fLeft);
+        if (touchesPerUplink != 0 && i % touchesPerUplink == 0)
+            {
+            std::uint16_t left, right;
+
+            // as startTransmission() and sendBufferDone() do it.
+            counters.getUnacked(left, right);
+            counters.startSend(left, right);
+            counters.sendDone(true);
+            }
+
+        // poll()
+        if (counters.isFlushDue())
+            counters.flush(false);
+        }
+
+    auto const &stats = counters.getJournal().getStats();
+    std::uint32_t const erases0 = flash.getErases(FlashMap::kCounterBase);
+    std::uint32_t const erases1 = flash.getErases(FlashMap::kCounterBase + FlashMap::kSectorSize);
+    std::uint32_t const erases = erases0 > erases1 ? erases0 : erases1;
+
+    std::cout << pTitle << ": " << stats.nWrites << " entries, "
+              << double(flash.getBytesProgrammed()) / nTouches << " bytes programmed per touch, "
+              << erases << " erases per sector; lasts "
+              << (erases ? kEraseCycles * nTouches / erases / 1000000 : 0) << " million touches\n";
+
+    // a reset: what comes back?
+    cTouchCounters restored(flash, power);
+    restored.begin();
+
+    if (counters.getLeft() - restored.getLeft() >= cTouchCounters::kBatch ||
+        counters.getRight() - restored.getRight() >= cTouchCounters::kBatch ||
+        restored.getLeft() > counters.getLeft() ||
+        restored.getRight() > counters.getRight())
+        {
+        std::cerr << pTitle << ": restored " << restored.getLeft() << "/" << restored.getRight()
+                  << " of " << counters.getLeft() << "/" << counters.getRight() << "\n";
+        ++nFail;
+        }
+    return nFail;
+    }
+
+int main(int argc, char **argv)
+    {
+    std::uint32_t const nTouches = argc > 1 ? std::uint32_t(std::strtoul(argv[1], nullptr, 0)) : 1000000;
+    unsigned const seed = argc > 2 ? unsigned(std::strtoul(argv[2], nullptr, 0)) : 4610;
+
+    if (nTouches == 0)
+        {
+        std::cerr << "usage: catena-counter-journal-bench [touches [seed]]\n";
+        return 2;
+        }
+
+    std::mt19937 rng(seed);
+    unsigned nFail = 0;
+
+    std::cout << nTouches << " touches, batch " << cTouchCounters::kBatch << ", "
+              << cTouchCounters::Journal::getJournalCapacity() << " entries per sector\n";
+    nFail += run("batch only", nTouches, 0, rng);
+    nFail += run("uplink every 50", nTouches, 50, rng);
+    nFail += run("uplink every 8", nTouches, 8, rng);
+
+    std::cout << nFail << " failures\n";
+    return nFail == 0 ? 0 : 1;
+    }
@@ -0,0 +1,342 @@
+/*
+
+Name:   catena-downlink-port-2-format-test.cpp
+
+Function:
+        Generate, and round-trip test, port 2 configuration downlinks.
+
+Copyright and License:
+        See accompanying LICENSE file
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../Catena4610_cDownlinkParser.h"
+
+using McciCatena4610::cDownlinkParser;
+using Command = cDownlinkParser::Command;
+using Status = cDownlinkParser::Status;
+
+// the fields of cMeasurementLoop::Config that downlinks can set.
+struct Config
+    {
+    std::uint32_t txCycleSec;
+    std::uint32_t fastTxCycleSec;
+    std::uint32_t fastTxCycleCount;
+    std::uint16_t thresholdRight;
+    std::uint16_t thresholdLeft;
+    std::uint16_t samplePeriodMs;
+    std::uint16_t touchHysteresis;
+    std::uint16_t touchDebounce;
+    };
+
+bool operator==(const Config &a, const Config &b)
+    {
+    return a.txCycleSec == b.txCycleSec &&
+           a.fastTxCycleSec == b.fastTxCycleSec &&
+           a.fastTxCycleCount == b.fastTxCycleCount &&
+           a.thresholdRight == b.thresholdRight &&
+           a.thresholdLeft == b.thresholdLeft &&
+           a.samplePeriodMs == b.samplePeriodMs &&
+           a.touchHysteresis == b.touchHysteresis &&
+           a.touchDebounce == b.touchDebounce;
+    }
+
+// what a message says, field by field.
+template <typename T>
+struct val
+    {
+    bool fValid;
+    T v;
+    };
+
+struct Commands
+    {
+    val<std::uint16_t> TxCycle;
+    val<std::uint16_t> FastCycle;
+    val<std::uint8_t> FastCount;
+    val<std::uint16_t> ThresholdRight;
+    val<std::uint16_t> ThresholdLeft;
+    val<std::uint16_t> SamplePeriod;
+    val<std::uint16_t> Hysteresis;
+    val<std::uint8_t> Debounce;
+    bool fDiag;
+    };
+
+class Buffer : public std::vector<std::uint8_t>
+    {
+public:
+    Buffer() : std::vector<std::uint8_t>() {};
+
+    void push_back_be(std::uint16_t v)
+        {
+        this->push_back(std::uint8_t(v >> 8));
+        this->push_back(std::uint8_t(v & 0xFF));
+        }
+    };
+
+// encode; a field given alone gets the other half of its command from
+// the base configuration.
+void encodeCommands(Buffer &buf, const Commands &m, const Config &base)
+    {
+    buf.clear();
+
+    if (m.TxCycle.fValid)
+        {
+        buf.push_back(std::uint8_t(Command::kSetTxCycle));
+        buf.push_back_be(m.TxCycle.v);
+        }
+
+    if (m.FastCycle.fValid || m.FastCount.fValid)
+        {
+        buf.push_back(std::uint8_t(Command::kSetFastCycle));
+        buf.push_back_be(m.FastCycle.fValid ? m.FastCycle.v : std::uint16_t(base.fastTxCycleSec));
+        buf.push_back(m.FastCount.fValid ? m.FastCount.v : std::uint8_t(base.fastTxCycleCount));
+        }
+
+    if (m.ThresholdRight.fValid || m.ThresholdLeft.fValid)
+        {
+        buf.push_back(std::uint8_t(Command::kSetThresholds));
+        buf.push_back_be(m.ThresholdRight.fValid ? m.ThresholdRight.v : base.thresholdRight);
+        buf.push_back_be(m.ThresholdLeft.fValid ? m.ThresholdLeft.v : base.thresholdLeft);
+        }
+
+    if (m.SamplePeriod.fValid)
+        {
+        buf.push_back(std::uint8_t(Command::kSetSamplePeriod));
+        buf.push_back_be(m.SamplePeriod.v);
+        }
+
+    if (m.fDiag)
+        buf.push_back(std::uint8_t(Command::kRequestDiagnostics));
+
+    if (m.Hysteresis.fValid || m.Debounce.fValid)
+        {
+        buf.push_back(std::uint8_t(Command::kSetTouchDetection));
+        buf.push_back_be(m.Hysteresis.fValid ? m.Hysteresis.v : base.touchHysteresis);
+        buf.push_back(m.Debounce.fValid ? m.Debounce.v : std::uint8_t(base.touchDebounce));
+        }
+    }
+
+// the configuration the encoded message should produce.
+Config expectConfig(const Commands &m, Config c)
+    {
+    if (m.TxCycle.fValid)
+        c.txCycleSec = m.TxCycle.v;
+    if (m.FastCycle.fValid)
+        c.fastTxCycleSec = m.FastCycle.v;
+    if (m.FastCount.fValid)
+        c.fastTxCycleCount = m.FastCount.v;
+    if (m.ThresholdRight.fValid)
+        c.thresholdRight = m.ThresholdRight.v;
+    if (m.ThresholdLeft.fValid)
+        c.thresholdLeft = m.ThresholdLeft.v;
+    if (m.SamplePeriod.fValid)
+        c.samplePeriodMs = m.SamplePeriod.v;
+    if (m.Hysteresis.fValid)
+        c.touchHysteresis = m.Hysteresis.v;
+    if (m.Debounce.fValid)
+        c.touchDebounce = m.Debounce.v;
+    return c;
+    }
+
+// encode, decode and compare. Every proper prefix of the message must
+// be rejected, and leave nothing applied.
+bool roundTrip(const Commands &m, const Config &base, Buffer &buf)
+    {
+    encodeCommands(buf, m, base);
+
+    Config c = base;
+    auto const r = cDownlinkParser::parse(buf.data(), buf.size(), c);
+    bool const fAny = ! buf.empty();
+
+    if (r.status != (fAny ? Status::kSuccess : Status::kEmpty))
+        return false;
+    if (fAny && ! (c == expectConfig(m, base)))
+        return false;
+    if (r.fDiagnostics != m.fDiag)
+        return false;
+
+    for (std::size_t n = 1; n < buf.size(); ++n)
+        {
+        Config t = base;
+        auto const rt = cDownlinkParser::parse(buf.data(), n, t);
+
+        // a prefix ending on a command boundary is a valid, shorter
+        // message; anything else must be truncated.
+        if (rt.status != Status::kSuccess && rt.status != Status::kTruncated)
+            return false;
+        }
+
+    return true;
+    }
+
+void putTestVector(const Commands &m, const Config &base)
+    {
+    Buffer buf {};
+    bool const fOk = roundTrip(m, base, buf);
+    bool fFirst = true;
+
+    for (auto v : buf)
+        {
+        if (! fFirst)
+            std::cout << " ";
+        fFirst = false;
+        std::cout.width(2);
+        std::cout.fill('0');
+        std::cout << std::hex << unsigned(v);
+        }
+    std::cout << std::dec << (fOk ? "\n" : "  ** round trip failed\n");
+    }
+
+// random messages, plus every unknown opcode.
+int selfTest(unsigned nTrials)
+    {
+    std::mt19937 rng(0x30);
+    Config const base { 360, 30, 10, 400, 270, 50, 20, 1 };
+    unsigned nFail = 0;
+    Buffer buf {};
+
+    for (unsigned i = 0; i < nTrials; ++i)
+        {
+        Commands m {};
+        auto const coin = [&rng]() { return (rng() & 1) != 0; };
+
+        m.TxCycle = { coin(), std::uint16_t(rng()) };
+        m.FastCycle = { coin(), std::uint16_t(rng()) };
+        m.FastCount = { coin(), std::uint8_t(rng()) };
+        m.ThresholdRight = { coin(), std::uint16_t(rng()) };
+        m.ThresholdLeft = { coin(), std::uint16_t(rng()) };
+        m.SamplePeriod = { coin(), std::uint16_t(rng()) };
+        m.Hysteresis = { coin(), std::uint16_t(rng()) };
+        m.Debounce = { coin(), std::uint8_t(rng()) };
+        m.fDiag = coin();
+
+        if (! roundTrip(m, base, buf))
+            ++nFail;
+        }
+
+    for (unsigned opcode = 0; opcode < 256; ++opcode)
+        {
+        std::uint8_t const msg[8] = { std::uint8_t(opcode) };
+        Config c = base;
+        auto const r = cDownlinkParser::parse(msg, sizeof(msg), c);
+
+        if (cDownlinkParser::getArgumentBytes(std::uint8_t(opcode)) < 0 &&
+            (r.status != Status::kUnknownCommand || ! (c == base)))
+            ++nFail;
+        }
+
+    std::cout << nTrials << " messages, 256 opcodes: " << nFail << " failures\n";
+    return nFail == 0 ? 0 : 1;
+    }
+
+int main(int argc, char **argv)
+    {
+    Config const base { 360, 30, 10, 400, 270, 50, 20, 1 };
+    Commands m {};
+    Commands const m0 {};
+    bool fAny;
+
+    if (argc > 1 && std::strcmp(argv[1], "--selftest") == 0)
+        return selfTest(argc > 2 ? unsigned(std::strtoul(argv[2], nullptr, 0)) : 100000);
+
+    std::cout << "Input one or more lines of name/value tuples, ended by '.'\n";
+
+    fAny = false;
+    while (std::cin.good())
+        {
+        bool fUpdate = true;
+        std::string key;
+        unsigned v;
+
+        std::cin >> key;
+
+        if (key == "TxCycle")
+            {
+            std::cin >> v;
+            m.TxCycle = { true, std::uint16_t(v) };
+            }
+        else if (key == "FastCycle")
+            {
+            std::cin >> v;
+            m.FastCycle = { true, std::uint16_t(v) };
+            }
+        else if (key == "FastCount")
+            {
+            std::cin >> v;
+            m.FastCount = { true, std::uint8_t(v) };
+            }
+        else if (key == "ThresholdRight")
+            {
+            std::cin >> v;
+            m.ThresholdRight = { true, std::uint16_t(v) };
+            }
+        else if (key == "ThresholdLeft")
+            {
+            std::cin >> v;
+            m.ThresholdLeft = { true, std::uint16_t(v) };
+            }
+        else if (key == "SamplePeriod")
+            {
+            std::cin >> v;
+            m.SamplePeriod = { true, std::uint16_t(v) };
+            }
+        else if (key == "Hysteresis")
+            {
+            std::cin >> v;
+            m.Hysteresis = { true, std::uint16_t(v) };
+            }
+        else if (key == "Debounce")
+            {
+            std::cin >> v;
+            m.Debounce = { true, std::uint8_t(v) };
+            }
+        else if (key == "Diag")
+            {
+            m.fDiag = true;
+            }
+        else if (key == ".")
+            {
+            putTestVector(m, base);
+            m = m0;
+            fAny = false;
+            fUpdate = false;
+            }
+        else if (key == "")
+            /* ignore empty keys */
+            fUpdate = false;
+        else
+            {
+            std::cerr << "unknown key: " << key << "\n";
+            fUpdate = false;
+            }
+
+        fAny |= fUpdate;
+        }
+
+    if (!std::cin.eof() && std::cin.fail())
+        {
+        std::string nextword;
+
+        std::cin.clear(std::cin.goodbit);
+        std::cin >> nextword;
+        std::cerr << "parse error: " << nextword << "\n";
+        return 1;
+        }
+
+    if (fAny)
+        putTestVector(m, base);
+
+    return 0;
+    }
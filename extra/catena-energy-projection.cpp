@@ -0,0 +1,187 @@
+/*
+
+Name:   catena-energy-projection.cpp
+
+Function:
+        Project battery life for a range of configurations, with the
+        energy meter the sketch uses.
+
+Copyright and License:
+        See accompanying LICENSE file
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+Usage:
+        g++ -std=c++14 -O2 -o catena-energy-projection catena-energy-projection.cpp
+
+        catena-energy-projection [capacity-mAh [payload-bytes [category=uA ...]]]
+
+        For each uplink interval, spreading factor (125 kHz) and way of
+        sleeping, a day of uplinks is accounted by a cEnergyMeter as the
+        measurement loop accounts it: kMeasureMs measuring, transmitting
+        until the second receive window has closed, then the rest of the
+        interval in light sleep (stSleeping, sampling the sensor) or in
+        deep sleep. This prints the average current and the life of a
+        battery of the given capacity (default 1000 mAh) for each, and
+        the share of the charge that went on air.
+
+        The payload (default 24 bytes) is the application payload; the
+        meter adds the LoRaWAN framing. Currents may be overridden with
+        the names the "energy" command uses, e.g. sleeping=800 radiotx=
+        40000, to project from figures measured on a unit.
+
+        Before that, the time on air the meter computes is checked
+        against values worked by hand from Semtech's formula (AN1200.13).
+
+*/
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+#include "../Catena4610_cEnergyMeter.h"
+
+using McciCatena4610::cEnergyMeter;
+
+using Category = cEnergyMeter::Category;
+
+constexpr std::uint32_t kMeasureMs = 100;
+// the second receive window opens this long after the uplink ends.
+constexpr std::uint32_t kRx2DelayMs = 2000;
+constexpr std::uint32_t kSecPerDay = 24 * 60 * 60;
+
+// one day of uplinks.
+static void runDay(
+    cEnergyMeter &meter,
+    std::uint32_t txCycleSec,
+    std::uint8_t sf,
+    std::uint8_t nPayload,
+    bool fDeepSleep
+    )
+    {
+    std::uint32_t const msTx = cEnergyMeter::getAirtimeUs(sf, 125, nPayload + cEnergyMeter::kLoRaWANOverhead) / 1000 +
+                               kRx2DelayMs +
+                               cEnergyMeter::kRxWindowSymbols * cEnergyMeter::getSymbolUs(sf, 125) / 1000;
+    std::uint32_t const msSleep = txCycleSec * 1000 - kMeasureMs - msTx;
+    std::uint32_t const nUplinks = kSecPerDay / txCycleSec;
+
+    for (std::uint32_t i = 0; i < nUplinks; ++i)
+        {
+        meter.account(fDeepSleep ? Category::kDeepSleep : Category::kSleeping, msSleep);
+        meter.account(Category::kMeasure, kMeasureMs);
+        meter.account(Category::kTransmit, msTx);
+        meter.accountUplink(sf, 125, nPayload);
+        }
+    }
+
+static unsigned checkAirtime()
+    {
+    // sf, bytes on air, and the time on air in microseconds
+    // (125 kHz, CR 4/5, explicit header, CRC on, 8-symbol preamble).
+    static const struct { std::uint8_t sf; std::uint8_t nBytes; std::uint32_t us; } kCases[] =
+        {
+        { 7, 13, 46336 },
+        { 7, 37, 82176 },
+        { 9, 37, 267264 },
+        { 10, 37, 493568 },
+        { 12, 37, 1974272 },
+        };
+    unsigned nFail = 0;
+
+    for (auto const &c : kCases)
+        {
+        std::uint32_t const us = cEnergyMeter::getAirtimeUs(c.sf, 125, c.nBytes);
+
+        if (us != c.us)
+            {
+            std::cerr << "SF" << unsigned(c.sf) << ", " << unsigned(c.nBytes) << " bytes: "
+                      << us << " us on air, expected " << c.us << "\n";
+            ++nFail;
+            }
+        }
+    return nFail;
+    }
+
+static bool setCurrent(cEnergyMeter &meter, const char *pArg)
+    {
+    const char *const pEquals = std::strchr(pArg, '=');
+
+    if (pEquals == nullptr)
+        return false;
+
+    for (std::size_t i = 0; i < cEnergyMeter::kCategories; ++i)
+        {
+        const char *const pName = cEnergyMeter::getCategoryName(Category(i));
+
+        if (std::strlen(pName) == std::size_t(pEquals - pArg) &&
+            std::strncmp(pName, pArg, pEquals - pArg) == 0)
+            {
+            meter.setCurrent(Category(i), std::uint32_t(std::strtoul(pEquals + 1, nullptr, 0)));
+            return true;
+            }
+        }
+    return false;
+    }
+
+int main(int argc, char **argv)
+    {
+    std::uint32_t const capacityMah = argc > 1 ? std::uint32_t(std::strtoul(argv[1], nullptr, 0)) : 1000;
+    std::uint32_t const nPayload = argc > 2 ? std::uint32_t(std::strtoul(argv[2], nullptr, 0)) : 24;
+    cEnergyMeter currents;
+
+    if (capacityMah == 0 || nPayload > 222)
+        {
+        std::cerr << "usage: catena-energy-projection [capacity-mAh [payload-bytes [category=uA ...]]]\n";
+        return 2;
+        }
+    for (int i = 3; i < argc; ++i)
+        {
+        if (! setCurrent(currents, argv[i]))
+            {
+            std::cerr << "unknown current: " << argv[i] << "\n";
+            return 2;
+            }
+        }
+
+    unsigned const nFail = checkAirtime();
+
+    std::cout << "currents:";
+    for (std::size_t i = 0; i < cEnergyMeter::kCategories; ++i)
+        std::cout << " " << cEnergyMeter::getCategoryName(Category(i)) << "="
+                  << currents.getCurrent(Category(i));
+    std::cout << " uA\n" << nPayload << "-byte payload, " << capacityMah << " mAh\n\n";
+
+    std::cout << "interval   SF    sleep      avg uA    days   on air\n";
+    for (std::uint32_t txCycleSec : { 60u, 360u, 900u, 3600u })
+        {
+        for (std::uint8_t sf : { 7, 9, 10, 12 })
+            {
+            for (bool fDeepSleep : { false, true })
+                {
+                cEnergyMeter meter;
+
+                for (std::size_t i = 0; i < cEnergyMeter::kCategories; ++i)
+                    meter.setCurrent(Category(i), currents.getCurrent(Category(i)));
+
+                runDay(meter, txCycleSec, sf, std::uint8_t(nPayload), fDeepSleep);
+
+                auto const &stats = meter.getStats();
+                std::uint64_t const uAsAir = stats.uAs[unsigned(Category::kRadioTx)] +
+                                             stats.uAs[unsigned(Category::kRadioRx)];
+                std::uint64_t const uAsTotal = meter.getTotalUas();
+
+                std::cout << std::setw(6) << txCycleSec << " s  " << std::setw(3) << unsigned(sf)
+                          << "    " << std::left << std::setw(8) << (fDeepSleep ? "deep" : "light")
+                          << std::right << std::setw(8) << meter.getAverageUa()
+                          << std::setw(8) << meter.getProjectedLifeDays(capacityMah)
+                          << std::setw(8) << (uAsTotal ? uAsAir * 100 / uAsTotal : 0) << "%\n";
+                }
+            }
+        }
+
+    std::cout << "\n" << nFail << " failures\n";
+    return nFail == 0 ? 0 : 1;
+    }
@@ -0,0 +1,268 @@
+/*
+
+Name:   catena-idle-scheduler-sim.cpp
+
+Function:
+        Simulate cIdleScheduler with the sketch's deadline sources, and
+        check its budget against their deadlines.
+
+Copyright and License:
+        See accompanying LICENSE file
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+Usage:
+        g++ -std=c++14 -O2 -o catena-idle-scheduler-sim catena-idle-scheduler-sim.cpp
+
+        catena-idle-scheduler-sim [minutes [seed]]
+
+        Time is simulated in microseconds, for some minutes (default 60),
+        starting shortly before millis() wraps. loop() is run as the
+        sketch runs it: gCatena.poll(), then idle(). The sources are:
+
+            sensor      a sample every sampling period, taking 600 us
+            uplink      an uplink every 6 minutes, 40 ms of work
+            queue       a retry now and then, at a random time
+
+        and, without a deadline, the command stream, which gets a line of
+        input at random (ending any wait, as Serial.available() does).
+
+        For sampling periods of 20, 50 and 200 ms this prints the CPU duty
+        cycle and average current, against those of a loop that never
+        idles. No wait may run past a deadline by more than one tick, no
+        wait may exceed kMaxIdleMs, and the scheduler's accounting must match
+        the simulated time.
+
+*/
+
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+#include "../Catena4610_cIdleScheduler.h"
+
+using McciCatena4610::cDeadlineSource;
+using McciCatena4610::cIdleScheduler;
+
+static std::uint64_t g_us;
+
+static std::uint32_t millisNow() { return std::uint32_t(g_us / 1000); }
+
+// something that needs a poll at given times, and takes usWork when it
+// gets one that's due.
+class cSimSource : public cDeadlineSource
+    {
+public:
+    cSimSource(const char *pName, std::uint32_t usWork)
+        : m_pName(pName)
+        , m_usWork(usWork)
+        , m_fPending(false)
+        , m_tDue(0)
+        , m_nLate(0)
+        , m_msMaxLate(0)
+        , m_nServed(0)
+        {}
+
+    void schedule(std::uint32_t tDue)
+        {
+        this->m_fPending = true;
+        this->m_tDue = tDue;
+        }
+
+    virtual bool getNextDeadline(std::uint32_t tNow, std::uint32_t &msRemaining) override
+        {
+        if (! this->m_fPending)
+            return false;
+
+        std::int32_t const delta = std::int32_t(this->m_tDue - tNow);
+        msRemaining = delta > 0 ? std::uint32_t(delta) : 0;
+        return true;
+        }
+
+    // a wait from tStart to tWake: was the deadline slept through?
+    void checkWait(std::uint32_t tStart, std::uint32_t tWake)
+        {
+        if (! this->m_fPending || std::int32_t(tWake - this->m_tDue) <= 0)
+            return;
+
+        // late on entry isn't the wait's doing.
+        std::uint32_t const msLate = tWake - (std::int32_t(tStart - this->m_tDue) > 0 ? tStart : this->m_tDue);
+
+        if (msLate > 1)
+            ++this->m_nLate;
+        if (msLate > this->m_msMaxLate)
+            this->m_msMaxLate = msLate;
+        }
+
+    // poll: returns true if the deadline was served.
+    bool poll()
+        {
+        std::uint32_t const tNow = millisNow();
+
+        if (! this->m_fPending || std::int32_t(tNow - this->m_tDue) < 0)
+            return false;
+
+        this->m_fPending = false;
+        ++this->m_nServed;
+        g_us += this->m_usWork;
+        return true;
+        }
+
+    const char          *m_pName;
+    std::uint32_t       m_usWork;
+    bool                m_fPending;
+    std::uint32_t       m_tDue;
+    std::uint32_t       m_nLate;
+    std::uint32_t       m_msMaxLate;
+    std::uint32_t       m_nServed;
+    };
+
+struct Result
+    {
+    std::uint32_t   dutyPermille;
+    std::uint32_t   averageUa;
+    unsigned        nFail;
+    };
+
+static Result run(std::uint32_t samplePeriodMs, std::uint32_t minutes, std::mt19937 &rng)
+    {
+    cIdleScheduler scheduler;
+    cSimSource sensor("sensor", 600);
+    cSimSource uplink("uplink", 40000);
+    cSimSource queue("queue", 2000);
+    unsigned nFail = 0;
+    std::uint32_t msMaxWait = 0;
+    std::uint32_t nInput = 0;
+
+    scheduler.registerSource(&sensor);
+    scheduler.registerSource(&uplink);
+    scheduler.registerSource(&queue);
+
+    // a minute before millis() wraps.
+    g_us = (std::uint64_t(0xFFFFFFFFu) - 60000) * 1000;
+    std::uint64_t const usStart = g_us;
+    std::uint64_t const usEnd = g_us + std::uint64_t(minutes) * 60 * 1000 * 1000;
+    std::uint64_t usLastWake = g_us;
+
+    sensor.schedule(millisNow() + samplePeriodMs);
+    uplink.schedule(millisNow() + 6 * 60 * 1000);
+
+    // the next line of serial input.
+    std::uint64_t usInput = g_us + (rng() % 30000) * 1000ull;
+
+    while (g_us < usEnd)
+        {
+        // gCatena.poll(): a little overhead, and each source that's due.
+        g_us += 30;
+        if (sensor.poll())
+            sensor.schedule(sensor.m_tDue + samplePeriodMs);
+        if (uplink.poll())
+            {
+            uplink.schedule(uplink.m_tDue + 6 * 60 * 1000);
+            if (rng() % 3 == 0)
+                queue.schedule(millisNow() + 10000 + rng() % 5000);
+            }
+        queue.poll();
+        if (g_us >= usInput)
+            {
+            // the command stream handles the line.
+            g_us += 300;
+            ++nInput;
+            usInput = g_us + (5000 + rng() % 60000) * 1000ull;
+            }
+
+        // idle(): WFI until the budget is used up, or serial input.
+        std::uint32_t const tStart = millisNow();
+        std::uint32_t const budget = scheduler.getIdleBudget(tStart);
+        std::uint64_t const usStartIdle = g_us;
+
+        if (budget != 0)
+            {
+            // the budget is in whole ticks from the tick we're in.
+            std::uint64_t usWake = g_us - g_us % 1000 + std::uint64_t(budget) * 1000;
+            if (usInput < usWake)
+                usWake = usInput + 1000 - usInput % 1000;
+            if (usWake > g_us)
+                g_us = usWake;
+            }
+
+        std::uint32_t const msWait = millisNow() - tStart;
+        if (msWait > msMaxWait)
+            msMaxWait = msWait;
+
+        // a wait must end by the tick of the first deadline. (A source
+        // can still be late because another one's work ran long; that's
+        // not the scheduler's doing.)
+        if (msWait != 0)
+            {
+            for (auto *p : { &sensor, &uplink, &queue })
+                p->checkWait(tStart, millisNow());
+            }
+
+        scheduler.account(std::uint32_t(usStartIdle - usLastWake), std::uint32_t(g_us - usStartIdle));
+        usLastWake = g_us;
+        }
+
+    auto const &stats = scheduler.getStats();
+    Result r { scheduler.getDutyCyclePermille(), scheduler.getAverageCurrentUa(), 0 };
+
+    std::cout << "sampling every " << samplePeriodMs << " ms: duty cycle "
+              << r.dutyPermille / 10 << "." << r.dutyPermille % 10 << "%, "
+              << stats.nIdle << " waits, longest " << msMaxWait << " ms, "
+              << nInput << " command lines\n";
+    for (auto const *p : { &sensor, &uplink, &queue })
+        {
+        std::cout << "  " << std::left << std::setw(8) << p->m_pName << std::right
+                  << p->m_nServed << " served, waits overran by at most " << p->m_msMaxLate << " ms\n";
+        if (p->m_nLate != 0)
+            {
+            std::cerr << p->m_pName << ": " << p->m_nLate << " deadlines slept through\n";
+            ++nFail;
+            }
+        }
+
+    if (msMaxWait > cIdleScheduler::kMaxIdleMs ||
+        stats.usAwake + stats.usIdle != g_us - usStart ||
+        sensor.m_nServed < (minutes * 60 * 1000) / samplePeriodMs - 1)
+        {
+        std::cerr << "sampling every " << samplePeriodMs << " ms: longest wait " << msMaxWait
+                  << " ms, accounted " << stats.usAwake + stats.usIdle << " us of " << g_us - usStart
+                  << ", " << sensor.m_nServed << " samples\n";
+        ++nFail;
+        }
+
+    r.nFail = nFail;
+    return r;
+    }
+
+int main(int argc, char **argv)
+    {
+    std::uint32_t const minutes = argc > 1 ? std::uint32_t(std::strtoul(argv[1], nullptr, 0)) : 60;
+    unsigned const seed = argc > 2 ? unsigned(std::strtoul(argv[2], nullptr, 0)) : 4610;
+
+    if (minutes == 0 || minutes > 24 * 60)
+        {
+        std::cerr << "usage: catena-idle-scheduler-sim [minutes [seed]]\n";
+        return 2;
+        }
+
+    std::mt19937 rng(seed);
+    unsigned nFail = 0;
+
+    std::cout << "never idling: " << cIdleScheduler::kRunCurrentUa << " uA\n\n";
+    for (std::uint32_t period : { 20u, 50u, 200u })
+        {
+        Result const r = run(period, minutes, rng);
+
+        std::cout << "  average CPU current " << r.averageUa << " uA, "
+                  << (cIdleScheduler::kRunCurrentUa - r.averageUa) * 100 / cIdleScheduler::kRunCurrentUa
+                  << "% less\n\n";
+        nFail += r.nFail;
+        }
+
+    std::cout << nFail << " failures\n";
+    return nFail == 0 ? 0 : 1;
+    }
@@ -0,0 +1,285 @@
+/*
+
+Name:   catena-iqs620a-burst-test.cpp
+
+Function:
+        Test cIqs620aReader against a mock I2C bus, and measure the time
+        and CPU time per sample, against blocking reads.
+
+Copyright and License:
+        See accompanying LICENSE file
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+Usage:
+        g++ -std=c++14 -O2 -o catena-iqs620a-burst-test catena-iqs620a-burst-test.cpp
+
+        catena-iqs620a-burst-test [samples [kHz [error%]]]
+
+        Time is simulated, in microseconds, so the results don't depend
+        on the host's scheduling. The mock bus times each transfer at the
+        given bus speed (default 400 kHz): the address phase takes the
+        caller's CPU, as with cI2cDmaBus, and the burst runs in the
+        background; when the clock passes its end, the mock calls the
+        completion function, as the DMA interrupt would. error% of the
+        reads (default 2) fail with a NACK, and as many never complete
+        at all.
+
+        Each sample starts a read, idles for the rest of a 2 ms sampling
+        period, and collects the result, which must match the registers
+        the mock was given for that sample. Every read must complete
+        exactly once, and every failure must be counted.
+
+        Then the same number of samples are read as the sensor driver
+        does it: a blocking transaction for each of the four values.
+
+*/
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+
+#include "../Catena4610_cIqs620aReader.h"
+#include "../Catena4610_cTouchChannels.h"
+
+using McciCatena4610::cI2cBus;
+using McciCatena4610::cIqs620aReader;
+using McciCatena4610::cTouchChannels;
+
+// the simulated clock, in microseconds.
+static double g_us = 0;
+
+static std::uint32_t micros()
+    {
+    return std::uint32_t(g_us);
+    }
+
+// use the CPU for us microseconds, as a polled I2C driver would.
+static void spin(double us)
+    {
+    g_us += us;
+    }
+
+class MockBus : public cI2cBus
+    {
+public:
+    enum class Fault { kNone, kNack, kHang };
+
+    explicit MockBus(unsigned kHz)
+        : m_usPerBit(1000.0 / kHz)
+        {}
+
+    // the registers, and the fault for the next read.
+    std::uint8_t regs[256] {};
+    Fault nextFault = Fault::kNone;
+
+    unsigned nStarted = 0;
+    unsigned nCompleted = 0;
+    unsigned nDoubled = 0;
+
+    virtual bool startRead(
+        std::uint8_t address,
+        std::uint8_t reg,
+        std::uint8_t *pBuffer,
+        std::size_t nBuffer,
+        CompletionFn pDone,
+        void *pClientData
+        ) override
+        {
+        if (this->isBusy() || address != cIqs620aReader::kAddress)
+            return false;
+
+        // START, address and register byte, on our CPU.
+        spin((1 + 2 * 9) * this->m_usPerBit);
+
+        this->m_reg = reg;
+        this->m_pBuffer = pBuffer;
+        this->m_nBuffer = nBuffer;
+        this->m_pDone = pDone;
+        this->m_pClientData = pClientData;
+        this->m_fault = this->nextFault;
+        // repeated START, address, the data, STOP.
+        this->m_usDone = g_us + (2 + 9 + 9 * nBuffer) * this->m_usPerBit;
+        this->m_fBusy = true;
+        this->m_fDelivered = false;
+        ++this->nStarted;
+        return true;
+        }
+
+    virtual bool isBusy() const override
+        {
+        return this->m_fBusy;
+        }
+
+    virtual void abort() override
+        {
+        if (this->m_fBusy)
+            this->complete(Status::kAborted);
+        }
+
+    // let the clock run to usEnd with the CPU idle; a transfer that ends
+    // on the way completes then, as from its interrupt.
+    void idleUntil(double usEnd)
+        {
+        if (this->m_fBusy && this->m_fault != Fault::kHang && this->m_usDone <= usEnd)
+            {
+            if (this->m_usDone > g_us)
+                g_us = this->m_usDone;
+
+            if (this->m_fault == Fault::kNack)
+                this->complete(Status::kNack);
+            else
+                {
+                std::memcpy(this->m_pBuffer, this->regs + this->m_reg, this->m_nBuffer);
+                this->complete(Status::kOk);
+                }
+            }
+
+        if (usEnd > g_us)
+            g_us = usEnd;
+        }
+
+private:
+    void complete(Status status)
+        {
+        if (this->m_fDelivered)
+            ++this->nDoubled;
+        this->m_fDelivered = true;
+        this->m_fBusy = false;
+        ++this->nCompleted;
+        this->m_pDone(this->m_pClientData, status);
+        }
+
+    double                      m_usPerBit;
+    double                      m_usDone = 0;
+    bool                        m_fBusy = false;
+    bool                        m_fDelivered = false;
+    Fault                       m_fault = Fault::kNone;
+    std::uint8_t                m_reg = 0;
+    std::uint8_t                *m_pBuffer = nullptr;
+    std::size_t                 m_nBuffer = 0;
+    CompletionFn                m_pDone = nullptr;
+    void                        *m_pClientData = nullptr;
+    };
+
+static void put16(std::uint8_t *p, std::int16_t v)
+    {
+    p[0] = std::uint8_t(v);
+    p[1] = std::uint8_t(std::uint16_t(v) >> 8);
+    }
+
+int main(int argc, char **argv)
+    {
+    unsigned const nSamples = argc > 1 ? unsigned(std::strtoul(argv[1], nullptr, 0)) : 2000;
+    unsigned const kHz = argc > 2 ? unsigned(std::strtoul(argv[2], nullptr, 0)) : 400;
+    unsigned const errorPercent = argc > 3 ? unsigned(std::strtoul(argv[3], nullptr, 0)) : 2;
+    double const usSamplePeriod = 2000;
+
+    std::mt19937 rng(0x620A);
+    std::uniform_int_distribution<unsigned> percent(0, 99);
+    MockBus bus(kHz);
+    cIqs620aReader reader;
+    unsigned nFail = 0;
+    unsigned nNack = 0, nHang = 0, nGood = 0;
+
+    reader.begin(bus, micros);
+
+    for (unsigned i = 0; i < nSamples; ++i)
+        {
+        double const usSample = g_us;
+        std::int16_t truth[4];
+
+        for (auto &v : truth)
+            v = std::int16_t(rng());
+        for (unsigned j = 0; j < 3; ++j)
+            put16(bus.regs + 0x20 + 2 * j, truth[j]);
+        put16(bus.regs + 0x2E, truth[3]);
+
+        unsigned const p = percent(rng);
+        bus.nextFault = p < errorPercent ? MockBus::Fault::kNack :
+                        p < 2 * errorPercent ? MockBus::Fault::kHang :
+                        MockBus::Fault::kNone;
+
+        if (! reader.start())
+            {
+            std::cerr << "sample " << i << ": start failed\n";
+            ++nFail;
+            }
+
+        // the CPU is free until the next sample.
+        bus.idleUntil(usSample + usSamplePeriod);
+        reader.poll();
+
+        bool const fResult = reader.getResult();
+        switch (bus.nextFault)
+            {
+        case MockBus::Fault::kNack: ++nNack; break;
+        case MockBus::Fault::kHang: ++nHang; break;
+        default: ++nGood; break;
+            }
+
+        if (fResult != (bus.nextFault == MockBus::Fault::kNone))
+            {
+            std::cerr << "sample " << i << (fResult ? ": result from a failed read\n" : ": no result\n");
+            ++nFail;
+            continue;
+            }
+        if (! fResult)
+            continue;
+
+        cTouchChannels<3>::Readings ch;
+        cTouchChannels<3>::read(reader, ch);
+        // channel order is Ch1, Ch2, Ch0.
+        if (ch[0] != truth[1] || ch[1] != truth[2] || ch[2] != truth[0] ||
+            reader.getAmplitude() != truth[3])
+            {
+            std::cerr << "sample " << i << ": wrong values\n";
+            ++nFail;
+            }
+        }
+
+    // collect the last read, if it hung; the next start() would have.
+    bool const fLastHung = bus.isBusy();
+    bus.abort();
+    reader.getResult();
+
+    auto const &stats = reader.getStats();
+    unsigned const nLate = nHang - fLastHung;
+    if (stats.nReads != nGood || stats.nErrors != nNack + nHang || stats.nBusy != nLate)
+        {
+        std::cerr << "stats: " << stats.nReads << " reads, " << stats.nErrors << " errors, "
+                  << stats.nBusy << " late; expected " << nGood << ", " << nNack + nHang
+                  << ", " << nLate << "\n";
+        ++nFail;
+        }
+    if (bus.nCompleted != bus.nStarted || bus.nDoubled != 0)
+        {
+        std::cerr << bus.nStarted << " reads started, " << bus.nCompleted << " completions, "
+                  << bus.nDoubled << " repeated\n";
+        ++nFail;
+        }
+
+    // the driver's way: four blocking transactions of two bytes.
+    double const usPerBlockingRead = 4 * (2 + 4 * 9 + 2 * 9) * 1000.0 / kHz;
+    std::uint64_t usBlocking = 0;
+    for (unsigned i = 0; i < nSamples; ++i)
+        {
+        std::uint32_t const tStart = micros();
+        spin(usPerBlockingRead);
+        usBlocking += micros() - tStart;
+        }
+
+    std::cout << nSamples << " samples at " << kHz << " kHz, " << errorPercent << "% NACK, "
+              << errorPercent << "% hung:\n";
+    std::cout << "  burst:    " << stats.nReads << " reads, "
+              << stats.usTotal / (stats.nReads ? stats.nReads : 1) << " us per read (max "
+              << stats.usMax << "), CPU "
+              << stats.usCpuTotal / (stats.nReads ? stats.nReads : 1) << " us per read (max "
+              << stats.usCpuMax << ")\n";
+    std::cout << "  blocking: " << usBlocking / nSamples << " us per read, all of it CPU\n";
+    std::cout << "  " << nFail << " failures\n";
+    return nFail == 0 ? 0 : 1;
+    }
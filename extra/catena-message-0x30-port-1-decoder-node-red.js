@@ -13,6 +13,9 @@ Author:
 
 */
 
+// touch channels in field 3; must match the sketch's kTouchChannels.
+var kTouchChannels = 2;
+
 function DecodeU16(Parse) {
     var i = Parse.i;
     var bytes = Parse.bytes;
@@ -93,6 +96,9 @@ function Decoder(bytes, port) {
         decoded.ch1 = DecodeU16(Parse);
         // Channel2 data
         decoded.ch2 = DecodeU16(Parse);
+        // Channel0 data, in 3-channel builds
+        if (kTouchChannels > 2)
+            decoded.ch0 = DecodeU16(Parse);
         // Hall Effect Amplitude
         decoded.amplitude = DecodeI16(Parse);
     }
@@ -104,6 +110,30 @@ function Decoder(bytes, port) {
         decoded.touchCountRight = DecodeU16(Parse);
     }
 
+    if (flags & 0x20) {
+        // Diagnostics
+        decoded.diag = {};
+        // uplinks failed since boot
+        decoded.diag.txFail = DecodeU16(Parse);
+        // measurement to TX complete, last periodic uplink (ms)
+        decoded.diag.txLatency = DecodeU16(Parse);
+        // longest poll() since the last report (ms)
+        decoded.diag.maxPoll = DecodeU16(Parse);
+        // late sensor samples since boot
+        decoded.diag.sampleOverruns = bytes[Parse.i++];
+        // charge used since boot (mAh)
+        decoded.diag.energyUsed = DecodeU16(Parse);
+    }
+
+    if (flags & 0x40) {
+        // Sensor Array: bit i for sensor i
+        decoded.sensors = {};
+        // sensors whose last read succeeded
+        decoded.sensors.present = bytes[Parse.i++];
+        // sensors touched since the last periodic uplink
+        decoded.sensors.active = bytes[Parse.i++];
+    }
+
     // at this point, decoded has the real values.
     return decoded;
 }
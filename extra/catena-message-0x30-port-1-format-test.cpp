@@ -34,6 +34,8 @@ struct touchData
     {
     int16_t ch1;
     int16_t ch2;
+    int16_t ch0;        // sent only if fCh0
+    bool fCh0;
     int16_t amplitude;
     };
 
@@ -44,6 +46,23 @@ struct counter
     int16_t touchCountRight;
     };
 
+// Diagnostics
+struct diagnostics
+    {
+    std::uint16_t txFail;
+    std::uint16_t txLatency;
+    std::uint16_t maxPoll;
+    std::uint8_t sampleOverruns;
+    std::uint16_t energyUsed;
+    };
+
+// Sensor Array
+struct sensors
+    {
+    std::uint8_t present;
+    std::uint8_t active;
+    };
+
 struct Measurements
     {
     val<float> Vbat;
@@ -52,6 +71,8 @@ struct Measurements
     val<std::uint8_t> Boot;
     val<touchData> TouchData;
     val<counter> TouchCount;
+    val<diagnostics> Diag;
+    val<sensors> Sensors;
     };
 
 std::uint16_t encode16s(float v)
@@ -147,6 +168,8 @@ void encodeMeasurement(Buffer &buf, Measurements &m)
 
         buf.push_back_be(encodeChannel(m.TouchData.v.ch1));
         buf.push_back_be(encodeChannel(m.TouchData.v.ch2));
+        if (m.TouchData.v.fCh0)
+            buf.push_back_be(encodeChannel(m.TouchData.v.ch0));
         buf.push_back_be(encodeAmplitude(m.TouchData.v.amplitude));
         }
 
@@ -158,6 +181,25 @@ void encodeMeasurement(Buffer &buf, Measurements &m)
         buf.push_back_be(encodeTouch(m.TouchCount.v.touchCountRight));
         }
 
+    if (m.Diag.fValid)
+        {
+        flags |= 1 << 5;
+
+        buf.push_back_be(m.Diag.v.txFail);
+        buf.push_back_be(m.Diag.v.txLatency);
+        buf.push_back_be(m.Diag.v.maxPoll);
+        buf.push_back(m.Diag.v.sampleOverruns);
+        buf.push_back_be(m.Diag.v.energyUsed);
+        }
+
+    if (m.Sensors.fValid)
+        {
+        flags |= 1 << 6;
+
+        buf.push_back(m.Sensors.v.present);
+        buf.push_back(m.Sensors.v.active);
+        }
+
     // update the flags
     buf.data()[1] = flags;
     }
@@ -203,6 +245,8 @@ void logMeasurement(Measurements &m)
         {
         std::cout << pad.get() << "Channel1 " << m.TouchData.v.ch1;
         std::cout << pad.get() << "Channel2 " << m.TouchData.v.ch2;
+        if (m.TouchData.v.fCh0)
+            std::cout << pad.get() << "Channel0 " << m.TouchData.v.ch0;
         std::cout << pad.get() << "Amplitude " << m.TouchData.v.amplitude;
         }
 
@@ -212,6 +256,21 @@ void logMeasurement(Measurements &m)
         std::cout << pad.get() << "RightTouchCounter " << m.TouchCount.v.touchCountRight;
         }
 
+    if (m.Diag.fValid)
+        {
+        std::cout << pad.get() << "TxFail " << m.Diag.v.txFail;
+        std::cout << pad.get() << "TxLatency " << m.Diag.v.txLatency;
+        std::cout << pad.get() << "MaxPoll " << m.Diag.v.maxPoll;
+        std::cout << pad.get() << "SampleOverruns " << unsigned(m.Diag.v.sampleOverruns);
+        std::cout << pad.get() << "EnergyUsed " << m.Diag.v.energyUsed;
+        }
+
+    if (m.Sensors.fValid)
+        {
+        std::cout << pad.get() << "SensorsPresent " << unsigned(m.Sensors.v.present);
+        std::cout << pad.get() << "SensorsActive " << unsigned(m.Sensors.v.active);
+        }
+
     // make the syntax cut/pastable.
     std::cout << pad.get() << ".\n";
     }
@@ -279,6 +338,13 @@ int main(int argc, char **argv)
             std::cin >> m.TouchData.v.ch2;
             m.TouchData.fValid = true;
             }
+        else if (key == "Channel0")
+            {
+            // only 3-channel builds send this.
+            std::cin >> m.TouchData.v.ch0;
+            m.TouchData.v.fCh0 = true;
+            m.TouchData.fValid = true;
+            }
         else if (key == "Amplitude")
             {
             std::cin >> m.TouchData.v.amplitude;
@@ -294,6 +360,47 @@ int main(int argc, char **argv)
             std::cin >> m.TouchCount.v.touchCountRight;
             m.TouchCount.fValid = true;
             }
+        else if (key == "TxFail")
+            {
+            std::cin >> m.Diag.v.txFail;
+            m.Diag.fValid = true;
+            }
+        else if (key == "TxLatency")
+            {
+            std::cin >> m.Diag.v.txLatency;
+            m.Diag.fValid = true;
+            }
+        else if (key == "MaxPoll")
+            {
+            std::cin >> m.Diag.v.maxPoll;
+            m.Diag.fValid = true;
+            }
+        else if (key == "SampleOverruns")
+            {
+            std::uint32_t nOverruns;
+            std::cin >> nOverruns;
+            m.Diag.v.sampleOverruns = (std::uint8_t) nOverruns;
+            m.Diag.fValid = true;
+            }
+        else if (key == "EnergyUsed")
+            {
+            std::cin >> m.Diag.v.energyUsed;
+            m.Diag.fValid = true;
+            }
+        else if (key == "SensorsPresent")
+            {
+            std::uint32_t bitmap;
+            std::cin >> bitmap;
+            m.Sensors.v.present = (std::uint8_t) bitmap;
+            m.Sensors.fValid = true;
+            }
+        else if (key == "SensorsActive")
+            {
+            std::uint32_t bitmap;
+            std::cin >> bitmap;
+            m.Sensors.v.active = (std::uint8_t) bitmap;
+            m.Sensors.fValid = true;
+            }
         else if (key == ".")
             {
             putTestVector(m);
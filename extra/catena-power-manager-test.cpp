@@ -0,0 +1,311 @@
+/*
+
+Name:   catena-power-manager-test.cpp
+
+Function:
+        Test cPowerManager with simulated peripherals, through a run of
+        deep sleeps.
+
+Copyright and License:
+        See accompanying LICENSE file
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+Usage:
+        g++ -std=c++14 -O2 -o catena-power-manager-test catena-power-manager-test.cpp
+
+        catena-power-manager-test [cycles [seed]]
+
+        Time is simulated, in milliseconds, and the switch records what
+        it's asked to do. First the reference counts are checked: nested
+        users power a peripheral up once and down once, an absent one is
+        never switched, and an extra release does nothing.
+
+        Then the sketch's use is run for a number of cycles (default
+        1000): the serial console and the sensor bus are held throughout,
+        the boost regulator sometimes, and the flash only for a write now
+        and then. Each cycle sleeps (suspend, then resume), then runs
+        deepSleepRecovery()'s wait for the boost regulator alongside
+        poll(), which samples once ensureSensor() allows, as the sketch
+        does. Nothing may be powered in sleep; the sensor bus may not come
+        back before the boost regulator has settled, nor serial before its
+        user asks; a peripheral must never be on without a reference; the
+        times powered must match those the switch saw; and the
+        wake-to-sample latency must be the settling time, when the boost
+        regulator is on.
+
+*/
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+
+#include "../Catena4610_cPowerManager.h"
+
+using McciCatena4610::cPowerManager;
+using Peripheral = cPowerManager::Peripheral;
+
+constexpr std::size_t kPeripherals = cPowerManager::kPeripherals;
+
+static std::uint32_t g_ms;
+static bool g_on[kPeripherals];
+static std::uint32_t g_tOn[kPeripherals];
+static std::uint64_t g_msOn[kPeripherals];
+static std::uint32_t g_nSwitches[kPeripherals];
+static unsigned g_nBadSwitches;
+
+static std::uint32_t clockMs() { return g_ms; }
+
+static void setPower(Peripheral p, bool fOn)
+    {
+    unsigned const i = unsigned(p);
+
+    // switching to the state it's already in is a mistake.
+    if (g_on[i] == fOn)
+        {
+        std::cerr << cPowerManager::getPeripheralName(p) << ": switched " << (fOn ? "on" : "off") << " twice\n";
+        ++g_nBadSwitches;
+        }
+
+    if (fOn)
+        g_tOn[i] = g_ms;
+    else if (g_on[i])
+        g_msOn[i] += g_ms - g_tOn[i];
+
+    g_on[i] = fOn;
+    ++g_nSwitches[i];
+    }
+
+static void resetSim()
+    {
+    for (std::size_t i = 0; i < kPeripherals; ++i)
+        {
+        g_on[i] = false;
+        g_msOn[i] = 0;
+        g_nSwitches[i] = 0;
+        }
+    }
+
+// nothing may be on without a reference, and the manager must agree
+// with the hardware.
+static unsigned checkConsistent(const cPowerManager &power, const char *pWhere)
+    {
+    unsigned nFail = 0;
+
+    for (std::size_t i = 0; i < kPeripherals; ++i)
+        {
+        auto const p = Peripheral(i);
+
+        if (power.isOn(p) != g_on[i] || (g_on[i] && power.getRefs(p) == 0))
+            {
+            std::cerr << pWhere << ": " << cPowerManager::getPeripheralName(p)
+                      << " is " << (g_on[i] ? "on" : "off") << ", manager says "
+                      << (power.isOn(p) ? "on" : "off") << " with " << unsigned(power.getRefs(p)) << " refs\n";
+            ++nFail;
+            }
+        }
+    return nFail;
+    }
+
+static unsigned testRefcounts()
+    {
+    cPowerManager power;
+    unsigned nFail = 0;
+
+    resetSim();
+    power.begin(clockMs, setPower, 0);
+
+    // nested users: one power-up, one power-down.
+    power.acquire(Peripheral::kFlash);
+    power.acquire(Peripheral::kFlash);
+    g_ms += 10;
+    power.release(Peripheral::kFlash);
+    if (! g_on[unsigned(Peripheral::kFlash)])
+        ++nFail;
+    power.release(Peripheral::kFlash);
+    power.release(Peripheral::kFlash);
+    if (g_nSwitches[unsigned(Peripheral::kFlash)] != 2 || power.getRefs(Peripheral::kFlash) != 0)
+        {
+        std::cerr << "nested: " << g_nSwitches[unsigned(Peripheral::kFlash)] << " switches\n";
+        ++nFail;
+        }
+
+    // the boost regulator isn't ready until it has settled.
+    power.acquire(Peripheral::kBoost);
+    if (power.isReady(Peripheral::kBoost) || power.ensure(Peripheral::kBoost))
+        ++nFail;
+    g_ms += cPowerManager::kBoostSettleMs;
+    if (! power.ensure(Peripheral::kBoost))
+        ++nFail;
+    power.release(Peripheral::kBoost);
+
+    // an absent peripheral is counted but never switched.
+    power.setPresent(Peripheral::kFlash, false);
+    power.acquire(Peripheral::kFlash);
+    if (power.isOn(Peripheral::kFlash) || power.getRefs(Peripheral::kFlash) != 1 ||
+        g_nSwitches[unsigned(Peripheral::kFlash)] != 2)
+        ++nFail;
+    power.release(Peripheral::kFlash);
+
+    // nothing in use: ensure() has nothing to do.
+    if (! power.ensure(Peripheral::kI2c) || power.isOn(Peripheral::kI2c))
+        ++nFail;
+
+    power.account();
+    if (power.getStats(Peripheral::kFlash).msOn != 10 || power.getStats(Peripheral::kFlash).nPowerUps != 1)
+        {
+        std::cerr << "nested: flash on " << power.getStats(Peripheral::kFlash).msOn << " ms\n";
+        ++nFail;
+        }
+
+    nFail += checkConsistent(power, "refcounts");
+    std::cout << "refcounts: " << (nFail ? "FAILED" : "ok") << "\n\n";
+    return nFail;
+    }
+
+static unsigned testSleepCycles(std::mt19937 &rng, unsigned nCycles)
+    {
+    cPowerManager power;
+    unsigned nFail = 0;
+    unsigned nBoostWakes = 0;
+    std::uint32_t msMaxLatency = 0;
+    bool fBoost = false;
+
+    // as at boot: USB serial is up already.
+    resetSim();
+    g_on[unsigned(Peripheral::kSerial)] = true;
+    g_tOn[unsigned(Peripheral::kSerial)] = g_ms;
+    power.begin(clockMs, setPower, cPowerManager::getMask(Peripheral::kSerial));
+    power.acquire(Peripheral::kSerial);
+    power.acquire(Peripheral::kI2c);
+
+    for (unsigned i = 0; i < nCycles; ++i)
+        {
+        // awake: measure, maybe switch the boost regulator, maybe write.
+        g_ms += 1 + rng() % 100;
+        if (rng() % 4 == 0)
+            {
+            fBoost = ! fBoost;
+            if (fBoost)
+                power.acquire(Peripheral::kBoost);
+            else
+                power.release(Peripheral::kBoost);
+            }
+        if (rng() % 8 == 0)
+            {
+            power.acquire(Peripheral::kFlash);
+            g_ms += 5 + rng() % 20;
+            power.release(Peripheral::kFlash);
+            }
+        g_ms += rng() % 50;
+        nFail += checkConsistent(power, "awake");
+
+        // deep sleep.
+        power.suspend();
+        for (std::size_t j = 0; j < kPeripherals; ++j)
+            {
+            if (g_on[j])
+                {
+                std::cerr << "cycle " << i << ": " << cPowerManager::getPeripheralName(Peripheral(j))
+                          << " on in sleep\n";
+                ++nFail;
+                }
+            }
+        g_ms += 60000 + rng() % 300000;
+        power.resume();
+
+        // each millisecond, deepSleepRecovery() waits for the boost
+        // regulator, and poll() samples once ensureSensor() says so.
+        bool fSampled = false;
+        for (std::uint32_t ms = 0; ! fSampled && ms <= cPowerManager::kBoostSettleMs; ++ms, ++g_ms)
+            {
+            power.ensure(Peripheral::kBoost);
+            if (power.ensureSensor())
+                {
+                power.noteSample();
+                fSampled = true;
+                }
+            else if (g_on[unsigned(Peripheral::kI2c)])
+                {
+                std::cerr << "cycle " << i << ": sensor bus up before the boost regulator\n";
+                ++nFail;
+                }
+            }
+        if (! fSampled || g_on[unsigned(Peripheral::kSerial)])
+            {
+            std::cerr << "cycle " << i << ": " << (fSampled ? "serial powered up before use" : "never sampled") << "\n";
+            ++nFail;
+            }
+
+        std::uint32_t const msExpected = fBoost ? cPowerManager::kBoostSettleMs : 0;
+        if (power.getWakeStats().msLast != msExpected)
+            {
+            std::cerr << "cycle " << i << ": wake to sample " << power.getWakeStats().msLast
+                      << " ms, expected " << msExpected << "\n";
+            ++nFail;
+            }
+        if (fBoost)
+            ++nBoostWakes;
+        if (msExpected > msMaxLatency)
+            msMaxLatency = msExpected;
+
+        // another sample in the same wake isn't the first.
+        g_ms += 20;
+        power.noteSample();
+        nFail += checkConsistent(power, "woken");
+        }
+
+    power.account();
+
+    // no USB host in this run: serial stays down after the first sleep.
+    auto const &wake = power.getWakeStats();
+    std::cout << nCycles << " sleep cycles, " << nBoostWakes << " with the boost regulator on:\n";
+    for (std::size_t j = 0; j < kPeripherals; ++j)
+        {
+        auto const p = Peripheral(j);
+        auto const &stats = power.getStats(p);
+        std::uint64_t msSeen = g_msOn[j] + (g_on[j] ? g_ms - g_tOn[j] : 0);
+
+        std::cout << "  " << cPowerManager::getPeripheralName(p) << ": " << stats.nPowerUps
+                  << " power-ups, on " << stats.msOn / 1000 << " s of " << g_ms / 1000 << " s\n";
+        if (stats.msOn != msSeen)
+            {
+            std::cerr << cPowerManager::getPeripheralName(p) << ": on " << stats.msOn
+                      << " ms, switch saw " << msSeen << " ms\n";
+            ++nFail;
+            }
+        }
+    std::cout << "  wake to sample: " << wake.nSampled << " of " << wake.nWakes << " wakes, max "
+              << wake.msMax << " ms, average " << (wake.nSampled ? wake.msTotal / wake.nSampled : 0) << " ms\n\n";
+
+    if (wake.nWakes != nCycles || wake.nSampled != nCycles || wake.msMax != msMaxLatency ||
+        power.getStats(Peripheral::kSerial).nPowerUps != 0 ||
+        power.getStats(Peripheral::kI2c).nPowerUps != nCycles + 1)
+        {
+        std::cerr << "wake stats: " << wake.nWakes << " wakes, " << wake.nSampled << " sampled, max "
+                  << wake.msMax << " ms; serial up " << power.getStats(Peripheral::kSerial).nPowerUps
+                  << ", i2c up " << power.getStats(Peripheral::kI2c).nPowerUps << "\n";
+        ++nFail;
+        }
+
+    return nFail;
+    }
+
+int main(int argc, char **argv)
+    {
+    unsigned const nCycles = argc > 1 ? unsigned(std::strtoul(argv[1], nullptr, 0)) : 1000;
+    unsigned const seed = argc > 2 ? unsigned(std::strtoul(argv[2], nullptr, 0)) : 4610;
+
+    std::mt19937 rng(seed);
+    unsigned nFail = 0;
+
+    g_ms = 1000;
+    nFail += testRefcounts();
+    nFail += testSleepCycles(rng, nCycles);
+    nFail += g_nBadSwitches;
+
+    std::cout << nFail << " failures\n";
+    return nFail == 0 ? 0 : 1;
+    }
@@ -0,0 +1,360 @@
+/*
+
+Name:   catena-sensor-array-sim.cpp
+
+Function:
+        Simulate cSensorArray on a shared I2C bus, and show the sample
+        rate each sensor gets as the number of sensors grows.
+
+Copyright and License:
+        See accompanying LICENSE file
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+Usage:
+        g++ -std=c++14 -O2 -o catena-sensor-array-sim catena-sensor-array-sim.cpp
+
+        catena-sensor-array-sim [period-ms [kHz [reads-per-round]]]
+
+        The sensors are wired as cMeasurementLoop wires them: sensor i is
+        an IQS620A on channel i of a mux. Time is simulated: every
+        transfer takes as long as its bits do at the bus speed (default
+        400 kHz), the address phase and each mux switch on the CPU; and
+        the loop polls 20 microseconds after each completion interrupt.
+        One round is started every sampling period (default 50 ms), and
+        ended at the end of it, for 1000 periods.
+
+        For 1 to 8 sensors, this prints the rate at which each sensor is
+        read, the fraction of the time the bus is busy, and the rounds
+        that ended with sensors unread:
+
+            every sensor every round, round robin
+            reads-per-round (default 4) each round, round robin
+            the same, sensor 0 at priority 4 and the others at 1
+            every sensor every round, with a 2 ms sampling period
+
+        Every value read must be the one the simulated sensor held, and
+        each sensor's touch state must match a cTouchDetector fed the
+        same readings. A missing sensor must be reported missing.
+
+*/
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+
+#include "../Catena4610_cSensorArray.h"
+#include "../Catena4610_cTouchDetector.h"
+
+using McciCatena4610::cI2cBus;
+using McciCatena4610::cIqs620aReader;
+using McciCatena4610::cSensorArray;
+using McciCatena4610::cTouchDetector;
+
+constexpr std::size_t kMaxSensors = 8;
+constexpr std::size_t kChannels = 2;
+constexpr std::uint16_t kThreshold = 400;
+constexpr std::uint16_t kHysteresis = 20;
+constexpr std::uint8_t kDebounce = 2;
+constexpr double kPollLatencyUs = 20;
+constexpr unsigned kRounds = 1000;
+
+using Array = cSensorArray<kMaxSensors, kChannels>;
+
+// the simulated clock, in microseconds.
+static double g_us;
+
+class SimBus : public cI2cBus
+    {
+public:
+    explicit SimBus(unsigned kHz)
+        : m_usPerBit(1000.0 / kHz)
+        {}
+
+    // each sensor's registers; sensors at or past nPresent don't answer.
+    std::uint8_t regs[kMaxSensors][256] {};
+    std::size_t nPresent = kMaxSensors;
+    double usBusy = 0;
+
+    virtual bool startRead(
+        std::uint8_t address,
+        std::uint8_t reg,
+        std::uint8_t *pBuffer,
+        std::size_t nBuffer,
+        CompletionFn pDone,
+        void *pClientData
+        ) override
+        {
+        if (this->m_fBusy || this->m_mux >= kMaxSensors)
+            return false;
+
+        // START, address and register byte, on the CPU.
+        double const usAddress = (1 + 2 * 9) * this->m_usPerBit;
+        g_us += usAddress;
+        this->usBusy += usAddress;
+
+        this->m_fBusy = true;
+        this->m_fNack = address != cIqs620aReader::kAddress || this->m_mux >= this->nPresent;
+        this->m_reg = reg;
+        this->m_pBuffer = pBuffer;
+        this->m_nBuffer = nBuffer;
+        this->m_pDone = pDone;
+        this->m_pClientData = pClientData;
+        // repeated START, address, the data, STOP; a NACK ends it early.
+        this->m_tDone = g_us + (2 + 9 + (this->m_fNack ? 0 : 9 * nBuffer)) * this->m_usPerBit;
+        return true;
+        }
+
+    virtual bool isBusy() const override
+        {
+        return this->m_fBusy;
+        }
+
+    virtual void abort() override
+        {
+        if (! this->m_fBusy)
+            return;
+
+        this->usBusy += g_us - (this->m_tDone - this->duration());
+        this->m_fBusy = false;
+        this->m_pDone(this->m_pClientData, Status::kAborted);
+        }
+
+    // the mux: one byte written, on the CPU.
+    static bool selectMux(void *pContext, std::uint8_t channel)
+        {
+        SimBus * const pThis = static_cast<SimBus *>(pContext);
+        double const us = (1 + 2 * 9 + 1) * pThis->m_usPerBit;
+
+        g_us += us;
+        pThis->usBusy += us;
+        pThis->m_mux = channel;
+        return true;
+        }
+
+    // run the clock to the end of the transfer, if it ends by tLimit,
+    // and interrupt.
+    bool runUntil(double tLimit)
+        {
+        if (! this->m_fBusy || this->m_tDone > tLimit)
+            return false;
+
+        g_us = this->m_tDone;
+        this->usBusy += this->duration();
+        this->m_fBusy = false;
+        if (this->m_fNack)
+            {
+            this->m_pDone(this->m_pClientData, Status::kNack);
+            return true;
+            }
+
+        std::memcpy(this->m_pBuffer, this->regs[this->m_mux] + this->m_reg, this->m_nBuffer);
+        this->m_pDone(this->m_pClientData, Status::kOk);
+        return true;
+        }
+
+private:
+    double duration() const
+        {
+        return (2 + 9 + (this->m_fNack ? 0 : 9 * this->m_nBuffer)) * this->m_usPerBit;
+        }
+
+    double          m_usPerBit;
+    bool            m_fBusy = false;
+    bool            m_fNack = false;
+    std::uint8_t    m_mux = Array::kNoMux;
+    std::uint8_t    m_reg = 0;
+    std::uint8_t    *m_pBuffer = nullptr;
+    std::size_t     m_nBuffer = 0;
+    CompletionFn    m_pDone = nullptr;
+    void            *m_pClientData = nullptr;
+    double          m_tDone = 0;
+    };
+
+static void put16(std::uint8_t *p, std::int16_t v)
+    {
+    p[0] = std::uint8_t(v);
+    p[1] = std::uint8_t(std::uint16_t(v) >> 8);
+    }
+
+struct Result
+    {
+    double          hz[kMaxSensors];
+    double          busyPercent;
+    std::uint32_t   nOverruns;
+    std::uint8_t    present;
+    unsigned        nFail;
+    };
+
+static Result simulate(
+    std::size_t nSensors,
+    std::size_t nPresent,
+    Array::Policy policy,
+    std::size_t readsPerRound,
+    double msPeriod,
+    unsigned kHz
+    )
+    {
+    std::mt19937 rng(0x4610 + unsigned(nSensors));
+    SimBus bus(kHz);
+    Array array;
+    cTouchDetector detector[kMaxSensors];
+    Array::Readings truth[kMaxSensors];
+    Result result {};
+
+    g_us = 0;
+    bus.nPresent = nPresent;
+    array.begin(bus, SimBus::selectMux, &bus);
+    array.setSchedule(policy, readsPerRound);
+    array.setThresholds(Array::Thresholds {{ kThreshold, kThreshold }});
+    array.setDetection(kHysteresis, kDebounce);
+    for (std::size_t i = 0; i < nSensors; ++i)
+        array.addSensor(cIqs620aReader::kAddress, std::uint8_t(i), i == 0 ? 4 : 1);
+
+    double const usPeriod = msPeriod * 1000;
+
+    for (unsigned r = 0; r < kRounds; ++r)
+        {
+        double const tRound = r * usPeriod;
+        double const tEnd = tRound + usPeriod;
+
+        if (g_us < tRound)
+            g_us = tRound;
+
+        // now and then, a sensor is touched for a few rounds.
+        for (std::size_t i = 0; i < nSensors; ++i)
+            {
+            bool const fTouched = (r / 4 + i) % 7 == 0;
+
+            for (auto &v : truth[i])
+                v = std::int16_t(fTouched ? rng() % kThreshold : kThreshold + rng() % 1000);
+            // channel order is Ch1, Ch2: registers 0x22 and 0x24.
+            put16(bus.regs[i] + 0x22, truth[i][0]);
+            put16(bus.regs[i] + 0x24, truth[i][1]);
+            put16(bus.regs[i] + 0x2E, std::int16_t(rng()));
+            }
+
+        array.startRound();
+
+        // each completion interrupt wakes the loop, which polls.
+        while (bus.runUntil(tEnd))
+            {
+            g_us += kPollLatencyUs;
+            array.poll();
+            }
+        g_us = tEnd;
+
+        std::uint8_t const fresh = array.endRound();
+        std::uint8_t touching = 0, newTouches = 0;
+
+        for (std::size_t i = 0; i < nSensors; ++i)
+            {
+            if ((fresh & (1u << i)) == 0)
+                {
+                touching |= std::uint8_t(detector[i].isTouching()) << i;
+                continue;
+                }
+
+            Array::Readings ch;
+            array.getReadings(i, ch);
+            if (ch != truth[i] || array.getAmplitude(i) != std::int16_t(bus.regs[i][0x2E] | (bus.regs[i][0x2F] << 8)))
+                {
+                std::cerr << nSensors << " sensors, round " << r << ", sensor " << i << ": wrong values\n";
+                ++result.nFail;
+                }
+
+            auto const t = detector[i].update<kChannels>(
+                ch,
+                Array::Thresholds {{ kThreshold, kThreshold }},
+                kHysteresis,
+                kDebounce
+                );
+            touching |= std::uint8_t(detector[i].isTouching()) << i;
+            newTouches |= std::uint8_t(t.fNewTouch) << i;
+            }
+
+        if (touching != array.getTouching() || newTouches != array.getNewTouches())
+            {
+            std::cerr << nSensors << " sensors, round " << r << ": touching "
+                      << unsigned(array.getTouching()) << " new " << unsigned(array.getNewTouches())
+                      << ", expected " << unsigned(touching) << " new " << unsigned(newTouches) << "\n";
+            ++result.nFail;
+            }
+        }
+
+    double const seconds = kRounds * usPeriod / 1e6;
+    for (std::size_t i = 0; i < nSensors; ++i)
+        result.hz[i] = array.getReads(i) / seconds;
+    result.busyPercent = 100 * bus.usBusy / (kRounds * usPeriod);
+    result.nOverruns = array.getStats().nOverruns;
+    result.present = array.getPresent();
+    return result;
+    }
+
+static unsigned runTable(
+    const char *pTitle,
+    Array::Policy policy,
+    std::size_t readsPerRound,
+    double msPeriod,
+    unsigned kHz
+    )
+    {
+    unsigned nFail = 0;
+
+    std::cout << pTitle << ", " << msPeriod << " ms period:\n";
+    std::cout << "  K  reads per second, by sensor                    busy  overruns\n";
+
+    for (std::size_t k = 1; k <= kMaxSensors; ++k)
+        {
+        Result const r = simulate(k, k, policy, readsPerRound, msPeriod, kHz);
+        std::cout << "  " << k << " ";
+        for (std::size_t i = 0; i < kMaxSensors; ++i)
+            {
+            std::cout << std::setw(6);
+            if (i < k)
+                std::cout << std::fixed << std::setprecision(1) << r.hz[i];
+            else
+                std::cout << "";
+            }
+        std::cout << std::setw(5) << std::setprecision(0) << r.busyPercent << "% "
+                  << std::setw(8) << r.nOverruns << "\n";
+        nFail += r.nFail;
+        }
+    std::cout << "\n";
+    return nFail;
+    }
+
+int main(int argc, char **argv)
+    {
+    double const msPeriod = argc > 1 ? std::strtod(argv[1], nullptr) : 50;
+    unsigned const kHz = argc > 2 ? unsigned(std::strtoul(argv[2], nullptr, 0)) : 400;
+    std::size_t const readsPerRound = argc > 3 ? std::strtoul(argv[3], nullptr, 0) : 4;
+    unsigned nFail = 0;
+
+    std::cout << kHz << " kHz bus, " << kRounds << " rounds\n\n";
+
+    nFail += runTable("every sensor every round", Array::Policy::kRoundRobin, 0, msPeriod, kHz);
+
+    std::string const title = std::to_string(readsPerRound) + " reads per round";
+    nFail += runTable((title + ", round robin").c_str(), Array::Policy::kRoundRobin, readsPerRound, msPeriod, kHz);
+    nFail += runTable((title + ", sensor 0 at priority 4").c_str(), Array::Policy::kPriority, readsPerRound, msPeriod, kHz);
+    nFail += runTable("every sensor every round", Array::Policy::kRoundRobin, 0, 2, kHz);
+
+    // a sensor that doesn't answer is reported missing, and doesn't stop
+    // the others.
+    Result const r = simulate(3, 2, Array::Policy::kRoundRobin, 0, msPeriod, kHz);
+    if (r.present != 0x03 || r.hz[0] == 0 || r.hz[1] == 0)
+        {
+        std::cerr << "missing sensor: present " << unsigned(r.present) << ", expected 3\n";
+        ++nFail;
+        }
+    nFail += r.nFail;
+
+    std::cout << nFail << " failures\n";
+    return nFail == 0 ? 0 : 1;
+    }
@@ -0,0 +1,333 @@
+/*
+
+Name:   catena-session-store-test.cpp
+
+Function:
+        Test cSessionStore against a simulated NOR flash, with resets
+        injected part-way through programs and erases.
+
+Copyright and License:
+        See accompanying LICENSE file
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+Usage:
+        g++ -std=c++14 -O2 -o catena-session-store-test catena-session-store-test.cpp
+
+        catena-session-store-test [uplinks [seed]]
+
+        The flash behaves as the MX25V8035F does: an erase sets a sector
+        to 0xFF, a program can only clear bits and must not cross a page.
+
+        The store is driven as cLoRaWANSession drives it, for a number of
+        uplinks (default 20000): update() after each, with the session
+        itself (data rate, as ADR would) changing now and then. At random
+        the device resets, sometimes in the middle of a program or an
+        erase, leaving only part of it done; a new store is then begun
+        on the same flash. The session restored must always be the one in
+        use, with an uplink counter beyond any already used.
+
+        Then "session erase" is checked: after erase(), update() must not
+        write the running session back, however many uplinks follow, and
+        a reset must join; a join (new keys, with a new address or the
+        same one) must be saved again.
+
+*/
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "../Catena4610_cSessionStore.h"
+
+namespace FlashMap = McciCatena4610::FlashMap;
+
+// thrown to simulate a reset in the middle of a flash operation.
+struct Reset {};
+
+class cSimFlash
+    {
+public:
+    cSimFlash()
+        : m_mem(FlashMap::kSessionSectors * FlashMap::kSectorSize, 0xFF)
+        , m_nOps(0)
+        , m_tearAt(0)
+        , m_nErases(0)
+        , m_nPrograms(0)
+        , m_nErrors(0)
+        {}
+
+    void read(std::uint32_t addr, std::uint8_t *p, std::size_t n)
+        {
+        std::memcpy(p, &this->m_mem[this->offset(addr, n)], n);
+        }
+
+    void program(std::uint32_t addr, const std::uint8_t *p, std::size_t n)
+        {
+        std::size_t const off = this->offset(addr, n);
+
+        if (addr / FlashMap::kPageSize != (addr + n - 1) / FlashMap::kPageSize)
+            {
+            std::cerr << "program of " << n << " bytes at " << std::hex << addr << std::dec
+                      << " crosses a page\n";
+            ++this->m_nErrors;
+            }
+
+        std::size_t const nDone = this->tear(n);
+        for (std::size_t i = 0; i < nDone; ++i)
+            this->m_mem[off + i] &= p[i];
+        ++this->m_nPrograms;
+        if (nDone != n)
+            throw Reset();
+        }
+
+    void eraseSector(std::uint32_t addr)
+        {
+        std::size_t const off = this->offset(addr, FlashMap::kSectorSize);
+
+        // an interrupted erase leaves the sector partly erased.
+        std::size_t const nDone = this->tear(FlashMap::kSectorSize);
+        std::memset(&this->m_mem[off], 0xFF, nDone);
+        ++this->m_nErases;
+        if (nDone != FlashMap::kSectorSize)
+            {
+            // and the rest scrambled.
+            for (std::size_t i = nDone; i < FlashMap::kSectorSize; ++i)
+                this->m_mem[off + i] |= std::uint8_t(i * 37);
+            throw Reset();
+            }
+        }
+
+    // reset at the nth flash operation from now (0: never).
+    void setTear(std::uint32_t n, std::uint32_t fraction)
+        {
+        this->m_tearAt = n;
+        this->m_tearFraction = fraction;
+        this->m_nOps = 0;
+        }
+
+    std::uint32_t getErases() const { return this->m_nErases; }
+    std::uint32_t getPrograms() const { return this->m_nPrograms; }
+    unsigned getErrors() const { return this->m_nErrors; }
+
+private:
+    std::size_t offset(std::uint32_t addr, std::size_t n)
+        {
+        if (addr < FlashMap::kSessionBase ||
+            addr + n > FlashMap::kSessionBase + this->m_mem.size())
+            {
+            std::cerr << "access at " << std::hex << addr << std::dec << " outside the store\n";
+            ++this->m_nErrors;
+            std::exit(1);
+            }
+        return addr - FlashMap::kSessionBase;
+        }
+
+    // how much of an n-byte operation gets done.
+    std::size_t tear(std::size_t n)
+        {
+        if (this->m_tearAt == 0 || ++this->m_nOps != this->m_tearAt)
+            return n;
+
+        this->m_tearAt = 0;
+        return n * this->m_tearFraction / 100;
+        }
+
+    std::vector<std::uint8_t>   m_mem;
+    std::uint32_t               m_nOps;
+    std::uint32_t               m_tearAt;
+    std::uint32_t               m_tearFraction;
+    std::uint32_t               m_nErases;
+    std::uint32_t               m_nPrograms;
+    unsigned                    m_nErrors;
+    };
+
+using Store = McciCatena4610::cSessionStore<cSimFlash>;
+using Session = Store::Session;
+
+static Session makeSession(std::uint32_t devAddr, std::uint8_t datarate)
+    {
+    Session s;
+
+    std::memset(&s, 0, sizeof(s));
+    s.netId = 0x13;
+    s.devAddr = devAddr;
+    s.datarate = datarate;
+    s.txPower = 14;
+    s.rxDelay = 1;
+    for (unsigned i = 0; i < 16; ++i)
+        s.nwkSKey[i] = s.appSKey[i] = std::uint8_t(devAddr + i);
+    return s;
+    }
+
+static unsigned testResets(std::uint32_t nUplinks, std::mt19937 &rng)
+    {
+    cSimFlash flash;
+    unsigned nFail = 0;
+    unsigned nResets = 0;
+    unsigned nTorn = 0;
+
+    Session running = makeSession(0x26011234, 5);
+    std::uint32_t lastUsed = 0;
+
+    Store *pStore = new Store(flash);
+    pStore->begin();
+
+    for (std::uint32_t i = 0; i < nUplinks; ++i)
+        {
+        // an uplink uses the next counter value.
+        lastUsed = running.seqnoUp++;
+        if (rng() % 5 == 0)
+            ++running.seqnoDn;
+        if (rng() % 1000 == 0)
+            running.datarate = std::uint8_t(rng() % 6);
+
+        // now and then, reset; or arrange for a reset in the middle of
+        // one of the next few flash operations.
+        bool fReset = rng() % 400 == 0;
+        if (rng() % 400 == 0)
+            flash.setTear(1 + rng() % 3, rng() % 100);
+
+        try
+            {
+            pStore->update(running);
+            }
+        catch (const Reset &)
+            {
+            fReset = true;
+            ++nTorn;
+            }
+
+        if (! fReset)
+            continue;
+
+        // reset: begin again, and resume as cLoRaWANSession::restore()
+        // does; that writes too, and may itself be interrupted.
+        ++nResets;
+
+        Session restored;
+        bool fFound;
+        for (;;)
+            {
+            delete pStore;
+            pStore = new Store(flash);
+            try
+                {
+                fFound = pStore->begin() && pStore->resume(restored);
+                break;
+                }
+            catch (const Reset &)
+                {
+                ++nTorn;
+                }
+            }
+
+        if (! fFound)
+            {
+            std::cerr << "uplink " << i << ": no session after reset\n";
+            ++nFail;
+            continue;
+            }
+        if (restored.devAddr != running.devAddr ||
+            std::int32_t(restored.seqnoUp - lastUsed) <= 0)
+            {
+            std::cerr << "uplink " << i << ": restored seqnoUp " << restored.seqnoUp
+                      << ", last used " << lastUsed << "\n";
+            ++nFail;
+            }
+
+        // an interrupted session change may leave the old one: ADR
+        // sets it again, and the next update() saves it.
+        std::uint8_t const datarate = running.datarate;
+        running = restored;
+        running.datarate = datarate;
+        }
+
+    std::cout << nUplinks << " uplinks, " << nResets << " resets (" << nTorn << " mid-write): "
+              << flash.getErases() << " sector erases, " << flash.getPrograms() << " programs; "
+              << "generation " << pStore->getGeneration() << "\n";
+
+    delete pStore;
+    return nFail + flash.getErrors();
+    }
+
+static unsigned testErase()
+    {
+    cSimFlash flash;
+    unsigned nFail = 0;
+    Store store(flash);
+    Session running = makeSession(0x26011234, 5);
+
+    store.begin();
+    for (unsigned i = 0; i < 40; ++i, ++running.seqnoUp)
+        store.update(running);
+
+    store.erase(running);
+    std::uint32_t const nPrograms = flash.getPrograms();
+
+    // the rest of the running session: nothing may be written.
+    for (unsigned i = 0; i < 1000; ++i, ++running.seqnoUp)
+        {
+        store.update(running);
+        }
+
+        {
+        Store after(flash);
+        if (after.begin() || flash.getPrograms() != nPrograms || ! store.isHeld())
+            {
+            std::cerr << "erase: the running session was saved again\n";
+            ++nFail;
+            }
+        }
+
+    // a join with a new address is saved.
+    Session joined = makeSession(0x26015678, 5);
+    store.update(joined);
+        {
+        Store after(flash);
+        Session s;
+        if (! after.begin() || ! after.getSession(s) || s.devAddr != joined.devAddr || store.isHeld())
+            {
+            std::cerr << "erase: a new join wasn't saved\n";
+            ++nFail;
+            }
+        }
+
+    // a join that keeps the address, right after the erase.
+    store.erase(joined);
+    store.update(joined);
+    Session rejoined = joined;
+    rejoined.nwkSKey[0] ^= 0x5A;
+    store.update(rejoined);
+        {
+        Store after(flash);
+        Session s;
+        if (! after.begin() || ! after.getSession(s) || s.seqnoUp != 2 * Store::kJournalInterval)
+            {
+            std::cerr << "erase: a join keeping the address wasn't saved\n";
+            ++nFail;
+            }
+        }
+
+    std::cout << "session erase: " << (nFail ? "FAILED" : "ok") << "\n";
+    return nFail + flash.getErrors();
+    }
+
+int main(int argc, char **argv)
+    {
+    std::uint32_t const nUplinks = argc > 1 ? std::uint32_t(std::strtoul(argv[1], nullptr, 0)) : 20000;
+    unsigned const seed = argc > 2 ? unsigned(std::strtoul(argv[2], nullptr, 0)) : 4610;
+
+    std::mt19937 rng(seed);
+    unsigned nFail = 0;
+
+    nFail += testResets(nUplinks, rng);
+    nFail += testErase();
+
+    std::cout << nFail << " failures\n";
+    return nFail == 0 ? 0 : 1;
+    }
@@ -0,0 +1,311 @@
+/*
+
+Name:   catena-stall-monitor-test.cpp
+
+Function:
+        Test cStallMonitor with a simulated loop that has slow paths
+        injected, and a simulated watchdog.
+
+Copyright and License:
+        See accompanying LICENSE file
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+Usage:
+        g++ -std=c++14 -O2 -o catena-stall-monitor-test catena-stall-monitor-test.cpp
+
+        catena-stall-monitor-test [iterations [seed]]
+
+        Time is simulated, in milliseconds. Each iteration of the loop
+        (default 20000) takes a few milliseconds; now and then a slow path
+        is injected, as the sketch's blocking sites would be:
+
+            txspin      a transmission, 1 to 5 seconds, in stTransmit,
+                        with the FSM entered from it for a little
+            counters    saving the touch counters, 100 to 300 ms
+            fsm         a slow FSM step, 100 to 200 ms
+            loop        a slow command, 100 to 300 ms, not marked
+
+        The worst stalls kept must be the longest injected, longest first,
+        each with the site and FSM state it was injected with. The counts
+        must match, and the watchdog must be kicked after every iteration
+        shorter than kHealthyMs.
+
+        The same is done again without transmissions, so that the other
+        sites make the list.
+
+        Then the watchdog is checked: one iteration just over kHealthyMs
+        is survived; two in a row reset the simulated CPU, as does a hang.
+        Last, a join or duty-cycle wait: a transmit spin of two minutes,
+        in passes of a few milliseconds (now and then a few seconds), each
+        marked with progress(), is survived; without the marks it resets,
+        as does a pass that hangs.
+
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "../Catena4610_cStallMonitor.h"
+
+using McciCatena4610::cStallMonitor;
+using Site = cStallMonitor::Site;
+
+// the measurement loop's states, as numbered there.
+constexpr std::uint8_t kSleeping = 3;
+constexpr std::uint8_t kTransmit = 6;
+
+static std::uint32_t g_ms;
+static std::uint8_t g_state;
+static std::uint32_t g_nKicks;
+static std::uint32_t g_tLastKick;
+
+static std::uint32_t clockMs() { return g_ms; }
+static std::uint8_t getState() { return g_state; }
+
+static void kick()
+    {
+    ++g_nKicks;
+    g_tLastKick = g_ms;
+    }
+
+// the watchdog fires if it's been kWatchdogMs since the last kick.
+static bool watchdogFired()
+    {
+    return g_ms - g_tLastKick >= cStallMonitor::kWatchdogMs;
+    }
+
+struct Injected
+    {
+    std::uint32_t   ms;
+    Site            site;
+    std::uint8_t    state;
+    };
+
+// run nIterations of the loop; check the records and counts.
+static unsigned runPhase(cStallMonitor &monitor, std::mt19937 &rng, unsigned nIterations, bool fTransmit)
+    {
+    std::vector<Injected> stalls;
+    unsigned nFail = 0;
+    unsigned nExpectedKicks = 0;
+    std::uint32_t const nKicksBefore = g_nKicks;
+
+    monitor.resetStats();
+
+    for (unsigned i = 0; i < nIterations; ++i)
+        {
+        g_state = kSleeping;
+        std::uint32_t const tStart = g_ms;
+
+        monitor.beginIteration();
+        g_ms += 1 + rng() % 3;
+
+        unsigned const r = rng() % 1000;
+        Injected slow { 0, Site::kLoop, kSleeping };
+
+        if (r < 3 && fTransmit)
+            {
+            // a transmission: the FSM runs inside it, briefly.
+            g_state = kTransmit;
+            auto const site = monitor.enter(Site::kTxSpin);
+            std::uint32_t const ms = 1000 + rng() % 4000;
+
+            g_ms += ms / 2;
+            auto const inner = monitor.enter(Site::kFsm);
+            g_ms += 10 + rng() % 50;
+            monitor.leave(inner);
+            g_ms += ms - ms / 2;
+            monitor.leave(site);
+            slow = Injected { 0, Site::kTxSpin, kTransmit };
+            }
+        else if (r >= 3 && r < 8)
+            {
+            auto const site = monitor.enter(Site::kCounters);
+            g_ms += 100 + rng() % 200;
+            monitor.leave(site);
+            slow.site = Site::kCounters;
+            }
+        else if (r >= 8 && r < 12)
+            {
+            auto const site = monitor.enter(Site::kFsm);
+            g_ms += 100 + rng() % 100;
+            monitor.leave(site);
+            slow.site = Site::kFsm;
+            }
+        else if (r >= 12 && r < 14)
+            {
+            g_ms += 100 + rng() % 200;
+            }
+
+        g_ms += rng() % 2;
+        monitor.endIteration();
+
+        std::uint32_t const ms = g_ms - tStart;
+        if (ms >= cStallMonitor::kStallMs)
+            {
+            slow.ms = ms;
+            stalls.push_back(slow);
+            }
+        if (ms < cStallMonitor::kHealthyMs)
+            ++nExpectedKicks;
+
+        if (watchdogFired())
+            {
+            std::cerr << "iteration " << i << ": watchdog fired\n";
+            ++nFail;
+            }
+
+        // idle.
+        g_ms += rng() % 50;
+        }
+
+    auto const &stats = monitor.getStats();
+
+    std::stable_sort(stalls.begin(), stalls.end(),
+        [](const Injected &a, const Injected &b) { return a.ms > b.ms; });
+
+    std::cout << nIterations << " iterations" << (fTransmit ? "" : ", no uplinks") << ": "
+              << stats.nStalls << " stalls, longest " << stats.msMax << " ms; worst:\n";
+
+    std::size_t const n = monitor.getCount();
+    if (n != std::min(stalls.size(), cStallMonitor::kRecords))
+        {
+        std::cerr << n << " records, expected " << std::min(stalls.size(), cStallMonitor::kRecords) << "\n";
+        ++nFail;
+        }
+
+    for (std::size_t i = 0; i < n && i < stalls.size(); ++i)
+        {
+        auto const &r = monitor.getRecord(i);
+        auto const &e = stalls[i];
+
+        std::cout << "  " << r.ms << " ms at " << r.tStart << " ms, "
+                  << cStallMonitor::getSiteName(r.site) << ", state " << unsigned(r.state) << "\n";
+
+        // equal lengths may be kept in either order.
+        if (r.ms != e.ms ||
+            std::none_of(stalls.begin(), stalls.end(), [&](const Injected &x)
+                { return x.ms == r.ms && x.site == r.site && x.state == r.state; }))
+            {
+            std::cerr << "record " << i << ": " << r.ms << " ms, " << cStallMonitor::getSiteName(r.site)
+                      << ", expected " << e.ms << " ms, " << cStallMonitor::getSiteName(e.site) << "\n";
+            ++nFail;
+            }
+        }
+
+    std::uint32_t const nKicks = g_nKicks - nKicksBefore;
+    if (stats.nIterations != nIterations || stats.nStalls != stalls.size() ||
+        stats.nKicks != nExpectedKicks || nKicks != nExpectedKicks ||
+        stats.nMissedKicks != nIterations - nExpectedKicks ||
+        (! stalls.empty() && stats.msMax != stalls[0].ms))
+        {
+        std::cerr << "stats: " << stats.nIterations << " iterations, " << stats.nStalls << " stalls, "
+                  << stats.nKicks << " kicks (" << nKicks << " seen), " << stats.nMissedKicks
+                  << " missed; expected " << nIterations << ", " << stalls.size() << ", "
+                  << nExpectedKicks << "\n";
+        ++nFail;
+        }
+
+    std::cout << "\n";
+    return nFail;
+    }
+
+int main(int argc, char **argv)
+    {
+    unsigned const nIterations = argc > 1 ? unsigned(std::strtoul(argv[1], nullptr, 0)) : 20000;
+    unsigned const seed = argc > 2 ? unsigned(std::strtoul(argv[2], nullptr, 0)) : 4610;
+
+    std::mt19937 rng(seed);
+    cStallMonitor monitor;
+    unsigned nFail = 0;
+
+    monitor.begin(clockMs, getState);
+    monitor.setKick(kick);
+    g_ms = 1000;
+    g_tLastKick = g_ms;
+
+    nFail += runPhase(monitor, rng, nIterations, true);
+    // without the transmissions, the other sites make the list.
+    nFail += runPhase(monitor, rng, nIterations, false);
+
+    // the watchdog: run iterations of the given lengths after a kick.
+    auto const runLong = [&](std::initializer_list<std::uint32_t> lengths)
+        {
+        monitor.beginIteration();
+        monitor.endIteration();
+        for (std::uint32_t ms : lengths)
+            {
+            monitor.beginIteration();
+            g_ms += ms;
+            if (watchdogFired())
+                return true;
+            monitor.endIteration();
+            }
+        return false;
+        };
+
+    std::uint32_t const msLong = cStallMonitor::kHealthyMs + 100;
+    bool const fOne = runLong({ msLong, 5, msLong / 2 });
+    bool const fTwo = runLong({ msLong, msLong });
+    bool const fHang = runLong({ cStallMonitor::kWatchdogMs });
+
+    std::cout << "watchdog: one " << msLong << " ms stall " << (fOne ? "resets" : "survived")
+              << ", two " << (fTwo ? "reset" : "survived")
+              << ", a hang " << (fHang ? "resets" : "survived") << "\n";
+    if (fOne || ! fTwo || ! fHang)
+        ++nFail;
+
+    // the transmit spin: passes of the given lengths, as stTransmit runs
+    // them, marking progress after each one if fProgress.
+    auto const runSpin = [&](std::uint32_t msSpin, std::uint32_t msHang, bool fProgress)
+        {
+        bool fFired = false;
+
+        monitor.beginIteration();
+        monitor.endIteration();
+
+        g_state = kTransmit;
+        monitor.beginIteration();
+        auto const site = monitor.enter(Site::kTxSpin);
+        for (std::uint32_t t = 0; t < msSpin && ! fFired; )
+            {
+            // os_runloop_once(): mostly quick; now and then the radio.
+            std::uint32_t const ms = rng() % 100 == 0 ? 1000 + rng() % 2000 : 1 + rng() % 20;
+
+            g_ms += ms;
+            t += ms;
+            if (msHang != 0 && t >= msSpin / 2)
+                {
+                g_ms += msHang;
+                t += msHang;
+                msHang = 0;
+                }
+            fFired = watchdogFired();
+            if (fProgress)
+                monitor.progress();
+            }
+        monitor.leave(site);
+        monitor.endIteration();
+        g_state = kSleeping;
+        return fFired;
+        };
+
+    std::uint32_t const msJoin = 120 * 1000;
+    bool const fJoin = runSpin(msJoin, 0, true);
+    bool const fUnmarked = runSpin(msJoin, 0, false);
+    bool const fSpinHang = runSpin(msJoin, cStallMonitor::kWatchdogMs, true);
+
+    std::cout << "watchdog: a " << msJoin / 1000 << " s join " << (fJoin ? "resets" : "survived")
+              << ", unmarked " << (fUnmarked ? "resets" : "survived")
+              << ", a hang in it " << (fSpinHang ? "resets" : "survived") << "\n";
+    if (fJoin || ! fUnmarked || ! fSpinHang)
+        ++nFail;
+
+    std::cout << nFail << " failures\n";
+    return nFail == 0 ? 0 : 1;
+    }
@@ -0,0 +1,337 @@
+/*
+
+Name:   catena-stream-capture.cpp
+
+Function:
+        Capture the raw sample stream ("stream on") to a trace file.
+
+Copyright and License:
+        See accompanying LICENSE file
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+Usage:
+        g++ -std=c++14 -O2 -o catena-stream-capture catena-stream-capture.cpp
+        catena-stream-capture [-s] [-b baud] [-t seconds] port output.trace
+
+        port is the Catena's USB serial device (e.g. /dev/ttyACM0), or a
+        file holding a raw capture. With -s, "stream on" is sent at the
+        start and "stream off" at the end. Capture runs until -t seconds
+        have passed, the input ends, or ^C.
+
+        Once a second, and at the end, the samples received, the sample
+        rate, the bytes per second, and the samples dropped by the device
+        (its ring was full) are reported on stderr, with the frames lost
+        in transit (sequence gaps) and chunks that failed to decode
+        (usually text from the device). Samples dropped by the device are
+        recorded in the trace, as are the battery and bus voltage readings
+        sent with the samples.
+
+*/
+
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "../Catena4610_cSampleStream.h"
+#include "catena-trace.h"
+
+using McciCatena4610::cSampleStream;
+using Clock = std::chrono::steady_clock;
+
+static volatile std::sig_atomic_t gfStop = 0;
+
+static void onSignal(int)
+    {
+    gfStop = 1;
+    }
+
+struct Stats
+    {
+    std::uint64_t   nSamples;
+    std::uint64_t   nEvents;
+    std::uint64_t   nBytes;
+    std::uint64_t   nFrames;
+    std::uint64_t   nLostFrames;
+    std::uint64_t   nBadChunks;
+    std::uint32_t   nDeviceDropped;
+    };
+
+class Capture
+    {
+public:
+    Capture(CatenaTrace::Writer &writer)
+        : m_writer(writer)
+        , m_stats {}
+        , m_lastSequence(0)
+        , m_lastDropped(0)
+        , m_fFirst(true)
+        {}
+
+    // feed received bytes.
+    void put(const std::uint8_t *p, std::size_t n)
+        {
+        this->m_stats.nBytes += n;
+        for (std::size_t i = 0; i < n; ++i)
+            {
+            if (p[i] != 0)
+                {
+                // a chunk far longer than a frame is text; keep it short.
+                if (this->m_chunk.size() <= 2 * cSampleStream::kMaxEncodedBytes)
+                    this->m_chunk.push_back(p[i]);
+                continue;
+                }
+
+            if (! this->m_chunk.empty())
+                this->chunkDone();
+            }
+        }
+
+    const Stats &getStats() const
+        {
+        return this->m_stats;
+        }
+
+private:
+    void chunkDone()
+        {
+        std::uint8_t frame[2 * cSampleStream::kMaxEncodedBytes + 1];
+        cSampleStream::Sample samples[cSampleStream::kSamplesPerFrame];
+        cSampleStream::FrameInfo info;
+
+        std::size_t const nFrame = cSampleStream::cobsDecode(this->m_chunk.data(), this->m_chunk.size(), frame);
+        this->m_chunk.clear();
+
+        if (nFrame == 0 || ! cSampleStream::decodeFrame(frame, nFrame, info, samples))
+            {
+            ++this->m_stats.nBadChunks;
+            return;
+            }
+
+        // a restarted stream begins again at sequence 0, with a fresh
+        // count of dropped samples.
+        bool const fRestart = info.sequence == 0 && this->m_lastSequence != 0xFFFF;
+
+        if (this->m_fFirst || fRestart)
+            this->m_lastDropped = 0;
+        else
+            this->m_stats.nLostFrames += std::uint16_t(info.sequence - this->m_lastSequence - 1);
+
+        if (info.nDropped != this->m_lastDropped && info.nSamples != 0)
+            {
+            std::uint32_t const nNew = info.nDropped - this->m_lastDropped;
+
+            this->m_writer.writeDropped(samples[0].tMs, nNew);
+            this->m_stats.nDeviceDropped += nNew;
+            }
+
+        for (unsigned i = 0; i < info.nSamples; ++i)
+            {
+            auto const &s = samples[i];
+
+            switch (s.kind)
+                {
+            case cSampleStream::Kind::kSample:
+                this->m_writer.writeSample(s.tMs, s.ch1, s.ch2, s.amplitude);
+                ++this->m_stats.nSamples;
+                break;
+            case cSampleStream::Kind::kVbat:
+                this->m_writer.writeVoltage(s.tMs, CatenaTrace::RecordType::kVbat, std::uint16_t(s.ch1));
+                ++this->m_stats.nEvents;
+                break;
+            case cSampleStream::Kind::kVbus:
+                this->m_writer.writeVoltage(s.tMs, CatenaTrace::RecordType::kVbus, std::uint16_t(s.ch1));
+                ++this->m_stats.nEvents;
+                break;
+            default:
+                ++this->m_stats.nEvents;
+                break;
+                }
+            }
+
+        ++this->m_stats.nFrames;
+        this->m_lastSequence = info.sequence;
+        this->m_lastDropped = info.nDropped;
+        this->m_fFirst = false;
+        }
+
+    CatenaTrace::Writer         &m_writer;
+    std::vector<std::uint8_t>   m_chunk;
+    Stats                       m_stats;
+    std::uint16_t               m_lastSequence;
+    std::uint32_t               m_lastDropped;
+    bool                        m_fFirst;
+    };
+
+static speed_t getBaud(unsigned long baud)
+    {
+    switch (baud)
+        {
+    case 9600:      return B9600;
+    case 19200:     return B19200;
+    case 38400:     return B38400;
+    case 57600:     return B57600;
+    case 115200:    return B115200;
+    case 230400:    return B230400;
+    default:        return B0;
+        }
+    }
+
+static bool setRaw(int fd, unsigned long baud)
+    {
+    termios t;
+
+    if (tcgetattr(fd, &t) != 0)
+        return false;
+
+    cfmakeraw(&t);
+    t.c_cc[VMIN] = 0;
+    t.c_cc[VTIME] = 0;
+    if (getBaud(baud) != B0)
+        {
+        cfsetispeed(&t, getBaud(baud));
+        cfsetospeed(&t, getBaud(baud));
+        }
+    return tcsetattr(fd, TCSANOW, &t) == 0;
+    }
+
+static void sendCommand(int fd, const char *pCommand)
+    {
+    std::string const s = std::string(pCommand) + "\r\n";
+
+    if (write(fd, s.data(), s.size()) != ssize_t(s.size()))
+        std::cerr << "couldn't send '" << pCommand << "': " << std::strerror(errno) << "\n";
+    }
+
+static void report(const Stats &s, double seconds, bool fFinal)
+    {
+    double const t = seconds > 0 ? seconds : 1;
+
+    std::cerr << (fFinal ? "total: " : "")
+              << s.nSamples << " samples (" << unsigned(s.nSamples / t) << "/s), "
+              << s.nEvents << " voltage readings, "
+              << unsigned(s.nBytes / t) << " bytes/s, "
+              << s.nDeviceDropped << " dropped by device, "
+              << s.nLostFrames << " frames lost, "
+              << s.nBadChunks << " bad chunks"
+              << (fFinal ? "\n" : "\r");
+    }
+
+static int usage(const char *pName)
+    {
+    std::cerr << "usage: " << pName << " [-s] [-b baud] [-t seconds] port output.trace\n";
+    return 2;
+    }
+
+int main(int argc, char **argv)
+    {
+    bool fSendCommands = false;
+    unsigned long baud = 115200;
+    double limitSeconds = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "sb:t:")) != -1)
+        {
+        switch (opt)
+            {
+        case 's':   fSendCommands = true; break;
+        case 'b':   baud = std::strtoul(optarg, nullptr, 0); break;
+        case 't':   limitSeconds = std::strtod(optarg, nullptr); break;
+        default:    return usage(argv[0]);
+            }
+        }
+
+    if (argc - optind != 2)
+        return usage(argv[0]);
+
+    int const fd = open(argv[optind], O_RDWR | O_NOCTTY);
+    if (fd < 0)
+        {
+        std::cerr << argv[optind] << ": " << std::strerror(errno) << "\n";
+        return 1;
+        }
+
+    bool const fTty = isatty(fd);
+    if (fTty && ! setRaw(fd, baud))
+        {
+        std::cerr << argv[optind] << ": can't set raw mode: " << std::strerror(errno) << "\n";
+        return 1;
+        }
+
+    CatenaTrace::Writer writer;
+    std::uint64_t const tNowUnixMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()
+        ).count();
+
+    if (! writer.open(argv[optind + 1], tNowUnixMs))
+        {
+        std::cerr << argv[optind + 1] << ": " << std::strerror(errno) << "\n";
+        return 1;
+        }
+
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+
+    if (fTty && fSendCommands)
+        sendCommand(fd, "stream on");
+
+    Capture capture(writer);
+    auto const tStart = Clock::now();
+    auto tReport = tStart;
+    std::uint8_t buf[4096];
+
+    while (! gfStop)
+        {
+        pollfd pfd { fd, POLLIN, 0 };
+
+        if (fTty && poll(&pfd, 1, 100) < 0 && errno != EINTR)
+            break;
+
+        ssize_t const n = read(fd, buf, sizeof(buf));
+        if (n > 0)
+            capture.put(buf, std::size_t(n));
+        else if (n == 0 && ! fTty)
+            break;
+        else if (n < 0 && errno != EAGAIN && errno != EINTR)
+            {
+            std::cerr << "\nread: " << std::strerror(errno) << "\n";
+            break;
+            }
+
+        auto const tNow = Clock::now();
+        double const seconds = std::chrono::duration<double>(tNow - tStart).count();
+
+        if (limitSeconds > 0 && seconds >= limitSeconds)
+            break;
+
+        if (fTty && tNow - tReport >= std::chrono::seconds(1))
+            {
+            tReport = tNow;
+            report(capture.getStats(), seconds, false);
+            }
+        }
+
+    if (fTty && fSendCommands)
+        sendCommand(fd, "stream off");
+
+    double const seconds = std::chrono::duration<double>(Clock::now() - tStart).count();
+    bool const fOk = writer.close();
+
+    report(capture.getStats(), seconds, true);
+    std::cerr << writer.getRecordCount() << " records written to " << argv[optind + 1] << "\n";
+
+    close(fd);
+    return fOk ? 0 : 1;
+    }
@@ -0,0 +1,184 @@
+/*
+
+Name:   catena-stream-generate.cpp
+
+Function:
+        Generate a raw sample stream capture, as a device streaming over
+        a USB port with a slow host would send it, to check the capture
+        tool against.
+
+Copyright and License:
+        See accompanying LICENSE file
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+Usage:
+        g++ -std=c++14 -O2 -o catena-stream-generate catena-stream-generate.cpp
+
+        catena-stream-generate [-t seconds] [-r seed] output.raw
+        catena-stream-capture output.raw output.trace
+
+        The device side is the sketch's cSampleStream, driven as
+        cStreamPort drives it, in simulated milliseconds (default 900 s).
+        Samples come every 50 ms, and in bursts every 2 ms (as with a short
+        sampling period); a battery reading every 6 minutes and a bus
+        reading now and then go in with them. Each millisecond the port
+        takes what the host has read: normally 64 bytes, but the host
+        stalls now and then for up to 150 ms, so the ring overruns. A frame
+        is written only when it fits whole, as cStreamPort::poll() does.
+        Lines of debug text are written between frames.
+
+        The counts the capture tool should report are printed: samples and
+        voltage readings delivered, samples dropped by the device, no
+        frames lost, and one bad chunk per run of text lines.
+
+*/
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+
+#include <unistd.h>
+
+#include "../Catena4610_cSampleStream.h"
+
+using McciCatena4610::cSampleStream;
+
+using Kind = cSampleStream::Kind;
+
+constexpr std::uint32_t kSamplePeriodMs = 50;
+constexpr std::uint32_t kBurstPeriodMs = 2;
+constexpr std::uint32_t kVbatPeriodMs = 6 * 60 * 1000;
+constexpr std::size_t kPortBytesPerMs = 64;
+
+static int usage(const char *pName)
+    {
+    std::cerr << "usage: " << pName << " [-t seconds] [-r seed] output.raw\n";
+    return 2;
+    }
+
+int main(int argc, char **argv)
+    {
+    std::uint32_t seconds = 900;
+    unsigned seed = 4610;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:r:")) != -1)
+        {
+        switch (opt)
+            {
+        case 't':   seconds = std::uint32_t(std::strtoul(optarg, nullptr, 0)); break;
+        case 'r':   seed = unsigned(std::strtoul(optarg, nullptr, 0)); break;
+        default:    return usage(argv[0]);
+            }
+        }
+    if (argc - optind != 1 || seconds == 0)
+        return usage(argv[0]);
+
+    std::FILE *const fp = std::fopen(argv[optind], "wb");
+    if (fp == nullptr)
+        {
+        std::cerr << argv[optind] << ": " << std::strerror(errno) << "\n";
+        return 1;
+        }
+
+    std::mt19937 rng(seed);
+    cSampleStream stream;
+    std::uint8_t buf[cSampleStream::kMaxEncodedBytes];
+    std::uint32_t nSamples = 0, nVoltages = 0, nLines = 0, nChunks = 0;
+    bool fFrameSinceText = true;
+    std::uint32_t nDeliveredSamples = 0, nDeliveredVoltages = 0;
+    std::uint32_t tBurstEnd = 0, tNextSample = 0, tStallEnd = 0;
+    std::size_t portRoom = 0;
+
+    // push, and count what got into the ring.
+    auto const push = [&stream](const cSampleStream::Sample &sample, std::uint32_t &nDelivered)
+        {
+        std::uint32_t const nDropped = stream.getStats().nDropped;
+
+        stream.push(sample);
+        if (stream.getStats().nDropped == nDropped)
+            ++nDelivered;
+        };
+
+    stream.start();
+    for (std::uint32_t t = 0; t < seconds * 1000; ++t)
+        {
+        // the sampling path.
+        if (t >= tBurstEnd && rng() % 20000 == 0)
+            tBurstEnd = t + 2000 + rng() % 8000;
+
+        if (t >= tNextSample)
+            {
+            std::int16_t const ch1 = std::int16_t(400 + rng() % 50);
+            std::int16_t const ch2 = std::int16_t(380 + rng() % 50);
+
+            push(cSampleStream::Sample { t, Kind::kSample, ch1, ch2, std::int16_t(ch1 - ch2) }, nDeliveredSamples);
+            ++nSamples;
+            tNextSample = t + (t < tBurstEnd ? kBurstPeriodMs : kSamplePeriodMs);
+            }
+        if (t % kVbatPeriodMs == 0)
+            {
+            push(cSampleStream::Sample { t, Kind::kVbat, std::int16_t(3700 - t / 100000), 0, 0 }, nDeliveredVoltages);
+            ++nVoltages;
+            }
+        if (rng() % 60000 == 0)
+            {
+            push(cSampleStream::Sample { t, Kind::kVbus, std::int16_t(rng() % 2 ? 5000 : 0), 0, 0 }, nDeliveredVoltages);
+            ++nVoltages;
+            }
+
+        // the host.
+        if (t >= tStallEnd && rng() % 3000 == 0)
+            tStallEnd = t + 20 + rng() % 130;
+        if (t >= tStallEnd)
+            portRoom = kPortBytesPerMs;
+
+        // cStreamPort::poll(), and now and then some debug text.
+        while (! stream.isEmpty() && portRoom >= sizeof(buf))
+            {
+            std::size_t const n = stream.getFrame(buf);
+
+            std::fwrite(buf, 1, n, fp);
+            portRoom -= n;
+            fFrameSinceText = true;
+            }
+        if (t >= tStallEnd && rng() % 2000 == 0)
+            {
+            std::string const line = "cMeasurementLoop::fsmDispatch: enter stSleeping at " + std::to_string(t) + "\r\n";
+
+            std::fwrite(line.data(), 1, line.size(), fp);
+            ++nLines;
+
+            // lines with no frame between them are one chunk.
+            if (fFrameSinceText)
+                ++nChunks;
+            fFrameSinceText = false;
+            }
+        }
+
+    // let the host drain the rest.
+    while (! stream.isEmpty())
+        {
+        std::size_t const n = stream.getFrame(buf);
+
+        std::fwrite(buf, 1, n, fp);
+        }
+    std::fclose(fp);
+
+    auto const &stats = stream.getStats();
+
+    std::cout << nSamples << " samples and " << nVoltages << " voltage readings pushed, "
+              << stats.nDropped << " dropped, " << stats.nFrames << " frames, "
+              << nLines << " text lines\n"
+              << "catena-stream-capture should report " << nDeliveredSamples << " samples, "
+              << nDeliveredVoltages << " voltage readings, " << stats.nDropped
+              << " dropped by device, 0 frames lost, " << nChunks << " bad chunks\n";
+    return 0;
+    }
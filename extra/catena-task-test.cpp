@@ -0,0 +1,268 @@
+/*
+
+Name:   catena-task-test.cpp
+
+Function:
+        Test the stackless tasks of Catena4610_cTask.h under a simulated
+        millis(), across its wrap.
+
+Copyright and License:
+        See accompanying LICENSE file
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+Usage:
+        g++ -std=c++14 -O2 -o catena-task-test catena-task-test.cpp
+
+        catena-task-test [rounds [seed]]
+
+        A task yields, waits for a flag, then delays, as the measurement
+        loop's tasks do; it's called as poll() calls them, with millis()
+        simulated. Checked:
+
+            TASK_YIELD()        gives way for exactly one call
+            TASK_WAIT_UNTIL()   resumes on the first call after the
+                                condition becomes true, and not before
+            TASK_DELAY()        resumes on the first call at or after the
+                                deadline, never before; getRemaining()
+                                agrees. Start times include some just
+                                before millis() wraps, and delays run
+                                from 0 to a minute.
+            reset()             part-way through (as stSleeping's exit
+                                does to the sleep alert), the next call
+                                starts again from TASK_BEGIN().
+
+        Then for some rounds (default 10000), the same is done with time
+        moving on by random amounts between calls, as when loop() is held
+        up; the delay must end on the first call at or after its deadline.
+
+*/
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+
+#include "../Catena4610_cTask.h"
+
+using McciCatena4610::cTask;
+
+static std::uint32_t g_ms;
+
+static std::uint32_t millis() { return g_ms; }
+
+// the task under test; m_step shows how far it has got.
+class cTestTask
+    {
+public:
+    cTestTask()
+        : m_step(0)
+        , m_nBegins(0)
+        , m_fReady(false)
+        , m_msDelay(0)
+        , m_tDelay(0)
+        {}
+
+    bool run()
+        {
+        TASK_BEGIN(this->m_task);
+
+        ++this->m_nBegins;
+        this->m_step = 1;
+        TASK_YIELD(this->m_task);
+
+        this->m_step = 2;
+        TASK_WAIT_UNTIL(this->m_task, this->m_fReady);
+
+        this->m_step = 3;
+        this->m_tDelay = millis();
+        TASK_DELAY(this->m_task, millis(), this->m_msDelay);
+
+        this->m_step = 4;
+        TASK_END(this->m_task);
+        }
+
+    cTask           m_task;
+    unsigned        m_step;
+    unsigned        m_nBegins;
+    bool            m_fReady;
+    std::uint32_t   m_msDelay;
+    std::uint32_t   m_tDelay;
+    };
+
+static unsigned expect(bool fOk, const char *pWhat, std::uint32_t tStart, std::uint32_t msDelay)
+    {
+    if (fOk)
+        return 0;
+
+    std::cerr << pWhat << ": start 0x" << std::hex << tStart << std::dec
+              << ", delay " << msDelay << " ms, now 0x" << std::hex << g_ms << std::dec << "\n";
+    return 1;
+    }
+
+// run the task from the top with a delay of msDelay, starting at tStart.
+static unsigned testSteps(std::uint32_t tStart, std::uint32_t msDelay)
+    {
+    cTestTask t;
+    unsigned nFail = 0;
+
+    g_ms = tStart;
+    t.m_msDelay = msDelay;
+
+    // the yield: one call, then on.
+    nFail += expect(! t.run() && t.m_step == 1 && t.m_task.isRunning(), "yield", tStart, msDelay);
+    nFail += expect(! t.run() && t.m_step == 2, "after yield", tStart, msDelay);
+
+    // the wait: nothing until the flag is set.
+    for (unsigned i = 0; i < 5; ++i)
+        {
+        ++g_ms;
+        nFail += expect(! t.run() && t.m_step == 2 && t.m_task.getRemaining(g_ms) == 0,
+                        "wait", tStart, msDelay);
+        }
+    t.m_fReady = true;
+
+    // the delay: from this call to exactly msDelay later.
+    bool fDone = t.run();
+    std::uint32_t const tDelay = g_ms;
+
+    while (! fDone && std::uint32_t(g_ms - tDelay) < msDelay)
+        {
+        nFail += expect(t.m_step == 3 && t.m_task.getRemaining(g_ms) == msDelay - (g_ms - tDelay),
+                        "delay", tStart, msDelay);
+        ++g_ms;
+        fDone = t.run();
+        }
+
+    nFail += expect(fDone && t.m_step == 4 && ! t.m_task.isRunning() &&
+                    std::uint32_t(g_ms - tDelay) == msDelay && t.m_nBegins == 1,
+                    "delay end", tStart, msDelay);
+
+    // finished: the next call starts again.
+    nFail += expect(! t.run() && t.m_step == 1 && t.m_nBegins == 2, "restart", tStart, msDelay);
+    return nFail;
+    }
+
+// reset the task at each of its waits; it must start again from the top.
+static unsigned testReset(std::uint32_t tStart)
+    {
+    unsigned nFail = 0;
+
+    for (unsigned stage = 1; stage <= 3; ++stage)
+        {
+        cTestTask t;
+
+        g_ms = tStart;
+        t.m_msDelay = 1000;
+        t.m_fReady = stage == 3;
+
+        // stop at the yield, in the wait, or in the delay.
+        t.run();
+        if (stage >= 2)
+            t.run();
+        g_ms += 10;
+        if (stage == 3)
+            t.run();
+
+        t.m_task.reset();
+        if (t.m_task.isRunning() || t.m_step != stage)
+            {
+            std::cerr << "reset in step " << stage << ": got to step " << t.m_step
+                      << (t.m_task.isRunning() ? ", still running" : "") << "\n";
+            ++nFail;
+            }
+
+        // the next call is a fresh start, stopping at the yield.
+        t.m_fReady = true;
+        if (t.run() || t.m_step != 1 || t.m_nBegins != 2)
+            {
+            std::cerr << "reset in step " << stage << ": resumed in step " << t.m_step
+                      << ", " << t.m_nBegins << " begins\n";
+            ++nFail;
+            }
+
+        // and it runs through as before.
+        t.run();
+        std::uint32_t const tDelay = g_ms;
+        g_ms += 999;
+        if (t.run())
+            ++nFail;
+        g_ms += 1;
+        if (! t.run() || g_ms - tDelay != 1000)
+            {
+            std::cerr << "reset in step " << stage << ": delay didn't end on time\n";
+            ++nFail;
+            }
+        }
+    return nFail;
+    }
+
+// time moves on by random amounts between calls.
+static unsigned testRandom(std::uint32_t nRounds, std::mt19937 &rng)
+    {
+    unsigned nFail = 0;
+    unsigned nWrapped = 0;
+
+    for (std::uint32_t round = 0; round < nRounds && nFail < 10; ++round)
+        {
+        cTestTask t;
+        std::uint32_t const tStart = rng() % 2 ? std::uint32_t(0 - rng() % 100000) : std::uint32_t(rng());
+
+        g_ms = tStart;
+        t.m_msDelay = rng() % 4 == 0 ? rng() % 10 : rng() % 60000;
+        t.m_fReady = true;
+
+        bool fWrapped = false;
+        t.run();
+        bool fDone = t.run();
+        std::uint32_t const tDelay = t.m_tDelay;
+        std::uint32_t tPrevious = g_ms;
+
+        while (! fDone)
+            {
+            g_ms += rng() % 100 == 0 ? rng() % 5000 : rng() % 20;
+            fDone = t.run();
+            if (fDone && std::uint32_t(g_ms - tDelay) < t.m_msDelay)
+                {
+                nFail += expect(false, "random: early", tStart, t.m_msDelay);
+                break;
+                }
+            if (! fDone && std::uint32_t(g_ms - tDelay) >= t.m_msDelay)
+                {
+                nFail += expect(false, "random: late", tStart, t.m_msDelay);
+                break;
+                }
+            if (g_ms < tPrevious)
+                fWrapped = true;
+            tPrevious = g_ms;
+            }
+        if (fWrapped)
+            ++nWrapped;
+        }
+
+    std::cout << nRounds << " random rounds, " << nWrapped << " across the wrap\n";
+    return nFail;
+    }
+
+int main(int argc, char **argv)
+    {
+    std::uint32_t const nRounds = argc > 1 ? std::uint32_t(std::strtoul(argv[1], nullptr, 0)) : 10000;
+    unsigned const seed = argc > 2 ? unsigned(std::strtoul(argv[2], nullptr, 0)) : 4610;
+
+    std::mt19937 rng(seed);
+    unsigned nFail = 0;
+
+    for (std::uint32_t tStart : { 0u, 12345u, 0xFFFFFFFFu - 500u, 0xFFFFFFFFu - 70000u, 0xFFFFFFFFu })
+        {
+        for (std::uint32_t msDelay : { 0u, 1u, 100u, 1000u, 60000u })
+            nFail += testSteps(tStart, msDelay);
+        nFail += testReset(tStart);
+        }
+    std::cout << "yield, wait, delay and reset: " << (nFail ? "FAILED" : "ok") << "\n";
+
+    nFail += testRandom(nRounds, rng);
+
+    std::cout << nFail << " failures\n";
+    return nFail == 0 ? 0 : 1;
+    }
@@ -0,0 +1,519 @@
+/*
+
+Name:   catena-threshold-tune.cpp
+
+Function:
+        Search the touch detector's settings against labelled traces.
+
+Copyright and License:
+        See accompanying LICENSE file
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+Usage:
+        g++ -std=c++14 -O2 -pthread -o catena-threshold-tune catena-threshold-tune.cpp
+        catena-threshold-tune [-j threads] [-r right] [-l left]
+                              [-y hysteresis] [-d debounce] [-w ms]
+                              [-k top] trace...
+
+        -r, -l, -y and -d each take a value or a range lo:hi:step, and
+        set the right (Ch1) and left (Ch2) thresholds, the hysteresis and
+        the debounce to try (defaults 250:550:25, 150:400:25, 0:60:20 and
+        1:3:1). Each combination is run through cTouchDetector, as the
+        device runs it, and scored against every trace. These are all
+        the settings the device's detector has, so the winner can be set
+        with "config right", "config left", "config hysteresis" and
+        "config debounce", or with port 2 downlinks (0x03 and 0x06). The
+        detector has no baseline tracking, so there is no baseline rate
+        to tune.
+
+        The traces need label records (see catena-trace.h) marking the
+        real touches; catena-trace-replay -g writes them. A counted touch
+        is a hit if it falls in an unmatched labelled touch on that side,
+        from w ms (default 200) before it starts to w ms after it ends;
+        otherwise it's a false touch. A labelled touch with no hit is a
+        miss. Candidates are ranked by the mean of the two sides' F1
+        scores.
+
+        The report gives the device's default settings (from
+        Catena4610_MeasurementDefaults.h) for comparison, then the top
+        candidates (-k, default 10) with precision and recall per side.
+        Work is spread over -j threads (default: all) with a work-stealing
+        pool.
+
+*/
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include <unistd.h>
+
+#include "../Catena4610_MeasurementDefaults.h"
+#include "../Catena4610_cTouchDetector.h"
+#include "catena-trace.h"
+#include "catena-work-pool.h"
+
+using McciCatena4610::cTouchDetector;
+using CatenaTrace::Record;
+using CatenaTrace::RecordType;
+using Clock = std::chrono::steady_clock;
+
+namespace Defaults = McciCatena4610::MeasurementDefaults;
+
+// candidates scored per pass over a trace. Each pass reads the trace
+// once, so this trades memory traffic against parallelism.
+static constexpr std::size_t kCandidatesPerJob = 16;
+
+struct Range
+    {
+    std::uint32_t   lo;
+    std::uint32_t   hi;
+    std::uint32_t   step;
+    };
+
+struct Candidate
+    {
+    std::uint16_t   right;
+    std::uint16_t   left;
+    std::uint16_t   hysteresis;
+    std::uint8_t    debounce;
+    };
+
+struct Label
+    {
+    std::uint64_t   tStart;
+    std::uint64_t   tEnd;
+    };
+
+struct Trace
+    {
+    const char                  *pPath;
+    CatenaTrace::Reader         reader;
+    std::vector<Label>          right;
+    std::vector<Label>          left;
+    std::uint64_t               nSamples;
+    };
+
+struct SideScore
+    {
+    std::uint64_t   nHits;
+    std::uint64_t   nFalse;
+    std::uint64_t   nMisses;
+
+    void add(const SideScore &s)
+        {
+        this->nHits += s.nHits;
+        this->nFalse += s.nFalse;
+        this->nMisses += s.nMisses;
+        }
+
+    double precision() const
+        {
+        std::uint64_t const n = this->nHits + this->nFalse;
+        return n == 0 ? 1.0 : double(this->nHits) / n;
+        }
+
+    double recall() const
+        {
+        std::uint64_t const n = this->nHits + this->nMisses;
+        return n == 0 ? 1.0 : double(this->nHits) / n;
+        }
+
+    double f1() const
+        {
+        double const p = this->precision();
+        double const r = this->recall();
+        return p + r == 0 ? 0 : 2 * p * r / (p + r);
+        }
+    };
+
+struct Score
+    {
+    SideScore   right;
+    SideScore   left;
+
+    void add(const Score &s)
+        {
+        this->right.add(s.right);
+        this->left.add(s.left);
+        }
+
+    double objective() const
+        {
+        return (this->right.f1() + this->left.f1()) / 2;
+        }
+    };
+
+/****************************************************************************\
+|
+|   Scoring.
+|
+|   Labels and detections on a side both come in time order, so each side
+|   keeps an index to the first label not yet matched or passed; a hit
+|   consumes the label, so a touch counted twice scores one hit and one
+|   false touch.
+|
+\****************************************************************************/
+
+class SideMatcher
+    {
+public:
+    void begin(const std::vector<Label> &labels, std::uint64_t window)
+        {
+        this->m_pLabels = labels.data();
+        this->m_nLabels = labels.size();
+        this->m_iNext = 0;
+        this->m_window = window;
+        this->m_score = SideScore {};
+        }
+
+    void detect(std::uint64_t t)
+        {
+        while (this->m_iNext < this->m_nLabels &&
+               this->m_pLabels[this->m_iNext].tEnd + this->m_window < t)
+            {
+            ++this->m_score.nMisses;
+            ++this->m_iNext;
+            }
+
+        if (this->m_iNext < this->m_nLabels &&
+            this->m_pLabels[this->m_iNext].tStart <= t + this->m_window)
+            {
+            ++this->m_score.nHits;
+            ++this->m_iNext;
+            }
+        else
+            ++this->m_score.nFalse;
+        }
+
+    const SideScore &end()
+        {
+        this->m_score.nMisses += this->m_nLabels - this->m_iNext;
+        this->m_iNext = this->m_nLabels;
+        return this->m_score;
+        }
+
+private:
+    const Label     *m_pLabels;
+    std::size_t     m_nLabels;
+    std::size_t     m_iNext;
+    std::uint64_t   m_window;
+    SideScore       m_score;
+    };
+
+// run the device's detector with n candidate settings over a trace, in
+// one pass.
+static void score(const Trace &trace, const Candidate *pCandidates, std::size_t n, std::uint64_t window, Score *pScores)
+    {
+    std::unique_ptr<cTouchDetector[]> const detectors(new cTouchDetector[n]);
+    std::unique_ptr<SideMatcher[]> const right(new SideMatcher[n]);
+    std::unique_ptr<SideMatcher[]> const left(new SideMatcher[n]);
+
+    for (std::size_t i = 0; i < n; ++i)
+        {
+        right[i].begin(trace.right, window);
+        left[i].begin(trace.left, window);
+        }
+
+    const Record *p = trace.reader.begin();
+    const Record * const pEnd = trace.reader.end();
+    std::uint64_t tNow = 0;
+    std::uint32_t lastTms = p != pEnd ? p->tMs : 0;
+
+    for (; p != pEnd; ++p)
+        {
+        tNow += std::uint32_t(p->tMs - lastTms);
+        lastTms = p->tMs;
+        if (p->type != RecordType::kSample)
+            continue;
+
+        for (std::size_t i = 0; i < n; ++i)
+            {
+            Candidate const &c = pCandidates[i];
+            auto const r = detectors[i].update(p->a, p->b, c.right, c.left, c.hysteresis, c.debounce);
+
+            if (r.fRight)
+                right[i].detect(tNow);
+            if (r.fLeft)
+                left[i].detect(tNow);
+            }
+        }
+
+    for (std::size_t i = 0; i < n; ++i)
+        {
+        pScores[i].right = right[i].end();
+        pScores[i].left = left[i].end();
+        }
+    }
+
+// map a trace and collect its labels, on the same clock as score().
+static bool load(Trace &trace)
+    {
+    const char *pError;
+
+    if (! trace.reader.open(trace.pPath, pError))
+        {
+        if (errno != 0)
+            std::fprintf(stderr, "%s: %s: %s\n", trace.pPath, pError, std::strerror(errno));
+        else
+            std::fprintf(stderr, "%s: %s\n", trace.pPath, pError);
+        return false;
+        }
+
+    const Record *p = trace.reader.begin();
+    const Record * const pEnd = trace.reader.end();
+    std::uint64_t tNow = 0;
+    std::uint32_t lastTms = p != pEnd ? p->tMs : 0;
+
+    trace.nSamples = 0;
+    for (; p != pEnd; ++p)
+        {
+        tNow += std::uint32_t(p->tMs - lastTms);
+        lastTms = p->tMs;
+
+        if (p->type == RecordType::kSample)
+            ++trace.nSamples;
+        else if (p->type == RecordType::kLabel)
+            {
+            Label const label { tNow, tNow + std::uint16_t(p->b) };
+
+            if (p->a & CatenaTrace::kLabelRight)
+                trace.right.push_back(label);
+            if (p->a & CatenaTrace::kLabelLeft)
+                trace.left.push_back(label);
+            }
+        }
+
+    if (trace.right.empty() && trace.left.empty())
+        std::fprintf(stderr, "%s: warning: no labels; every touch will count as false\n", trace.pPath);
+
+    return true;
+    }
+
+/****************************************************************************\
+|
+|   main
+|
+\****************************************************************************/
+
+static bool parseRange(const char *p, Range &r)
+    {
+    char *pEnd;
+
+    r.lo = r.hi = std::uint32_t(std::strtoul(p, &pEnd, 0));
+    r.step = 1;
+    if (*pEnd == ':')
+        {
+        r.hi = std::uint32_t(std::strtoul(pEnd + 1, &pEnd, 0));
+        if (*pEnd == ':')
+            r.step = std::uint32_t(std::strtoul(pEnd + 1, &pEnd, 0));
+        }
+
+    return *pEnd == '\0' && r.step != 0 && r.lo <= r.hi;
+    }
+
+static std::vector<std::uint32_t> values(const Range &r)
+    {
+    std::vector<std::uint32_t> v;
+
+    for (std::uint64_t x = r.lo; x <= r.hi; x += r.step)
+        v.push_back(std::uint32_t(x));
+    return v;
+    }
+
+static void printScore(const Score &s)
+    {
+    std::printf("  %6.4f   %5.3f %5.3f   %5.3f %5.3f",
+        s.objective(),
+        s.right.precision(), s.right.recall(),
+        s.left.precision(), s.left.recall());
+    }
+
+static int usage(const char *pName)
+    {
+    std::fprintf(stderr,
+        "usage: %s [-j threads] [-r right] [-l left] [-y hysteresis] [-d debounce] [-w ms] [-k top] trace...\n"
+        "       ranges are lo:hi:step\n",
+        pName);
+    return 2;
+    }
+
+int main(int argc, char **argv)
+    {
+    Range right { 250, 550, 25 };
+    Range left { 150, 400, 25 };
+    Range hysteresis { 0, 60, 20 };
+    Range debounce { 1, 3, 1 };
+    unsigned nThreads = 0;
+    unsigned nTop = 10;
+    std::uint64_t window = 200;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "j:r:l:y:d:w:k:")) != -1)
+        {
+        bool fOk = true;
+
+        switch (opt)
+            {
+        case 'j':   nThreads = unsigned(std::strtoul(optarg, nullptr, 0)); break;
+        case 'r':   fOk = parseRange(optarg, right) && right.hi <= 0xFFFF; break;
+        case 'l':   fOk = parseRange(optarg, left) && left.hi <= 0xFFFF; break;
+        case 'y':   fOk = parseRange(optarg, hysteresis) && hysteresis.hi <= 0xFFFF; break;
+        case 'd':   fOk = parseRange(optarg, debounce) && debounce.lo >= 1 && debounce.hi <= Defaults::kMaxTouchDebounce; break;
+        case 'w':   window = std::strtoull(optarg, nullptr, 0); break;
+        case 'k':   nTop = unsigned(std::strtoul(optarg, nullptr, 0)); break;
+        default:    return usage(argv[0]);
+            }
+
+        if (! fOk)
+            {
+            std::fprintf(stderr, "-%c %s: not a valid range\n", opt, optarg);
+            return 2;
+            }
+        }
+
+    if (optind == argc)
+        return usage(argv[0]);
+
+    // the corpus.
+    std::vector<std::unique_ptr<Trace>> traces;
+    std::uint64_t nSamples = 0;
+    std::uint64_t nLabels = 0;
+
+    for (int i = optind; i < argc; ++i)
+        {
+        traces.emplace_back(new Trace);
+        traces.back()->pPath = argv[i];
+        if (! load(*traces.back()))
+            return 1;
+
+        nSamples += traces.back()->nSamples;
+        nLabels += traces.back()->right.size() + traces.back()->left.size();
+        }
+
+    // the candidates.
+    std::vector<Candidate> candidates;
+
+    for (auto r : values(right))
+        for (auto l : values(left))
+            for (auto h : values(hysteresis))
+                for (auto d : values(debounce))
+                    candidates.push_back(Candidate { std::uint16_t(r), std::uint16_t(l), std::uint16_t(h), std::uint8_t(d) });
+
+    std::size_t const nCandidates = candidates.size();
+    std::size_t const nBlocks = (nCandidates + kCandidatesPerJob - 1) / kCandidatesPerJob;
+
+    std::printf("corpus: %zu traces, %" PRIu64 " samples, %" PRIu64 " labelled touches (by side)\n",
+        traces.size(), nSamples, nLabels);
+    std::printf("candidates: %zu\n", nCandidates);
+
+    // one job per trace per block of candidates, plus the default
+    // settings on each trace. Each job writes only its own scores.
+    std::vector<Score> scores(traces.size() * nCandidates);
+    std::vector<Score> deviceScores(traces.size());
+    CatenaTrace::WorkPool pool(nThreads);
+    auto const tStart = Clock::now();
+
+    for (std::size_t iTrace = 0; iTrace < traces.size(); ++iTrace)
+        {
+        Trace const &trace = *traces[iTrace];
+
+        pool.submit([&trace, &deviceScores, iTrace, window]
+            {
+            Candidate const defaults
+                {
+                Defaults::kThresholdRight,
+                Defaults::kThresholdLeft,
+                Defaults::kTouchHysteresis,
+                std::uint8_t(Defaults::kTouchDebounce)
+                };
+            score(trace, &defaults, 1, window, &deviceScores[iTrace]);
+            });
+
+        for (std::size_t iBlock = 0; iBlock < nBlocks; ++iBlock)
+            {
+            std::size_t const iFirst = iBlock * kCandidatesPerJob;
+            std::size_t const n = std::min(kCandidatesPerJob, nCandidates - iFirst);
+            Score * const pScores = &scores[iTrace * nCandidates + iFirst];
+            Candidate const * const pCandidates = &candidates[iFirst];
+
+            pool.submit([&trace, pScores, pCandidates, n, window]
+                {
+                score(trace, pCandidates, n, window, pScores);
+                });
+            }
+        }
+
+    pool.wait();
+    double const seconds = std::chrono::duration<double>(Clock::now() - tStart).count();
+
+    // totals over the corpus, best first; ties go to the earlier (smaller)
+    // settings.
+    std::vector<Score> totals(nCandidates);
+    Score device {};
+
+    for (std::size_t iTrace = 0; iTrace < traces.size(); ++iTrace)
+        {
+        device.add(deviceScores[iTrace]);
+        for (std::size_t i = 0; i < nCandidates; ++i)
+            totals[i].add(scores[iTrace * nCandidates + i]);
+        }
+
+    std::vector<std::size_t> order(nCandidates);
+    for (std::size_t i = 0; i < nCandidates; ++i)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(),
+        [&totals](std::size_t a, std::size_t b)
+            {
+            return totals[a].objective() > totals[b].objective();
+            });
+
+    std::printf("\n         right left hyst deb   score   right P/R     left P/R\n");
+    std::printf("default  %4u %4u %4u %3u",
+        Defaults::kThresholdRight, Defaults::kThresholdLeft,
+        Defaults::kTouchHysteresis, Defaults::kTouchDebounce);
+    printScore(device);
+    std::printf("\n");
+
+    for (std::size_t i = 0; i < nTop && i < nCandidates; ++i)
+        {
+        Candidate const &c = candidates[order[i]];
+
+        std::printf("%7zu  %4u %4u %4u %3u", i + 1, c.right, c.left, c.hysteresis, c.debounce);
+        printScore(totals[order[i]]);
+        std::printf("\n");
+        }
+
+    if (nCandidates != 0)
+        {
+        Candidate const &best = candidates[order[0]];
+        Score const &s = totals[order[0]];
+
+        std::printf("\nbest: right %u, left %u, hysteresis %u, debounce %u\n",
+            best.right, best.left, best.hysteresis, best.debounce);
+        std::printf("  port 2 downlink: 03 %02x %02x %02x %02x 06 %02x %02x %02x\n",
+            best.right >> 8, best.right & 0xFF,
+            best.left >> 8, best.left & 0xFF,
+            best.hysteresis >> 8, best.hysteresis & 0xFF,
+            best.debounce);
+        std::printf("  right: %" PRIu64 " hits, %" PRIu64 " false, %" PRIu64 " missed\n",
+            s.right.nHits, s.right.nFalse, s.right.nMisses);
+        std::printf("  left:  %" PRIu64 " hits, %" PRIu64 " false, %" PRIu64 " missed\n",
+            s.left.nHits, s.left.nFalse, s.left.nMisses);
+        }
+
+    // timing goes to stderr, so the report itself is reproducible.
+    double const evaluations = double(nSamples) * (nCandidates + 1);
+    std::fprintf(stderr, "%u threads, %.3f s: %.1f M sample-evaluations/s\n",
+        pool.size(), seconds, evaluations / (seconds > 0 ? seconds : 1e-9) / 1e6);
+    return 0;
+    }
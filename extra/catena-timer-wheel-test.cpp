@@ -0,0 +1,215 @@
+/*
+
+Name:   catena-timer-wheel-test.cpp
+
+Function:
+        Test cTimerWheel against a plain list of expiry times, across the
+        wrap of millis(); and measure arm/expire throughput.
+
+Copyright and License:
+        See accompanying LICENSE file
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+Usage:
+        g++ -std=c++14 -O2 -o catena-timer-wheel-test catena-timer-wheel-test.cpp
+
+        catena-timer-wheel-test [steps [seed]]
+
+        For each of several start times, including some just before
+        millis() wraps, timers are armed, re-armed and cancelled at random
+        for some steps (default 200000). Time moves on by a random amount
+        each step: usually a few milliseconds, sometimes more than a turn
+        of the wheel, as when loop() is held up. Delays run from 0 to a
+        few minutes.
+
+        After each advance(), the timers that fired must be exactly those
+        whose expiry has come, and none may fire early or be lost;
+        timedOut() must report each once. getNextDeadline() must agree
+        with the list.
+
+        Then the time to arm and expire timers is measured, with the
+        sketch's 16-bucket, 64 ms wheel full.
+
+*/
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+
+#include "../Catena4610_cTimerWheel.h"
+
+enum class Id : std::uint8_t
+    {
+    k0, k1, k2, k3, k4, k5, k6, k7,
+    kCount
+    };
+
+using Wheel = McciCatena4610::cTimerWheel<Id>;
+
+constexpr unsigned kTimers = unsigned(Id::kCount);
+
+// the reference: just the expiry times.
+struct Reference
+    {
+    bool            fArmed[kTimers];
+    std::uint32_t   expiry[kTimers];
+    };
+
+static unsigned testWrap(std::uint32_t tStart, std::uint32_t nSteps, std::mt19937 &rng)
+    {
+    Wheel wheel;
+    Reference ref {};
+    unsigned nFail = 0;
+    std::uint32_t nFired = 0;
+    std::uint32_t tNow = tStart;
+    bool fWrapped = false;
+
+    for (std::uint32_t step = 0; step < nSteps && nFail < 10; ++step)
+        {
+        // arm or cancel something.
+        unsigned const i = rng() % kTimers;
+        unsigned const op = rng() % 8;
+
+        if (op < 3)
+            {
+            std::uint32_t ms;
+            unsigned const range = rng() % 4;
+
+            if (range == 0)
+                ms = rng() % 64;
+            else if (range == 1)
+                ms = rng() % 1024;
+            else if (range == 2)
+                ms = rng() % 10000;
+            else
+                ms = rng() % (5 * 60 * 1000);
+
+            wheel.arm(Id(i), tNow, ms);
+            ref.fArmed[i] = true;
+            ref.expiry[i] = tNow + ms;
+            }
+        else if (op == 3)
+            {
+            wheel.cancel(Id(i));
+            ref.fArmed[i] = false;
+            }
+
+        // time goes by.
+        std::uint32_t const dt = rng() % 100 == 0 ? rng() % 5000 : rng() % 20;
+        std::uint32_t const tNext = tNow + dt;
+
+        if (tNext < tNow)
+            fWrapped = true;
+        tNow = tNext;
+
+        Wheel::Mask const fired = wheel.advance(tNow);
+        Wheel::Mask expected = 0;
+
+        for (unsigned j = 0; j < kTimers; ++j)
+            {
+            if (ref.fArmed[j] && std::int32_t(tNow - ref.expiry[j]) >= 0)
+                {
+                expected |= Wheel::bit(Id(j));
+                ref.fArmed[j] = false;
+                }
+            }
+
+        if (fired != expected)
+            {
+            std::cerr << "start " << std::hex << tStart << ", t " << tNow << std::dec
+                      << ": fired " << fired << ", expected " << expected << "\n";
+            ++nFail;
+            }
+
+        for (unsigned j = 0; j < kTimers; ++j)
+            {
+            bool const fTimedOut = wheel.timedOut(Id(j));
+
+            if (fTimedOut != ((expected & Wheel::bit(Id(j))) != 0) ||
+                wheel.timedOut(Id(j)) ||
+                wheel.isArmed(Id(j)) != ref.fArmed[j])
+                {
+                std::cerr << "start " << std::hex << tStart << ", t " << tNow << std::dec
+                          << ": timer " << j << " state wrong\n";
+                ++nFail;
+                }
+            }
+        nFired += __builtin_popcount(expected);
+
+        // the earliest deadline.
+        std::uint32_t msWheel;
+        std::uint32_t msRef = 0;
+        bool fAny = false;
+
+        for (unsigned j = 0; j < kTimers; ++j)
+            {
+            if (! ref.fArmed[j])
+                continue;
+
+            std::uint32_t const ms = ref.expiry[j] - tNow;
+            if (! fAny || ms < msRef)
+                msRef = ms;
+            fAny = true;
+            }
+
+        if (wheel.getNextDeadline(tNow, msWheel) != fAny || (fAny && msWheel != msRef))
+            {
+            std::cerr << "start " << std::hex << tStart << ", t " << tNow << std::dec
+                      << ": next deadline " << msWheel << ", expected " << msRef << "\n";
+            ++nFail;
+            }
+        }
+
+    std::cout << "start 0x" << std::hex << tStart << ", end 0x" << tNow << std::dec
+              << (fWrapped ? " (wrapped)" : "") << ": " << nFired << " timers fired\n";
+    return nFail;
+    }
+
+static void benchmark()
+    {
+    using Clock = std::chrono::steady_clock;
+    constexpr std::uint32_t kRounds = 1000000;
+
+    Wheel wheel;
+    std::uint32_t tNow = 0xFFFF0000u;
+    std::uint32_t nFired = 0;
+
+    auto const tStart = Clock::now();
+    for (std::uint32_t round = 0; round < kRounds; ++round)
+        {
+        // re-arm the lot, with delays spread over the wheel, then let
+        // one tick go by.
+        for (unsigned i = 0; i < kTimers; ++i)
+            {
+            if (! wheel.isArmed(Id(i)))
+                wheel.arm(Id(i), tNow, (round * 7 + i * 131) % 2000);
+            }
+        tNow += Wheel::kMsPerTick;
+        nFired += __builtin_popcount(wheel.advance(tNow));
+        }
+    double const ns = std::chrono::duration<double, std::nano>(Clock::now() - tStart).count();
+
+    std::cout << kRounds << " ticks, " << nFired << " timers armed and expired: "
+              << ns / kRounds << " ns per tick, " << ns / nFired << " ns per timer\n";
+    }
+
+int main(int argc, char **argv)
+    {
+    std::uint32_t const nSteps = argc > 1 ? std::uint32_t(std::strtoul(argv[1], nullptr, 0)) : 200000;
+    unsigned const seed = argc > 2 ? unsigned(std::strtoul(argv[2], nullptr, 0)) : 4610;
+
+    std::mt19937 rng(seed);
+    unsigned nFail = 0;
+
+    for (std::uint32_t tStart : { 0u, 12345u, 0xFFFFFFFFu - 2000u, 0xFFFFFFFFu - 200000u, 0xFFFFFFFFu })
+        nFail += testWrap(tStart, nSteps, rng);
+
+    benchmark();
+
+    std::cout << nFail << " failures\n";
+    return nFail == 0 ? 0 : 1;
+    }
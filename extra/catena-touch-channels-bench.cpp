@@ -0,0 +1,316 @@
+/*
+
+Name:   catena-touch-channels-bench.cpp
+
+Function:
+        Measure the per-sample cost of the touch channel code for 2 and 3
+        channels, against the 2-channel code as it was written out by hand.
+
+Copyright and License:
+        See accompanying LICENSE file
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+Usage:
+        g++ -std=c++14 -O2 -o catena-touch-channels-bench catena-touch-channels-bench.cpp
+
+        catena-touch-channels-bench [samples [rounds]]
+
+        Each sample goes through what cMeasurementLoop does with it: read
+        the channels, check warmup stability, run the touch detector, and
+        encode field 3. The best of the rounds (default 5) is reported
+        for each version. The 2-channel template must produce exactly the
+        same touches and bytes as the hand-written code; channel 2 must
+        never count, even reading below zero; and a held touch must count
+        once, held through readings within the hysteresis, with the
+        debounce applied both to touching and releasing.
+
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "../Catena4610_cTouchChannels.h"
+#include "../Catena4610_cTouchDetector.h"
+
+using McciCatena4610::cTouchChannels;
+using McciCatena4610::cTouchDetector;
+
+constexpr std::int16_t kStableDelta = 8;
+constexpr std::uint16_t kThresholdRight = 400;
+constexpr std::uint16_t kThresholdLeft = 270;
+constexpr std::uint16_t kHysteresis = 20;
+constexpr std::uint8_t kDebounce = 2;
+
+// stands in for the IQS620A: replays recorded readings.
+class FakeSensor
+    {
+public:
+    FakeSensor(const std::vector<std::int16_t> (&ch)[3])
+        : m_ch(ch)
+        , m_i(0)
+        {}
+
+    void seek(std::size_t i)
+        {
+        this->m_i = i;
+        }
+
+    std::int16_t getCh0Data() { return this->m_ch[2][this->m_i]; }
+    std::int16_t getCh1Data() { return this->m_ch[0][this->m_i]; }
+    std::int16_t getCh2Data() { return this->m_ch[1][this->m_i]; }
+
+private:
+    const std::vector<std::int16_t> (&m_ch)[3];
+    std::size_t m_i;
+    };
+
+struct Totals
+    {
+    std::uint32_t   nLeft;
+    std::uint32_t   nRight;
+    std::uint32_t   nStable;
+    std::uint32_t   sum;        // of the encoded bytes
+    };
+
+static std::uint8_t *put16(std::uint8_t *p, std::uint16_t v)
+    {
+    *p++ = std::uint8_t(v >> 8);
+    *p++ = std::uint8_t(v);
+    return p;
+    }
+
+static void account(Totals &t, const cTouchDetector::Result &r, bool fStable, const std::uint8_t *p, const std::uint8_t *pEnd)
+    {
+    t.nLeft += r.fLeft;
+    t.nRight += r.fRight;
+    t.nStable += fStable;
+    while (p < pEnd)
+        t.sum = t.sum * 31 + *p++;
+    }
+
+// cTouchDetector for 2 channels, written out by hand.
+class cLegacyTouchDetector
+    {
+public:
+    cTouchDetector::Result update(
+        std::int16_t ch1,
+        std::int16_t ch2,
+        std::uint16_t thresholdRight,
+        std::uint16_t thresholdLeft,
+        std::uint16_t hysteresis,
+        std::uint8_t debounce
+        )
+        {
+        cTouchDetector::Result r { false, false, false, 0 };
+
+        if (! this->m_fTouching)
+            {
+            bool const fRight = ch1 < thresholdRight;
+            bool const fLeft = ch2 < thresholdLeft;
+
+            if (! fRight && ! fLeft)
+                this->m_nRun = 0;
+            else if (++this->m_nRun >= debounce)
+                {
+                this->m_nRun = 0;
+                this->m_fTouching = true;
+                r.fRight = fRight;
+                r.fLeft = fLeft;
+                r.fNewTouch = true;
+                }
+            }
+        else
+            {
+            if (ch1 < thresholdRight + hysteresis || ch2 < thresholdLeft + hysteresis)
+                this->m_nRun = 0;
+            else if (++this->m_nRun >= debounce)
+                {
+                this->m_nRun = 0;
+                this->m_fTouching = false;
+                }
+            }
+
+        return r;
+        }
+
+private:
+    bool            m_fTouching = false;
+    std::uint8_t    m_nRun = 0;
+    };
+
+// the loop's code before the channel count became a parameter.
+__attribute__((noinline))
+Totals runHandWritten(FakeSensor &sensor, std::size_t n)
+    {
+    Totals t {};
+    cLegacyTouchDetector detector;
+    std::int16_t lastCh1 = 0, lastCh2 = 0;
+    std::uint8_t buf[8];
+
+    for (std::size_t i = 0; i < n; ++i)
+        {
+        sensor.seek(i);
+        std::int16_t const ch1 = sensor.getCh1Data();
+        std::int16_t const ch2 = sensor.getCh2Data();
+
+        bool const fStable = std::abs(ch1 - lastCh1) <= kStableDelta &&
+                             std::abs(ch2 - lastCh2) <= kStableDelta;
+        lastCh1 = ch1;
+        lastCh2 = ch2;
+
+        auto const r = detector.update(ch1, ch2, kThresholdRight, kThresholdLeft, kHysteresis, kDebounce);
+
+        std::uint8_t *p = buf;
+        p = put16(p, std::uint16_t(ch1));
+        p = put16(p, std::uint16_t(ch2));
+        account(t, r, fStable, buf, p);
+        }
+
+    return t;
+    }
+
+template <std::size_t a_nChannels>
+__attribute__((noinline))
+Totals runTemplate(FakeSensor &sensor, std::size_t n)
+    {
+    using Channels = cTouchChannels<a_nChannels>;
+    Totals t {};
+    cTouchDetector detector;
+    typename Channels::Readings ch {}, last {};
+    typename Channels::Thresholds thresholds {};
+    std::uint8_t buf[2 * a_nChannels];
+
+    thresholds[0] = kThresholdRight;
+    thresholds[1] = kThresholdLeft;
+
+    for (std::size_t i = 0; i < n; ++i)
+        {
+        sensor.seek(i);
+        Channels::read(sensor, ch);
+
+        bool const fStable = Channels::isStable(ch, last, kStableDelta);
+        last = ch;
+
+        auto const r = detector.update<a_nChannels>(ch, thresholds, kHysteresis, kDebounce);
+
+        std::uint8_t *p = buf;
+        Channels::forEach([&](std::size_t j)
+            {
+            p = put16(p, std::uint16_t(ch[j]));
+            });
+        account(t, r, fStable, buf, p);
+        }
+
+    return t;
+    }
+
+template <typename F>
+double nsPerSample(F f, std::size_t n, Totals &t)
+    {
+    auto const tStart = std::chrono::steady_clock::now();
+    t = f();
+    std::chrono::duration<double, std::nano> const dt = std::chrono::steady_clock::now() - tStart;
+    return dt.count() / n;
+    }
+
+int main(int argc, char **argv)
+    {
+    std::size_t const n = argc > 1 ? std::strtoul(argv[1], nullptr, 0) : 20000000;
+    unsigned const nRounds = argc > 2 ? unsigned(std::strtoul(argv[2], nullptr, 0)) : 5;
+
+    // random walks around 600/500/700, with a touch now and then.
+    std::vector<std::int16_t> ch[3];
+    std::mt19937 rng(0x620A);
+    int v[3] = { 600, 500, 700 };
+    unsigned nTouch = 0;
+
+    for (auto &c : ch)
+        c.resize(n);
+    for (std::size_t i = 0; i < n; ++i)
+        {
+        if (nTouch == 0 && rng() % 64 == 0)
+            nTouch = 1 + rng() % 6;
+        for (unsigned j = 0; j < 3; ++j)
+            {
+            v[j] += int(rng() % 21) - 10;
+            v[j] = std::min(std::max(v[j], 450), 750);
+            ch[j][i] = std::int16_t(nTouch != 0 && j == (i / 7) % 2 ? 150 : v[j]);
+            }
+        if (nTouch != 0)
+            --nTouch;
+        }
+
+    FakeSensor sensor(ch);
+    Totals tHand {}, t2 {}, t3 {};
+
+    double nsHand = 1e30, ns2 = 1e30, ns3 = 1e30;
+
+    // interleaved, so that the versions see the same machine.
+    for (unsigned i = 0; i < nRounds; ++i)
+        {
+        nsHand = std::min(nsHand, nsPerSample([&] { return runHandWritten(sensor, n); }, n, tHand));
+        ns2 = std::min(ns2, nsPerSample([&] { return runTemplate<2>(sensor, n); }, n, t2));
+        ns3 = std::min(ns3, nsPerSample([&] { return runTemplate<3>(sensor, n); }, n, t3));
+        }
+
+    bool const fSame = tHand.nLeft == t2.nLeft && tHand.nRight == t2.nRight &&
+                       tHand.nStable == t2.nStable && tHand.sum == t2.sum;
+
+    std::cout << n << " samples, best of " << nRounds << ":\n";
+    std::cout << "  hand-written, 2 channels: " << nsHand << " ns/sample, "
+              << nsHand / 2 << " ns/channel\n";
+    std::cout << "  template, 2 channels:     " << ns2 << " ns/sample, "
+              << ns2 / 2 << " ns/channel\n";
+    std::cout << "  template, 3 channels:     " << ns3 << " ns/sample, "
+              << ns3 / 3 << " ns/channel\n";
+    std::cout << "  touches (right/left):     " << t2.nRight << "/" << t2.nLeft
+              << "; 3 channels " << t3.nRight << "/" << t3.nLeft << "\n";
+
+    if (! fSame)
+        {
+        std::cout << "the 2-channel template differs from the hand-written code\n";
+        return 1;
+        }
+
+    // a channel that isn't a side never counts, even below zero.
+    cTouchDetector detector;
+    cTouchChannels<3>::Thresholds const thresholds {{ kThresholdRight, kThresholdLeft, 0 }};
+
+    for (unsigned i = 0; i < kDebounce; ++i)
+        {
+        if (detector.update<3>(cTouchChannels<3>::Readings {{ 600, 500, -100 }}, thresholds, kHysteresis, kDebounce).channels != 0)
+            {
+            std::cout << "channel 2 counted a touch\n";
+            return 1;
+            }
+        }
+
+    // a held touch counts once, after kDebounce samples; a reading
+    // within the hysteresis keeps it held.
+    static const std::int16_t kHeld[] =
+        {
+        150, 150, 150, 150, kThresholdRight + kHysteresis - 1, 600, 150, 600, 600, 150, 150
+        };
+    static const bool kCounts[] =
+        {
+        false, true, false, false, false, false, false, false, false, false, true
+        };
+    cTouchDetector held;
+
+    for (std::size_t i = 0; i < sizeof(kHeld) / sizeof(kHeld[0]); ++i)
+        {
+        if (held.update(kHeld[i], 500, kThresholdRight, kThresholdLeft, kHysteresis, kDebounce).fRight != kCounts[i])
+            {
+            std::cout << "held touch: sample " << i << " counted wrongly\n";
+            return 1;
+            }
+        }
+    return 0;
+    }
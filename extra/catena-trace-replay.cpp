@@ -0,0 +1,599 @@
+/*
+
+Name:   catena-trace-replay.cpp
+
+Function:
+        Replay a sensor trace through the touch detector and uplink
+        schedule, faster than real time.
+
+Copyright and License:
+        See accompanying LICENSE file
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+Usage:
+        g++ -std=c++14 -O2 -o catena-trace-replay catena-trace-replay.cpp
+        catena-trace-replay [-r right] [-l left] [-y hysteresis]
+                            [-d debounce] [-e] [-c txcycle]
+                            [-f fastcycle] [-n fastcount] [-v] trace
+        catena-trace-replay -g samples [-s seed] output.trace
+
+        The first form maps the trace and runs every sample through
+        cTouchDetector, the code the device uses, with the given
+        thresholds, hysteresis and debounce (default: the device's, 400
+        and 270, 20, and 1 sample). Uplinks are
+        scheduled on the trace's own clock as the device does: fastcount
+        uplinks fastcycle seconds apart, then one every txcycle seconds
+        (defaults 10, 30 and 360, as for "config"). The defaults, the
+        sampling period and the USB power threshold all come from
+        Catena4610_MeasurementDefaults.h, so they follow the device.
+        With -e, each new touch also sends a touch event uplink. Battery
+        readings drive the boost regulator model, and bus readings select
+        USB power, as on the device.
+
+        The report gives the touches counted, the uplinks and what each
+        carried, the touch durations, gaps in the trace and samples the
+        device dropped, and how much faster than real time the replay ran.
+        The same trace and options always give the same report. With -v,
+        each uplink is listed.
+
+        The second form writes a synthetic trace of the given number of
+        samples (50 ms apart, with labelled touches, baseline drift, bounce
+        and noise, and battery and bus readings), for trying out options,
+        for catena-threshold-tune, and for benchmarking.
+
+*/
+
+#include <cerrno>
+#include <chrono>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <unistd.h>
+
+#include "../Catena4610_MeasurementDefaults.h"
+#include "../Catena4610_cBatteryModel.h"
+#include "../Catena4610_cTouchDetector.h"
+#include "catena-trace.h"
+
+using McciCatena4610::cBatteryModel;
+using McciCatena4610::cTouchDetector;
+using CatenaTrace::Record;
+using CatenaTrace::RecordType;
+using Clock = std::chrono::steady_clock;
+
+namespace Defaults = McciCatena4610::MeasurementDefaults;
+
+// the device's, as configured by default.
+static constexpr std::uint32_t kSamplePeriodMs = Defaults::kSamplePeriodMs;
+static constexpr std::uint16_t kVbusPresentMv = Defaults::kVbusPresentMv;
+
+// a step in the device clock this many sample periods long is a gap.
+static constexpr std::uint32_t kGapPeriods = 4;
+
+struct Options
+    {
+    std::uint16_t   thresholdRight = Defaults::kThresholdRight;
+    std::uint16_t   thresholdLeft = Defaults::kThresholdLeft;
+    std::uint16_t   touchHysteresis = Defaults::kTouchHysteresis;
+    std::uint16_t   touchDebounce = Defaults::kTouchDebounce;
+    std::uint32_t   txCycleSec = Defaults::kTxCycleSec;
+    std::uint32_t   fastTxCycleSec = Defaults::kFastTxCycleSec;
+    std::uint32_t   fastTxCycleCount = Defaults::kFastTxCycleCount;
+    bool            fTouchEvents = false;
+    bool            fVerbose = false;
+    };
+
+struct Report
+    {
+    std::uint64_t   nRecords;
+    std::uint64_t   nSamples;
+    std::uint64_t   nUnknown;
+    std::uint64_t   nVbat;
+    std::uint64_t   nVbus;
+    std::uint64_t   nLabels;
+    std::uint64_t   nDropped;
+    std::uint64_t   nGaps;
+    std::uint64_t   gapMs;
+    std::uint64_t   nLeft;
+    std::uint64_t   nRight;
+    std::uint64_t   nNewTouches;
+    std::uint64_t   nUplinks;
+    std::uint64_t   nEventUplinks;
+    std::uint64_t   nEmptyUplinks;
+    std::uint32_t   maxUplinkLeft;
+    std::uint32_t   maxUplinkRight;
+    std::uint64_t   nContacts;
+    std::uint64_t   contactMs;
+    std::uint64_t   minContactMs;
+    std::uint64_t   maxContactMs;
+    std::uint64_t   nBoostChanges;
+    std::uint64_t   nUsbChanges;
+    std::uint64_t   spanMs;
+    };
+
+/****************************************************************************\
+|
+|   The replay.
+|
+|   Device time is millis(), which wraps every 49.7 days; the replay keeps
+|   its own 64-bit clock, advanced by the difference between successive
+|   records, so long traces stay in order.
+|
+\****************************************************************************/
+
+class Replay
+    {
+public:
+    Replay(const Options &options)
+        : m_options(options)
+        , m_report {}
+        , m_tNow(0)
+        , m_tNextUplink(0)
+        , m_tContactStart(0)
+        , m_nFastLeft(options.fastTxCycleCount)
+        , m_unackedLeft(0)
+        , m_unackedRight(0)
+        , m_lastTms(0)
+        , m_vbatMv(0)
+        , m_fFirst(true)
+        , m_fContact(false)
+        , m_fUsbPower(false)
+        , m_fBoostOn(false)
+        {
+        this->m_report.minContactMs = ~std::uint64_t(0);
+        }
+
+    void run(const Record *pBegin, const Record *pEnd)
+        {
+        for (const Record *p = pBegin; p != pEnd; ++p)
+            {
+            this->advance(p->tMs);
+
+            switch (p->type)
+                {
+            case RecordType::kSample:
+                this->sample(*p);
+                break;
+
+            case RecordType::kDropped:
+                this->m_report.nDropped += std::uint16_t(p->a) | (std::uint32_t(std::uint16_t(p->b)) << 16);
+                break;
+
+            case RecordType::kVbat:
+                this->vbat(std::uint16_t(p->a));
+                break;
+
+            case RecordType::kVbus:
+                this->vbus(std::uint16_t(p->a));
+                break;
+
+            case RecordType::kLabel:
+                ++this->m_report.nLabels;
+                break;
+
+            default:
+                ++this->m_report.nUnknown;
+                break;
+                }
+            }
+
+        this->m_report.nRecords += pEnd - pBegin;
+        this->m_report.spanMs = this->m_tNow;
+        }
+
+    const Report &getReport() const
+        {
+        return this->m_report;
+        }
+
+private:
+    void advance(std::uint32_t tMs)
+        {
+        if (this->m_fFirst)
+            {
+            // the device sends its first uplink as soon as it's up.
+            this->m_fFirst = false;
+            this->m_lastTms = tMs;
+            this->uplink(false);
+            return;
+            }
+
+        std::uint32_t const delta = tMs - this->m_lastTms;
+
+        this->m_lastTms = tMs;
+        if (delta >= kGapPeriods * kSamplePeriodMs)
+            {
+            ++this->m_report.nGaps;
+            this->m_report.gapMs += delta;
+            }
+
+        this->m_tNow += delta;
+        while (this->m_tNow >= this->m_tNextUplink)
+            this->uplink(false);
+        }
+
+    void sample(const Record &r)
+        {
+        Options const &o = this->m_options;
+        auto const touch = this->m_detector.update(
+            r.a, r.b,
+            o.thresholdRight, o.thresholdLeft,
+            o.touchHysteresis, std::uint8_t(o.touchDebounce)
+            );
+
+        ++this->m_report.nSamples;
+        if (touch.fLeft)
+            {
+            ++this->m_report.nLeft;
+            ++this->m_unackedLeft;
+            }
+        if (touch.fRight)
+            {
+            ++this->m_report.nRight;
+            ++this->m_unackedRight;
+            }
+        if (touch.fNewTouch)
+            {
+            ++this->m_report.nNewTouches;
+            if (o.fTouchEvents)
+                {
+                ++this->m_report.nEventUplinks;
+                this->uplink(true);
+                }
+            }
+
+        // a contact is a run of samples below either threshold, however
+        // often the detector counts it.
+        bool const fContact = r.a < o.thresholdRight || r.b < o.thresholdLeft;
+
+        if (fContact && ! this->m_fContact)
+            this->m_tContactStart = this->m_tNow;
+        else if (! fContact && this->m_fContact)
+            {
+            std::uint64_t const ms = this->m_tNow - this->m_tContactStart;
+            Report &rep = this->m_report;
+
+            ++rep.nContacts;
+            rep.contactMs += ms;
+            if (ms < rep.minContactMs)
+                rep.minContactMs = ms;
+            if (ms > rep.maxContactMs)
+                rep.maxContactMs = ms;
+            }
+        this->m_fContact = fContact;
+        }
+
+    void vbat(std::uint16_t mV)
+        {
+        ++this->m_report.nVbat;
+        this->m_vbatMv = mV;
+        this->m_battery.sampleVbat(mV);
+        this->updateBoost();
+        }
+
+    void vbus(std::uint16_t mV)
+        {
+        bool const fUsbPower = mV > kVbusPresentMv;
+
+        ++this->m_report.nVbus;
+        if (fUsbPower != this->m_fUsbPower)
+            {
+            ++this->m_report.nUsbChanges;
+            this->m_fUsbPower = fUsbPower;
+            this->updateBoost();
+            }
+        }
+
+    void updateBoost()
+        {
+        if (this->m_vbatMv == 0)
+            return;
+
+        bool const fBoostOn = this->m_battery.updateBoost(this->m_vbatMv, this->m_fUsbPower);
+
+        if (fBoostOn != this->m_fBoostOn)
+            {
+            ++this->m_report.nBoostChanges;
+            this->m_fBoostOn = fBoostOn;
+            }
+        }
+
+    // send the unacked counts. A scheduled uplink also sets the next one.
+    void uplink(bool fEvent)
+        {
+        Report &rep = this->m_report;
+
+        ++rep.nUplinks;
+        if (this->m_unackedLeft == 0 && this->m_unackedRight == 0)
+            ++rep.nEmptyUplinks;
+        if (this->m_unackedLeft > rep.maxUplinkLeft)
+            rep.maxUplinkLeft = this->m_unackedLeft;
+        if (this->m_unackedRight > rep.maxUplinkRight)
+            rep.maxUplinkRight = this->m_unackedRight;
+
+        if (this->m_options.fVerbose)
+            std::printf(
+                "%12.3f s  %s  left %" PRIu32 "  right %" PRIu32 "\n",
+                this->m_tNow / 1000.0,
+                fEvent ? "event " : "uplink",
+                this->m_unackedLeft,
+                this->m_unackedRight
+                );
+
+        this->m_unackedLeft = this->m_unackedRight = 0;
+        if (fEvent)
+            return;
+
+        std::uint32_t cycleSec = this->m_options.txCycleSec;
+        if (this->m_nFastLeft != 0)
+            {
+            --this->m_nFastLeft;
+            cycleSec = this->m_options.fastTxCycleSec;
+            }
+        this->m_tNextUplink += std::uint64_t(cycleSec) * 1000;
+        }
+
+    Options const   &m_options;
+    Report          m_report;
+    cTouchDetector  m_detector;
+    cBatteryModel   m_battery;
+    std::uint64_t   m_tNow;
+    std::uint64_t   m_tNextUplink;
+    std::uint64_t   m_tContactStart;
+    std::uint32_t   m_nFastLeft;
+    std::uint32_t   m_unackedLeft;
+    std::uint32_t   m_unackedRight;
+    std::uint32_t   m_lastTms;
+    std::uint16_t   m_vbatMv;
+    bool            m_fFirst;
+    bool            m_fContact;
+    bool            m_fUsbPower;
+    bool            m_fBoostOn;
+    };
+
+/****************************************************************************\
+|
+|   Synthetic traces.
+|
+\****************************************************************************/
+
+class Random
+    {
+public:
+    Random(std::uint64_t seed) : m_state(seed ? seed : 1) {}
+
+    // xorshift64*
+    std::uint32_t next()
+        {
+        this->m_state ^= this->m_state >> 12;
+        this->m_state ^= this->m_state << 25;
+        this->m_state ^= this->m_state >> 27;
+        return std::uint32_t((this->m_state * 0x2545F4914F6CDD1Dull) >> 32);
+        }
+
+    std::uint32_t below(std::uint32_t n)
+        {
+        return std::uint32_t((std::uint64_t(this->next()) * n) >> 32);
+        }
+
+private:
+    std::uint64_t   m_state;
+    };
+
+static bool generate(const char *pPath, std::uint64_t nSamples, std::uint64_t seed)
+    {
+    CatenaTrace::Writer writer;
+
+    if (! writer.open(pPath, 0))
+        return false;
+
+    Random rng(seed);
+    std::uint32_t tMs = rng.next();    // exercise millis() wrap
+    std::uint32_t vbatMv = 3600;
+    std::uint32_t nTouch = 0;
+    std::uint32_t nQuiet = 0;
+    bool fLeft = false;
+    bool fRight = false;
+    bool fUsb = false;
+    bool fOk = true;
+
+    // the untouched readings drift up and down by up to kDrift over
+    // kDriftPeriod samples (temperature, humidity).
+    constexpr std::int32_t kDrift = 120;
+    constexpr std::uint64_t kDriftPeriod = 4 * 3600 * 1000 / kSamplePeriodMs;
+
+    for (std::uint64_t i = 0; i < nSamples && fOk; ++i)
+        {
+        // a touch every 30 s or so, held for 100 ms to 2 s, and at least
+        // 200 ms apart.
+        if (nTouch == 0 && nQuiet == 0 && rng.below(600) == 0)
+            {
+            nTouch = 2 + rng.below(39);
+            std::uint32_t const side = rng.below(3);
+            fRight = side != 1;
+            fLeft = side != 0;
+            fOk = writer.writeLabel(
+                tMs,
+                (fRight ? CatenaTrace::kLabelRight : 0) | (fLeft ? CatenaTrace::kLabelLeft : 0),
+                std::uint16_t(nTouch * kSamplePeriodMs)
+                );
+            }
+
+        std::uint64_t const phase = i % kDriftPeriod;
+        std::int32_t const drift = std::int32_t(
+            (phase < kDriftPeriod / 2 ? phase : kDriftPeriod - phase) * 4 * kDrift / kDriftPeriod
+            ) - kDrift;
+
+        // a held touch sometimes reads untouched for a sample (bounce);
+        // and now and then a single untouched sample dips (noise).
+        bool const fBounce = nTouch != 0 && nTouch != 1 && rng.below(16) == 0;
+        bool const fDip = nTouch == 0 && rng.below(20000) == 0;
+        bool const fRightLow = (nTouch != 0 && fRight && ! fBounce) || fDip;
+        bool const fLeftLow = (nTouch != 0 && fLeft && ! fBounce) || fDip;
+
+        std::int16_t const ch1 = std::int16_t((fRightLow ? 150 + rng.below(200) : 600 + rng.below(100)) + drift);
+        std::int16_t const ch2 = std::int16_t((fLeftLow ? 100 + rng.below(150) : 500 + rng.below(100)) + drift);
+
+        if (nTouch != 0)
+            {
+            if (--nTouch == 0)
+                nQuiet = 4;
+            }
+        else if (nQuiet != 0)
+            --nQuiet;
+
+        fOk = writer.writeSample(tMs, ch1, ch2, std::int16_t(rng.below(64)));
+
+        // now and then the device's ring overflows.
+        if (rng.below(100000) == 0)
+            {
+            std::uint32_t const nDropped = 1 + rng.below(20);
+
+            fOk = fOk && writer.writeDropped(tMs, nDropped);
+            tMs += nDropped * kSamplePeriodMs;
+            }
+
+        // battery on each uplink; slowly discharging, with noise.
+        if (i % (360000 / kSamplePeriodMs) == 0)
+            {
+            if (vbatMv > 2900 && rng.below(4) == 0)
+                --vbatMv;
+            fOk = fOk && writer.writeVoltage(tMs, RecordType::kVbat, std::uint16_t(vbatMv - 20 + rng.below(40)));
+            }
+
+        // USB plugged or unplugged about once a day.
+        if (rng.below(24 * 3600 * 1000 / kSamplePeriodMs) == 0)
+            {
+            fUsb = ! fUsb;
+            fOk = fOk && writer.writeVoltage(tMs, RecordType::kVbus, std::uint16_t(fUsb ? 5000 : 300));
+            }
+
+        tMs += kSamplePeriodMs;
+        }
+
+    return writer.close() && fOk;
+    }
+
+/****************************************************************************\
+|
+|   main
+|
+\****************************************************************************/
+
+static void printReport(const Report &r, double seconds, const Options &o)
+    {
+    double const spanSec = r.spanMs / 1000.0;
+
+    std::printf("thresholds: right %u, left %u; hysteresis %u, debounce %u\n",
+        o.thresholdRight, o.thresholdLeft, o.touchHysteresis, o.touchDebounce);
+    std::printf("records: %" PRIu64 " (%" PRIu64 " samples, %" PRIu64 " battery, %" PRIu64 " bus, %" PRIu64 " labels, %" PRIu64 " unknown)\n",
+        r.nRecords, r.nSamples, r.nVbat, r.nVbus, r.nLabels, r.nUnknown);
+    std::printf("trace span: %.1f s (%.2f days)\n", spanSec, spanSec / 86400.0);
+    std::printf("gaps: %" PRIu64 " totalling %.1f s; %" PRIu64 " samples dropped by device\n",
+        r.nGaps, r.gapMs / 1000.0, r.nDropped);
+    std::printf("touches: %" PRIu64 " left, %" PRIu64 " right, %" PRIu64 " new touches\n",
+        r.nLeft, r.nRight, r.nNewTouches);
+    if (r.nContacts != 0)
+        std::printf("contacts: %" PRIu64 ", duration min %" PRIu64 " / mean %" PRIu64 " / max %" PRIu64 " ms\n",
+            r.nContacts, r.minContactMs, r.contactMs / r.nContacts, r.maxContactMs);
+    else
+        std::printf("contacts: 0\n");
+    std::printf("uplinks: %" PRIu64 " (%" PRIu64 " touch events, %" PRIu64 " with no touches); most in one: left %u, right %u\n",
+        r.nUplinks, r.nEventUplinks, r.nEmptyUplinks, r.maxUplinkLeft, r.maxUplinkRight);
+    std::printf("power: %" PRIu64 " boost changes, %" PRIu64 " USB changes\n", r.nBoostChanges, r.nUsbChanges);
+
+    // timing goes to stderr, so the report itself is reproducible.
+    double const t = seconds > 0 ? seconds : 1e-9;
+    std::fprintf(stderr, "replayed in %.3f s: %.1f M samples/s, %.0fx real time\n",
+        seconds, r.nSamples / t / 1e6, spanSec / t);
+    }
+
+static int usage(const char *pName)
+    {
+    std::fprintf(stderr,
+        "usage: %s [-r right] [-l left] [-y hysteresis] [-d debounce] [-e] [-c txcycle] [-f fastcycle] [-n fastcount] [-v] trace\n"
+        "       %s -g samples [-s seed] output.trace\n",
+        pName, pName);
+    return 2;
+    }
+
+int main(int argc, char **argv)
+    {
+    Options options;
+    std::uint64_t nGenerate = 0;
+    std::uint64_t seed = 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "r:l:y:d:ec:f:n:vg:s:")) != -1)
+        {
+        switch (opt)
+            {
+        case 'r':   options.thresholdRight = std::uint16_t(std::strtoul(optarg, nullptr, 0)); break;
+        case 'l':   options.thresholdLeft = std::uint16_t(std::strtoul(optarg, nullptr, 0)); break;
+        case 'y':   options.touchHysteresis = std::uint16_t(std::strtoul(optarg, nullptr, 0)); break;
+        case 'd':   options.touchDebounce = std::uint16_t(std::strtoul(optarg, nullptr, 0)); break;
+        case 'e':   options.fTouchEvents = true; break;
+        case 'c':   options.txCycleSec = std::uint32_t(std::strtoul(optarg, nullptr, 0)); break;
+        case 'f':   options.fastTxCycleSec = std::uint32_t(std::strtoul(optarg, nullptr, 0)); break;
+        case 'n':   options.fastTxCycleCount = std::uint32_t(std::strtoul(optarg, nullptr, 0)); break;
+        case 'v':   options.fVerbose = true; break;
+        case 'g':   nGenerate = std::strtoull(optarg, nullptr, 0); break;
+        case 's':   seed = std::strtoull(optarg, nullptr, 0); break;
+        default:    return usage(argv[0]);
+            }
+        }
+
+    if (argc - optind != 1)
+        return usage(argv[0]);
+
+    if (options.txCycleSec == 0 || options.fastTxCycleSec == 0)
+        {
+        std::fprintf(stderr, "uplink cycles must be nonzero\n");
+        return 2;
+        }
+
+    if (options.touchDebounce < 1 || options.touchDebounce > Defaults::kMaxTouchDebounce)
+        {
+        std::fprintf(stderr, "debounce must be 1 to %u\n", unsigned(Defaults::kMaxTouchDebounce));
+        return 2;
+        }
+
+    const char * const pPath = argv[optind];
+
+    if (nGenerate != 0)
+        {
+        if (! generate(pPath, nGenerate, seed))
+            {
+            std::fprintf(stderr, "%s: %s\n", pPath, std::strerror(errno));
+            return 1;
+            }
+        return 0;
+        }
+
+    CatenaTrace::Reader reader;
+    const char *pError;
+
+    if (! reader.open(pPath, pError))
+        {
+        if (errno != 0)
+            std::fprintf(stderr, "%s: %s: %s\n", pPath, pError, std::strerror(errno));
+        else
+            std::fprintf(stderr, "%s: %s\n", pPath, pError);
+        return 1;
+        }
+
+    Replay replay(options);
+    auto const tStart = Clock::now();
+
+    replay.run(reader.begin(), reader.end());
+
+    double const seconds = std::chrono::duration<double>(Clock::now() - tStart).count();
+
+    printReport(replay.getReport(), seconds, options);
+    return 0;
+    }
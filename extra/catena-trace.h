@@ -0,0 +1,269 @@
+/*
+
+Name:   catena-trace.h
+
+Function:
+        The sensor trace file format, for the host tools.
+
+Copyright and License:
+        See accompanying LICENSE file
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#ifndef _catena_trace_h_
+# define _catena_trace_h_
+
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace CatenaTrace {
+
+/****************************************************************************\
+|
+|   A trace file is a 32-byte header followed by fixed-size 12-byte
+|   records, all little-endian, in time order:
+|
+|       header:  char[8] magic, u16 version, u16 header bytes,
+|                u32 record bytes, u64 capture start (Unix ms),
+|                u64 reserved
+|       record:  u32 device millis(), u8 type, u8 reserved,
+|                i16 a, i16 b, i16 c
+|
+|   Records are the same size whatever their type, so a reader can index
+|   a file directly. Readers skip record types they don't know, so types
+|   can be added without changing the version.
+|
+|   Reader maps the file and hands out the records in place; nothing is
+|   copied, so a trace of several GB costs only the page cache.
+|
+|   Label records mark where touches really happened, for scoring a
+|   detector against a trace; the device never sends them. They come
+|   before the first sample of the touch.
+|
+\****************************************************************************/
+
+constexpr char kMagic[8] = { 'C', '4', '6', '1', '0', 'T', 'R', 'C' };
+constexpr std::uint16_t kVersion = 1;
+
+enum class RecordType : std::uint8_t
+    {
+    kSample = 1,        // a = Ch1, b = Ch2, c = amplitude
+    kDropped = 2,       // samples lost just before this point: a | b << 16
+    kVbat = 3,          // battery voltage: u16(a) mV
+    kVbus = 4,          // bus voltage: u16(a) mV
+    kLabel = 5,         // a real touch starts here: a = sides
+                        // (kLabelRight | kLabelLeft), u16(b) = ms held
+    };
+
+constexpr std::int16_t kLabelRight = 1 << 0;
+constexpr std::int16_t kLabelLeft = 1 << 1;
+
+struct FileHeader
+    {
+    char            magic[8];
+    std::uint16_t   version;
+    std::uint16_t   headerBytes;
+    std::uint32_t   recordBytes;
+    std::uint64_t   tCaptureUnixMs;
+    std::uint64_t   reserved;
+    };
+
+struct Record
+    {
+    std::uint32_t   tMs;
+    RecordType      type;
+    std::uint8_t    reserved;
+    std::int16_t    a;
+    std::int16_t    b;
+    std::int16_t    c;
+    };
+
+static_assert(sizeof(FileHeader) == 32, "FileHeader layout");
+static_assert(sizeof(Record) == 12, "Record layout");
+
+// buffered trace writer.
+class Writer
+    {
+public:
+    Writer() : m_fp(nullptr), m_nRecords(0) {}
+    ~Writer() { this->close(); }
+
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+
+    bool open(const char *pPath, std::uint64_t tCaptureUnixMs)
+        {
+        this->m_fp = std::fopen(pPath, "wb");
+        if (this->m_fp == nullptr)
+            return false;
+
+        std::setvbuf(this->m_fp, nullptr, _IOFBF, 1 << 20);
+
+        FileHeader h {};
+        std::memcpy(h.magic, kMagic, sizeof(h.magic));
+        h.version = kVersion;
+        h.headerBytes = sizeof(FileHeader);
+        h.recordBytes = sizeof(Record);
+        h.tCaptureUnixMs = tCaptureUnixMs;
+        return std::fwrite(&h, sizeof(h), 1, this->m_fp) == 1;
+        }
+
+    bool write(const Record &r)
+        {
+        ++this->m_nRecords;
+        return std::fwrite(&r, sizeof(r), 1, this->m_fp) == 1;
+        }
+
+    bool writeSample(std::uint32_t tMs, std::int16_t ch1, std::int16_t ch2, std::int16_t amplitude)
+        {
+        return this->write(Record { tMs, RecordType::kSample, 0, ch1, ch2, amplitude });
+        }
+
+    bool writeDropped(std::uint32_t tMs, std::uint32_t nDropped)
+        {
+        return this->write(Record {
+            tMs, RecordType::kDropped, 0,
+            std::int16_t(nDropped & 0xFFFF), std::int16_t(nDropped >> 16), 0
+            });
+        }
+
+    bool writeVoltage(std::uint32_t tMs, RecordType type, std::uint16_t mV)
+        {
+        return this->write(Record { tMs, type, 0, std::int16_t(mV), 0, 0 });
+        }
+
+    bool writeLabel(std::uint32_t tMs, std::int16_t sides, std::uint16_t msHeld)
+        {
+        return this->write(Record { tMs, RecordType::kLabel, 0, sides, std::int16_t(msHeld), 0 });
+        }
+
+    bool close()
+        {
+        if (this->m_fp == nullptr)
+            return true;
+
+        bool const fOk = std::fclose(this->m_fp) == 0;
+        this->m_fp = nullptr;
+        return fOk;
+        }
+
+    std::uint64_t getRecordCount() const { return this->m_nRecords; }
+
+private:
+    std::FILE       *m_fp;
+    std::uint64_t   m_nRecords;
+    };
+
+// read-only view of a trace file, mapped into memory.
+class Reader
+    {
+public:
+    Reader() : m_pBase(nullptr), m_nBytes(0), m_pHeader(nullptr), m_pBegin(nullptr), m_nRecords(0) {}
+    ~Reader() { this->close(); }
+
+    Reader(const Reader&) = delete;
+    Reader& operator=(const Reader&) = delete;
+
+    // map pPath and check the header. On failure, returns false and sets
+    // pError to a description; errno is left set for system errors, and
+    // is zero if the file isn't a usable trace.
+    bool open(const char *pPath, const char *&pError)
+        {
+        this->close();
+
+        int const fd = ::open(pPath, O_RDONLY);
+        if (fd < 0)
+            {
+            pError = "can't open";
+            return false;
+            }
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || std::size_t(st.st_size) < sizeof(FileHeader))
+            {
+            ::close(fd);
+            errno = 0;
+            pError = "too short for a trace header";
+            return false;
+            }
+
+        void * const p = mmap(nullptr, std::size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED)
+            {
+            pError = "can't map";
+            return false;
+            }
+
+        // the records are read once, front to back.
+        madvise(p, std::size_t(st.st_size), MADV_SEQUENTIAL);
+
+        this->m_pBase = p;
+        this->m_nBytes = std::size_t(st.st_size);
+        this->m_pHeader = static_cast<const FileHeader *>(p);
+
+        FileHeader const &h = *this->m_pHeader;
+        if (std::memcmp(h.magic, kMagic, sizeof(h.magic)) != 0)
+            pError = "not a trace file";
+        else if (h.version != kVersion)
+            pError = "unsupported trace version";
+        else if (h.recordBytes != sizeof(Record) || h.headerBytes < sizeof(FileHeader) ||
+                 h.headerBytes > this->m_nBytes || h.headerBytes % alignof(Record) != 0)
+            pError = "unsupported record layout";
+        else
+            {
+            this->m_pBegin = reinterpret_cast<const Record *>(
+                static_cast<const std::uint8_t *>(p) + h.headerBytes
+                );
+            // a partial record at the end (capture killed mid-write) is
+            // ignored.
+            this->m_nRecords = (this->m_nBytes - h.headerBytes) / sizeof(Record);
+            return true;
+            }
+
+        this->close();
+        errno = 0;
+        return false;
+        }
+
+    void close()
+        {
+        if (this->m_pBase != nullptr)
+            munmap(this->m_pBase, this->m_nBytes);
+
+        this->m_pBase = nullptr;
+        this->m_nBytes = 0;
+        this->m_pHeader = nullptr;
+        this->m_pBegin = nullptr;
+        this->m_nRecords = 0;
+        }
+
+    const FileHeader &getHeader() const { return *this->m_pHeader; }
+    const Record *begin() const { return this->m_pBegin; }
+    const Record *end() const { return this->m_pBegin + this->m_nRecords; }
+    std::size_t size() const { return this->m_nRecords; }
+
+private:
+    void                *m_pBase;
+    std::size_t         m_nBytes;
+    const FileHeader    *m_pHeader;
+    const Record        *m_pBegin;
+    std::size_t         m_nRecords;
+    };
+
+} // namespace CatenaTrace
+
+#endif /* _catena_trace_h_ */
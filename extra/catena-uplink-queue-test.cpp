@@ -0,0 +1,338 @@
+/*
+
+Name:   catena-uplink-queue-test.cpp
+
+Function:
+        Test cUplinkQueue: coalescing with retried frames pending, and a
+        long run over a lossy link.
+
+Copyright and License:
+        See accompanying LICENSE file
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+Usage:
+        g++ -std=c++14 -O2 -o catena-uplink-queue-test catena-uplink-queue-test.cpp
+
+        catena-uplink-queue-test [hours [loss-percent [seed]]]
+
+        First some fixed cases: a new frame replaces the newest waiting
+        frame of its class, not an older one that is being retried; and a
+        frame queued without coalescing (a diagnostics frame, in the
+        sketch) is neither replaced nor replaces another. An evicted
+        frame is counted as a drop of its own class.
+
+        Then the queue is run, as the measurement loop runs it, for some
+        hours (default 48) of simulated time over a link that loses the
+        given percentage of uplinks (default 30): a periodic frame every
+        6 minutes, every tenth one with diagnostics; touches at random,
+        each burst queueing a touch-event frame. Each frame carries the
+        touches not yet covered by a delivered frame, filled in when it's
+        sent, as startTransmission() does. The network side adds up what
+        it receives.
+
+        No frame may be delivered twice, the network's total must equal
+        the touches acknowledged, and every touch must be delivered once
+        the link has been drained. Every diagnostics frame must arrive
+        unless the queue counted a drop for it.
+
+*/
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <set>
+
+#include "../Catena4610_cUplinkQueue.h"
+
+using Queue = McciCatena4610::cUplinkQueue<4, 26>;
+using Priority = Queue::Priority;
+
+// the payload of a test frame: kind, id, and the touch counts.
+enum Kind : std::uint8_t { kPeriodic = 'P', kTouch = 'T', kDiag = 'D' };
+constexpr std::size_t kFrameBytes = 7;
+
+constexpr std::uint32_t kTxCycleMs = 6 * 60 * 1000;
+constexpr std::uint32_t kAirMs = 2000;
+
+static void makeFrame(std::uint8_t *p, Kind kind, std::uint32_t id)
+    {
+    p[0] = kind;
+    for (unsigned i = 0; i < 4; ++i)
+        p[1 + i] = std::uint8_t(id >> (24 - 8 * i));
+    p[5] = p[6] = 0;
+    }
+
+static std::uint32_t getId(const std::uint8_t *p)
+    {
+    return (std::uint32_t(p[1]) << 24) | (std::uint32_t(p[2]) << 16) |
+           (std::uint32_t(p[3]) << 8) | p[4];
+    }
+
+static bool put(Queue &q, Kind kind, std::uint32_t id, std::uint32_t tNow)
+    {
+    std::uint8_t frame[kFrameBytes];
+
+    makeFrame(frame, kind, id);
+    return q.put(frame, sizeof(frame), 1,
+                 kind == kTouch ? Priority::kTouchEvent : Priority::kPeriodic,
+                 /* fCoalesce */ kind != kDiag, tNow);
+    }
+
+// send whatever is due now and report the outcome; the id sent, or 0.
+static std::uint32_t sendOne(Queue &q, std::uint32_t tNow, bool fSuccess)
+    {
+    auto const pEntry = q.startSend(tNow);
+
+    if (pEntry == nullptr)
+        return 0;
+
+    std::uint32_t const id = getId(pEntry->data);
+    q.sendDone(fSuccess, tNow);
+    return id;
+    }
+
+static unsigned testCoalescing()
+    {
+    unsigned nFail = 0;
+    std::uint32_t t = 0;
+
+    // a retried frame must not be overtaken by a later frame of the same
+    // class: P1 in flight, P2 queued behind it, P1 fails, P3 arrives.
+        {
+        Queue q;
+
+        put(q, kPeriodic, 1, t);
+        q.startSend(t);
+        put(q, kPeriodic, 2, t);
+        q.sendDone(false, t);
+        put(q, kPeriodic, 3, t);
+
+        // P1 is retried after its backoff, then P3; P2 is gone.
+        t += Queue::kRetryMaxMs * 2;
+        std::uint32_t const first = sendOne(q, t, true);
+        std::uint32_t const second = sendOne(q, t, true);
+        std::uint32_t const third = sendOne(q, t, true);
+
+        if (first != 1 || second != 3 || third != 0 || q.getStats().nCoalesced != 1)
+            {
+            std::cerr << "retried: sent " << first << ", " << second << ", " << third
+                      << "; expected 1, 3, none\n";
+            ++nFail;
+            }
+        }
+
+    // a diagnostics frame is not replaced...
+        {
+        Queue q;
+
+        put(q, kDiag, 1, t);
+        put(q, kPeriodic, 2, t);
+        std::uint32_t const first = sendOne(q, t, true);
+        std::uint32_t const second = sendOne(q, t, true);
+
+        if (first != 1 || second != 2 || q.getStats().nCoalesced != 0)
+            {
+            std::cerr << "diag first: sent " << first << ", " << second << "; expected 1, 2\n";
+            ++nFail;
+            }
+        }
+
+    // ... and doesn't replace another.
+        {
+        Queue q;
+
+        put(q, kPeriodic, 1, t);
+        put(q, kDiag, 2, t);
+        put(q, kPeriodic, 3, t);
+        std::uint32_t const first = sendOne(q, t, true);
+        std::uint32_t const second = sendOne(q, t, true);
+        std::uint32_t const third = sendOne(q, t, true);
+
+        if (first != 1 || second != 2 || third != 3 || q.getStats().nCoalesced != 0)
+            {
+            std::cerr << "diag second: sent " << first << ", " << second << ", " << third
+                      << "; expected 1, 2, 3\n";
+            ++nFail;
+            }
+        }
+
+    std::cout << "coalescing: " << (nFail ? "FAILED" : "ok") << "\n\n";
+    return nFail;
+    }
+
+// drops are counted by class, so a sender of a sequence knows it broke.
+static unsigned testDropsByClass()
+    {
+    unsigned nFail = 0;
+    std::uint32_t t = 0;
+    Queue q;
+    std::uint8_t frame[kFrameBytes];
+
+    makeFrame(frame, kPeriodic, 1);
+    q.put(frame, sizeof(frame), 3, Priority::kWaveform, /* fCoalesce */ false, t);
+    for (std::uint32_t id = 2; id < 2 + 4; ++id)
+        put(q, kDiag, id, t);
+
+    if (q.getDropped(Priority::kWaveform) != 1 ||
+        q.getDropped(Priority::kPeriodic) != 0 ||
+        q.getStats().nDropped != 1)
+        {
+        std::cerr << "eviction: " << q.getDropped(Priority::kWaveform) << " waveform and "
+                  << q.getDropped(Priority::kPeriodic) << " periodic drops; expected 1 and 0\n";
+        ++nFail;
+        }
+
+    std::cout << "drops by class: " << (nFail ? "FAILED" : "ok") << "\n\n";
+    return nFail;
+    }
+
+static unsigned testLossyLink(std::uint32_t hours, unsigned lossPercent, std::mt19937 &rng)
+    {
+    Queue q;
+    unsigned nFail = 0;
+    std::uint32_t id = 0;
+    std::uint32_t nPeriodic = 0;
+
+    // the device's counters, and what the network has added up.
+    std::uint32_t touches = 0;
+    std::uint32_t acked = 0;
+    std::uint32_t sending = 0;
+    std::uint64_t networkTotal = 0;
+
+    std::set<std::uint32_t> delivered;
+    std::set<std::uint32_t> diagQueued;
+
+    // the frame in the air, and when it lands.
+    bool fInAir = false;
+    std::uint32_t tLands = 0;
+    std::uint32_t idInAir = 0;
+
+    q.setSeed(rng());
+
+    std::uint32_t const tEnd = hours * 3600u * 1000u;
+    std::uint32_t tNextPeriodic = kTxCycleMs;
+
+    auto const step = [&](std::uint32_t t, bool fLossy)
+        {
+        if (fInAir && t >= tLands)
+            {
+            bool const fSuccess = ! fLossy || rng() % 100 >= lossPercent;
+
+            fInAir = false;
+            q.sendDone(fSuccess, t);
+            if (fSuccess)
+                {
+                if (! delivered.insert(idInAir).second)
+                    {
+                    std::cerr << "frame " << idInAir << " delivered twice\n";
+                    ++nFail;
+                    }
+                networkTotal += sending;
+                acked += sending;
+                }
+            }
+
+        if (! fInAir)
+            {
+            auto const pEntry = q.startSend(t);
+
+            if (pEntry != nullptr)
+                {
+                // startTransmission(): the touches not yet acknowledged.
+                sending = touches - acked;
+                if (sending > 0xFFFF)
+                    sending = 0xFFFF;
+                idInAir = getId(pEntry->data);
+                fInAir = true;
+                tLands = t + kAirMs;
+                }
+            }
+        };
+
+    for (std::uint32_t t = 0; t < tEnd; t += 1000)
+        {
+        if (t >= tNextPeriodic)
+            {
+            tNextPeriodic += kTxCycleMs;
+            Kind const kind = ++nPeriodic % 10 == 0 ? kDiag : kPeriodic;
+
+            ++id;
+            if (kind == kDiag)
+                diagQueued.insert(id);
+            put(q, kind, id, t);
+            }
+
+        if (rng() % 600 == 0)
+            {
+            touches += 1 + rng() % 5;
+            put(q, kTouch, ++id, t);
+            }
+
+        step(t, true);
+        }
+
+    // drain over a perfect link, queueing a final frame for what's left.
+    std::uint32_t t = tEnd;
+    put(q, kPeriodic, ++id, t);
+    for (std::uint32_t tDrain = t + 2 * 3600u * 1000u; t < tDrain; t += 1000)
+        step(t, false);
+
+    auto const &stats = q.getStats();
+    std::size_t nDiagLost = 0;
+    for (auto const d : diagQueued)
+        {
+        if (delivered.count(d) == 0)
+            ++nDiagLost;
+        }
+
+    std::cout << hours << " hours at " << lossPercent << "% loss: "
+              << id << " frames queued, " << stats.nQueued << " slots used, "
+              << stats.nCoalesced << " coalesced, " << stats.nSent << " sent, "
+              << stats.nRetries << " retries, " << stats.nDropped << " dropped; max depth "
+              << unsigned(stats.maxDepth) << "\n"
+              << "  touches " << touches << ", acknowledged " << acked
+              << ", network total " << networkTotal << "; diagnostics "
+              << diagQueued.size() - nDiagLost << " of " << diagQueued.size() << " delivered\n\n";
+
+    if (networkTotal != acked || acked != touches)
+        {
+        std::cerr << "touches: " << touches << " counted, " << acked << " acknowledged, network saw "
+                  << networkTotal << "\n";
+        ++nFail;
+        }
+    if (nDiagLost > stats.nDropped || stats.depth != 0 || stats.nSent != delivered.size())
+        {
+        std::cerr << nDiagLost << " diagnostics frames lost, " << stats.nDropped << " drops; depth "
+                  << unsigned(stats.depth) << "; " << stats.nSent << " sent, " << delivered.size() << " delivered\n";
+        ++nFail;
+        }
+
+    return nFail;
+    }
+
+int main(int argc, char **argv)
+    {
+    std::uint32_t const hours = argc > 1 ? std::uint32_t(std::strtoul(argv[1], nullptr, 0)) : 48;
+    unsigned const lossPercent = argc > 2 ? unsigned(std::strtoul(argv[2], nullptr, 0)) : 30;
+    unsigned const seed = argc > 3 ? unsigned(std::strtoul(argv[3], nullptr, 0)) : 4610;
+
+    if (hours == 0 || hours > 1000 || lossPercent > 90)
+        {
+        std::cerr << "usage: catena-uplink-queue-test [hours [loss-percent [seed]]]\n";
+        return 2;
+        }
+
+    std::mt19937 rng(seed);
+    unsigned nFail = 0;
+
+    nFail += testCoalescing();
+    nFail += testDropsByClass();
+    nFail += testLossyLink(hours, lossPercent, rng);
+
+    std::cout << nFail << " failures\n";
+    return nFail == 0 ? 0 : 1;
+    }
@@ -0,0 +1,235 @@
+/*
+
+Name:   catena-waveform-port-3-decoder-node-red.js
+
+Function:
+        Reassemble and decode MCCI port 3 waveform fragments for Node-Red
+        flow.
+
+Copyright and License:
+        See accompanying LICENSE file
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+// CRC-32 (IEEE 802.3), as computed by the device.
+function Crc32(bytes, n) {
+    var crc = 0xFFFFFFFF;
+
+    for (var i = 0; i < n; ++i) {
+        crc ^= bytes[i];
+        for (var j = 0; j < 8; ++j)
+            crc = (crc >>> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+    return (~crc) >>> 0;
+}
+
+function DecodeU32(bytes, i) {
+    return ((bytes[i] << 24) >>> 0) + (bytes[i + 1] << 16) + (bytes[i + 2] << 8) + bytes[i + 3];
+}
+
+function DecodeVarint(Parse) {
+    var v = 0;
+
+    for (var shift = 0; shift < 35; shift += 7) {
+        if (Parse.i >= Parse.end)
+            return null;
+
+        var b = Parse.bytes[Parse.i++];
+        v += (b & 0x7F) * Math.pow(2, shift);
+        if ((b & 0x80) === 0)
+            return v;
+    }
+    return null;
+}
+
+/*
+
+Name:   DecodeWaveform()
+
+Function:
+    Decode a reassembled waveform capture.
+
+Definition:
+    function DecodeWaveform(blob) -> object
+
+Description:
+    blob is the concatenated data of all the fragments of a capture. The
+    CRC is checked, and the samples are returned with their device
+    times (ms) and readings.
+
+Returns:
+    Object, or null if the blob is damaged.
+
+*/
+
+function DecodeWaveform(blob) {
+    var n = blob.length;
+
+    if (n < 12 || blob[0] !== 1)
+        return null;
+
+    if (DecodeU32(blob, n - 4) !== Crc32(blob, n - 4))
+        return null;
+
+    var decoded = {};
+    decoded.reason = ["?", "touch", "amplitude", "manual"][blob[1]] || "?";
+    decoded.nPre = blob[2];
+    decoded.nPost = blob[3];
+
+    var nSamples = decoded.nPre + decoded.nPost;
+    var Parse = { bytes: blob, i: 8, end: n - 4 };
+    var samples = [];
+    var t = DecodeU32(blob, 4);
+
+    for (var i = 0; i < nSamples; ++i) {
+        if (i > 0) {
+            var dt = DecodeVarint(Parse);
+            if (dt === null)
+                return null;
+            t = (t + dt) % 0x100000000;
+        }
+        samples.push({ t: t });
+    }
+
+    // each channel is sent as zigzag-encoded differences.
+    var fields = ["ch1", "ch2", "amplitude"];
+    for (var f = 0; f < fields.length; ++f) {
+        var last = 0;
+
+        for (var i = 0; i < nSamples; ++i) {
+            var z = DecodeVarint(Parse);
+            if (z === null)
+                return null;
+
+            last += (z % 2) ? -(z + 1) / 2 : z / 2;
+            // wrap to int16, as the device does.
+            last = ((last + 0x8000) & 0xFFFF) - 0x8000;
+            samples[i][fields[f]] = last;
+        }
+    }
+
+    if (Parse.i !== Parse.end)
+        return null;
+
+    decoded.samples = samples;
+    return decoded;
+}
+
+/*
+
+Name:   Reassemble()
+
+Function:
+    Add a fragment to the capture being reassembled.
+
+Definition:
+    function Reassemble(state, bytes) -> object
+
+Description:
+    Fragments may come in any order, and repeats are ignored. The device
+    sends one capture at a time, so a fragment of a different capture
+    abandons the one in progress (some of its fragments were lost).
+    state is kept between calls; start with {}.
+
+Returns:
+    The decoded capture when bytes completes one; otherwise null.
+
+*/
+
+function Reassemble(state, bytes) {
+    if (bytes.length < 5 || bytes[0] !== 0x31)
+        return null;
+
+    var id = bytes[1];
+    var index = bytes[2];
+    var count = bytes[3];
+
+    if (count === 0 || index >= count)
+        return null;
+
+    if (state.id !== id || state.count !== count || !state.pieces) {
+        state.id = id;
+        state.count = count;
+        state.pieces = [];
+        state.nHave = 0;
+    }
+
+    if (state.pieces[index])
+        return null;
+
+    state.pieces[index] = Array.prototype.slice.call(bytes, 4);
+    if (++state.nHave !== count)
+        return null;
+
+    var blob = [];
+    for (var i = 0; i < count; ++i)
+        blob = blob.concat(state.pieces[i]);
+    state.pieces = null;
+
+    var decoded = DecodeWaveform(blob);
+    if (decoded !== null) {
+        decoded.captureId = id;
+        decoded.fragments = count;
+    }
+    return decoded;
+}
+
+// end of insertion of catena-waveform-port-3-decoder-node-red.js
+
+/*
+
+Node-RED function body.
+
+Input:
+    msg     the object to be decoded.
+
+            msg.payload_raw is taken
+            as the raw payload if present; otherwise msg.payload
+            is taken to be a raw payload.
+
+            msg.port is taken to be the LoRaWAN port number.
+
+Returns:
+    When a fragment completes a capture, msg with msg.payload changed to
+    the decoded capture and msg.local set to additional
+    application-specific information. Otherwise nothing, so that
+    Node-RED doesn't propagate the message any further.
+
+    The capture in progress is kept in the node context, per device
+    (msg.hardware_serial or msg.dev_id, if present).
+
+*/
+
+if (msg.port !== 3)
+    return;
+
+var bytes;
+
+if ("payload_raw" in msg) {
+    bytes = msg.payload_raw;
+} else {
+    bytes = msg.payload;
+}
+
+var deviceKey = "waveform:" + (msg.hardware_serial || msg.dev_id || "");
+var state = context.get(deviceKey) || {};
+var result = Reassemble(state, bytes);
+
+context.set(deviceKey, state);
+
+if (result === null)
+    return;
+
+msg.payload = result;
+msg.local =
+    {
+        nodeType: "TouchSense-Lorawan",
+        platformType: "Catena 4610",
+        radioType: "Murata",
+        applicationName: "Touch and Proximity Sensor - LoRaWAN"
+    };
+
+return msg;
@@ -0,0 +1,330 @@
+/*
+
+Name:   catena-waveform-port-3-format-test.cpp
+
+Function:
+        Generate, and test the fragmentation and reassembly of, port 3
+        waveform capture uplinks.
+
+Copyright and License:
+        See accompanying LICENSE file
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+Usage:
+        g++ -std=c++14 -O2 -o catena-waveform-port-3-format-test catena-waveform-port-3-format-test.cpp
+
+        catena-waveform-port-3-format-test
+            Print the fragments of a sample capture in hex, one per line,
+            as test vectors for the backend.
+
+        catena-waveform-port-3-format-test --selftest [captures [loss%]]
+            Capture random waveforms, send their fragments through a
+            simulated link that loses (default 10%), duplicates and
+            reorders them, and reassemble. Every capture whose fragments
+            all arrive must decode to exactly the samples captured, and
+            nothing else may decode. Also checks that captures are off
+            until enabled, and that an abandoned upload stops.
+
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "../Catena4610_cWaveformCapture.h"
+
+// the fragment size the device uses: a full uplink buffer.
+using Capture = McciCatena4610::cWaveformCapture<26>;
+using Sample = Capture::Sample;
+using Fragment = std::vector<std::uint8_t>;
+
+bool sameSamples(const std::vector<Sample> &a, const std::vector<Sample> &b)
+    {
+    return a.size() == b.size() &&
+           std::equal(a.begin(), a.end(), b.begin(),
+                [](const Sample &x, const Sample &y)
+                    {
+                    return x.tMs == y.tMs && x.ch1 == y.ch1 && x.ch2 == y.ch2 && x.amplitude == y.amplitude;
+                    });
+    }
+
+struct Waveform
+    {
+    std::uint8_t        captureId;
+    std::vector<Sample> samples;
+    };
+
+// reassembles fragments as the backend does: in any order, ignoring
+// duplicates. The device uploads one capture at a time, so a fragment
+// of another capture (or with another count) abandons the one in
+// progress.
+class Assembler
+    {
+public:
+    // returns true and fills w if f completed a capture.
+    bool put(const Fragment &f, Waveform &w)
+        {
+        if (f.size() < Capture::kFragmentHeaderBytes || f[0] != Capture::kFragmentFormat)
+            return false;
+
+        std::uint8_t const id = f[1];
+        std::uint8_t const index = f[2];
+        std::uint8_t const count = f[3];
+
+        if (count == 0 || index >= count)
+            return false;
+
+        auto &partial = this->m_partial;
+        if (partial.id != id || partial.pieces.size() != count)
+            {
+            partial.id = id;
+            partial.pieces.assign(count, Fragment {});
+            partial.nHave = 0;
+            }
+
+        Fragment &piece = partial.pieces[index];
+        if (! piece.empty())
+            return false;
+
+        piece.assign(f.begin() + Capture::kFragmentHeaderBytes, f.end());
+        if (piece.empty())
+            return false;
+        if (++partial.nHave != count)
+            return false;
+
+        Fragment blob;
+        for (auto const &p : partial.pieces)
+            blob.insert(blob.end(), p.begin(), p.end());
+        partial.pieces.clear();
+
+        Sample samples[Capture::kWindowSamples];
+        Capture::Reason reason;
+        std::uint8_t nPre, nPost;
+
+        if (! Capture::decodeBlob(blob.data(), blob.size(), reason, nPre, nPost, samples))
+            {
+            ++this->m_nBad;
+            return false;
+            }
+
+        w.captureId = id;
+        w.samples.assign(samples, samples + nPre + nPost);
+        return true;
+        }
+
+    unsigned getBadCount() const
+        {
+        return this->m_nBad;
+        }
+
+private:
+    struct Partial
+        {
+        std::uint8_t            id;
+        std::vector<Fragment>   pieces;
+        unsigned                nHave;
+        };
+
+    Partial     m_partial {};
+    unsigned    m_nBad = 0;
+    };
+
+// run one capture: nPreload samples, a trigger, and the post-trigger
+// samples. Returns the window captured, and the fragments.
+std::vector<Sample> capture(
+    Capture &c,
+    std::mt19937 &rng,
+    std::uint32_t &tMs,
+    unsigned nPreload,
+    std::vector<Fragment> &fragments
+    )
+    {
+    std::vector<Sample> pushed;
+    Sample s { tMs, 600, 500, 0 };
+
+    auto const next = [&]()
+        {
+        s.tMs = tMs;
+        s.ch1 = std::int16_t(s.ch1 + int(rng() % 41) - 20);
+        s.ch2 = std::int16_t(s.ch2 + int(rng() % 41) - 20);
+        // now and then a big jump, to exercise the long varints.
+        s.amplitude = (rng() % 16 == 0) ? std::int16_t(rng()) : std::int16_t(s.amplitude + int(rng() % 9) - 4);
+        tMs += 45 + rng() % 11;
+        c.push(s);
+        pushed.push_back(s);
+        };
+
+    for (unsigned i = 0; i < nPreload; ++i)
+        next();
+
+    c.trigger(s.tMs, Capture::Reason::kManual, true);
+    unsigned const nPre = std::min<unsigned>(nPreload, Capture::kPreSamples);
+
+    for (unsigned i = 0; i < Capture::kPostSamples; ++i)
+        next();
+
+    fragments.clear();
+    std::uint8_t buf[26];
+    while (c.hasFragment())
+        {
+        std::size_t const n = c.getFragment(buf);
+        fragments.emplace_back(buf, buf + n);
+        }
+
+    return std::vector<Sample>(pushed.end() - nPre - Capture::kPostSamples, pushed.end());
+    }
+
+int selfTest(unsigned nCaptures, unsigned lossPercent)
+    {
+    std::mt19937 rng(0x31);
+    std::uniform_int_distribution<unsigned> percent(0, 99);
+    Capture c;
+    Assembler a;
+    std::uint32_t tMs = 0xFFFF0000u;     // exercise millis() wrap
+    std::vector<Fragment> fragments;
+    std::vector<Fragment> link;
+    std::map<std::uint8_t, std::vector<Sample>> sent;
+    unsigned nComplete = 0;
+    unsigned nDelivered = 0;
+    unsigned nFail = 0;
+    std::size_t nBlobBytes = 0;
+    std::size_t nFragments = 0;
+
+    c.setEnabled(true);
+    c.setSpikeDelta(0);
+    for (unsigned i = 0; i < nCaptures; ++i)
+        {
+        // no samples may carry over from the last capture.
+        unsigned const nPreload = 1 + rng() % (Capture::kPreSamples + 8);
+        auto const truth = capture(c, rng, tMs, nPreload, fragments);
+        std::uint8_t const id = fragments.front()[1];
+
+        sent[id] = truth;
+        nBlobBytes += c.getStats().lastBlobBytes;
+        nFragments += fragments.size();
+
+        // the link: lose, duplicate, then shuffle neighbours.
+        link.clear();
+        bool fAll = true;
+        for (auto const &f : fragments)
+            {
+            if (percent(rng) < lossPercent)
+                {
+                fAll = false;
+                continue;
+                }
+            link.push_back(f);
+            if (percent(rng) < 5)
+                link.push_back(f);
+            }
+        for (std::size_t j = 1; j < link.size(); ++j)
+            if (percent(rng) < 20)
+                std::swap(link[j - 1], link[j]);
+
+        nComplete += fAll;
+
+        Waveform w;
+        bool fGot = false;
+        for (auto const &f : link)
+            {
+            if (! a.put(f, w))
+                continue;
+
+            fGot = true;
+            ++nDelivered;
+            if (! (w.captureId == id && sameSamples(w.samples, sent[id])))
+                {
+                std::cerr << "capture " << i << ": reassembled the wrong samples\n";
+                ++nFail;
+                }
+            }
+
+        if (fAll != fGot)
+            {
+            std::cerr << "capture " << i << ": " << (fAll ? "complete but not delivered\n" : "delivered but incomplete\n");
+            ++nFail;
+            }
+        }
+
+    // captures are off until enabled.
+    Capture off;
+    off.push(Sample { tMs, 0, 0, 0 });
+    if (off.trigger(tMs, Capture::Reason::kManual, true))
+        {
+        std::cerr << "a new capture triggered before it was enabled\n";
+        ++nFail;
+        }
+
+    // an upload abandoned part way sends nothing more, and the next
+    // capture gets a new number.
+    std::uint8_t buf[26];
+    capture(c, rng, tMs, Capture::kPreSamples, fragments);
+    std::uint8_t const idLast = fragments.front()[1];
+    c.push(Sample { tMs, 0, 0, 0 });
+    c.trigger(tMs++, Capture::Reason::kManual, true);
+    for (unsigned i = 0; i < Capture::kPostSamples; ++i)
+        c.push(Sample { tMs++, 0, 0, 0 });
+    c.getFragment(buf);
+    c.abort();
+    if (c.hasFragment() || c.getStats().nAborted != 1)
+        {
+        std::cerr << "abort left the capture uploading\n";
+        ++nFail;
+        }
+    capture(c, rng, tMs, Capture::kPreSamples, fragments);
+    if (fragments.front()[1] != std::uint8_t(idLast + 2))
+        {
+        std::cerr << "the capture after an abort reused a number\n";
+        ++nFail;
+        }
+
+    nFail += a.getBadCount();
+    std::cout << nCaptures << " captures, " << lossPercent << "% loss: "
+              << nDelivered << " reassembled (" << nComplete << " arrived whole), "
+              << double(nBlobBytes) / nCaptures << " bytes and "
+              << double(nFragments) / nCaptures << " fragments per capture, "
+              << nFail << " failures\n";
+    return nFail == 0 ? 0 : 1;
+    }
+
+int main(int argc, char **argv)
+    {
+    if (argc > 1 && std::strcmp(argv[1], "--selftest") == 0)
+        return selfTest(
+            argc > 2 ? unsigned(std::strtoul(argv[2], nullptr, 0)) : 10000,
+            argc > 3 ? unsigned(std::strtoul(argv[3], nullptr, 0)) : 10
+            );
+
+    std::mt19937 rng(0x31);
+    Capture c;
+    std::uint32_t tMs = 1000;
+    std::vector<Fragment> fragments;
+
+    c.setEnabled(true);
+    c.setSpikeDelta(0);
+    capture(c, rng, tMs, Capture::kPreSamples, fragments);
+    for (auto const &f : fragments)
+        {
+        bool fFirst = true;
+
+        for (auto v : f)
+            {
+            if (! fFirst)
+                std::cout << " ";
+            fFirst = false;
+            std::cout.width(2);
+            std::cout.fill('0');
+            std::cout << std::hex << unsigned(v);
+            }
+        std::cout << std::dec << "\n";
+        }
+
+    return 0;
+    }
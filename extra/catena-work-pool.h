@@ -0,0 +1,198 @@
+/*
+
+Name:   catena-work-pool.h
+
+Function:
+        A work-stealing thread pool, for the host tools.
+
+Copyright and License:
+        See accompanying LICENSE file
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+*/
+
+#ifndef _catena_work_pool_h_
+# define _catena_work_pool_h_
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace CatenaTrace {
+
+/****************************************************************************\
+|
+|   Each worker has its own queue. Work is dealt out round-robin; a worker
+|   takes from the back of its own queue and, when that's empty, steals
+|   from the front of the others', starting with its neighbour. So workers
+|   that finish early take over from ones given the long jobs, and the
+|   queues are rarely contended: a worker only touches another's lock when
+|   it has nothing left of its own.
+|
+|   Jobs shouldn't throw.
+|
+\****************************************************************************/
+
+class WorkPool
+    {
+public:
+    using Job = std::function<void()>;
+
+    // nThreads == 0 means one per hardware thread.
+    explicit WorkPool(unsigned nThreads = 0)
+        : m_iNext(0)
+        , m_nPending(0)
+        , m_fStop(false)
+        {
+        if (nThreads == 0)
+            nThreads = std::thread::hardware_concurrency();
+        if (nThreads == 0)
+            nThreads = 1;
+
+        for (unsigned i = 0; i < nThreads; ++i)
+            this->m_queues.emplace_back(new Queue);
+        for (unsigned i = 0; i < nThreads; ++i)
+            this->m_threads.emplace_back(&WorkPool::worker, this, i);
+        }
+
+    ~WorkPool()
+        {
+            {
+            std::lock_guard<std::mutex> lock(this->m_lock);
+            this->m_fStop = true;
+            }
+        this->m_wake.notify_all();
+        for (auto &t : this->m_threads)
+            t.join();
+        }
+
+    WorkPool(const WorkPool&) = delete;
+    WorkPool& operator=(const WorkPool&) = delete;
+
+    unsigned size() const
+        {
+        return unsigned(this->m_threads.size());
+        }
+
+    void submit(Job job)
+        {
+        Queue &q = *this->m_queues[this->m_iNext++ % this->m_queues.size()];
+
+        this->m_nPending.fetch_add(1);
+            {
+            std::lock_guard<std::mutex> lock(q.lock);
+            q.jobs.push_back(std::move(job));
+            }
+            {
+            // taken so a worker can't miss the wakeup between checking
+            // for work and waiting.
+            std::lock_guard<std::mutex> lock(this->m_lock);
+            }
+        this->m_wake.notify_one();
+        }
+
+    // wait for every job submitted so far to finish.
+    void wait()
+        {
+        std::unique_lock<std::mutex> lock(this->m_lock);
+
+        this->m_done.wait(lock, [this] { return this->m_nPending.load() == 0; });
+        }
+
+private:
+    struct Queue
+        {
+        std::mutex          lock;
+        std::deque<Job>     jobs;
+        };
+
+    bool take(unsigned iSelf, Job &job)
+        {
+        std::size_t const n = this->m_queues.size();
+
+        for (std::size_t i = 0; i < n; ++i)
+            {
+            Queue &q = *this->m_queues[(iSelf + i) % n];
+            std::lock_guard<std::mutex> lock(q.lock);
+
+            if (q.jobs.empty())
+                continue;
+
+            if (i == 0)
+                {
+                job = std::move(q.jobs.back());
+                q.jobs.pop_back();
+                }
+            else
+                {
+                job = std::move(q.jobs.front());
+                q.jobs.pop_front();
+                }
+            return true;
+            }
+
+        return false;
+        }
+
+    void worker(unsigned iSelf)
+        {
+        Job job;
+
+        for (;;)
+            {
+            if (this->take(iSelf, job))
+                {
+                job();
+                job = nullptr;
+                if (this->m_nPending.fetch_sub(1) == 1)
+                    {
+                    std::lock_guard<std::mutex> lock(this->m_lock);
+                    this->m_done.notify_all();
+                    }
+                continue;
+                }
+
+            std::unique_lock<std::mutex> lock(this->m_lock);
+            if (this->m_fStop)
+                return;
+            // recheck under the lock; submit() takes it before notifying.
+            if (this->hasWork())
+                continue;
+            this->m_wake.wait(lock);
+            }
+        }
+
+    bool hasWork()
+        {
+        for (auto &p : this->m_queues)
+            {
+            std::lock_guard<std::mutex> lock(p->lock);
+            if (! p->jobs.empty())
+                return true;
+            }
+        return false;
+        }
+
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    std::vector<std::thread>            m_threads;
+    std::mutex                          m_lock;
+    std::condition_variable             m_wake;
+    std::condition_variable             m_done;
+    std::size_t                         m_iNext;
+    std::atomic<std::size_t>            m_nPending;
+    bool                                m_fStop;
+    };
+
+} // namespace CatenaTrace
+
+#endif /* _catena_work_pool_h_ */
@@ -0,0 +1,88 @@
+/*
+
+Name:   Catena_Mx25v8035f.h
+
+Function:
+        Host stand-in for the Catena library's MX25V8035F flash driver,
+        so the sketch's flash users can be built into host tools.
+
+Copyright and License:
+        See accompanying LICENSE file
+
+Author:
+        Pranau R, MCCI Corporation   May 2023
+
+Usage:
+        Put this directory ahead of the Catena library, e.g.
+
+            g++ -std=c++14 -I host ...
+
+        The flash is held in memory and behaves as the part does: an erase
+        sets a sector to 0xFF, and a program can only clear bits. Bytes
+        programmed and sectors erased are counted, by sector.
+
+*/
+
+#ifndef _Catena_Mx25v8035f_h_
+# define _Catena_Mx25v8035f_h_
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace McciCatena {
+
+class Catena_Mx25v8035f
+    {
+public:
+    static constexpr std::uint32_t SECTOR_SIZE = 4096;
+    static constexpr std::uint32_t PAGE_SIZE = 256;
+    static constexpr std::uint32_t CHIP_SIZE = 1024 * 1024;
+
+    Catena_Mx25v8035f()
+        : m_mem(CHIP_SIZE, 0xFF)
+        , m_erases(CHIP_SIZE / SECTOR_SIZE, 0)
+        , m_nProgrammed(0)
+        , m_nPrograms(0)
+        {}
+
+    void powerDown() {}
+    void powerUp() {}
+
+    void read(std::uint32_t addr, std::uint8_t *p, std::size_t n)
+        {
+        std::memcpy(p, &this->m_mem[addr], n);
+        }
+
+    void program(std::uint32_t addr, const std::uint8_t *p, std::size_t n)
+        {
+        for (std::size_t i = 0; i < n; ++i)
+            this->m_mem[addr + i] &= p[i];
+        this->m_nProgrammed += n;
+        ++this->m_nPrograms;
+        }
+
+    void eraseSector(std::uint32_t addr)
+        {
+        addr -= addr % SECTOR_SIZE;
+        std::memset(&this->m_mem[addr], 0xFF, SECTOR_SIZE);
+        ++this->m_erases[addr / SECTOR_SIZE];
+        }
+
+    std::uint64_t getBytesProgrammed() const { return this->m_nProgrammed; }
+    std::uint32_t getPrograms() const { return this->m_nPrograms; }
+    std::uint32_t getErases(std::uint32_t addr) const { return this->m_erases[addr / SECTOR_SIZE]; }
+
+private:
+    std::vector<std::uint8_t>   m_mem;
+    std::vector<std::uint32_t>  m_erases;
+    std::uint64_t               m_nProgrammed;
+    std::uint32_t               m_nPrograms;
+    };
+
+} // namespace McciCatena
+
+#endif /* _Catena_Mx25v8035f_h_ */
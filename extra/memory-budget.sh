@@ -0,0 +1,96 @@
+#!/bin/sh
+
+#
+# Module:  memory-budget.sh
+#
+# Function:
+#       Report static RAM and flash use of the sketch, per object file and
+#       per symbol, and fail if the totals exceed the budget.
+#
+# Copyright and License:
+#       See accompanying LICENSE file
+#
+# Author:
+#       Pranau R, MCCI Corporation   May 2023
+#
+# Usage:
+#       arduino-cli compile --build-path build ...
+#       extra/memory-budget.sh [-r ramBudget] [-f flashBudget] [-n nSymbols] build
+#
+#       The defaults suit the STM32L082 on the Catena 4801: 192 KiB of
+#       flash, and 20 KiB of RAM less 2 KiB held back for stack and heap.
+#       RAM and flash use are as reported by `size`: flash is text + data,
+#       RAM is data + bss.
+#
+# Exit status:
+#       0 if within budget, 1 if over budget, 2 for usage errors.
+#
+
+PNAME="$(basename "$0")"
+
+RAM_BUDGET=${RAM_BUDGET:-$((18 * 1024))}
+FLASH_BUDGET=${FLASH_BUDGET:-$((192 * 1024))}
+NSYMBOLS=${NSYMBOLS:-20}
+CROSS=${CROSS-arm-none-eabi-}
+
+_usage() {
+	echo "usage: $PNAME [-r ramBudget] [-f flashBudget] [-n nSymbols] buildDir" 1>&2
+	exit 2
+}
+
+while getopts "r:f:n:h" opt; do
+	case "$opt" in
+	r) RAM_BUDGET="$OPTARG" ;;
+	f) FLASH_BUDGET="$OPTARG" ;;
+	n) NSYMBOLS="$OPTARG" ;;
+	*) _usage ;;
+	esac
+done
+shift $((OPTIND - 1))
+
+[ $# -eq 1 ] || _usage
+BUILD="$1"
+
+ELF="$(ls "$BUILD"/*.ino.elf 2>/dev/null | head -n 1)"
+if [ -z "$ELF" ]; then
+	echo "$PNAME: no .ino.elf in $BUILD" 1>&2
+	exit 2
+fi
+
+if ! command -v "${CROSS}size" > /dev/null; then
+	echo "$PNAME: ${CROSS}size not found; set CROSS to the toolchain prefix" 1>&2
+	exit 2
+fi
+
+echo "== per object (sketch) =="
+printf "%8s %8s %8s  %s\n" "flash" "ram" "bss" "object"
+for OBJ in "$BUILD"/sketch/*.o; do
+	[ -f "$OBJ" ] || continue
+	"${CROSS}size" "$OBJ" | awk -v obj="$(basename "$OBJ")" \
+		'NR == 2 { printf "%8d %8d %8d  %s\n", $1 + $2, $2 + $3, $3, obj }'
+done
+
+echo
+echo "== largest RAM symbols =="
+"${CROSS}nm" -C -S --size-sort --radix=d "$ELF" |
+	awk '$3 ~ /^[bBdD]$/ { print }' | tail -n "$NSYMBOLS" | sort -rn -k2
+
+echo
+echo "== largest flash symbols =="
+"${CROSS}nm" -C -S --size-sort --radix=d "$ELF" |
+	awk '$3 ~ /^[tTrR]$/ { print }' | tail -n "$NSYMBOLS" | sort -rn -k2
+
+echo
+eval "$("${CROSS}size" "$ELF" | awk 'NR == 2 { printf "FLASH=%d RAM=%d\n", $1 + $2, $2 + $3 }')"
+printf "== total: flash %d / %d, ram %d / %d ==\n" "$FLASH" "$FLASH_BUDGET" "$RAM" "$RAM_BUDGET"
+
+STATUS=0
+if [ "$FLASH" -gt "$FLASH_BUDGET" ]; then
+	echo "$PNAME: flash over budget by $((FLASH - FLASH_BUDGET)) bytes" 1>&2
+	STATUS=1
+fi
+if [ "$RAM" -gt "$RAM_BUDGET" ]; then
+	echo "$PNAME: RAM over budget by $((RAM - RAM_BUDGET)) bytes" 1>&2
+	STATUS=1
+fi
+exit $STATUS